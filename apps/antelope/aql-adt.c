@@ -86,6 +86,7 @@ aql_clear(aql_adt_t *adt)
   adt->relation_count = 0;
   adt->attribute_count = 0;
   adt->value_count = 0;
+  adt->parameter_count = 0;
   adt->flags = 0;
   memset(adt->aggregators, 0, sizeof(adt->aggregators));
 }
@@ -147,3 +148,34 @@ aql_add_value(aql_adt_t *adt, domain_t domain, void *value_ptr)
 
   return DB_OK;
 }
+
+db_result_t
+aql_add_parameter(aql_adt_t *adt, uint8_t position)
+{
+  if(adt->parameter_count == AQL_PARAMETER_LIMIT) {
+    return DB_LIMIT_ERROR;
+  }
+
+  adt->parameters[adt->parameter_count++] = position;
+
+  return DB_OK;
+}
+
+db_result_t
+aql_add_group(aql_adt_t *adt, char *name)
+{
+  int i;
+
+  /* Only projected attributes without an aggregator can be grouped on. */
+  for(i = 0; i < AQL_ATTRIBUTE_COUNT(adt); i++) {
+    if(adt->aggregators[i] == AQL_NONE &&
+       !(adt->attributes[i].flags & ATTRIBUTE_FLAG_NO_STORE) &&
+       strcmp(adt->attributes[i].name, name) == 0) {
+      adt->attributes[i].flags |= ATTRIBUTE_FLAG_GROUP;
+      AQL_SET_FLAG(adt, AQL_FLAG_GROUP);
+      return DB_OK;
+    }
+  }
+
+  return DB_NAME_ERROR;
+}
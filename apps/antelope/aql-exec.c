@@ -44,13 +44,32 @@
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
 
+#include "lib/memb.h"
+
 #include "index.h"
+#include "lvm.h"
 #include "relation.h"
 #include "result.h"
 #include "aql.h"
 
+/*
+ * A prepared statement keeps the parsed query, including its own copies
+ * of the condition bytecode, the names of the variables referenced by
+ * the bytecode, and the string values, which otherwise reside in
+ * buffers that are reused by the next parsing.
+ */
+struct db_statement {
+  aql_adt_t adt;
+  lvm_instance_t lvm_instance;
+  unsigned char vmcode[DB_VM_BYTECODE_SIZE];
+  char variables[LVM_MAX_VARIABLE_ID][LVM_MAX_NAME_LENGTH + 1];
+  char strings[DB_MAX_CHAR_SIZE_PER_ROW];
+};
+
 static aql_adt_t adt;
 
+MEMB(statement_memb, db_statement_t, DB_STATEMENT_POOL_SIZE);
+
 static void
 clear_handle(db_handle_t *handle)
 {
@@ -112,7 +131,9 @@ aql_execute(db_handle_t *handle, aql_adt_t *adt)
     result = index_create(AQL_GET_INDEX_TYPE(adt), rel, relattr);
     break;
   case AQL_TYPE_CREATE_RELATION:
-    if(relation_create(adt->relations[0], DB_STORAGE) != NULL) {
+    if(relation_create(adt->relations[0], DB_STORAGE,
+                       AQL_GET_FLAGS(adt) & AQL_FLAG_COLUMNAR ?
+                       DB_FORMAT_COLUMN : DB_FORMAT_ROW) != NULL) {
       result = DB_OK;
     }
     break;
@@ -210,6 +231,114 @@ db_query(db_handle_t *handle, const char *format, ...)
   return aql_execute(handle, &adt);
 }
 
+db_statement_t *
+db_prepare(const char *format, ...)
+{
+  va_list ap;
+  char query_string[AQL_MAX_QUERY_LENGTH];
+  db_statement_t *statement;
+  lvm_instance_t *lvm_instance;
+  attribute_value_t *value;
+  char *name;
+  size_t offset;
+  size_t length;
+  int i;
+
+  va_start(ap, format);
+  vsnprintf(query_string, sizeof(query_string), format, ap);
+  va_end(ap);
+
+  statement = memb_alloc(&statement_memb);
+  if(statement == NULL) {
+    PRINTF("DB: No more prepared statements available\n");
+    return NULL;
+  }
+
+  if(AQL_ERROR(aql_parse(&statement->adt, query_string))) {
+    memb_free(&statement_memb, statement);
+    return NULL;
+  }
+
+  lvm_instance = statement->adt.lvm_instance;
+  if(lvm_instance != NULL) {
+    lvm_clone(&statement->lvm_instance, lvm_instance);
+    memcpy(statement->vmcode, lvm_instance->code, sizeof(statement->vmcode));
+    statement->lvm_instance.code = statement->vmcode;
+    AQL_SET_CONDITION(&statement->adt, &statement->lvm_instance);
+  }
+
+  memset(statement->variables, 0, sizeof(statement->variables));
+  for(i = 0; i < LVM_MAX_VARIABLE_ID; i++) {
+    name = lvm_get_variable_name(i);
+    if(name == NULL) {
+      break;
+    }
+    strcpy(statement->variables[i], name);
+  }
+
+  offset = 0;
+  for(i = 0; i < statement->adt.value_count; i++) {
+    value = &statement->adt.values[i];
+    if(value->domain == DOMAIN_STRING) {
+      length = strlen((char *)VALUE_STRING(value)) + 1;
+      memcpy(&statement->strings[offset], VALUE_STRING(value), length);
+      VALUE_STRING(value) = (unsigned char *)&statement->strings[offset];
+      offset += length;
+    }
+  }
+
+  PRINTF("DB: Prepared a statement with %u parameters\n",
+         (unsigned)statement->adt.parameter_count);
+
+  return statement;
+}
+
+db_result_t
+db_bind_long(db_statement_t *statement, unsigned parameter, long value)
+{
+  uint8_t position;
+
+  if(parameter >= statement->adt.parameter_count) {
+    return DB_ARGUMENT_ERROR;
+  }
+
+  position = statement->adt.parameters[parameter];
+  if(position & AQL_PARAMETER_VALUE) {
+    VALUE_LONG(&statement->adt.values[position & ~AQL_PARAMETER_VALUE]) = value;
+  } else if(statement->adt.lvm_instance == NULL ||
+            LVM_ERROR(lvm_replace_long(statement->adt.lvm_instance,
+                                       position, value))) {
+    return DB_IMPLEMENTATION_ERROR;
+  }
+
+  return DB_OK;
+}
+
+db_result_t
+db_execute(db_handle_t *handle, db_statement_t *statement)
+{
+  int i;
+
+  if(handle != NULL) {
+    clear_handle(handle);
+  }
+
+  /* Restore the variables of the condition, in case another query has 
+     been parsed since the statement was prepared. */
+  lvm_clear_variables();
+  for(i = 0; i < LVM_MAX_VARIABLE_ID && statement->variables[i][0] != '\0'; i++) {
+    lvm_register_variable(statement->variables[i], LVM_LONG);
+  }
+
+  return aql_execute(handle, &statement->adt);
+}
+
+void
+db_finalize(db_statement_t *statement)
+{
+  memb_free(&statement_memb, statement);
+}
+
 db_result_t
 db_process(db_handle_t *handle)
 {
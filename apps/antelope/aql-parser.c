@@ -107,6 +107,10 @@ static aql_adt_t *adt;
 static lvm_instance_t p;
 static unsigned char vmcode[DB_VM_BYTECODE_SIZE];
 
+/* The number of operands set in the bytecode, which locates the operand
+   of a parameter in the code. */
+static uint8_t operand_count;
+
 /* Parsing functions for AQL. */
 PARSER_TOKEN(cmp)
 {
@@ -241,7 +245,10 @@ PARSER(relations)
 
 PARSER(values)
 {
+  long unbound_value;
+
   /* Parse comma-separated attribute values. */
+  unbound_value = 0;
   NEXT;
   switch(TOKEN) {
   case STRING_VALUE:
@@ -250,6 +257,13 @@ PARSER(values)
   case INTEGER_VALUE:
     AQL_ADD_VALUE(adt, DOMAIN_INT, VALUE);
     break;
+  case PARAMETER:
+    if(DB_ERROR(AQL_ADD_PARAMETER(adt,
+                                  AQL_PARAMETER_VALUE | adt->value_count))) {
+      RETURN(SYNTAX_ERROR);
+    }
+    AQL_ADD_VALUE(adt, DOMAIN_INT, &unbound_value);
+    break;
   default:
     RETURN(SYNTAX_ERROR);
   }
@@ -272,6 +286,7 @@ PARSER(operand)
     lvm_register_variable(VALUE, LVM_LONG);
     lvm_set_variable(&p, VALUE);
     AQL_ADD_PROCESSING_ATTRIBUTE(adt, VALUE);
+    operand_count++;
     break;
   case STRING_VALUE:
     break;
@@ -279,6 +294,14 @@ PARSER(operand)
     break;
   case INTEGER_VALUE:
     lvm_set_long(&p, *(long *)lexer->value);
+    operand_count++;
+    break;
+  case PARAMETER:
+    if(DB_ERROR(AQL_ADD_PARAMETER(adt, operand_count))) {
+      RETURN(SYNTAX_ERROR);
+    }
+    lvm_set_long(&p, 0);
+    operand_count++;
     break;
   default:
     RETURN(SYNTAX_ERROR);
@@ -479,8 +502,31 @@ PARSER(join)
   RETURN(OK);
 }
 
+PARSER(group)
+{
+  /* Parse comma-separated attributes to group on. */
+  CONSUME(IDENTIFIER);
+
+  if(DB_ERROR(AQL_ADD_GROUP(adt, VALUE))) {
+    RETURN(SYNTAX_ERROR);
+  }
+
+  NEXT;
+  if(TOKEN == COMMA) {
+    if(!PARSE(group)) {
+      RETURN(SYNTAX_ERROR);
+    }
+  } else {
+    REWIND;
+  }
+
+  RETURN(OK);
+}
+
 PARSER(select)
 {
+  int clauses;
+
   AQL_SET_TYPE(adt, AQL_TYPE_SELECT);
 
   /* projection attributes... */
@@ -493,17 +539,35 @@ PARSER(select)
     RETURN(SYNTAX_ERROR);
   }
 
+  clauses = 0;
+
   NEXT;
   if(TOKEN == WHERE) {
     lvm_reset(&p, vmcode, sizeof(vmcode));
+    operand_count = 0;
 
     if(!PARSE(where)) {
       RETURN(SYNTAX_ERROR);
     }
 
     AQL_SET_CONDITION(adt, &p);
+    clauses++;
   } else {
     REWIND;
+  }
+
+  NEXT;
+  if(TOKEN == GROUP) {
+    CONSUME(BY);
+    if(!PARSE(group)) {
+      RETURN(SYNTAX_ERROR);
+    }
+    clauses++;
+  } else {
+    REWIND;
+  }
+
+  if(clauses == 0) {
     RETURN(OK);
   }
 
@@ -563,6 +627,7 @@ PARSER(remove_from)
   CONSUME(WHERE);
 
   lvm_reset(&p, vmcode, sizeof(vmcode));
+  operand_count = 0;
   AQL_SET_CONDITION(adt, &p);
 
   return PARSE(where);
@@ -645,6 +710,9 @@ PARSER_TOKEN(index_type)
   case MEMHASH:
     type = INDEX_MEMHASH;
     break;
+  case BTREE:
+    type = INDEX_BTREE;
+    break;
   default:
     return NONE;
   };
@@ -682,6 +750,15 @@ PARSER(create_relation)
   AQL_SET_TYPE(adt, AQL_TYPE_CREATE_RELATION);
   AQL_ADD_RELATION(adt, VALUE);
 
+  /* The relation may optionally be stored column by column. */
+  NEXT;
+  if(TOKEN == TYPE) {
+    CONSUME(COLUMNAR);
+    AQL_SET_FLAG(adt, AQL_FLAG_COLUMNAR);
+  } else {
+    REWIND;
+  }
+
   RETURN(OK);
 }
 
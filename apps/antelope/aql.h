@@ -104,6 +104,11 @@ enum token {
   MEMHASH = 46,
   RELATION = 47,
   ATTRIBUTE = 48,
+  BTREE = 49,
+  PARAMETER = 50,
+  GROUP = 51,
+  BY = 52,
+  COLUMNAR = 53,
 
   INTEGER_VALUE = 251,
   FLOAT_VALUE = 252,
@@ -150,7 +155,10 @@ struct aql_adt {
   aql_attribute_t attributes[AQL_ATTRIBUTE_LIMIT];
   aql_aggregator_t aggregators[AQL_ATTRIBUTE_LIMIT];
   attribute_value_t values[AQL_ATTRIBUTE_LIMIT];
+  /* The positions of the parameters in the values or the condition. */
+  uint8_t parameters[AQL_PARAMETER_LIMIT];
   index_type_t index_type;
+  uint8_t parameter_count;
   uint8_t relation_count;
   uint8_t attribute_count;
   uint8_t value_count;
@@ -179,6 +187,11 @@ typedef struct aql_adt aql_adt_t;
 #define AQL_FLAG_AGGREGATE		1
 #define AQL_FLAG_ASSIGN			2
 #define AQL_FLAG_INVERSE_LOGIC		4
+#define AQL_FLAG_GROUP			8
+#define AQL_FLAG_COLUMNAR		16
+
+/* A parameter that is an inserted value rather than a condition operand. */
+#define AQL_PARAMETER_VALUE		0x80
 
 #define AQL_CLEAR(adt)			aql_clear(adt)
 #define AQL_SET_TYPE(adt, type)	(((adt))->optype = (type))
@@ -204,6 +217,10 @@ typedef struct aql_adt aql_adt_t;
 #define AQL_SET_CONDITION(adt, cond)	((adt)->lvm_instance = (cond))
 #define AQL_ADD_VALUE(adt, domain, value)				\
     aql_add_value((adt), (domain), (value))
+#define AQL_ADD_PARAMETER(adt, position)				\
+    aql_add_parameter((adt), (position))
+#define AQL_ADD_GROUP(adt, attr)					\
+    aql_add_group((adt), (attr))
 
 int lexer_start(lexer_t *, char *, token_t *, value_t *);
 int lexer_next(lexer_t *);
@@ -215,7 +232,17 @@ db_result_t aql_add_attribute(aql_adt_t *adt, char *name,
                                domain_t domain, unsigned element_size,
                                int processed_only);
 db_result_t aql_add_value(aql_adt_t *adt, domain_t domain, void *value);
+db_result_t aql_add_parameter(aql_adt_t *adt, uint8_t position);
+db_result_t aql_add_group(aql_adt_t *adt, char *name);
 db_result_t db_query(db_handle_t *handle, const char *format, ...);
 db_result_t db_process(db_handle_t *handle);
 
+typedef struct db_statement db_statement_t;
+
+db_statement_t *db_prepare(const char *format, ...);
+db_result_t db_bind_long(db_statement_t *statement, unsigned parameter,
+                         long value);
+db_result_t db_execute(db_handle_t *handle, db_statement_t *statement);
+void db_finalize(db_statement_t *statement);
+
 #endif /* !AQL_H */
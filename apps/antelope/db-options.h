@@ -49,11 +49,22 @@
 #define DB_FEATURE_JOIN			1
 #endif /* DB_FEATURE_JOIN */
 
+/* Support grouped aggregation in selections. */
+#ifndef DB_FEATURE_GROUP
+#define DB_FEATURE_GROUP		1
+#endif /* DB_FEATURE_GROUP */
+
 /* Support tuple removals. */
 #ifndef DB_FEATURE_REMOVE
 #define DB_FEATURE_REMOVE		1
 #endif /* DB_FEATURE_REMOVE */
 
+/* Support relations that are stored column by column in compressed
+   segments. A columnar relation needs a storage buffer when loaded. */
+#ifndef DB_FEATURE_COLUMNAR
+#define DB_FEATURE_COLUMNAR		(DB_STORAGE_BUFFER_SIZE > 0)
+#endif /* DB_FEATURE_COLUMNAR */
+
 /* Support floating-point values in attributes. */
 #ifndef DB_FEATURE_FLOATS
 #define DB_FEATURE_FLOATS		0
@@ -88,6 +99,11 @@
 #define DB_RELATION_POOL_SIZE		5
 #endif /* DB_RELATION_POOL_SIZE */
 
+/* The maximum number of prepared statements. */
+#ifndef DB_STATEMENT_POOL_SIZE
+#define DB_STATEMENT_POOL_SIZE		2
+#endif /* DB_STATEMENT_POOL_SIZE */
+
 /* The maximum number of attributes loaded in memory. */
 #ifndef DB_ATTRIBUTE_POOL_SIZE
 #define DB_ATTRIBUTE_POOL_SIZE		16
@@ -110,6 +126,21 @@
 #define DB_VM_BYTECODE_SIZE		128
 #endif /* DB_VM_BYTECODE_SIZE */
 
+/* The size of the buffer used for reading ahead and for batching
+   inserted rows in a relation. Preferably a multiple of the flash
+   page size. Set to 0 to access rows one at a time. */
+#ifndef DB_STORAGE_BUFFER_SIZE
+#define DB_STORAGE_BUFFER_SIZE		256
+#endif /* DB_STORAGE_BUFFER_SIZE */
+
+/* The maximum number of loaded relations that can have a storage
+   buffer at the same time. A columnar relation holds one decoded
+   segment in its buffer, so the buffer size also determines the
+   number of rows per segment. */
+#ifndef DB_STORAGE_BUFFER_LIMIT
+#define DB_STORAGE_BUFFER_LIMIT		2
+#endif /* DB_STORAGE_BUFFER_LIMIT */
+
 /*----------------------------------------------------------------------------*/
 
 /* Language options. */
@@ -133,6 +164,11 @@
 #define AQL_ATTRIBUTE_LIMIT    		5
 #endif /* AQL_ATTRIBUTE_LIMIT */
 
+/* The maximum number of parameters ("?") in a prepared statement. */
+#ifndef AQL_PARAMETER_LIMIT
+#define AQL_PARAMETER_LIMIT		4
+#endif /* AQL_PARAMETER_LIMIT */
+
 /*----------------------------------------------------------------------------*/
 
 /*
@@ -191,10 +227,27 @@
 #define DB_MEMHASH_INDEX_LIMIT  	1
 #endif /* DB_MEMHASH_INDEX_LIMIT */
 
-/* The default hash table index size. */
-#ifndef DB_MEMHASH_TABLE_SIZE
-#define DB_MEMHASH_TABLE_SIZE		61
-#endif /* DB_MEMHASH_TABLE_SIZE */
+/* The number of buckets in each segment of a hash table index. A hash
+   table starts with one segment, and grows one bucket at a time. */
+#ifndef DB_MEMHASH_SEGMENT_SIZE
+#define DB_MEMHASH_SEGMENT_SIZE		8
+#endif /* DB_MEMHASH_SEGMENT_SIZE */
+
+/* The number of bucket segments shared by all hash table indexes. */
+#ifndef DB_MEMHASH_SEGMENT_LIMIT
+#define DB_MEMHASH_SEGMENT_LIMIT	4
+#endif /* DB_MEMHASH_SEGMENT_LIMIT */
+
+/* The number of entries shared by all hash table indexes. */
+#ifndef DB_MEMHASH_ENTRY_LIMIT
+#define DB_MEMHASH_ENTRY_LIMIT		64
+#endif /* DB_MEMHASH_ENTRY_LIMIT */
+
+/* The average number of entries per bucket at which a hash table
+   index grows by another bucket. */
+#ifndef DB_MEMHASH_LOAD_FACTOR
+#define DB_MEMHASH_LOAD_FACTOR		2
+#endif /* DB_MEMHASH_LOAD_FACTOR */
 
 /* The maximum number of Maxheap indexes. */
 #ifndef DB_HEAP_INDEX_LIMIT
@@ -206,6 +259,87 @@
 #define DB_HEAP_CACHE_LIMIT		1
 #endif /* DB_HEAP_CACHE_LIMIT */
 
+/* The maximum number of B+-tree indexes. */
+#ifndef DB_BTREE_INDEX_LIMIT
+#define DB_BTREE_INDEX_LIMIT		1
+#endif /* DB_BTREE_INDEX_LIMIT */
+
+/* The size in bytes of a B+-tree page. */
+#ifndef DB_BTREE_PAGE_SIZE
+#define DB_BTREE_PAGE_SIZE		256
+#endif /* DB_BTREE_PAGE_SIZE */
+
+/* The number of B+-tree pages cached in RAM. At least two pages
+   are needed to split a node. */
+#ifndef DB_BTREE_CACHE_LIMIT
+#define DB_BTREE_CACHE_LIMIT		3
+#endif /* DB_BTREE_CACHE_LIMIT */
+
+/* The space reserved for a new B+-tree file. The file grows beyond
+   this size if necessary. */
+#ifndef DB_BTREE_RESERVE_SIZE
+#define DB_BTREE_RESERVE_SIZE		8192
+#endif /* DB_BTREE_RESERVE_SIZE */
+
+/* The number of keys sorted in RAM at a time when a B+-tree index
+   is bulk-loaded from an existing relation. Longer relations are
+   sorted by merging runs of this length from a file, and the same
+   memory is then used for the merge buffers. */
+#ifndef DB_BTREE_BULK_ENTRIES
+#define DB_BTREE_BULK_ENTRIES		32
+#endif /* DB_BTREE_BULK_ENTRIES */
+
+/*----------------------------------------------------------------------------*/
+
+/* Join options. */
+
+/* The memory budget in bytes for the rows of the build relation in a
+   hash join or block nested-loop join without an index. */
+#ifndef DB_JOIN_MEMORY
+#define DB_JOIN_MEMORY			512
+#endif /* DB_JOIN_MEMORY */
+
+/* The number of hash buckets used for the rows in the join memory. */
+#ifndef DB_JOIN_HASH_BUCKETS
+#define DB_JOIN_HASH_BUCKETS		16
+#endif /* DB_JOIN_HASH_BUCKETS */
+
+/* The maximum number of partition files per relation when a hash join
+   spills to storage. Each partition file is open while the relation
+   is partitioned. Set to 0 to use block nested loops instead. */
+#ifndef DB_JOIN_PARTITIONS
+#define DB_JOIN_PARTITIONS		3
+#endif /* DB_JOIN_PARTITIONS */
+
+/* The cost of writing a row to a partition file relative to reading
+   a row, used when deciding whether to spill. */
+#ifndef DB_JOIN_WRITE_COST
+#define DB_JOIN_WRITE_COST		4
+#endif /* DB_JOIN_WRITE_COST */
+
+/*----------------------------------------------------------------------------*/
+
+/* Grouping options. */
+
+/* The memory budget in bytes for the groups of a GROUP BY selection.
+   When the groups do not fit, they are sorted and spilled to storage
+   as runs that are merged when the selection has been processed. */
+#ifndef DB_GROUP_MEMORY
+#define DB_GROUP_MEMORY			512
+#endif /* DB_GROUP_MEMORY */
+
+/* The number of hash buckets used for the groups in memory. */
+#ifndef DB_GROUP_HASH_BUCKETS
+#define DB_GROUP_HASH_BUCKETS		16
+#endif /* DB_GROUP_HASH_BUCKETS */
+
+/* The maximum number of spilled runs that are merged at once. When
+   this number is reached, the runs are merged into a single run.
+   The maximum value is 8. */
+#ifndef DB_GROUP_RUN_LIMIT
+#define DB_GROUP_RUN_LIMIT		4
+#endif /* DB_GROUP_RUN_LIMIT */
+
 /*----------------------------------------------------------------------------*/
 
 /* LVM options. */
@@ -216,10 +350,10 @@
 #define LVM_MAX_NAME_LENGTH		ATTRIBUTE_NAME_LENGTH
 #endif /* LVM_MAX_NAME_LENGTH */
 
-/* The maximum variable identifier number in the LVM. The default 
-   value corresponds to the highest attribute ID. */
+/* The number of variables in the LVM. The default value allows a
+   condition to refer to as many attributes as a query may select. */
 #ifndef LVM_MAX_VARIABLE_ID
-#define LVM_MAX_VARIABLE_ID		AQL_ATTRIBUTE_LIMIT - 1
+#define LVM_MAX_VARIABLE_ID		AQL_ATTRIBUTE_LIMIT
 #endif /* LVM_MAX_VARIABLE_ID */
 
 /* Specify whether floats should be used or not inside the LVM. */
@@ -227,5 +361,30 @@
 #define LVM_USE_FLOATS			DB_FEATURE_FLOATS
 #endif /* LVM_USE_FLOATS */
 
+/* The maximum number of rows that lvm_execute_batch() evaluates in one
+   call. Each batch needs one column of longs per variable, and some
+   scratch vectors of the same length on the stack. The maximum value
+   is 256. */
+#ifndef LVM_BATCH_SIZE
+#define LVM_BATCH_SIZE			16
+#endif /* LVM_BATCH_SIZE */
+
+/* The memory in bytes for the rows that a full scan with a condition
+   reads ahead, so that the condition is evaluated for up to
+   LVM_BATCH_SIZE rows at once. This costs the read-ahead buffer and
+   LVM_MAX_VARIABLE_ID columns of LVM_BATCH_SIZE longs of static RAM,
+   and a few vectors of LVM_BATCH_SIZE longs of stack per nesting level
+   of the condition, so it is off by default. 128 bytes suit bulk
+   analysis on hosts with plenty of RAM. Batches are not used with
+   floats. */
+#ifndef DB_SELECT_BATCH_MEMORY
+#define DB_SELECT_BATCH_MEMORY		0
+#endif /* DB_SELECT_BATCH_MEMORY */
+
+#if LVM_USE_FLOATS
+#undef DB_SELECT_BATCH_MEMORY
+#define DB_SELECT_BATCH_MEMORY		0
+#endif /* LVM_USE_FLOATS */
+
 
 #endif /* !DB_OPTIONS_H */
@@ -0,0 +1,1173 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *     A B+-tree index stored in fixed-size pages of a CFS file.
+ *
+ *     Inner pages route searches by separator entries, and leaf pages
+ *     hold sorted (key, tuple) entries that are chained from left to 
+ *     right, so that a range search descends once to the first leaf
+ *     and then scans leaves sequentially until the range ends. Since
+ *     entries are ordered by both the key and the tuple ID, duplicate
+ *     keys are handled just like unique keys.
+ *
+ *     Pages are accessed through a small write-back cache that is 
+ *     flushed at the end of each index operation. When an index is
+ *     created over an existing relation, its keys are sorted externally:
+ *     runs that fit in RAM are written to a file and merged. The sorted
+ *     stream then fills the leaves from left to right, and each inner
+ *     level is built from the first entries of the pages below it, so
+ *     that no page is split and all but the rightmost pages are full.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cfs/cfs.h"
+#include "lib/memb.h"
+
+#include "db-options.h"
+#include "index.h"
+#include "result.h"
+#include "storage.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#if DB_BTREE_CACHE_LIMIT < 2
+#error "DB_BTREE_CACHE_LIMIT must be at least 2."
+#endif
+
+/* The runs of a bulk load are merged through buffers of this many
+   entries, which are taken from the bulk_entries array. */
+#define BULK_BUFFER_ENTRIES	4
+#define BULK_FAN_IN		(DB_BTREE_BULK_ENTRIES / BULK_BUFFER_ENTRIES - 1)
+
+#if BULK_FAN_IN < 2
+#error "DB_BTREE_BULK_ENTRIES must be at least 12."
+#endif
+
+#define BTREE_MAGIC		0xb7ee
+#define BTREE_MAX_HEIGHT	8
+#define META_PAGE		0
+#define PAGE_HEADER_SIZE	8
+
+typedef int32_t btree_key_t;
+typedef uint16_t btree_page_id_t;
+
+struct btree_entry {
+  btree_key_t key;
+  tuple_id_t tuple;
+};
+
+#define LEAF_CAPACITY							\
+  ((DB_BTREE_PAGE_SIZE - PAGE_HEADER_SIZE) / sizeof(struct btree_entry))
+#define INNER_CAPACITY							\
+  ((DB_BTREE_PAGE_SIZE - PAGE_HEADER_SIZE - sizeof(btree_page_id_t)) / \
+   (sizeof(struct btree_entry) + sizeof(btree_page_id_t)))
+
+struct btree_page {
+  uint8_t leaf;
+  uint8_t unused;
+  uint16_t count;
+  /* The next leaf to the right, or META_PAGE if there is none. */
+  btree_page_id_t next;
+  uint16_t reserved;
+  union {
+    struct btree_entry entries[LEAF_CAPACITY];
+    struct {
+      /* The first entry in the subtree of children[i + 1]. */
+      struct btree_entry separators[INNER_CAPACITY];
+      btree_page_id_t children[INNER_CAPACITY + 1];
+    } inner;
+  } u;
+};
+
+struct btree_meta {
+  uint16_t magic;
+  btree_page_id_t root;
+  btree_page_id_t page_count;
+  uint8_t height;
+};
+
+struct btree {
+  int fd;
+  struct btree_meta meta;
+  uint8_t meta_dirty;
+};
+typedef struct btree btree_t;
+
+struct page_cache {
+  btree_t *tree;
+  btree_page_id_t page_id;
+  uint8_t dirty;
+  uint16_t last_use;
+  struct btree_page page;
+};
+
+/* A sorted run of entries in a file, read through a small buffer. */
+struct bulk_run {
+  struct btree_entry *buffer;
+  unsigned long next;
+  unsigned long end;
+  uint8_t position;
+  uint8_t count;
+};
+
+struct bulk_load {
+  btree_t *tree;
+  /* The rightmost page of each level, starting from the leaves. */
+  btree_page_id_t levels[BTREE_MAX_HEIGHT];
+  /* The run files of two consecutive merge passes. */
+  db_storage_id_t fds[2];
+  char filename[2][DB_MAX_FILENAME_LENGTH];
+  /* The file that receives the entries, or -1 for the tree. */
+  db_storage_id_t fd;
+  struct btree_entry *buffer;
+  unsigned long written;
+  uint8_t pending;
+};
+
+static struct page_cache page_cache[DB_BTREE_CACHE_LIMIT];
+static uint16_t cache_clock;
+static struct btree_entry bulk_entries[DB_BTREE_BULK_ENTRIES];
+MEMB(btrees, btree_t, DB_BTREE_INDEX_LIMIT);
+
+static db_result_t create(index_t *);
+static db_result_t destroy(index_t *);
+static db_result_t load(index_t *);
+static db_result_t release(index_t *);
+static db_result_t insert(index_t *, attribute_value_t *, tuple_id_t);
+static db_result_t delete(index_t *, attribute_value_t *);
+static tuple_id_t get_next(index_iterator_t *);
+
+index_api_t index_btree = {
+  INDEX_BTREE,
+  INDEX_API_EXTERNAL | INDEX_API_RANGE_QUERIES | INDEX_API_BULK_LOAD,
+  create,
+  destroy,
+  load,
+  release,
+  insert,
+  delete,
+  get_next
+};
+
+static int
+entry_compare(const struct btree_entry *a, const struct btree_entry *b)
+{
+  if(a->key != b->key) {
+    return a->key < b->key ? -1 : 1;
+  }
+  if(a->tuple != b->tuple) {
+    return a->tuple < b->tuple ? -1 : 1;
+  }
+  return 0;
+}
+
+static int
+page_write(btree_t *tree, struct page_cache *cache)
+{
+  if(DB_ERROR(storage_write(tree->fd, &cache->page,
+                            (unsigned long)cache->page_id * DB_BTREE_PAGE_SIZE,
+                            sizeof(cache->page)))) {
+    PRINTF("DB: Failed to write B+-tree page %u\n",
+           (unsigned)cache->page_id);
+    return 0;
+  }
+  cache->dirty = 0;
+  return 1;
+}
+
+static struct page_cache *
+cache_allocate(btree_t *tree, btree_page_id_t page_id)
+{
+  struct page_cache *cache;
+  int i;
+
+  /* Replace the least recently used page. */
+  cache = &page_cache[0];
+  for(i = 0; i < DB_BTREE_CACHE_LIMIT; i++) {
+    if(page_cache[i].tree == NULL) {
+      cache = &page_cache[i];
+      break;
+    }
+    if((uint16_t)(cache_clock - page_cache[i].last_use) >
+       (uint16_t)(cache_clock - cache->last_use)) {
+      cache = &page_cache[i];
+    }
+  }
+
+  if(cache->tree != NULL && cache->dirty &&
+     page_write(cache->tree, cache) == 0) {
+    return NULL;
+  }
+
+  cache->tree = tree;
+  cache->page_id = page_id;
+  cache->dirty = 0;
+  cache->last_use = ++cache_clock;
+  return cache;
+}
+
+static struct page_cache *
+page_get(btree_t *tree, btree_page_id_t page_id)
+{
+  struct page_cache *cache;
+  int i;
+
+  for(i = 0; i < DB_BTREE_CACHE_LIMIT; i++) {
+    if(page_cache[i].tree == tree && page_cache[i].page_id == page_id) {
+      page_cache[i].last_use = ++cache_clock;
+      return &page_cache[i];
+    }
+  }
+
+  cache = cache_allocate(tree, page_id);
+  if(cache == NULL) {
+    return NULL;
+  }
+
+  if(DB_ERROR(storage_read(tree->fd, &cache->page,
+                           (unsigned long)page_id * DB_BTREE_PAGE_SIZE,
+                           sizeof(cache->page)))) {
+    PRINTF("DB: Failed to read B+-tree page %u\n", (unsigned)page_id);
+    cache->tree = NULL;
+    return NULL;
+  }
+
+  return cache;
+}
+
+static struct page_cache *
+page_new(btree_t *tree, uint8_t leaf)
+{
+  struct page_cache *cache;
+
+  if(tree->meta.page_count == (btree_page_id_t)-1) {
+    PRINTF("DB: The B+-tree has no more page IDs\n");
+    return NULL;
+  }
+
+  cache = cache_allocate(tree, tree->meta.page_count);
+  if(cache == NULL) {
+    return NULL;
+  }
+
+  memset(&cache->page, 0, sizeof(cache->page));
+  cache->page.leaf = leaf;
+  cache->dirty = 1;
+
+  tree->meta.page_count++;
+  tree->meta_dirty = 1;
+
+  return cache;
+}
+
+static int
+cache_flush(btree_t *tree)
+{
+  int i;
+
+  for(i = 0; i < DB_BTREE_CACHE_LIMIT; i++) {
+    if(page_cache[i].tree == tree && page_cache[i].dirty &&
+       page_write(tree, &page_cache[i]) == 0) {
+      return 0;
+    }
+  }
+
+  if(tree->meta_dirty) {
+    if(DB_ERROR(storage_write(tree->fd, &tree->meta, 0,
+                              sizeof(tree->meta)))) {
+      return 0;
+    }
+    tree->meta_dirty = 0;
+  }
+
+  return 1;
+}
+
+static void
+cache_invalidate(btree_t *tree)
+{
+  int i;
+
+  for(i = 0; i < DB_BTREE_CACHE_LIMIT; i++) {
+    if(page_cache[i].tree == tree) {
+      page_cache[i].tree = NULL;
+    }
+  }
+}
+
+/* Return the child of an inner page whose subtree may hold the entry. */
+static btree_page_id_t
+inner_child(struct btree_page *page, const struct btree_entry *entry)
+{
+  int low;
+  int high;
+  int mid;
+
+  /* Count the separators that are smaller than or equal to the entry. */
+  low = 0;
+  high = page->count;
+  while(low < high) {
+    mid = (low + high) / 2;
+    if(entry_compare(&page->u.inner.separators[mid], entry) <= 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return page->u.inner.children[low];
+}
+
+/* Return the position of the first leaf entry not smaller than the entry. */
+static int
+leaf_position(struct btree_page *page, const struct btree_entry *entry)
+{
+  int low;
+  int high;
+  int mid;
+
+  low = 0;
+  high = page->count;
+  while(low < high) {
+    mid = (low + high) / 2;
+    if(entry_compare(&page->u.entries[mid], entry) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/* Descend to the leaf that may hold the entry, and optionally record 
+   the inner pages on the way. */
+static btree_page_id_t
+find_leaf(btree_t *tree, const struct btree_entry *entry,
+          btree_page_id_t *path)
+{
+  struct page_cache *cache;
+  btree_page_id_t page_id;
+  int level;
+
+  page_id = tree->meta.root;
+  for(level = 0; level < tree->meta.height - 1; level++) {
+    if(path != NULL) {
+      path[level] = page_id;
+    }
+    cache = page_get(tree, page_id);
+    if(cache == NULL) {
+      return META_PAGE;
+    }
+    page_id = inner_child(&cache->page, entry);
+  }
+  return page_id;
+}
+
+static void
+inner_put(struct btree_page *page, const struct btree_entry *separator,
+          btree_page_id_t child)
+{
+  int i;
+
+  for(i = page->count;
+      i > 0 && entry_compare(&page->u.inner.separators[i - 1], separator) > 0;
+      i--) {
+    page->u.inner.separators[i] = page->u.inner.separators[i - 1];
+    page->u.inner.children[i + 1] = page->u.inner.children[i];
+  }
+  page->u.inner.separators[i] = *separator;
+  page->u.inner.children[i + 1] = child;
+  page->count++;
+}
+
+static void
+leaf_put(struct btree_page *page, int position,
+         const struct btree_entry *entry)
+{
+  memmove(&page->u.entries[position + 1], &page->u.entries[position],
+          (page->count - position) * sizeof(struct btree_entry));
+  page->u.entries[position] = *entry;
+  page->count++;
+}
+
+/* Add a separator for a new child page to the inner pages of the path,
+   splitting them as long as they are full. */
+static int
+insert_separator(btree_t *tree, btree_page_id_t *path, int level,
+                 struct btree_entry separator, btree_page_id_t child)
+{
+  struct page_cache *cache;
+  struct page_cache *new_cache;
+  struct btree_page *page;
+  struct btree_page *new_page;
+  struct btree_entry promoted;
+  int split;
+
+  for(; level >= 0; level--) {
+    cache = page_get(tree, path[level]);
+    if(cache == NULL) {
+      return 0;
+    }
+    page = &cache->page;
+    cache->dirty = 1;
+
+    if(page->count < INNER_CAPACITY) {
+      inner_put(page, &separator, child);
+      return 1;
+    }
+
+    new_cache = page_new(tree, 0);
+    if(new_cache == NULL) {
+      return 0;
+    }
+    new_page = &new_cache->page;
+
+    split = page->count / 2;
+
+    promoted = page->u.inner.separators[split];
+    new_page->count = page->count - split - 1;
+    memcpy(new_page->u.inner.separators, &page->u.inner.separators[split + 1],
+           new_page->count * sizeof(struct btree_entry));
+    memcpy(new_page->u.inner.children, &page->u.inner.children[split + 1],
+           (new_page->count + 1) * sizeof(btree_page_id_t));
+    page->count = split;
+
+    if(entry_compare(&separator, &promoted) < 0) {
+      inner_put(page, &separator, child);
+    } else {
+      inner_put(new_page, &separator, child);
+    }
+
+    separator = promoted;
+    child = new_cache->page_id;
+  }
+
+  /* The root was split, so the tree grows by one level. */
+  if(tree->meta.height == BTREE_MAX_HEIGHT) {
+    PRINTF("DB: The B+-tree has reached its maximum height\n");
+    return 0;
+  }
+
+  new_cache = page_new(tree, 0);
+  if(new_cache == NULL) {
+    return 0;
+  }
+  new_cache->page.count = 1;
+  new_cache->page.u.inner.separators[0] = separator;
+  new_cache->page.u.inner.children[0] = tree->meta.root;
+  new_cache->page.u.inner.children[1] = child;
+
+  tree->meta.root = new_cache->page_id;
+  tree->meta.height++;
+  tree->meta_dirty = 1;
+
+  return 1;
+}
+
+static int
+insert_entry(btree_t *tree, const struct btree_entry *entry)
+{
+  btree_page_id_t path[BTREE_MAX_HEIGHT];
+  btree_page_id_t leaf_id;
+  struct page_cache *cache;
+  struct page_cache *new_cache;
+  struct btree_page *page;
+  struct btree_page *new_page;
+  int position;
+  int split;
+
+  leaf_id = find_leaf(tree, entry, path);
+  if(leaf_id == META_PAGE) {
+    return 0;
+  }
+
+  cache = page_get(tree, leaf_id);
+  if(cache == NULL) {
+    return 0;
+  }
+  page = &cache->page;
+  cache->dirty = 1;
+
+  position = leaf_position(page, entry);
+  if(page->count < LEAF_CAPACITY) {
+    leaf_put(page, position, entry);
+    return 1;
+  }
+
+  new_cache = page_new(tree, 1);
+  if(new_cache == NULL) {
+    return 0;
+  }
+  new_page = &new_cache->page;
+
+  split = page->count / 2;
+
+  new_page->count = page->count - split;
+  memcpy(new_page->u.entries, &page->u.entries[split],
+         new_page->count * sizeof(struct btree_entry));
+  page->count = split;
+  new_page->next = page->next;
+  page->next = new_cache->page_id;
+
+  if(position <= split) {
+    leaf_put(page, position, entry);
+  } else {
+    leaf_put(new_page, position - split, entry);
+  }
+
+  return insert_separator(tree, path, tree->meta.height - 2,
+                          new_page->u.entries[0], new_cache->page_id);
+}
+
+static int
+tree_open(btree_t *tree, const char *filename)
+{
+  /* The pages are rewritten in place, so the file must not be opened
+     with flash-aware I/O semantics through storage_open(). */
+  tree->fd = cfs_open(filename, CFS_READ | CFS_WRITE);
+  return tree->fd >= 0;
+}
+
+/* Add a separator for a new child page to the rightmost page of a level.
+   The levels are filled from left to right, so pages are never split. */
+static int
+bulk_add_separator(struct bulk_load *bulk, int level,
+                   const struct btree_entry *separator, btree_page_id_t child)
+{
+  btree_t *tree;
+  struct page_cache *cache;
+  struct btree_page *page;
+  btree_page_id_t page_id;
+
+  tree = bulk->tree;
+
+  if(level == tree->meta.height) {
+    /* The level below got its second page, so the tree grows. */
+    if(tree->meta.height == BTREE_MAX_HEIGHT) {
+      PRINTF("DB: The B+-tree has reached its maximum height\n");
+      return 0;
+    }
+    cache = page_new(tree, 0);
+    if(cache == NULL) {
+      return 0;
+    }
+    cache->page.u.inner.children[0] = bulk->levels[level - 1];
+    bulk->levels[level] = cache->page_id;
+    tree->meta.height++;
+  } else {
+    cache = page_get(tree, bulk->levels[level]);
+    if(cache == NULL) {
+      return 0;
+    }
+    if(cache->page.count == INNER_CAPACITY) {
+      /* Start a new page, whose subtree begins with the separator. */
+      cache = page_new(tree, 0);
+      if(cache == NULL) {
+        return 0;
+      }
+      cache->page.u.inner.children[0] = child;
+      page_id = cache->page_id;
+      if(!bulk_add_separator(bulk, level + 1, separator, page_id)) {
+        return 0;
+      }
+      bulk->levels[level] = page_id;
+      return 1;
+    }
+  }
+
+  page = &cache->page;
+  page->u.inner.separators[page->count] = *separator;
+  page->u.inner.children[page->count + 1] = child;
+  page->count++;
+  cache->dirty = 1;
+
+  return 1;
+}
+
+/* Append the next entry of the sorted stream to the rightmost leaf. */
+static int
+bulk_add_entry(struct bulk_load *bulk, const struct btree_entry *entry)
+{
+  btree_t *tree;
+  struct page_cache *cache;
+  btree_page_id_t page_id;
+
+  tree = bulk->tree;
+
+  cache = page_get(tree, bulk->levels[0]);
+  if(cache == NULL) {
+    return 0;
+  }
+
+  if(cache->page.count == LEAF_CAPACITY) {
+    /* Chain the full leaf to the new leaf, which gets the next page ID. */
+    cache->page.next = tree->meta.page_count;
+    cache->dirty = 1;
+    cache = page_new(tree, 1);
+    if(cache == NULL) {
+      return 0;
+    }
+    page_id = cache->page_id;
+    if(!bulk_add_separator(bulk, 1, entry, page_id)) {
+      return 0;
+    }
+    bulk->levels[0] = page_id;
+    cache = page_get(tree, page_id);
+    if(cache == NULL) {
+      return 0;
+    }
+  }
+
+  cache->page.u.entries[cache->page.count++] = *entry;
+  cache->dirty = 1;
+
+  return 1;
+}
+
+static int
+bulk_flush(struct bulk_load *bulk)
+{
+  if(bulk->pending > 0) {
+    if(DB_ERROR(storage_write(bulk->fd, bulk->buffer,
+                              bulk->written * sizeof(struct btree_entry),
+                              bulk->pending * sizeof(struct btree_entry)))) {
+      return 0;
+    }
+    bulk->written += bulk->pending;
+    bulk->pending = 0;
+  }
+  return 1;
+}
+
+/* Pass an entry either to the file of the current merge pass or, 
+   in the last pass, to the tree. */
+static int
+bulk_emit(struct bulk_load *bulk, const struct btree_entry *entry)
+{
+  if(bulk->fd < 0) {
+    return bulk_add_entry(bulk, entry);
+  }
+
+  bulk->buffer[bulk->pending++] = *entry;
+  if(bulk->pending == BULK_BUFFER_ENTRIES) {
+    return bulk_flush(bulk);
+  }
+  return 1;
+}
+
+static int
+bulk_open(struct bulk_load *bulk, int slot, unsigned long entries)
+{
+  char *filename;
+
+  filename = storage_generate_file("bsort",
+                                   entries * sizeof(struct btree_entry));
+  if(filename == NULL) {
+    return 0;
+  }
+  strncpy(bulk->filename[slot], filename, DB_MAX_FILENAME_LENGTH - 1);
+  bulk->filename[slot][DB_MAX_FILENAME_LENGTH - 1] = '\0';
+
+  bulk->fd = bulk->fds[slot] = storage_open(bulk->filename[slot]);
+  bulk->written = 0;
+  bulk->pending = 0;
+
+  return bulk->fd >= 0;
+}
+
+static void
+bulk_close(struct bulk_load *bulk, int slot)
+{
+  if(bulk->fds[slot] >= 0) {
+    storage_close(bulk->fds[slot]);
+    bulk->fds[slot] = -1;
+  }
+  if(bulk->filename[slot][0] != '\0') {
+    storage_remove(bulk->filename[slot]);
+    bulk->filename[slot][0] = '\0';
+  }
+}
+
+static int
+run_fill(db_storage_id_t fd, struct bulk_run *run)
+{
+  unsigned count;
+
+  if(run->next == run->end) {
+    return 1;
+  }
+
+  count = BULK_BUFFER_ENTRIES;
+  if(run->end - run->next < count) {
+    count = run->end - run->next;
+  }
+  if(DB_ERROR(storage_read(fd, run->buffer,
+                           run->next * sizeof(struct btree_entry),
+                           count * sizeof(struct btree_entry)))) {
+    return 0;
+  }
+  run->next += count;
+  run->position = 0;
+  run->count = count;
+
+  return 1;
+}
+
+/* Merge groups of BULK_FAN_IN sorted runs from a file into longer runs. */
+static int
+merge_runs(struct bulk_load *bulk, db_storage_id_t fd,
+           unsigned long total, unsigned long run_length)
+{
+  struct bulk_run runs[BULK_FAN_IN];
+  struct bulk_run *min;
+  unsigned long start;
+  int count;
+  int i;
+
+  bulk->buffer = &bulk_entries[BULK_FAN_IN * BULK_BUFFER_ENTRIES];
+
+  for(start = 0; start < total; start += run_length * BULK_FAN_IN) {
+    for(count = 0;
+        count < BULK_FAN_IN && start + count * run_length < total;
+        count++) {
+      runs[count].buffer = &bulk_entries[count * BULK_BUFFER_ENTRIES];
+      runs[count].next = start + count * run_length;
+      runs[count].end = runs[count].next + run_length;
+      if(runs[count].end > total) {
+        runs[count].end = total;
+      }
+      runs[count].position = runs[count].count = 0;
+    }
+
+    for(;;) {
+      min = NULL;
+      for(i = 0; i < count; i++) {
+        if(runs[i].position == runs[i].count && !run_fill(fd, &runs[i])) {
+          return 0;
+        }
+        if(runs[i].position < runs[i].count &&
+           (min == NULL ||
+            entry_compare(&runs[i].buffer[runs[i].position],
+                          &min->buffer[min->position]) < 0)) {
+          min = &runs[i];
+        }
+      }
+      if(min == NULL) {
+        break;
+      }
+      if(!bulk_emit(bulk, &min->buffer[min->position++])) {
+        return 0;
+      }
+    }
+  }
+
+  return bulk_flush(bulk);
+}
+
+static db_result_t
+bulk_load(index_t *index, btree_t *tree)
+{
+  struct bulk_load bulk;
+  struct btree_entry entry;
+  unsigned char row[index->rel->row_length];
+  attribute_value_t value;
+  tuple_id_t tuple_id;
+  tuple_id_t cardinality;
+  db_result_t result;
+  unsigned long total;
+  unsigned long run_length;
+  int count;
+  int in;
+  int i;
+
+  bulk.tree = tree;
+  bulk.levels[0] = tree->meta.root;
+  bulk.fd = bulk.fds[0] = bulk.fds[1] = -1;
+  bulk.filename[0][0] = bulk.filename[1][0] = '\0';
+  bulk.written = 0;
+  bulk.pending = 0;
+
+  cardinality = relation_cardinality(index->rel);
+  if(cardinality == INVALID_TUPLE) {
+    return DB_STORAGE_ERROR;
+  }
+
+  /* Sort runs of keys in RAM. The runs are written to a file unless
+     all keys fit in RAM at once. */
+  count = 0;
+  for(tuple_id = 0;; tuple_id++) {
+    result = storage_get_row(index->rel, &tuple_id, row);
+    if(DB_ERROR(result)) {
+      goto done;
+    } else if(result == DB_FINISHED) {
+      break;
+    }
+
+    if(DB_ERROR(relation_get_value(index->rel, index->attr, row, &value))) {
+      result = DB_INDEX_ERROR;
+      goto done;
+    }
+
+    /* Insertion sort is fast when the keys arrive nearly in order, 
+       as for time series. */
+    entry.key = (btree_key_t)db_value_to_long(&value);
+    entry.tuple = tuple_id;
+    for(i = count; i > 0 && bulk_entries[i - 1].key > entry.key; i--) {
+      bulk_entries[i] = bulk_entries[i - 1];
+    }
+    bulk_entries[i] = entry;
+    count++;
+
+    if(count == DB_BTREE_BULK_ENTRIES) {
+      if(bulk.fd < 0 && !bulk_open(&bulk, 0, cardinality)) {
+        result = DB_STORAGE_ERROR;
+        goto done;
+      }
+      bulk.buffer = bulk_entries;
+      bulk.pending = count;
+      if(!bulk_flush(&bulk)) {
+        result = DB_STORAGE_ERROR;
+        goto done;
+      }
+      count = 0;
+    }
+  }
+
+  result = DB_INDEX_ERROR;
+
+  if(bulk.fd < 0) {
+    for(i = 0; i < count; i++) {
+      if(!bulk_add_entry(&bulk, &bulk_entries[i])) {
+        goto done;
+      }
+    }
+  } else {
+    bulk.buffer = bulk_entries;
+    bulk.pending = count;
+    if(!bulk_flush(&bulk)) {
+      goto done;
+    }
+
+    /* Merge the runs in passes until the last pass can fill the tree. */
+    total = bulk.written;
+    for(run_length = DB_BTREE_BULK_ENTRIES, in = 0;;
+        run_length *= BULK_FAN_IN, in = !in) {
+      if(total <= run_length * BULK_FAN_IN) {
+        bulk.fd = -1;
+      } else if(!bulk_open(&bulk, !in, total)) {
+        goto done;
+      }
+      if(!merge_runs(&bulk, bulk.fds[in], total, run_length)) {
+        goto done;
+      }
+      bulk_close(&bulk, in);
+      if(bulk.fd < 0) {
+        break;
+      }
+    }
+  }
+
+  tree->meta.root = bulk.levels[tree->meta.height - 1];
+  tree->meta_dirty = 1;
+
+  PRINTF("DB: Bulk-loaded %lu keys into a B+-tree of %u pages\n",
+         (unsigned long)cardinality, (unsigned)tree->meta.page_count);
+
+  result = cache_flush(tree) ? DB_OK : DB_STORAGE_ERROR;
+
+done:
+  bulk_close(&bulk, 0);
+  bulk_close(&bulk, 1);
+
+  return result;
+}
+
+static db_result_t
+create(index_t *index)
+{
+  char *filename;
+  btree_t *tree;
+  struct page_cache *cache;
+  db_result_t result;
+
+  filename = storage_generate_file("btree", DB_BTREE_RESERVE_SIZE);
+  if(filename == NULL) {
+    PRINTF("DB: Failed to generate a B+-tree file\n");
+    return DB_INDEX_ERROR;
+  }
+  memcpy(index->descriptor_file, filename, sizeof(index->descriptor_file));
+
+  index->opaque_data = tree = memb_alloc(&btrees);
+  if(tree == NULL) {
+    PRINTF("DB: Failed to allocate a B+-tree\n");
+    storage_remove(index->descriptor_file);
+    return DB_ALLOCATION_ERROR;
+  }
+
+  if(!tree_open(tree, index->descriptor_file)) {
+    memb_free(&btrees, tree);
+    storage_remove(index->descriptor_file);
+    return DB_STORAGE_ERROR;
+  }
+
+  /* The tree starts as a single empty leaf after the metadata page. */
+  tree->meta.magic = BTREE_MAGIC;
+  tree->meta.page_count = META_PAGE + 1;
+  tree->meta.height = 1;
+  tree->meta_dirty = 1;
+
+  result = DB_STORAGE_ERROR;
+  cache = page_new(tree, 1);
+  if(cache != NULL) {
+    tree->meta.root = cache->page_id;
+    if(cache_flush(tree)) {
+      result = bulk_load(index, tree);
+    }
+  }
+
+  if(DB_ERROR(result)) {
+    cache_invalidate(tree);
+    cfs_close(tree->fd);
+    memb_free(&btrees, tree);
+    storage_remove(index->descriptor_file);
+    return result;
+  }
+
+  PRINTF("DB: Created a B+-tree index in \"%s\"\n", index->descriptor_file);
+
+  return DB_OK;
+}
+
+static db_result_t
+destroy(index_t *index)
+{
+  /* The index has already been released. */
+  return storage_remove(index->descriptor_file);
+}
+
+static db_result_t
+load(index_t *index)
+{
+  btree_t *tree;
+
+  index->opaque_data = tree = memb_alloc(&btrees);
+  if(tree == NULL) {
+    PRINTF("DB: Failed to allocate a B+-tree\n");
+    return DB_ALLOCATION_ERROR;
+  }
+
+  if(!tree_open(tree, index->descriptor_file)) {
+    memb_free(&btrees, tree);
+    return DB_STORAGE_ERROR;
+  }
+
+  if(DB_ERROR(storage_read(tree->fd, &tree->meta, 0, sizeof(tree->meta))) ||
+     tree->meta.magic != BTREE_MAGIC) {
+    PRINTF("DB: Invalid B+-tree file %s\n", index->descriptor_file);
+    cfs_close(tree->fd);
+    memb_free(&btrees, tree);
+    return DB_STORAGE_ERROR;
+  }
+  tree->meta_dirty = 0;
+
+  PRINTF("DB: Loaded a B+-tree of height %u from file %s\n",
+         (unsigned)tree->meta.height, index->descriptor_file);
+
+  return DB_OK;
+}
+
+static db_result_t
+release(index_t *index)
+{
+  btree_t *tree;
+  db_result_t result;
+
+  tree = index->opaque_data;
+
+  result = cache_flush(tree) ? DB_OK : DB_STORAGE_ERROR;
+  cache_invalidate(tree);
+  cfs_close(tree->fd);
+  memb_free(&btrees, tree);
+
+  return result;
+}
+
+static db_result_t
+insert(index_t *index, attribute_value_t *key, tuple_id_t value)
+{
+  btree_t *tree;
+  struct btree_entry entry;
+
+  tree = index->opaque_data;
+
+  entry.key = (btree_key_t)db_value_to_long(key);
+  entry.tuple = value;
+
+  if(insert_entry(tree, &entry) == 0 || cache_flush(tree) == 0) {
+    PRINTF("DB: Failed to insert key %ld into a B+-tree index\n",
+           (long)entry.key);
+    return DB_INDEX_ERROR;
+  }
+
+  return DB_OK;
+}
+
+/* Remove all entries with the key from the leaves. Pages that become 
+   sparse are not merged, but remain in the chain of leaves. */
+static db_result_t
+delete(index_t *index, attribute_value_t *value)
+{
+  btree_t *tree;
+  struct btree_entry entry;
+  struct page_cache *cache;
+  struct btree_page *page;
+  btree_page_id_t page_id;
+  int position;
+  int end;
+
+  tree = index->opaque_data;
+
+  entry.key = (btree_key_t)db_value_to_long(value);
+  entry.tuple = 0;
+
+  page_id = find_leaf(tree, &entry, NULL);
+  while(page_id != META_PAGE) {
+    cache = page_get(tree, page_id);
+    if(cache == NULL) {
+      return DB_INDEX_ERROR;
+    }
+    page = &cache->page;
+
+    position = leaf_position(page, &entry);
+    for(end = position;
+        end < page->count && page->u.entries[end].key == entry.key;
+        end++);
+
+    if(end > position) {
+      memmove(&page->u.entries[position], &page->u.entries[end],
+              (page->count - end) * sizeof(struct btree_entry));
+      page->count -= end - position;
+      cache->dirty = 1;
+    }
+
+    if(position < page->count) {
+      /* The remaining entries have greater keys. */
+      break;
+    }
+    page_id = page->next;
+  }
+
+  return cache_flush(tree) ? DB_OK : DB_INDEX_ERROR;
+}
+
+/* Convert the bounds of a range search to keys. Bounds beyond the
+   range of the keys are clamped, and 0 is returned if no key can be
+   within the bounds. */
+static int
+range_to_keys(index_iterator_t *iterator, btree_key_t *min, btree_key_t *max)
+{
+  long lmin;
+  long lmax;
+
+  lmin = db_value_to_long(&iterator->min_value);
+  lmax = db_value_to_long(&iterator->max_value);
+  if(lmin > lmax || lmin > INT32_MAX || lmax < INT32_MIN) {
+    return 0;
+  }
+
+  *min = lmin < INT32_MIN ? INT32_MIN : (btree_key_t)lmin;
+  *max = lmax > INT32_MAX ? INT32_MAX : (btree_key_t)lmax;
+  return 1;
+}
+
+static tuple_id_t
+get_next(index_iterator_t *iterator)
+{
+  struct iteration_cache {
+    index_iterator_t *index_iterator;
+    btree_page_id_t page_id;
+    uint16_t position;
+  };
+  static struct iteration_cache cursor;
+  btree_t *tree;
+  struct page_cache *cache;
+  struct btree_entry *entry;
+  struct btree_entry min;
+  btree_key_t max;
+
+  tree = (btree_t *)iterator->index->opaque_data;
+
+  if(!range_to_keys(iterator, &min.key, &max)) {
+    return INVALID_TUPLE;
+  }
+  min.tuple = 0;
+
+  if(cursor.index_iterator != iterator || iterator->next_item_no == 0) {
+    /* Position the cursor at the first entry in the range. */
+    cursor.index_iterator = iterator;
+    cursor.page_id = find_leaf(tree, &min, NULL);
+    if(cursor.page_id == META_PAGE) {
+      return INVALID_TUPLE;
+    }
+    cache = page_get(tree, cursor.page_id);
+    if(cache == NULL) {
+      cursor.page_id = META_PAGE;
+      return INVALID_TUPLE;
+    }
+    cursor.position = leaf_position(&cache->page, &min);
+  }
+
+  while(cursor.page_id != META_PAGE) {
+    cache = page_get(tree, cursor.page_id);
+    if(cache == NULL) {
+      cursor.page_id = META_PAGE;
+      return INVALID_TUPLE;
+    }
+
+    if(cursor.position < cache->page.count) {
+      entry = &cache->page.u.entries[cursor.position++];
+      if(entry->key > max) {
+        cursor.page_id = META_PAGE;
+        return INVALID_TUPLE;
+      }
+      iterator->next_item_no++;
+      return entry->tuple;
+    }
+
+    cursor.page_id = cache->page.next;
+    cursor.position = 0;
+  }
+
+  return INVALID_TUPLE;
+}
@@ -27,23 +27,39 @@
  * SUCH DAMAGE.
  */
 
+
 /**
  * \file
  *	A memory-resident hash map used as a DB index.
+ *
+ *	The map uses linear hashing: buckets are added one at a time as
+ *	the number of entries grows, and removed again as it shrinks.
+ *	Buckets are allocated in segments and entries are chained within
+ *	buckets, so that several indexes share the same memory pools.
+ *	Duplicate keys are stored in separate entries of the same chain.
+ *
+ *	When the index is released, its entries are saved in the index
+ *	file, from which they are loaded the next time. If the index has
+ *	been modified after it was saved, it is rebuilt from the relation.
  * \author
  * 	Nicolas Tsiftes <nvt@sics.se>
  */
 
 #include <string.h>
 
+#include "cfs/cfs.h"
 #include "lib/memb.h"
 
 #include "db-options.h"
 #include "index.h"
+#include "result.h"
+#include "storage.h"
 
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
 
+#define SNAPSHOT_MAGIC	0x4d48
+
 static db_result_t create(index_t *);
 static db_result_t destroy(index_t *);
 static db_result_t load(index_t *);
@@ -64,88 +80,450 @@ index_api_t index_memhash = {
   get_next
 };
 
-struct hash_item {
+struct hash_entry {
+  struct hash_entry *next;
+  long key;
   tuple_id_t tuple_id;
-  attribute_value_t value;
 };
-typedef struct hash_item hash_item_t;
 
-typedef hash_item_t hash_map_t[DB_MEMHASH_TABLE_SIZE];
+struct hash_segment {
+  struct hash_entry *buckets[DB_MEMHASH_SEGMENT_SIZE];
+};
+
+struct hash_map {
+  struct hash_segment *segments[DB_MEMHASH_SEGMENT_LIMIT];
+  uint16_t entry_count;
+  /* The next bucket to split in the current round of doubling. */
+  uint16_t split;
+  uint8_t level;
+  uint8_t saved;
+};
+typedef struct hash_map hash_map_t;
+
+/* The file format of saved entries. */
+struct snapshot_header {
+  uint16_t magic;
+  uint16_t entry_count;
+};
+
+struct snapshot_entry {
+  int32_t key;
+  tuple_id_t tuple_id;
+};
 
 MEMB(hash_map_memb, hash_map_t, DB_MEMHASH_INDEX_LIMIT);
+MEMB(segment_memb, struct hash_segment, DB_MEMHASH_SEGMENT_LIMIT);
+MEMB(entry_memb, struct hash_entry, DB_MEMHASH_ENTRY_LIMIT);
+
+static unsigned long
+calculate_hash(long key)
+{
+  uint32_t hash_value;
+
+  /* Only the numeric value is hashed, and its bits are mixed so that
+     sequential keys spread over the buckets. */
+  hash_value = (uint32_t)key;
+  hash_value ^= hash_value >> 16;
+  hash_value *= 0x45d9f3bUL;
+  hash_value ^= hash_value >> 16;
+
+  return hash_value;
+}
+
+static unsigned
+bucket_count(hash_map_t *hash_map)
+{
+  return ((unsigned)DB_MEMHASH_SEGMENT_SIZE << hash_map->level) +
+    hash_map->split;
+}
 
 static unsigned
-calculate_hash(attribute_value_t *value)
+bucket_address(hash_map_t *hash_map, unsigned long hash_value)
+{
+  unsigned bucket;
+
+  bucket = hash_value % ((unsigned long)DB_MEMHASH_SEGMENT_SIZE <<
+                         hash_map->level);
+  if(bucket < hash_map->split) {
+    /* This bucket has already been split in the current round. */
+    bucket = hash_value % ((unsigned long)DB_MEMHASH_SEGMENT_SIZE <<
+                           (hash_map->level + 1));
+  }
+  return bucket;
+}
+
+static struct hash_entry **
+bucket_head(hash_map_t *hash_map, unsigned bucket)
 {
-  unsigned char *cp, *end;
-  unsigned hash_value;
+  return &hash_map->segments[bucket / DB_MEMHASH_SEGMENT_SIZE]->
+    buckets[bucket % DB_MEMHASH_SEGMENT_SIZE];
+}
 
-  cp = (unsigned char *)value;
-  end = cp + sizeof(*value);
-  hash_value = 0;
+static struct hash_entry **
+key_head(hash_map_t *hash_map, long key)
+{
+  return bucket_head(hash_map, bucket_address(hash_map, calculate_hash(key)));
+}
 
-  while(cp < end) {
-    hash_value = hash_value * 33 + *cp++;
+static struct hash_segment *
+segment_allocate(void)
+{
+  struct hash_segment *segment;
+
+  segment = memb_alloc(&segment_memb);
+  if(segment != NULL) {
+    memset(segment, 0, sizeof(*segment));
   }
+  return segment;
+}
 
-  return hash_value % DB_MEMHASH_TABLE_SIZE;
+/* Add a bucket by splitting the entries of the next bucket in turn. */
+static void
+grow(hash_map_t *hash_map)
+{
+  unsigned new_bucket;
+  unsigned segment;
+  struct hash_entry *entry;
+  struct hash_entry *next;
+  struct hash_entry **old_head;
+  struct hash_entry **new_head;
+  unsigned long modulus;
+
+  new_bucket = bucket_count(hash_map);
+  segment = new_bucket / DB_MEMHASH_SEGMENT_SIZE;
+  if(segment >= DB_MEMHASH_SEGMENT_LIMIT) {
+    return;
+  }
+  if(hash_map->segments[segment] == NULL) {
+    hash_map->segments[segment] = segment_allocate();
+    if(hash_map->segments[segment] == NULL) {
+      /* The chains will be longer until more memory is available. */
+      return;
+    }
+  }
+
+  old_head = bucket_head(hash_map, hash_map->split);
+  new_head = bucket_head(hash_map, new_bucket);
+  modulus = (unsigned long)DB_MEMHASH_SEGMENT_SIZE << (hash_map->level + 1);
+
+  entry = *old_head;
+  *old_head = NULL;
+  for(; entry != NULL; entry = next) {
+    next = entry->next;
+    if(calculate_hash(entry->key) % modulus == new_bucket) {
+      entry->next = *new_head;
+      *new_head = entry;
+    } else {
+      entry->next = *old_head;
+      *old_head = entry;
+    }
+  }
+
+  if(++hash_map->split == (unsigned)DB_MEMHASH_SEGMENT_SIZE << hash_map->level) {
+    hash_map->level++;
+    hash_map->split = 0;
+  }
+}
+
+/* Remove the last bucket by merging it into the bucket it was split from. */
+static void
+shrink(hash_map_t *hash_map)
+{
+  unsigned last_bucket;
+  struct hash_entry **last_head;
+  struct hash_entry **head;
+
+  if(bucket_count(hash_map) == DB_MEMHASH_SEGMENT_SIZE) {
+    return;
+  }
+
+  if(hash_map->split == 0) {
+    hash_map->level--;
+    hash_map->split = (unsigned)DB_MEMHASH_SEGMENT_SIZE << hash_map->level;
+  }
+  hash_map->split--;
+
+  last_bucket = bucket_count(hash_map);
+  last_head = bucket_head(hash_map, last_bucket);
+  for(head = bucket_head(hash_map, hash_map->split);
+      *head != NULL;
+      head = &(*head)->next);
+  *head = *last_head;
+  *last_head = NULL;
+
+  if(last_bucket % DB_MEMHASH_SEGMENT_SIZE == 0) {
+    memb_free(&segment_memb,
+              hash_map->segments[last_bucket / DB_MEMHASH_SEGMENT_SIZE]);
+    hash_map->segments[last_bucket / DB_MEMHASH_SEGMENT_SIZE] = NULL;
+  }
 }
 
 static db_result_t
-create(index_t *index)
+add_entry(hash_map_t *hash_map, long key, tuple_id_t tuple_id)
 {
-  int i;
-  hash_map_t *hash_map;
+  struct hash_entry *entry;
+  struct hash_entry **head;
 
-  PRINTF("Creating a memory-resident hash map index\n");
+  entry = memb_alloc(&entry_memb);
+  if(entry == NULL) {
+    PRINTF("DB: No more hash entries available\n");
+    return DB_ALLOCATION_ERROR;
+  }
+  entry->key = key;
+  entry->tuple_id = tuple_id;
+
+  head = key_head(hash_map, key);
+  entry->next = *head;
+  *head = entry;
+
+  hash_map->entry_count++;
+  if(hash_map->entry_count >
+     (unsigned long)bucket_count(hash_map) * DB_MEMHASH_LOAD_FACTOR) {
+    grow(hash_map);
+  }
+
+  return DB_OK;
+}
+
+static hash_map_t *
+allocate_map(index_t *index)
+{
+  hash_map_t *hash_map;
 
   hash_map = memb_alloc(&hash_map_memb);
   if(hash_map == NULL) {
-    return DB_ALLOCATION_ERROR;
+    return NULL;
   }
 
-  for(i = 0; i < DB_MEMHASH_TABLE_SIZE; i++) {
-    hash_map[i]->tuple_id = INVALID_TUPLE;
+  memset(hash_map, 0, sizeof(*hash_map));
+  hash_map->segments[0] = segment_allocate();
+  if(hash_map->segments[0] == NULL) {
+    memb_free(&hash_map_memb, hash_map);
+    return NULL;
   }
 
   index->opaque_data = hash_map;
+  return hash_map;
+}
+
+static void
+free_map(hash_map_t *hash_map)
+{
+  struct hash_entry *entry;
+  struct hash_entry *next;
+  unsigned bucket;
+  int i;
 
+  for(bucket = 0; bucket < bucket_count(hash_map); bucket++) {
+    for(entry = *bucket_head(hash_map, bucket); entry != NULL; entry = next) {
+      next = entry->next;
+      memb_free(&entry_memb, entry);
+    }
+  }
+
+  for(i = 0; i < DB_MEMHASH_SEGMENT_LIMIT; i++) {
+    if(hash_map->segments[i] != NULL) {
+      memb_free(&segment_memb, hash_map->segments[i]);
+    }
+  }
+  memb_free(&hash_map_memb, hash_map);
+}
+
+/* Mark the saved entries as outdated before the map is first modified. */
+static db_result_t
+invalidate_snapshot(index_t *index, hash_map_t *hash_map)
+{
+  struct snapshot_header header;
+  int fd;
+
+  if(!hash_map->saved) {
+    return DB_OK;
+  }
+
+  fd = cfs_open(index->descriptor_file, CFS_READ | CFS_WRITE);
+  if(fd < 0) {
+    return DB_STORAGE_ERROR;
+  }
+  memset(&header, 0, sizeof(header));
+  if(DB_ERROR(storage_write(fd, &header, 0, sizeof(header)))) {
+    cfs_close(fd);
+    return DB_STORAGE_ERROR;
+  }
+  cfs_close(fd);
+
+  hash_map->saved = 0;
   return DB_OK;
 }
 
 static db_result_t
-destroy(index_t *index)
+save_snapshot(index_t *index, hash_map_t *hash_map)
 {
-  memb_free(&hash_map_memb, index->opaque_data);
+  struct snapshot_header header;
+  struct snapshot_entry saved_entry;
+  struct hash_entry *entry;
+  unsigned long offset;
+  unsigned bucket;
+  int fd;
+
+  fd = cfs_open(index->descriptor_file, CFS_READ | CFS_WRITE);
+  if(fd < 0) {
+    return DB_STORAGE_ERROR;
+  }
+
+  /* Write the header last, so that an interrupted save is detected. */
+  offset = sizeof(header);
+  for(bucket = 0; bucket < bucket_count(hash_map); bucket++) {
+    for(entry = *bucket_head(hash_map, bucket);
+        entry != NULL;
+        entry = entry->next) {
+      saved_entry.key = entry->key;
+      saved_entry.tuple_id = entry->tuple_id;
+      if(DB_ERROR(storage_write(fd, &saved_entry, offset,
+                                sizeof(saved_entry)))) {
+        cfs_close(fd);
+        return DB_STORAGE_ERROR;
+      }
+      offset += sizeof(saved_entry);
+    }
+  }
+
+  header.magic = SNAPSHOT_MAGIC;
+  header.entry_count = hash_map->entry_count;
+  if(DB_ERROR(storage_write(fd, &header, 0, sizeof(header)))) {
+    cfs_close(fd);
+    return DB_STORAGE_ERROR;
+  }
+  cfs_close(fd);
+
+  PRINTF("DB: Saved %u hash entries in %s\n",
+         (unsigned)hash_map->entry_count, index->descriptor_file);
+
+  return DB_OK;
+}
+
+static db_result_t
+load_snapshot(index_t *index, hash_map_t *hash_map)
+{
+  struct snapshot_header header;
+  struct snapshot_entry saved_entry;
+  unsigned i;
+  int fd;
+
+  fd = cfs_open(index->descriptor_file, CFS_READ);
+  if(fd < 0) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(cfs_read(fd, &header, sizeof(header)) != sizeof(header) ||
+     header.magic != SNAPSHOT_MAGIC) {
+    cfs_close(fd);
+    return DB_INDEX_ERROR;
+  }
+
+  for(i = 0; i < header.entry_count; i++) {
+    if(cfs_read(fd, &saved_entry, sizeof(saved_entry)) !=
+       sizeof(saved_entry) ||
+       DB_ERROR(add_entry(hash_map, saved_entry.key, saved_entry.tuple_id))) {
+      cfs_close(fd);
+      return DB_INDEX_ERROR;
+    }
+  }
+  cfs_close(fd);
+
+  hash_map->saved = 1;
+  return DB_OK;
+}
+
+static db_result_t
+create(index_t *index)
+{
+  char *filename;
+
+  PRINTF("Creating a memory-resident hash map index\n");
+
+  filename = storage_generate_file("hash",
+                                   sizeof(struct snapshot_header) +
+                                   DB_MEMHASH_ENTRY_LIMIT *
+                                   sizeof(struct snapshot_entry));
+  if(filename == NULL) {
+    return DB_STORAGE_ERROR;
+  }
+  memcpy(index->descriptor_file, filename, sizeof(index->descriptor_file));
+
+  if(allocate_map(index) == NULL) {
+    storage_remove(index->descriptor_file);
+    index->descriptor_file[0] = '\0';
+    return DB_ALLOCATION_ERROR;
+  }
 
   return DB_OK;
 }
 
+static db_result_t
+destroy(index_t *index)
+{
+  /* The entries have been freed when the index was released. */
+  return storage_remove(index->descriptor_file);
+}
+
 static db_result_t
 load(index_t *index)
 {
-  return create(index);
+  hash_map_t *hash_map;
+
+  hash_map = allocate_map(index);
+  if(hash_map == NULL) {
+    return DB_ALLOCATION_ERROR;
+  }
+
+  if(DB_ERROR(load_snapshot(index, hash_map))) {
+    PRINTF("DB: No valid hash entries in %s; rebuilding the index\n",
+           index->descriptor_file);
+    free_map(hash_map);
+    hash_map = allocate_map(index);
+    if(hash_map == NULL) {
+      return DB_ALLOCATION_ERROR;
+    }
+    index->flags |= INDEX_LOAD_NEEDED;
+  }
+
+  return DB_OK;
 }
 
 static db_result_t
 release(index_t *index)
 {
-  return destroy(index);
+  hash_map_t *hash_map;
+
+  hash_map = index->opaque_data;
+
+  if(!hash_map->saved && !(index->flags & INDEX_LOAD_NEEDED) &&
+     DB_ERROR(save_snapshot(index, hash_map))) {
+    PRINTF("DB: Failed to save the hash index; it will be rebuilt\n");
+  }
+
+  free_map(hash_map);
+
+  return DB_OK;
 }
 
 static db_result_t
 insert(index_t *index, attribute_value_t *value, tuple_id_t tuple_id)
 {
   hash_map_t *hash_map;
-  uint16_t hash_value;
 
   hash_map = index->opaque_data;
 
-  hash_value = calculate_hash(value);
-  hash_map[hash_value]->tuple_id = tuple_id;
-  hash_map[hash_value]->value = *value;
+  if(DB_ERROR(invalidate_snapshot(index, hash_map))) {
+    return DB_STORAGE_ERROR;
+  }
 
-  PRINTF("DB: Inserted value %ld into the hash table\n", VALUE_LONG(value));
+  if(DB_ERROR(add_entry(hash_map, db_value_to_long(value), tuple_id))) {
+    return DB_INDEX_ERROR;
+  }
+
+  PRINTF("DB: Inserted value %ld into the hash table\n",
+         db_value_to_long(value));
 
   return DB_OK;
 }
@@ -154,41 +532,83 @@ static db_result_t
 delete(index_t *index, attribute_value_t *value)
 {
   hash_map_t *hash_map;
-  uint16_t hash_value;
+  struct hash_entry **head;
+  struct hash_entry *entry;
+  long key;
+  int found;
 
   hash_map = index->opaque_data;
+  key = db_value_to_long(value);
+
+  if(DB_ERROR(invalidate_snapshot(index, hash_map))) {
+    return DB_STORAGE_ERROR;
+  }
 
-  hash_value = calculate_hash(value);
-  if(memcmp(&hash_map[hash_value]->value, value, sizeof(*value)) != 0) {
+  /* Remove all entries with the key. */
+  found = 0;
+  for(head = key_head(hash_map, key); *head != NULL;) {
+    entry = *head;
+    if(entry->key == key) {
+      *head = entry->next;
+      memb_free(&entry_memb, entry);
+      hash_map->entry_count--;
+      found = 1;
+    } else {
+      head = &entry->next;
+    }
+  }
+
+  if(!found) {
     return DB_INDEX_ERROR;
   }
 
-  hash_map[hash_value]->tuple_id = INVALID_TUPLE;
+  while(bucket_count(hash_map) > DB_MEMHASH_SEGMENT_SIZE &&
+        hash_map->entry_count <
+        (unsigned long)bucket_count(hash_map) * DB_MEMHASH_LOAD_FACTOR / 2) {
+    shrink(hash_map);
+  }
+
   return DB_OK;
 }
 
 static tuple_id_t
 get_next(index_iterator_t *iterator)
 {
+  struct iteration_cache {
+    index_iterator_t *index_iterator;
+    struct hash_entry *entry;
+    long key;
+  };
+  static struct iteration_cache cache;
   hash_map_t *hash_map;
-  uint16_t hash_value;
-
-  if(iterator->next_item_no == 1) {
-    /* The memhash supports only unique values at the moment. */
-    return INVALID_TUPLE;
-  }
+  struct hash_entry *entry;
+  long max;
 
   hash_map = iterator->index->opaque_data;
+  max = db_value_to_long(&iterator->max_value);
 
-  hash_value = calculate_hash(&iterator->min_value);
-  if(memcmp(&hash_map[hash_value]->value, &iterator->min_value, sizeof(iterator->min_value)) != 0) {
-    return INVALID_TUPLE;
+  if(cache.index_iterator != iterator || iterator->next_item_no == 0) {
+    cache.index_iterator = iterator;
+    cache.key = db_value_to_long(&iterator->min_value);
+    cache.entry = *key_head(hash_map, cache.key);
   }
 
-  iterator->next_item_no++;
-
-  PRINTF("DB: Found value %ld in the hash table\n", 
-	VALUE_LONG(&iterator->min_value));
-
-  return hash_map[hash_value]->tuple_id;
+  /* A range of keys is emulated by looking up each key in turn. */
+  for(;;) {
+    while(cache.entry != NULL) {
+      entry = cache.entry;
+      cache.entry = entry->next;
+      if(entry->key == cache.key) {
+        iterator->next_item_no++;
+        PRINTF("DB: Found value %ld in the hash table\n", entry->key);
+        return entry->tuple_id;
+      }
+    }
+
+    if(cache.key >= max) {
+      return INVALID_TUPLE;
+    }
+    cache.key++;
+    cache.entry = *key_head(hash_map, cache.key);
+  }
 }
@@ -49,7 +49,7 @@
 #include "storage.h"
 
 static index_api_t *index_components[] = {&index_inline,
-	&index_maxheap};
+	&index_maxheap, &index_memhash, &index_btree};
 
 LIST(indices);
 MEMB(index_memb, index_t, DB_INDEX_POOL_SIZE);
@@ -140,7 +140,8 @@ index_create(index_type_t index_type, relation_t *rel, attribute_t *attr)
     return DB_INDEX_ERROR;
   }
 
-  if(!(api->flags & INDEX_API_INLINE) && cardinality > 0) {
+  if(!(api->flags & (INDEX_API_INLINE | INDEX_API_BULK_LOAD)) &&
+     cardinality > 0) {
     PRINTF("DB: Created an index for an old relation; issuing a load request\n");
     index->flags = INDEX_LOAD_NEEDED;
     process_post(&db_indexer, load_request_event, NULL);
@@ -188,6 +189,7 @@ index_load(relation_t *rel, attribute_t *attr)
   index->rel = rel;
   index->attr = attr;
   index->opaque_data = NULL;
+  index->flags = 0;
 
   api = find_index_api(index->type);
   if(api == NULL) {
@@ -204,7 +206,13 @@ index_load(relation_t *rel, attribute_t *attr)
 
   list_push(indices, index);
   attr->index = index;
-  index->flags = INDEX_READY;
+
+  if(index->flags & INDEX_LOAD_NEEDED) {
+    /* The index could not be restored from its file. */
+    process_post(&db_indexer, load_request_event, NULL);
+  } else {
+    index->flags = INDEX_READY;
+  }
 
   return DB_OK;
 }
@@ -388,7 +396,7 @@ PROCESS_THREAD(db_indexer, ev, data)
       continue;
     }
 
-    for(;; row++) {
+    for(row = 0;; row++) {
       PROCESS_PAUSE();
 
       result = db_process(&handle);
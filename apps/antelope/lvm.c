@@ -64,6 +64,10 @@
 #define LVM_USE_FLOATS			0
 #endif
 
+#if LVM_BATCH_SIZE > 256
+#error "LVM_BATCH_SIZE must not be larger than 256."
+#endif
+
 #define IS_CONNECTIVE(op) ((op) & LVM_CONNECTIVE)
 
 struct variable {
@@ -82,10 +86,10 @@ typedef struct derivation derivation_t;
 
 /* Registered variables for a LVM expression. Their values may be 
    changed between executions of the expression. */
-static variable_t variables[LVM_MAX_VARIABLE_ID - 1];
+static variable_t variables[LVM_MAX_VARIABLE_ID];
 
 /* Range derivations of variables that are used for index searches. */
-static derivation_t derivations[LVM_MAX_VARIABLE_ID - 1];
+static derivation_t derivations[LVM_MAX_VARIABLE_ID];
 
 #if DEBUG
 static void
@@ -107,7 +111,7 @@ lookup(char *name)
 {
   variable_t *var;
 
-  for(var = variables; var <= &variables[LVM_MAX_VARIABLE_ID - 1] && var->name[0] != '\0'; var++) {
+  for(var = variables; var < &variables[LVM_MAX_VARIABLE_ID] && var->name[0] != '\0'; var++) {
     if(strcmp(var->name, name) == 0) {
       break;
     }
@@ -307,6 +311,12 @@ lvm_reset(lvm_instance_t *p, unsigned char *code, lvm_ip_t size)
   p->ip = 0;
   p->error = 0;
 
+  lvm_clear_variables();
+}
+
+void
+lvm_clear_variables(void)
+{
   memset(variables, 0, sizeof(variables));
   memset(derivations, 0, sizeof(derivations));
 }
@@ -403,6 +413,386 @@ lvm_execute(lvm_instance_t *p)
   return status;
 }
 
+/*
+ * Batch execution evaluates the code for many rows at a time. Each node
+ * is decoded once per batch and then applied to the rows in a selection
+ * vector, which holds the numbers of the rows that are still candidates
+ * in ascending order. The variable values are taken from columns indexed
+ * by variable ID, so no name lookups are needed per row.
+ *
+ * Comparisons remove the rows for which they are false from the
+ * selection vector. Hence, the second operand of an AND is only
+ * evaluated for the rows that fulfill the first operand, and the second
+ * operand of an OR is only evaluated for the rows that do not. A
+ * division by zero is thus only reported if it occurs in a row that
+ * reaches the expression.
+ */
+struct batch_value {
+  long *vector;
+  long constant;
+};
+
+#define BATCH_ARITH(expr)				\
+  for(i = 0; i < count; i++) {				\
+    row = selection[i];					\
+    vector[row] = (expr);				\
+  }
+
+#define BATCH_SELECT(condition)				\
+  for(i = n = 0; i < *count; i++) {			\
+    row = selection[i];					\
+    if(condition) {					\
+      selection[n++] = row;				\
+    }							\
+  }
+
+static lvm_status_t eval_batch_expr(lvm_instance_t *p, operator_t op,
+                                    lvm_column_t *columns,
+                                    lvm_row_t *selection, unsigned count,
+                                    long *vector, struct batch_value *result);
+
+static lvm_status_t
+get_batch_value(lvm_instance_t *p, lvm_column_t *columns,
+                lvm_row_t *selection, unsigned count,
+                long *vector, struct batch_value *value)
+{
+  operator_t *operator;
+  operand_t operand;
+
+  switch(get_type(p)) {
+  case LVM_ARITH_OP:
+    operator = get_operator(p);
+    return eval_batch_expr(p, *operator, columns, selection, count,
+                           vector, value);
+  case LVM_OPERAND:
+    get_operand(p, &operand);
+    if(operand.type == LVM_VARIABLE) {
+      value->vector = columns[operand.value.id];
+    } else {
+      value->vector = NULL;
+      value->constant = operand_to_long(&operand);
+    }
+    return TRUE;
+  default:
+    return SEMANTIC_ERROR;
+  }
+}
+
+static lvm_status_t
+eval_batch_expr(lvm_instance_t *p, operator_t op, lvm_column_t *columns,
+                lvm_row_t *selection, unsigned count,
+                long *vector, struct batch_value *result)
+{
+  struct batch_value a, b;
+  long scratch[LVM_BATCH_SIZE];
+  lvm_status_t r;
+  unsigned i;
+  lvm_row_t row;
+
+  r = get_batch_value(p, columns, selection, count, vector, &a);
+  if(LVM_ERROR(r)) {
+    return r;
+  }
+  r = get_batch_value(p, columns, selection, count, scratch, &b);
+  if(LVM_ERROR(r)) {
+    return r;
+  }
+
+  if(op == LVM_DIV && b.vector == NULL && b.constant == 0) {
+    return MATH_ERROR;
+  }
+
+  if(a.vector == NULL && b.vector == NULL) {
+    /* Fold expressions of constants. */
+    result->vector = NULL;
+    switch(op) {
+    case LVM_ADD:
+      result->constant = a.constant + b.constant;
+      break;
+    case LVM_SUB:
+      result->constant = a.constant - b.constant;
+      break;
+    case LVM_MUL:
+      result->constant = a.constant * b.constant;
+      break;
+    case LVM_DIV:
+      result->constant = a.constant / b.constant;
+      break;
+    default:
+      return EXECUTION_ERROR;
+    }
+    return TRUE;
+  }
+
+  if(a.vector == NULL) {
+    BATCH_ARITH(a.constant);
+    a.vector = vector;
+  }
+
+  switch(op) {
+  case LVM_ADD:
+    if(b.vector == NULL) {
+      BATCH_ARITH(a.vector[row] + b.constant);
+    } else {
+      BATCH_ARITH(a.vector[row] + b.vector[row]);
+    }
+    break;
+  case LVM_SUB:
+    if(b.vector == NULL) {
+      BATCH_ARITH(a.vector[row] - b.constant);
+    } else {
+      BATCH_ARITH(a.vector[row] - b.vector[row]);
+    }
+    break;
+  case LVM_MUL:
+    if(b.vector == NULL) {
+      BATCH_ARITH(a.vector[row] * b.constant);
+    } else {
+      BATCH_ARITH(a.vector[row] * b.vector[row]);
+    }
+    break;
+  case LVM_DIV:
+    if(b.vector == NULL) {
+      BATCH_ARITH(a.vector[row] / b.constant);
+    } else {
+      for(i = 0; i < count; i++) {
+        row = selection[i];
+        if(b.vector[row] == 0) {
+          return MATH_ERROR;
+        }
+        vector[row] = a.vector[row] / b.vector[row];
+      }
+    }
+    break;
+  default:
+    return EXECUTION_ERROR;
+  }
+
+  result->vector = vector;
+  return TRUE;
+}
+
+static void
+remove_rows(lvm_row_t *selection, unsigned *count,
+            lvm_row_t *rows, unsigned row_count)
+{
+  unsigned i, j, n;
+
+  for(i = j = n = 0; i < *count; i++) {
+    while(j < row_count && rows[j] < selection[i]) {
+      j++;
+    }
+    if(j == row_count || rows[j] != selection[i]) {
+      selection[n++] = selection[i];
+    }
+  }
+  *count = n;
+}
+
+static lvm_status_t
+eval_batch_logic(lvm_instance_t *p, operator_t op, lvm_column_t *columns,
+                 lvm_row_t *selection, unsigned *count);
+
+static lvm_status_t
+eval_batch_connective(lvm_instance_t *p, operator_t op,
+                      lvm_column_t *columns,
+                      lvm_row_t *selection, unsigned *count)
+{
+  lvm_row_t matched[LVM_BATCH_SIZE];
+  unsigned matched_count;
+  operator_t *operator;
+  lvm_status_t r;
+  int i, j, k;
+
+  if(get_type(p) != LVM_CMP_OP) {
+    return SEMANTIC_ERROR;
+  }
+  operator = get_operator(p);
+
+  if(op == LVM_AND) {
+    r = eval_batch_logic(p, *operator, columns, selection, count);
+    if(LVM_ERROR(r)) {
+      return r;
+    }
+    if(get_type(p) != LVM_CMP_OP) {
+      return SEMANTIC_ERROR;
+    }
+    operator = get_operator(p);
+    return eval_batch_logic(p, *operator, columns, selection, count);
+  }
+
+  matched_count = *count;
+  memcpy(matched, selection, matched_count * sizeof(matched[0]));
+  r = eval_batch_logic(p, *operator, columns, matched, &matched_count);
+  if(LVM_ERROR(r)) {
+    return r;
+  }
+  remove_rows(selection, count, matched, matched_count);
+
+  if(op == LVM_NOT) {
+    return TRUE;
+  } else if(op != LVM_OR) {
+    return EXECUTION_ERROR;
+  }
+
+  if(get_type(p) != LVM_CMP_OP) {
+    return SEMANTIC_ERROR;
+  }
+  operator = get_operator(p);
+  r = eval_batch_logic(p, *operator, columns, selection, count);
+  if(LVM_ERROR(r)) {
+    return r;
+  }
+
+  /* Merge the disjoint selections of both operands from the end, so
+     that the rows remain in ascending order. */
+  i = *count - 1;
+  j = matched_count - 1;
+  k = *count + matched_count - 1;
+  *count = k + 1;
+  while(j >= 0) {
+    if(i >= 0 && selection[i] > matched[j]) {
+      selection[k--] = selection[i--];
+    } else {
+      selection[k--] = matched[j--];
+    }
+  }
+
+  return TRUE;
+}
+
+static lvm_status_t
+eval_batch_logic(lvm_instance_t *p, operator_t op, lvm_column_t *columns,
+                 lvm_row_t *selection, unsigned *count)
+{
+  struct batch_value a, b, tmp;
+  long left[LVM_BATCH_SIZE];
+  long right[LVM_BATCH_SIZE];
+  lvm_status_t r;
+  unsigned i, n;
+  lvm_row_t row;
+
+  if(IS_CONNECTIVE(op)) {
+    return eval_batch_connective(p, op, columns, selection, count);
+  }
+
+  r = get_batch_value(p, columns, selection, *count, left, &a);
+  if(LVM_ERROR(r)) {
+    return r;
+  }
+  r = get_batch_value(p, columns, selection, *count, right, &b);
+  if(LVM_ERROR(r)) {
+    return r;
+  }
+
+  if(a.vector == NULL && b.vector == NULL) {
+    /* The result is the same for all rows. */
+    for(i = 0; i < *count; i++) {
+      left[selection[i]] = a.constant;
+    }
+    a.vector = left;
+  } else if(a.vector == NULL) {
+    /* Put the vector on the left side by mirroring the comparison. */
+    tmp = a;
+    a = b;
+    b = tmp;
+    switch(op) {
+    case LVM_GE:
+      op = LVM_LE;
+      break;
+    case LVM_GEQ:
+      op = LVM_LEQ;
+      break;
+    case LVM_LE:
+      op = LVM_GE;
+      break;
+    case LVM_LEQ:
+      op = LVM_GEQ;
+      break;
+    default:
+      break;
+    }
+  }
+
+  switch(op) {
+  case LVM_EQ:
+    if(b.vector == NULL) {
+      BATCH_SELECT(a.vector[row] == b.constant);
+    } else {
+      BATCH_SELECT(a.vector[row] == b.vector[row]);
+    }
+    break;
+  case LVM_NEQ:
+    if(b.vector == NULL) {
+      BATCH_SELECT(a.vector[row] != b.constant);
+    } else {
+      BATCH_SELECT(a.vector[row] != b.vector[row]);
+    }
+    break;
+  case LVM_GE:
+    if(b.vector == NULL) {
+      BATCH_SELECT(a.vector[row] > b.constant);
+    } else {
+      BATCH_SELECT(a.vector[row] > b.vector[row]);
+    }
+    break;
+  case LVM_GEQ:
+    if(b.vector == NULL) {
+      BATCH_SELECT(a.vector[row] >= b.constant);
+    } else {
+      BATCH_SELECT(a.vector[row] >= b.vector[row]);
+    }
+    break;
+  case LVM_LE:
+    if(b.vector == NULL) {
+      BATCH_SELECT(a.vector[row] < b.constant);
+    } else {
+      BATCH_SELECT(a.vector[row] < b.vector[row]);
+    }
+    break;
+  case LVM_LEQ:
+    if(b.vector == NULL) {
+      BATCH_SELECT(a.vector[row] <= b.constant);
+    } else {
+      BATCH_SELECT(a.vector[row] <= b.vector[row]);
+    }
+    break;
+  default:
+    return EXECUTION_ERROR;
+  }
+
+  *count = n;
+  return TRUE;
+}
+
+lvm_status_t
+lvm_execute_batch(lvm_instance_t *p, lvm_column_t *columns,
+                  lvm_row_t *selection, unsigned *count)
+{
+  operator_t *operator;
+  lvm_status_t status;
+
+  if(*count > LVM_BATCH_SIZE) {
+    return EXECUTION_ERROR;
+  }
+
+  p->ip = 0;
+  if(get_type(p) != LVM_CMP_OP) {
+    PRINTF("Error: The code must start with a relational operator\n");
+    return EXECUTION_ERROR;
+  }
+
+  operator = get_operator(p);
+  status = eval_batch_logic(p, *operator, columns, selection, count);
+  if(!LVM_ERROR(status)) {
+    PRINTF("The statement is true for %u rows\n", *count);
+  } else {
+    PRINTF("Execution error: %d\n", (int)status);
+  }
+
+  return status;
+}
+
 void
 lvm_set_op(lvm_instance_t *p, operator_t op)
 {
@@ -472,6 +862,66 @@ lvm_set_variable_value(char *name, operand_value_t value)
   return TRUE;
 }
 
+variable_id_t
+lvm_get_variable_id(char *name)
+{
+  variable_id_t id;
+
+  id = lookup(name);
+  if(id >= sizeof(variables) / sizeof(variables[0]) ||
+     strcmp(variables[id].name, name) != 0) {
+    return LVM_INVALID_VARIABLE;
+  }
+  return id;
+}
+
+lvm_status_t
+lvm_set_variable_id_value(variable_id_t id, operand_value_t value)
+{
+  if(id >= sizeof(variables) / sizeof(variables[0])) {
+    return INVALID_IDENTIFIER;
+  }
+  variables[id].value = value;
+  return TRUE;
+}
+
+char *
+lvm_get_variable_name(variable_id_t id)
+{
+  if(id >= sizeof(variables) / sizeof(variables[0]) ||
+     variables[id].name[0] == '\0') {
+    return NULL;
+  }
+  return variables[id].name;
+}
+
+lvm_status_t
+lvm_replace_long(lvm_instance_t *p, unsigned operand_number, long l)
+{
+  lvm_ip_t ip;
+  node_type_t type;
+  operand_t op;
+
+  /* Operands are stored in the same order as they were set, so the
+     code can be walked from the start to find a given operand. */
+  for(ip = 0; ip < p->end;) {
+    memcpy(&type, &p->code[ip], sizeof(type));
+    ip += sizeof(type);
+    if(type != LVM_OPERAND) {
+      ip += sizeof(operator_t);
+    } else if(operand_number-- > 0) {
+      ip += sizeof(operand_t);
+    } else {
+      op.type = LVM_LONG;
+      op.value.l = l;
+      memcpy(&p->code[ip], &op, sizeof(op));
+      return TRUE;
+    }
+  }
+
+  return INVALID_IDENTIFIER;
+}
+
 void
 lvm_set_variable(lvm_instance_t *p, char *name)
 {
@@ -542,14 +992,10 @@ create_union(derivation_t *result, derivation_t *d1, derivation_t *d2)
   int i;
 
   for(i = 0; i < LVM_MAX_VARIABLE_ID; i++) {
-    if(!d1[i].derived && !d2[i].derived) {
+    if(!d1[i].derived || !d2[i].derived) {
+      /* A variable that is unconstrained in one of the operands
+         can have any value. */
       continue;
-    } else if(d1[i].derived && !d2[i].derived) {
-      result[i].min.l = d1[i].min.l;
-      result[i].max.l = d1[i].max.l;
-    } else if(!d1[i].derived && d2[i].derived) {
-      result[i].min.l = d2[i].min.l;
-      result[i].max.l = d2[i].max.l;
     } else {
       /* Both derivations have been made; create a
          union of the ranges. */
@@ -588,6 +1034,7 @@ derive_relation(lvm_instance_t *p, derivation_t *local_derivations)
   int i;
   int var;
   int variable_id;
+  operator_t op;
   operand_value_t *value;
   derivation_t *derivation;
 
@@ -655,12 +1102,33 @@ derive_relation(lvm_instance_t *p, derivation_t *local_derivations)
 
   PRINTF("variable id %d, value %ld\n", variable_id, *(long *)value);
 
+  /* Mirror the comparison if the variable is the right operand. */
+  op = *operator;
+  if(var == 1) {
+    switch(op) {
+    case LVM_GE:
+      op = LVM_LE;
+      break;
+    case LVM_GEQ:
+      op = LVM_LEQ;
+      break;
+    case LVM_LE:
+      op = LVM_GE;
+      break;
+    case LVM_LEQ:
+      op = LVM_GEQ;
+      break;
+    default:
+      break;
+    }
+  }
+
   derivation = local_derivations + variable_id;
   /* Default values. */
   derivation->max.l = LONG_MAX;
   derivation->min.l = LONG_MIN;
 
-  switch(*operator) {
+  switch(op) {
   case LVM_EQ:
     derivation->max = *value;
     derivation->min = *value;
@@ -689,6 +1157,8 @@ derive_relation(lvm_instance_t *p, derivation_t *local_derivations)
 lvm_status_t
 lvm_derive(lvm_instance_t *p)
 {
+  p->ip = 0;
+  memset(derivations, 0, sizeof(derivations));
   return derive_relation(p, derivations);
 }
 
@@ -120,7 +120,15 @@ struct operand {
 };
 typedef struct operand operand_t;
 
+#define LVM_INVALID_VARIABLE	((variable_id_t)-1)
+
+/* A row number within a batch, and the values of one variable
+   for all rows in a batch. */
+typedef unsigned char lvm_row_t;
+typedef long lvm_column_t[LVM_BATCH_SIZE];
+
 void lvm_reset(lvm_instance_t *p, unsigned char *code, lvm_ip_t size);
+void lvm_clear_variables(void);
 void lvm_clone(lvm_instance_t *dst, lvm_instance_t *src);
 lvm_status_t lvm_derive(lvm_instance_t *p);
 lvm_status_t lvm_get_derived_range(lvm_instance_t *p, char *name, 
@@ -128,8 +136,16 @@ lvm_status_t lvm_get_derived_range(lvm_instance_t *p, char *name,
                                    operand_value_t *max);
 void lvm_print_derivations(lvm_instance_t *p);
 lvm_status_t lvm_execute(lvm_instance_t *p);
+lvm_status_t lvm_execute_batch(lvm_instance_t *p, lvm_column_t *columns,
+                               lvm_row_t *selection, unsigned *count);
 lvm_status_t lvm_register_variable(char *name, operand_type_t type);
 lvm_status_t lvm_set_variable_value(char *name, operand_value_t value);
+variable_id_t lvm_get_variable_id(char *name);
+lvm_status_t lvm_set_variable_id_value(variable_id_t id,
+                                       operand_value_t value);
+char *lvm_get_variable_name(variable_id_t id);
+lvm_status_t lvm_replace_long(lvm_instance_t *p, unsigned operand_number,
+                              long l);
 void lvm_print_code(lvm_instance_t *p);
 lvm_ip_t lvm_jump_to_operand(lvm_instance_t *p);
 lvm_ip_t lvm_shift_for_operator(lvm_instance_t *p, lvm_ip_t end);
@@ -64,6 +64,7 @@ struct source_dest_map {
   attribute_t *to_attr;
   unsigned from_offset;
   unsigned to_offset;
+  variable_id_t variable_id;
 };
 
 static struct source_dest_map attr_map[AQL_ATTRIBUTE_LIMIT];
@@ -79,8 +80,147 @@ struct source_map {
 };
 
 static struct source_map source_map[AQL_ATTRIBUTE_LIMIT];
+
+/*
+ * Joins on attributes without an index are processed with a hash
+ * table over the smaller relation. The rows of this "build" relation
+ * are loaded into the join memory in blocks, and the larger "probe"
+ * relation is scanned once per block. If the build relation does not
+ * fit, the planner either keeps this block nested-loop scheme, or
+ * spills both relations into partition files by hash value so that
+ * each partition can be joined in a single block.
+ */
+#define JOIN_END		0xffff
+
+#if DB_JOIN_PARTITIONS > 0
+#define JOIN_PARTITION_SLOTS	DB_JOIN_PARTITIONS
+#else
+#define JOIN_PARTITION_SLOTS	1
+#endif
+
+enum {
+  JOIN_PHASE_PROBE,
+  JOIN_PHASE_SPILL_BUILD,
+  JOIN_PHASE_SPILL_PROBE
+};
+
+struct join_entry {
+  uint16_t next;
+  uint16_t hash;
+};
+
+struct join_table {
+  uint16_t buckets[DB_JOIN_HASH_BUCKETS];
+  unsigned char data[DB_JOIN_MEMORY];
+};
+
+struct join_input {
+  relation_t *rel;
+  attribute_t *attr;
+  unsigned char *row;
+  unsigned key_offset;
+  db_storage_id_t fd[JOIN_PARTITION_SLOTS];
+  tuple_id_t count[JOIN_PARTITION_SLOTS];
+  uint16_t pending[JOIN_PARTITION_SLOTS];
+  char filename[JOIN_PARTITION_SLOTS][DB_MAX_FILENAME_LENGTH];
+};
+
+static struct {
+  struct join_table *table;
+  struct join_input build;
+  struct join_input probe;
+  attribute_value_t probe_key;
+  tuple_id_t build_next;
+  tuple_id_t build_total;
+  tuple_id_t probe_next;
+  tuple_id_t probe_total;
+  tuple_id_t spill_next;
+  uint16_t entry_size;
+  uint16_t capacity;
+  uint16_t chain;
+  uint16_t probe_hash;
+  uint8_t partitions;
+  uint8_t partition;
+  uint8_t phase;
+} join;
+
+MEMB(join_table_memb, struct join_table, 1);
 #endif /* DB_FEATURE_JOIN */
 
+#if DB_FEATURE_GROUP
+/*
+ * Selections with a GROUP BY clause are aggregated in a single pass
+ * into a hash table of groups in the group memory. Each group entry
+ * holds the partial aggregates and the values of the grouping
+ * attributes, which form the group key. When the table is full, its
+ * entries are sorted by key and spilled to storage as a run. The
+ * runs are finally merged, and the partial aggregates of equal keys
+ * are combined while the result rows are returned.
+ */
+#define GROUP_END		0xffff
+#define GROUP_ALIGN(size)	(((size) + sizeof(long) - 1) & ~(sizeof(long) - 1))
+
+enum {
+  GROUP_PHASE_AGGREGATE,
+  GROUP_PHASE_OUTPUT_TABLE,
+  GROUP_PHASE_OUTPUT_RUNS
+};
+
+struct group_entry {
+  uint16_t next;
+};
+
+struct group_state {
+  long value;
+  long count;
+};
+
+struct group_table {
+  uint16_t buckets[DB_GROUP_HASH_BUCKETS];
+  long data[DB_GROUP_MEMORY / sizeof(long)];
+};
+
+static struct {
+  struct group_table *table;
+  db_storage_id_t fd;
+  char filename[DB_MAX_FILENAME_LENGTH];
+  unsigned long run_start[DB_GROUP_RUN_LIMIT + 1];
+  unsigned long run_next[DB_GROUP_RUN_LIMIT];
+  uint16_t entry_size;
+  uint16_t key_offset;
+  uint16_t key_length;
+  uint16_t slots;
+  uint16_t count;
+  uint16_t next;
+  uint8_t attribute_count;
+  uint8_t runs;
+  uint8_t run_limit;
+  uint8_t heads;
+  uint8_t phase;
+} group;
+
+MEMB(group_table_memb, struct group_table, 1);
+#endif /* DB_FEATURE_GROUP */
+
+#if DB_FEATURE_COLUMNAR
+/* The first tuple after the segment whose zone map was checked last. */
+static tuple_id_t zone_end;
+#endif /* DB_FEATURE_COLUMNAR */
+
+#if DB_SELECT_BATCH_MEMORY > 0
+/* Rows that a full scan has read ahead, and the rows among them that
+   fulfill the condition. */
+static struct {
+  unsigned char rows[DB_SELECT_BATCH_MEMORY];
+  lvm_column_t columns[LVM_MAX_VARIABLE_ID];
+  lvm_row_t selection[LVM_BATCH_SIZE];
+  unsigned count;
+  unsigned next;
+  uint8_t capacity;
+  uint8_t finished;
+} batch;
+#endif /* DB_SELECT_BATCH_MEMORY > 0 */
+
 static unsigned char row[DB_MAX_ATTRIBUTES_PER_RELATION * DB_MAX_ELEMENT_SIZE];
 static unsigned char extra_row[DB_MAX_ATTRIBUTES_PER_RELATION * DB_MAX_ELEMENT_SIZE];
 static unsigned char result_row[AQL_ATTRIBUTE_LIMIT * DB_MAX_ELEMENT_SIZE];
@@ -100,6 +240,9 @@ static void purge_relations(void);
 static void relation_clear(relation_t *);
 static relation_t *relation_allocate(void);
 static void relation_free(relation_t *);
+#if DB_FEATURE_JOIN
+static void reset_join_input(struct join_input *);
+#endif /* DB_FEATURE_JOIN */
 
 static relation_t *
 relation_find(char *name)
@@ -164,7 +307,9 @@ purge_relations(void)
 
   for(rel = list_head(relations); rel != NULL;) {
     next = rel->next;
-    if(rel->references == 0) {
+    /* A relation whose buffered rows could not be written on unload
+       is kept, so that they are not lost. */
+    if(rel->references == 0 && !DB_ERROR(storage_unload(rel))) {
       relation_free(rel);
     }
     rel = next;
@@ -220,6 +365,20 @@ relation_init(void)
   memb_init(&relations_memb);
   memb_init(&attributes_memb);
 
+#if DB_FEATURE_JOIN
+  memb_init(&join_table_memb);
+  join.table = NULL;
+  reset_join_input(&join.build);
+  reset_join_input(&join.probe);
+#endif /* DB_FEATURE_JOIN */
+
+#if DB_FEATURE_GROUP
+  memb_init(&group_table_memb);
+  group.table = NULL;
+  group.fd = -1;
+  group.filename[0] = '\0';
+#endif /* DB_FEATURE_GROUP */
+
   return DB_OK;
 }
 
@@ -266,18 +425,25 @@ relation_release(relation_t *rel)
   }
 
   if(rel->references == 0) {
-    storage_unload(rel);
+    return storage_unload(rel);
   }
 
   return DB_OK;
 }
 
 relation_t *
-relation_create(char *name, db_direction_t dir)
+relation_create(char *name, db_direction_t dir, db_storage_format_t format)
 {
   relation_t old_rel;
   relation_t *rel;
 
+#if !DB_FEATURE_COLUMNAR
+  if(format == DB_FORMAT_COLUMN) {
+    PRINTF("DB: Columnar relations are not supported\n");
+    return NULL;
+  }
+#endif /* !DB_FEATURE_COLUMNAR */
+
   if(*name != '\0') {
     relation_clear(&old_rel);
 
@@ -300,6 +466,7 @@ relation_create(char *name, db_direction_t dir)
     rel->dir = dir;
 
     if(dir == DB_STORAGE) {
+      rel->format = format;
       storage_drop_relation(rel, 1);
 
       if(storage_put_relation(rel) == DB_OK) {
@@ -320,11 +487,20 @@ relation_create(char *name, db_direction_t dir)
 db_result_t
 relation_rename(char *old_name, char *new_name)
 {
+  relation_t *rel;
+
   if(DB_ERROR(relation_remove(new_name, 0)) ||
      DB_ERROR(storage_rename_relation(old_name, new_name))) {
     return DB_STORAGE_ERROR;
   }
 
+  /* Forget the old name, so that a later relation by that name does
+     not remove the tuples that now belong to the renamed relation. */
+  rel = relation_find(old_name);
+  if(rel != NULL && rel->references == 0) {
+    relation_free(rel);
+  }
+
   return DB_OK;
 }
 #endif /* DB_FEATURE_REMOVE */
@@ -347,6 +523,16 @@ relation_attribute_add(relation_t *rel, db_direction_t dir, char *name,
     return NULL;
   }
 
+#if DB_FEATURE_COLUMNAR
+  /* The rows of a columnar relation are decoded into a storage buffer. */
+  if(rel->format == DB_FORMAT_COLUMN &&
+     (rel->row_length + element_size > DB_STORAGE_BUFFER_SIZE ||
+      rel->attribute_count >= DB_MAX_ATTRIBUTES_PER_RELATION)) {
+    PRINTF("DB: Too large row in columnar relation %s\n", rel->name);
+    return NULL;
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
   attribute = memb_alloc(&attributes_memb);
   if(attribute == NULL) {
     PRINTF("DB: Failed to allocate attribute \"%s\"!\n", name);
@@ -468,6 +654,10 @@ relation_remove(char *name, int remove_tuples)
   }
 
   result = storage_drop_relation(rel, remove_tuples);
+  if(DB_ERROR(result)) {
+    relation_release(rel);
+    return result;
+  }
   relation_free(rel);
   return result;
 }
@@ -619,6 +809,9 @@ generate_attribute_map(struct source_dest_map *attr_map, unsigned attribute_coun
     }
     attr_map_ptr->from_offset = offset;
     attr_map_ptr->to_offset = size_sum;
+    /* Resolve the LVM variable once instead of looking up its name
+       for each row. */
+    attr_map_ptr->variable_id = lvm_get_variable_id(to_attr->name);
 
     size_sum += to_attr->element_size;
     attr_map_ptr++;
@@ -654,8 +847,9 @@ select_index(db_handle_t *handle, lvm_instance_t *lvm_instance)
              attr->name, range + 1);
 
       if(range <= min_range) {
+        min_range = range;
         index = attr->index;
-        av_min.domain = av_max.domain = DOMAIN_INT;
+        av_min.domain = av_max.domain = DOMAIN_LONG;
         VALUE_LONG(&av_min) = min.l;
         VALUE_LONG(&av_max) = max.l;
       }
@@ -671,6 +865,235 @@ select_index(db_handle_t *handle, lvm_instance_t *lvm_instance)
   }
 }
 
+#if DB_FEATURE_COLUMNAR
+static void
+select_zone_map(db_handle_t *handle, aql_adt_t *adt)
+{
+  attribute_t *attr;
+  operand_value_t min;
+  operand_value_t max;
+
+  /* Segments can be skipped in full scans of columnar relations if
+     the condition restricts an attribute to a range of values. */
+  if(handle->rel->format != DB_FORMAT_COLUMN ||
+     (handle->flags & DB_HANDLE_FLAG_SEARCH_INDEX)) {
+    return;
+  }
+
+  for(attr = list_head(handle->rel->attributes);
+      attr != NULL;
+      attr = attr->next) {
+    if(!LVM_ERROR(lvm_get_derived_range(adt->lvm_instance, attr->name,
+                                        &min, &max))) {
+      handle->flags |= DB_HANDLE_FLAG_ZONE_MAP;
+      zone_end = 0;
+      return;
+    }
+  }
+}
+
+static db_result_t
+skip_segments(db_handle_t *handle)
+{
+  lvm_instance_t *lvm_instance;
+  attribute_t *attr;
+  operand_value_t min;
+  operand_value_t max;
+  long zone_min;
+  long zone_max;
+  db_result_t result;
+  int excluded;
+
+  lvm_instance = ((aql_adt_t *)handle->adt)->lvm_instance;
+
+  while(handle->tuple_id >= zone_end) {
+    excluded = 0;
+    for(attr = list_head(handle->rel->attributes);
+        attr != NULL && !excluded;
+        attr = attr->next) {
+      if(LVM_ERROR(lvm_get_derived_range(lvm_instance, attr->name,
+                                         &min, &max))) {
+        continue;
+      }
+
+      result = storage_get_zone(handle->rel, handle->tuple_id, attr,
+                                &zone_min, &zone_max, &zone_end);
+      if(result == DB_FINISHED) {
+        return DB_OK;
+      } else if(DB_ERROR(result)) {
+        return result;
+      }
+
+      excluded = zone_max < min.l || zone_min > max.l;
+    }
+
+    if(excluded) {
+      PRINTF("DB: Skipping tuples %lu to %lu by the zone map\n",
+             (unsigned long)handle->tuple_id, (unsigned long)zone_end - 1);
+      handle->tuple_id = zone_end;
+    }
+  }
+
+  return DB_OK;
+}
+#endif /* DB_FEATURE_COLUMNAR */
+
+static void
+decode_variable(struct source_dest_map *attr_map_ptr, unsigned char *from_ptr,
+                operand_value_t *operand_value)
+{
+  if(attr_map_ptr->from_attr->domain == DOMAIN_INT) {
+    operand_value->l = from_ptr[0] << 8 | from_ptr[1];
+  } else {
+    operand_value->l = (int32_t)((uint32_t)from_ptr[0] << 24 |
+                                 (uint32_t)from_ptr[1] << 16 |
+                                 (uint32_t)from_ptr[2] << 8 |
+                                 from_ptr[3]);
+  }
+}
+
+/* Whether the predicate reads the attribute as an LVM variable. */
+static int
+is_variable(struct source_dest_map *attr_map_ptr)
+{
+  return attr_map_ptr->variable_id != LVM_INVALID_VARIABLE &&
+         (attr_map_ptr->from_attr->domain == DOMAIN_INT ||
+          attr_map_ptr->from_attr->domain == DOMAIN_LONG);
+}
+
+#if DB_SELECT_BATCH_MEMORY > 0
+/* Full scans with a condition read rows ahead in batches, so that the
+   condition is evaluated by lvm_execute_batch() for many rows at once. */
+static void
+select_batch(db_handle_t *handle, aql_adt_t *adt)
+{
+  unsigned capacity;
+
+  if(adt->lvm_instance == NULL ||
+     (AQL_GET_FLAGS(adt) & AQL_FLAG_INVERSE_LOGIC) ||
+     (handle->flags & DB_HANDLE_FLAG_SEARCH_INDEX)) {
+    return;
+  }
+
+  capacity = sizeof(batch.rows) / handle->rel->row_length;
+  if(capacity > LVM_BATCH_SIZE) {
+    capacity = LVM_BATCH_SIZE;
+  }
+  if(capacity < 2) {
+    return;
+  }
+
+  batch.capacity = capacity;
+  batch.count = batch.next = 0;
+  batch.finished = 0;
+  handle->flags |= DB_HANDLE_FLAG_BATCH;
+}
+
+static db_result_t
+fill_batch(db_handle_t *handle)
+{
+  lvm_instance_t *lvm_instance;
+  struct source_dest_map *attr_map_ptr;
+  struct source_dest_map *attr_map_end;
+  unsigned char *batch_row;
+  operand_value_t operand_value;
+  db_result_t result;
+  lvm_status_t status;
+  unsigned row_length;
+  unsigned n;
+  unsigned i;
+
+  lvm_instance = ((aql_adt_t *)handle->adt)->lvm_instance;
+  attr_map_end = attr_map + handle->result_rel->attribute_count;
+  row_length = handle->rel->row_length;
+
+  for(n = 0; n < batch.capacity; n++) {
+#if DB_FEATURE_COLUMNAR
+    if(handle->flags & DB_HANDLE_FLAG_ZONE_MAP) {
+      result = skip_segments(handle);
+      if(DB_ERROR(result)) {
+        return result;
+      }
+    }
+#endif /* DB_FEATURE_COLUMNAR */
+
+    batch_row = &batch.rows[n * row_length];
+    result = storage_get_row(handle->rel, &handle->tuple_id, batch_row);
+    if(DB_ERROR(result)) {
+      PRINTF("DB: Failed to get a row in relation %s!\n", handle->rel->name);
+      return result;
+    } else if(result == DB_FINISHED) {
+      batch.finished = 1;
+      break;
+    }
+    handle->tuple_id++;
+
+    for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
+      if(is_variable(attr_map_ptr)) {
+        decode_variable(attr_map_ptr, batch_row + attr_map_ptr->from_offset,
+                        &operand_value);
+        batch.columns[attr_map_ptr->variable_id][n] = operand_value.l;
+      }
+    }
+    batch.selection[n] = n;
+  }
+
+  batch.count = n;
+  batch.next = 0;
+  if(n == 0) {
+    return DB_OK;
+  }
+
+  status = lvm_execute_batch(lvm_instance, batch.columns,
+                             batch.selection, &batch.count);
+  if(LVM_ERROR(status)) {
+    /* Find the rows for which lvm_execute() succeeds, as the row-by-row
+       evaluation would, so that an error in one row skips only that row. */
+    batch.count = 0;
+    for(i = 0; i < n; i++) {
+      for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
+        if(is_variable(attr_map_ptr)) {
+          operand_value.l = batch.columns[attr_map_ptr->variable_id][i];
+          lvm_set_variable_id_value(attr_map_ptr->variable_id, operand_value);
+        }
+      }
+      if(lvm_execute(lvm_instance) == TRUE) {
+        batch.selection[batch.count++] = i;
+      }
+    }
+  }
+
+  return DB_OK;
+}
+
+/* Copy the next row of the batch that fulfills the condition. Each call
+   reads at most one batch, and returns DB_OK if it found no such row. */
+static db_result_t
+next_batch_row(db_handle_t *handle)
+{
+  db_result_t result;
+  unsigned row_length;
+
+  if(batch.next == batch.count) {
+    if(batch.finished) {
+      return DB_FINISHED;
+    }
+    result = fill_batch(handle);
+    if(DB_ERROR(result)) {
+      return result;
+    }
+    if(batch.next == batch.count) {
+      return batch.finished ? DB_FINISHED : DB_OK;
+    }
+  }
+
+  row_length = handle->rel->row_length;
+  memcpy(row, &batch.rows[batch.selection[batch.next++] * row_length],
+         row_length);
+  return DB_GOT_ROW;
+}
+#endif /* DB_SELECT_BATCH_MEMORY > 0 */
+
 static db_result_t
 generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
 {
@@ -696,269 +1119,1445 @@ generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
     return DB_IMPLEMENTATION_ERROR;
   }
 
-  if(adt->lvm_instance != NULL) {
+  /* A removal keeps the tuples outside of the derived ranges, so it
+     must scan the whole relation. */
+  if(adt->lvm_instance != NULL &&
+     !(AQL_GET_FLAGS(adt) & AQL_FLAG_INVERSE_LOGIC)) {
     /* Try to establish acceptable ranges for the attribute values. */
     if(!LVM_ERROR(lvm_derive(adt->lvm_instance))) {
       select_index(handle, adt->lvm_instance);
+#if DB_FEATURE_COLUMNAR
+      select_zone_map(handle, adt);
+#endif /* DB_FEATURE_COLUMNAR */
     }
   }
 
+#if DB_SELECT_BATCH_MEMORY > 0
+  select_batch(handle, adt);
+#endif /* DB_SELECT_BATCH_MEMORY > 0 */
+
   handle->flags |= DB_HANDLE_FLAG_PROCESSING;
 
   return DB_OK;
 }
 
-#if DB_FEATURE_REMOVE
-db_result_t
-relation_process_remove(void *handle_ptr)
+#if DB_FEATURE_GROUP
+static unsigned char *
+group_slot(uint16_t i)
 {
-  db_handle_t *handle;
-  aql_adt_t *adt;
-  db_result_t result;
-
-  handle = (db_handle_t *)handle_ptr;
-  adt = handle->adt;
-
-  result = relation_process_select(handle_ptr);
-  if(result == DB_FINISHED) {
-    PRINTF("DB: Finished removing tuples. Overwriting relation %s with the result\n", 
-	adt->relations[1]);
-    relation_release(handle->rel);
-    relation_rename(adt->relations[0], adt->relations[1]);
-  }
-
-  return result;
+  return (unsigned char *)group.table->data + (unsigned long)i * group.entry_size;
 }
-#endif
 
-db_result_t
-relation_process_select(void *handle_ptr)
+static struct group_state *
+group_states(unsigned char *entry)
 {
-  db_handle_t *handle;
-  aql_adt_t *adt;
-  db_result_t result;
-  unsigned attribute_count;
-  struct source_dest_map *attr_map_ptr, *attr_map_end;
-  attribute_t *result_attr;
-  unsigned char *from_ptr;
-  unsigned char *to_ptr;
-  operand_value_t operand_value;
-  uint8_t intbuf[2];
-  attribute_value_t value;
-  lvm_status_t wanted_result;
-
-  handle = (db_handle_t *)handle_ptr;
-  adt = (aql_adt_t *)handle->adt;
+  return (struct group_state *)(entry + GROUP_ALIGN(sizeof(struct group_entry)));
+}
 
-  attribute_count = handle->result_rel->attribute_count;
-  attr_map_end = attr_map + attribute_count;
+static unsigned char *
+group_key(unsigned char *entry)
+{
+  return entry + group.key_offset;
+}
 
-  if(handle->flags & DB_HANDLE_FLAG_SEARCH_INDEX) {
-    handle->tuple_id = index_get_next(&handle->index_iterator);
-    if(handle->tuple_id == INVALID_TUPLE) {
-      PRINTF("DB: An attribute value could not be found in the index\n");
-      if(handle->index_iterator.next_item_no == 0) {
-        return DB_INDEX_ERROR;
-      }
+static int
+group_compare(unsigned char *entry1, unsigned char *entry2)
+{
+  return memcmp(group_key(entry1), group_key(entry2), group.key_length);
+}
 
-      if(adt->flags & AQL_FLAG_AGGREGATE) {
-        goto end_aggregation;
+static void
+copy_group_key(unsigned char *entry, unsigned char *row)
+{
+  struct source_dest_map *attr_map_ptr;
+  attribute_t *attr;
+  unsigned char *key;
+
+  key = group_key(entry);
+  for(attr_map_ptr = attr_map;
+      attr_map_ptr < attr_map + group.attribute_count;
+      attr_map_ptr++) {
+    attr = attr_map_ptr->to_attr;
+    if(attr->flags & ATTRIBUTE_FLAG_GROUP) {
+      if(attr->domain == DOMAIN_STRING) {
+        /* Clear the bytes after the string so that equal strings
+           produce equal keys. */
+        strncpy((char *)key, (char *)row + attr_map_ptr->from_offset,
+                attr->element_size);
+      } else {
+        memcpy(key, row + attr_map_ptr->from_offset, attr->element_size);
       }
-
-      return DB_FINISHED;
+      key += attr->element_size;
     }
   }
+}
 
-  /* Put the tuples fulfilling the given condition into a new relation.
-     The tuples may be projected. */
-  result = storage_get_row(handle->rel, &handle->tuple_id, row);
-  handle->tuple_id++;
-  if(DB_ERROR(result)) {
-    PRINTF("DB: Failed to get a row in relation %s!\n", handle->rel->name);
-    return result;
-  } else if(result == DB_FINISHED) {
-    if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
-      goto end_aggregation;
-    }
-    return DB_FINISHED;
+static uint16_t
+group_hash(unsigned char *entry)
+{
+  unsigned char *key;
+  uint16_t h;
+  uint16_t i;
+
+  key = group_key(entry);
+  h = 5381;
+  for(i = 0; i < group.key_length; i++) {
+    h = (h << 5) + h + key[i];
   }
 
-  /* Process the attributes in the result relation. */
-  for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
-    from_ptr = row + attr_map_ptr->from_offset;
-    result_attr = attr_map_ptr->to_attr;
+  return h;
+}
 
-    /* Update the internal state of the PLE. */
-    if(result_attr->domain == DOMAIN_INT) {
-      operand_value.l = from_ptr[0] << 8 | from_ptr[1];
-      lvm_set_variable_value(result_attr->name, operand_value);
-    } else if(result_attr->domain == DOMAIN_LONG) {
-      operand_value.l = (uint32_t)from_ptr[0] << 24 |
-                        (uint32_t)from_ptr[1] << 16 |
-                        (uint32_t)from_ptr[2] << 8 |
-                        from_ptr[3];
-      lvm_set_variable_value(result_attr->name, operand_value);
-    }
+static void
+reset_group_table(void)
+{
+  uint16_t i;
 
-    if(result_attr->flags & ATTRIBUTE_FLAG_NO_STORE) {
-      /* The attribute is used just for the predicate,
-         so do not copy the current value into the result. */
+  for(i = 0; i < DB_GROUP_HASH_BUCKETS; i++) {
+    group.table->buckets[i] = GROUP_END;
+  }
+  group.count = 0;
+}
+
+static void
+combine_groups(unsigned char *to_entry, unsigned char *from_entry)
+{
+  struct source_dest_map *attr_map_ptr;
+  struct group_state *to;
+  struct group_state *from;
+
+  to = group_states(to_entry);
+  from = group_states(from_entry);
+  for(attr_map_ptr = attr_map;
+      attr_map_ptr < attr_map + group.attribute_count;
+      attr_map_ptr++) {
+    if(attr_map_ptr->to_attr->aggregator == AQL_NONE) {
       continue;
     }
 
-    if(!(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE)) {
-      /* No aggregators. Copy the original value into the resulting tuple. */
-      memcpy(result_row + attr_map_ptr->to_offset, from_ptr,
-             result_attr->element_size);
+    switch(attr_map_ptr->to_attr->aggregator) {
+    case AQL_MAX:
+      if(from->value > to->value) {
+        to->value = from->value;
+      }
+      break;
+    case AQL_MIN:
+      if(from->value < to->value) {
+        to->value = from->value;
+      }
+      break;
+    default:
+      to->value += from->value;
+      break;
     }
+    to->count += from->count;
+    to++;
+    from++;
   }
+}
 
-  wanted_result = TRUE;
+static db_result_t
+read_group_run(uint8_t run)
+{
+  if(group.run_next[run] == group.run_start[run + 1]) {
+    group.heads &= ~(1 << run);
+    return DB_OK;
+  }
+
+  if(DB_ERROR(storage_read(group.fd, group_slot(run),
+                           group.run_next[run] * group.entry_size,
+                           group.entry_size))) {
+    return DB_STORAGE_ERROR;
+  }
+  group.run_next[run]++;
+  group.heads |= 1 << run;
+
+  return DB_OK;
+}
+
+/* The heads of the runs are kept in the first slots of the group memory. */
+static db_result_t
+start_group_merge(void)
+{
+  uint8_t i;
+
+  group.heads = 0;
+  for(i = 0; i < group.runs; i++) {
+    group.run_next[i] = group.run_start[i];
+    if(DB_ERROR(read_group_run(i))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  return DB_OK;
+}
+
+static db_result_t
+merge_groups(unsigned char *entry)
+{
+  int i;
+  int min;
+
+  min = -1;
+  for(i = 0; i < group.runs; i++) {
+    if((group.heads & (1 << i)) &&
+       (min < 0 || group_compare(group_slot(i), group_slot(min)) < 0)) {
+      min = i;
+    }
+  }
+
+  if(min < 0) {
+    return DB_FINISHED;
+  }
+
+  memcpy(entry, group_slot(min), group.entry_size);
+  if(DB_ERROR(read_group_run(min))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  /* The keys are unique within each run. */
+  for(i = 0; i < group.runs; i++) {
+    if((group.heads & (1 << i)) &&
+       group_compare(group_slot(i), entry) == 0) {
+      combine_groups(entry, group_slot(i));
+      if(DB_ERROR(read_group_run(i))) {
+        return DB_STORAGE_ERROR;
+      }
+    }
+  }
+
+  return DB_OK;
+}
+
+static db_result_t
+compact_group_runs(void)
+{
+  char filename[DB_MAX_FILENAME_LENGTH];
+  char *name;
+  db_storage_id_t fd;
+  unsigned char *entry;
+  unsigned long written;
+  db_result_t result;
+
+  name = storage_generate_file("group",
+           (unsigned long)group.run_start[group.runs] * group.entry_size);
+  if(name == NULL) {
+    return DB_STORAGE_ERROR;
+  }
+  strncpy(filename, name, sizeof(filename) - 1);
+  filename[sizeof(filename) - 1] = '\0';
+
+  fd = storage_open(filename);
+  if(fd < 0) {
+    storage_remove(filename);
+    return DB_STORAGE_ERROR;
+  }
+
+  written = 0;
+  entry = group_slot(group.slots - 1);
+  result = start_group_merge();
+  while(result == DB_OK) {
+    result = merge_groups(entry);
+    if(result == DB_OK) {
+      if(DB_ERROR(storage_write(fd, entry, written * group.entry_size,
+                                group.entry_size))) {
+        result = DB_STORAGE_ERROR;
+      }
+      written++;
+    }
+  }
+
+  if(DB_ERROR(result)) {
+    storage_close(fd);
+    storage_remove(filename);
+    return result;
+  }
+
+  PRINTF("DB: Merged %u group runs into one run of %lu groups\n",
+         group.runs, written);
+
+  storage_close(group.fd);
+  storage_remove(group.filename);
+  group.fd = fd;
+  strcpy(group.filename, filename);
+  group.runs = 1;
+  group.run_start[1] = written;
+
+  return DB_OK;
+}
+
+static db_result_t
+spill_groups(void)
+{
+  unsigned char *tmp;
+  uint16_t i;
+  uint16_t j;
+  char *name;
+
+  if(group.fd < 0) {
+    name = storage_generate_file("group", (unsigned long)group.run_limit *
+                                 group.count * group.entry_size);
+    if(name == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+    strncpy(group.filename, name, sizeof(group.filename) - 1);
+    group.fd = storage_open(group.filename);
+    if(group.fd < 0) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  /* Sort the groups by key, using the last slot as temporary storage. */
+  tmp = group_slot(group.slots - 1);
+  for(i = 1; i < group.count; i++) {
+    memcpy(tmp, group_slot(i), group.entry_size);
+    for(j = i; j > 0 && group_compare(group_slot(j - 1), tmp) > 0; j--) {
+      memcpy(group_slot(j), group_slot(j - 1), group.entry_size);
+    }
+    memcpy(group_slot(j), tmp, group.entry_size);
+  }
+
+  if(DB_ERROR(storage_write(group.fd, group.table->data,
+                            group.run_start[group.runs] * group.entry_size,
+                            group.count * group.entry_size))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  PRINTF("DB: Spilled a run of %u groups\n", group.count);
+
+  group.runs++;
+  group.run_start[group.runs] = group.run_start[group.runs - 1] + group.count;
+  reset_group_table();
+
+  if(group.runs == group.run_limit) {
+    return compact_group_runs();
+  }
+
+  return DB_OK;
+}
+
+static db_result_t
+group_row(unsigned char *row)
+{
+  struct source_dest_map *attr_map_ptr;
+  struct group_state *state;
+  attribute_value_t value;
+  unsigned char *entry;
+  uint16_t bucket;
+  uint16_t i;
+  long long_value;
+
+  entry = group_slot(group.slots - 1);
+  copy_group_key(entry, row);
+  bucket = group_hash(entry) % DB_GROUP_HASH_BUCKETS;
+
+  for(i = group.table->buckets[bucket]; i != GROUP_END;
+      i = ((struct group_entry *)group_slot(i))->next) {
+    if(group_compare(group_slot(i), entry) == 0) {
+      break;
+    }
+  }
+
+  if(i == GROUP_END) {
+    if(group.count == group.slots - 1) {
+      if(DB_ERROR(spill_groups())) {
+        return DB_STORAGE_ERROR;
+      }
+    }
+
+    i = group.count++;
+    entry = group_slot(i);
+    copy_group_key(entry, row);
+    ((struct group_entry *)entry)->next = group.table->buckets[bucket];
+    group.table->buckets[bucket] = i;
+
+    state = group_states(entry);
+    for(attr_map_ptr = attr_map;
+        attr_map_ptr < attr_map + group.attribute_count;
+        attr_map_ptr++) {
+      switch(attr_map_ptr->to_attr->aggregator) {
+      case AQL_NONE:
+        continue;
+      case AQL_MAX:
+        state->value = LONG_MIN;
+        break;
+      case AQL_MIN:
+        state->value = LONG_MAX;
+        break;
+      default:
+        state->value = 0;
+        break;
+      }
+      state->count = 0;
+      state++;
+    }
+  }
+
+  state = group_states(group_slot(i));
+  for(attr_map_ptr = attr_map;
+      attr_map_ptr < attr_map + group.attribute_count;
+      attr_map_ptr++) {
+    if(attr_map_ptr->to_attr->aggregator == AQL_NONE) {
+      continue;
+    }
+
+    if(DB_ERROR(db_phy_to_value(&value, attr_map_ptr->from_attr,
+                                row + attr_map_ptr->from_offset))) {
+      return DB_TYPE_ERROR;
+    }
+    long_value = db_value_to_long(&value);
+
+    switch(attr_map_ptr->to_attr->aggregator) {
+    case AQL_COUNT:
+      state->value++;
+      break;
+    case AQL_MAX:
+      if(long_value > state->value) {
+        state->value = long_value;
+      }
+      break;
+    case AQL_MIN:
+      if(long_value < state->value) {
+        state->value = long_value;
+      }
+      break;
+    default:
+      state->value += long_value;
+      break;
+    }
+    state->count++;
+    state++;
+  }
+
+  return DB_OK;
+}
+
+static db_result_t
+finish_groups(void)
+{
+  if(group.runs == 0) {
+    group.phase = GROUP_PHASE_OUTPUT_TABLE;
+    group.next = 0;
+    return DB_OK;
+  }
+
+  if(group.count > 0 && DB_ERROR(spill_groups())) {
+    return DB_STORAGE_ERROR;
+  }
+
+  group.phase = GROUP_PHASE_OUTPUT_RUNS;
+  return start_group_merge();
+}
+
+static db_result_t
+next_group(db_handle_t *handle)
+{
+  struct source_dest_map *attr_map_ptr;
+  struct group_state *state;
+  attribute_t *attr;
+  attribute_value_t value;
+  unsigned char *entry;
+  unsigned char *key;
+  db_result_t result;
+
+  if(group.phase == GROUP_PHASE_OUTPUT_TABLE) {
+    if(group.next == group.count) {
+      return DB_FINISHED;
+    }
+    entry = group_slot(group.next++);
+  } else {
+    entry = group_slot(group.slots - 1);
+    result = merge_groups(entry);
+    if(result != DB_OK) {
+      return result;
+    }
+  }
+
+  key = group_key(entry);
+  state = group_states(entry);
+  for(attr_map_ptr = attr_map;
+      attr_map_ptr < attr_map + group.attribute_count;
+      attr_map_ptr++) {
+    attr = attr_map_ptr->to_attr;
+    if(attr->flags & ATTRIBUTE_FLAG_NO_STORE) {
+      continue;
+    }
+
+    if(attr->flags & ATTRIBUTE_FLAG_GROUP) {
+      memcpy(result_row + attr_map_ptr->to_offset, key, attr->element_size);
+      key += attr->element_size;
+      continue;
+    }
+
+    value.domain = DOMAIN_LONG;
+    VALUE_LONG(&value) = state->value;
+    if(attr->aggregator == AQL_MEAN && state->count > 0) {
+      VALUE_LONG(&value) = state->value / state->count;
+    }
+    db_value_to_phy(result_row + attr_map_ptr->to_offset, attr, &value);
+    state++;
+  }
+
+  if(AQL_GET_FLAGS((aql_adt_t *)handle->adt) & AQL_FLAG_ASSIGN) {
+    if(DB_ERROR(storage_put_row(handle->result_rel, result_row))) {
+      PRINTF("DB: Failed to store a row in the result relation!\n");
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  handle->current_row++;
+  return DB_GOT_ROW;
+}
+
+static db_result_t
+process_group_result(db_handle_t *handle)
+{
+  db_result_t result;
+
+  result = next_group(handle);
+  if(result != DB_GOT_ROW) {
+    relation_group_free(handle);
+  }
+
+  return result;
+}
+
+static db_result_t
+start_groups(db_handle_t *handle)
+{
+  struct source_dest_map *attr_map_ptr;
+  attribute_t *attr;
+  unsigned key_length;
+  unsigned aggregates;
+
+  group.table = memb_alloc(&group_table_memb);
+  if(group.table == NULL) {
+    PRINTF("DB: The group memory is in use\n");
+    return DB_ALLOCATION_ERROR;
+  }
+
+  group.attribute_count = handle->result_rel->attribute_count;
+  key_length = aggregates = 0;
+  for(attr_map_ptr = attr_map;
+      attr_map_ptr < attr_map + group.attribute_count;
+      attr_map_ptr++) {
+    attr = attr_map_ptr->to_attr;
+    if(attr->flags & ATTRIBUTE_FLAG_GROUP) {
+      key_length += attr->element_size;
+    } else if(attr->aggregator != AQL_NONE) {
+      aggregates++;
+    }
+  }
+
+  group.key_offset = GROUP_ALIGN(sizeof(struct group_entry)) +
+                     aggregates * sizeof(struct group_state);
+  group.key_length = key_length;
+  group.entry_size = GROUP_ALIGN(group.key_offset + key_length);
+  group.slots = sizeof(group.table->data) / group.entry_size;
+
+  /* The slots hold at least two groups, and one temporary entry. */
+  if(group.slots < 3) {
+    PRINTF("DB: The group entries are too large for the group memory\n");
+    memb_free(&group_table_memb, group.table);
+    group.table = NULL;
+    return DB_LIMIT_ERROR;
+  }
+
+  group.run_limit = group.slots - 1 < DB_GROUP_RUN_LIMIT ?
+                    group.slots - 1 : DB_GROUP_RUN_LIMIT;
+  group.runs = 0;
+  group.run_start[0] = 0;
+  group.phase = GROUP_PHASE_AGGREGATE;
+  reset_group_table();
+
+  PRINTF("DB: Grouping with %u groups in memory\n", group.slots - 1);
+
+  handle->flags |= DB_HANDLE_FLAG_GROUP;
+
+  return DB_OK;
+}
+
+void
+relation_group_free(void *handle_ptr)
+{
+  db_handle_t *handle;
+
+  handle = (db_handle_t *)handle_ptr;
+  if(handle->flags & DB_HANDLE_FLAG_GROUP) {
+    if(group.fd >= 0) {
+      storage_close(group.fd);
+      group.fd = -1;
+    }
+    if(group.filename[0] != '\0') {
+      storage_remove(group.filename);
+      group.filename[0] = '\0';
+    }
+    memb_free(&group_table_memb, group.table);
+    group.table = NULL;
+    handle->flags &= ~DB_HANDLE_FLAG_GROUP;
+  }
+}
+#endif /* DB_FEATURE_GROUP */
+
+#if DB_FEATURE_REMOVE
+db_result_t
+relation_process_remove(void *handle_ptr)
+{
+  db_handle_t *handle;
+  aql_adt_t *adt;
+  db_result_t result;
+
+  handle = (db_handle_t *)handle_ptr;
+  adt = handle->adt;
+
+  result = relation_process_select(handle_ptr);
+  if(result == DB_FINISHED) {
+    PRINTF("DB: Finished removing tuples. Overwriting relation %s with the result\n", 
+	adt->relations[1]);
+    relation_release(handle->rel);
+    relation_release(handle->result_rel);
+    handle->rel = handle->result_rel = NULL;
+    relation_rename(adt->relations[0], adt->relations[1]);
+  }
+
+  return result;
+}
+#endif
+
+db_result_t
+relation_process_select(void *handle_ptr)
+{
+  db_handle_t *handle;
+  aql_adt_t *adt;
+  db_result_t result;
+  unsigned attribute_count;
+  struct source_dest_map *attr_map_ptr, *attr_map_end;
+  attribute_t *result_attr;
+  unsigned char *from_ptr;
+  unsigned char *to_ptr;
+  operand_value_t operand_value;
+  uint8_t intbuf[2];
+  attribute_value_t value;
+  lvm_status_t wanted_result;
+
+  handle = (db_handle_t *)handle_ptr;
+  adt = (aql_adt_t *)handle->adt;
+
+  attribute_count = handle->result_rel->attribute_count;
+  attr_map_end = attr_map + attribute_count;
+
+#if DB_FEATURE_GROUP
+  if((handle->flags & DB_HANDLE_FLAG_GROUP) &&
+     group.phase != GROUP_PHASE_AGGREGATE) {
+    return process_group_result(handle);
+  }
+#endif /* DB_FEATURE_GROUP */
+
+  if(handle->flags & DB_HANDLE_FLAG_SEARCH_INDEX) {
+    handle->tuple_id = index_get_next(&handle->index_iterator);
+    if(handle->tuple_id == INVALID_TUPLE) {
+      PRINTF("DB: No more attribute values in the index range\n");
+#if DB_FEATURE_GROUP
+      if(handle->flags & DB_HANDLE_FLAG_GROUP) {
+        goto end_group;
+      }
+#endif /* DB_FEATURE_GROUP */
+      if(adt->flags & AQL_FLAG_AGGREGATE) {
+        goto end_aggregation;
+      }
+
+      return DB_FINISHED;
+    }
+#if DB_FEATURE_COLUMNAR
+  } else if(handle->flags & DB_HANDLE_FLAG_ZONE_MAP) {
+    result = skip_segments(handle);
+    if(DB_ERROR(result)) {
+      return result;
+    }
+#endif /* DB_FEATURE_COLUMNAR */
+  }
+
+  /* Put the tuples fulfilling the given condition into a new relation.
+     The tuples may be projected. */
+#if DB_SELECT_BATCH_MEMORY > 0
+  if(handle->flags & DB_HANDLE_FLAG_BATCH) {
+    /* The rows of a batch have already been checked against the condition. */
+    result = next_batch_row(handle);
+    if(result == DB_OK) {
+      return DB_OK;
+    }
+  } else
+#endif /* DB_SELECT_BATCH_MEMORY > 0 */
+  {
+    result = storage_get_row(handle->rel, &handle->tuple_id, row);
+    handle->tuple_id++;
+  }
+  if(DB_ERROR(result)) {
+    PRINTF("DB: Failed to get a row in relation %s!\n", handle->rel->name);
+    return result;
+  } else if(result == DB_FINISHED) {
+#if DB_FEATURE_GROUP
+    if(handle->flags & DB_HANDLE_FLAG_GROUP) {
+      goto end_group;
+    }
+#endif /* DB_FEATURE_GROUP */
+    if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
+      goto end_aggregation;
+    }
+    return DB_FINISHED;
+  }
+
+  /* Process the attributes in the result relation. */
+  for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
+    from_ptr = row + attr_map_ptr->from_offset;
+    result_attr = attr_map_ptr->to_attr;
+
+    /* Update the internal state of the PLE. The result attribute of 
+       an aggregate may have another domain than the source attribute. */
+    if(is_variable(attr_map_ptr)) {
+      decode_variable(attr_map_ptr, from_ptr, &operand_value);
+      lvm_set_variable_id_value(attr_map_ptr->variable_id, operand_value);
+    }
+
+    if(result_attr->flags & ATTRIBUTE_FLAG_NO_STORE) {
+      /* The attribute is used just for the predicate,
+         so do not copy the current value into the result. */
+      continue;
+    }
+
+    if(!(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE)) {
+      /* No aggregators. Copy the original value into the resulting tuple. */
+      memcpy(result_row + attr_map_ptr->to_offset, from_ptr,
+             result_attr->element_size);
+    }
+  }
+
+  wanted_result = TRUE;
   if(AQL_GET_FLAGS(adt) & AQL_FLAG_INVERSE_LOGIC) {
     wanted_result = FALSE;
   }
 
-  /* Check whether the given predicate is true for this tuple. */
-  if(adt->lvm_instance == NULL ||
-     lvm_execute(adt->lvm_instance) == wanted_result) {
-    if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
-      for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
-        from_ptr = row + attr_map_ptr->from_offset;
-        result = db_phy_to_value(&value, attr_map_ptr->to_attr, from_ptr);
-        if(DB_ERROR(result)) {
-	  return result;
-        }
-        aggregate(attr_map_ptr->to_attr, &value);
-      }
-    } else {
-      if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
-        if(DB_ERROR(storage_put_row(handle->result_rel, result_row))) {
-          PRINTF("DB: Failed to store a row in the result relation!\n");
-          return DB_STORAGE_ERROR;
-        }
+  /* Check whether the given predicate is true for this tuple. */
+  if(adt->lvm_instance == NULL || (handle->flags & DB_HANDLE_FLAG_BATCH) ||
+     lvm_execute(adt->lvm_instance) == wanted_result) {
+#if DB_FEATURE_GROUP
+    if(handle->flags & DB_HANDLE_FLAG_GROUP) {
+      result = group_row(row);
+      if(DB_ERROR(result)) {
+        relation_group_free(handle);
+      }
+      return result;
+    }
+#endif /* DB_FEATURE_GROUP */
+    if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
+      for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
+        from_ptr = row + attr_map_ptr->from_offset;
+        result = db_phy_to_value(&value, attr_map_ptr->to_attr, from_ptr);
+        if(DB_ERROR(result)) {
+	  return result;
+        }
+        aggregate(attr_map_ptr->to_attr, &value);
+      }
+    } else {
+      if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
+        if(DB_ERROR(storage_put_row(handle->result_rel, result_row))) {
+          PRINTF("DB: Failed to store a row in the result relation!\n");
+          return DB_STORAGE_ERROR;
+        }
+      }
+      handle->current_row++;
+      return DB_GOT_ROW;
+    }
+  }
+
+  return DB_OK;
+
+end_aggregation:
+  /* Generate aggregated result if requested. */
+  for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
+    result_attr = attr_map_ptr->to_attr;
+    to_ptr = result_row + attr_map_ptr->to_offset;
+
+    intbuf[0] = result_attr->aggregation_value >> 8;
+    intbuf[1] = result_attr->aggregation_value & 0xff;
+    from_ptr = intbuf;
+    memcpy(to_ptr, from_ptr, result_attr->element_size);
+  }
+
+  if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
+    if(DB_ERROR(storage_put_row(handle->result_rel, result_row))) {
+      PRINTF("DB: Failed to store a row in the result relation!\n");
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  handle->current_row = 1;
+  AQL_GET_FLAGS(adt) &= ~AQL_FLAG_AGGREGATE; /* Stop the aggregation. */
+
+  return DB_GOT_ROW;
+
+#if DB_FEATURE_GROUP
+end_group:
+  if(DB_ERROR(finish_groups())) {
+    relation_group_free(handle);
+    return DB_STORAGE_ERROR;
+  }
+  return process_group_result(handle);
+#endif /* DB_FEATURE_GROUP */
+}
+
+db_result_t
+relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
+{
+  aql_adt_t *adt;
+  db_handle_t *handle;
+  char *name;
+  db_direction_t dir;
+  char *attribute_name;
+  attribute_t *attr;
+  domain_t domain;
+  size_t element_size;
+  int i;
+  int normal_attributes;
+  int group_attributes;
+  int aggregated_attributes;
+  db_result_t result;
+
+  adt = (aql_adt_t *)adt_ptr;
+
+  handle = (db_handle_t *)handle_ptr;
+  handle->rel = rel;
+  handle->adt = adt;
+
+  normal_attributes = group_attributes = aggregated_attributes = 0;
+  for(i = 0; i < AQL_ATTRIBUTE_COUNT(adt); i++) {
+    if(adt->aggregators[i] != AQL_NONE) {
+      aggregated_attributes++;
+    } else if(!(adt->attributes[i].flags & ATTRIBUTE_FLAG_NO_STORE)) {
+      /* Only count attributes projected into the result set. */
+      normal_attributes++;
+      if(adt->attributes[i].flags & ATTRIBUTE_FLAG_GROUP) {
+        group_attributes++;
+      }
+    }
+  }
+
+  if(AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP) {
+#if !DB_FEATURE_GROUP
+    return DB_RELATIONAL_ERROR;
+#endif /* !DB_FEATURE_GROUP */
+    /* Each projected attribute must be either grouped on or aggregated, 
+       and the median cannot be computed in a single pass. */
+    for(i = 0; i < AQL_ATTRIBUTE_COUNT(adt); i++) {
+      if(adt->aggregators[i] == AQL_MEDIAN) {
+        return DB_RELATIONAL_ERROR;
+      }
+    }
+    if(group_attributes != normal_attributes) {
+      return DB_RELATIONAL_ERROR;
+    }
+  } else if(normal_attributes > 0 && aggregated_attributes > 0) {
+    /* Preclude mixes of normal attributes and aggregated ones in 
+       selection results. */
+    return DB_RELATIONAL_ERROR;
+  }
+
+  if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
+    name = adt->relations[0];
+    dir = DB_STORAGE;
+  } else {
+    name = RESULT_RELATION;
+    dir = DB_MEMORY;
+  }
+  relation_remove(name, 1);
+  /* Tuple removals replace the relation with the result, so
+     preserve its storage format. */
+  relation_create(name, dir, AQL_GET_FLAGS(adt) & AQL_FLAG_INVERSE_LOGIC ?
+                             rel->format : DB_FORMAT_ROW);
+  handle->result_rel = relation_load(name);
+
+  if(handle->result_rel == NULL) {
+    PRINTF("DB: Failed to load a relation for the query result\n");
+    return DB_ALLOCATION_ERROR;
+  }
+
+  for(i = 0; i < AQL_ATTRIBUTE_COUNT(adt); i++) {
+    attribute_name = adt->attributes[i].name;
+
+    attr = relation_attribute_get(rel, attribute_name);
+    if(attr == NULL) {
+      PRINTF("DB: Select for invalid attribute %s in relation %s!\n",
+	     attribute_name, rel->name);
+      return DB_NAME_ERROR;
+    }
+
+    PRINTF("DB: Found attribute %s in relation %s\n",
+	attribute_name, rel->name);
+
+    domain = attr->domain;
+    element_size = attr->element_size;
+    if(adt->aggregators[i] != AQL_NONE) {
+      if(AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP) {
+        /* Aggregates of groups are computed in the LONG domain. */
+        domain = DOMAIN_LONG;
+        element_size = 4;
+      } else {
+        domain = DOMAIN_INT;
+        element_size = 2;
+      }
+    }
+
+    attr = relation_attribute_add(handle->result_rel, dir,
+				  attribute_name, domain, element_size);
+    if(attr == NULL) {
+      PRINTF("DB: Failed to add a result attribute\n");
+      relation_release(handle->result_rel);
+      return DB_ALLOCATION_ERROR;
+    }
+
+    attr->aggregator = adt->aggregators[i];
+    switch(attr->aggregator) {
+    case AQL_NONE:
+      break;
+    case AQL_MAX:
+      attr->aggregation_value = LONG_MIN;
+      break;
+    case AQL_MIN:
+      attr->aggregation_value = LONG_MAX;
+      break;
+    default:
+      attr->aggregation_value = 0;
+      break;
+    }
+
+    attr->flags = adt->attributes[i].flags;
+  }
+
+  result = generate_selection_result(handle, rel, adt);
+#if DB_FEATURE_GROUP
+  if(!DB_ERROR(result) && (AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP)) {
+    result = start_groups(handle);
+  }
+#endif /* DB_FEATURE_GROUP */
+
+  return result;
+}
+
+#if DB_FEATURE_JOIN
+static db_result_t
+emit_join_row(db_handle_t *handle)
+{
+  relation_t *join_rel;
+  unsigned char *join_next_attribute_ptr;
+  size_t element_size;
+  int i;
+
+  join_rel = handle->join_rel;
+
+  /* Use the source attribute map to fill in the physical representation
+     of the resulting tuple. */
+  join_next_attribute_ptr = join_row;
+
+  for(i = 0; i < join_rel->attribute_count; i++) {
+    element_size = source_map[i].attr->element_size;
+
+    memcpy(join_next_attribute_ptr, source_map[i].from_ptr, element_size);
+    join_next_attribute_ptr += element_size;
+  }
+
+  if(((aql_adt_t *)handle->adt)->flags & AQL_FLAG_ASSIGN) {
+    if(DB_ERROR(storage_put_row(join_rel, join_row))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  handle->current_row++;
+  return DB_GOT_ROW;
+}
+
+static db_result_t
+join_key(struct join_input *input, unsigned char *row,
+         attribute_value_t *value, uint16_t *hash)
+{
+  unsigned char *ptr;
+  unsigned long long_value;
+  uint16_t h;
+
+  if(DB_ERROR(db_phy_to_value(value, input->attr, row + input->key_offset))) {
+    return DB_TYPE_ERROR;
+  }
+
+  if(value->domain == DOMAIN_STRING) {
+    h = 5381;
+    for(ptr = VALUE_STRING(value); *ptr != '\0'; ptr++) {
+      h = (h << 5) + h + *ptr;
+    }
+  } else {
+    long_value = (unsigned long)db_value_to_long(value);
+    h = (uint16_t)(long_value ^ (long_value >> 16)) * 40503U;
+  }
+
+  *hash = h;
+  return DB_OK;
+}
+
+static int
+join_key_equal(attribute_value_t *a, attribute_value_t *b)
+{
+  if(a->domain == DOMAIN_STRING) {
+    return strcmp((char *)VALUE_STRING(a), (char *)VALUE_STRING(b)) == 0;
+  }
+  return db_value_to_long(a) == db_value_to_long(b);
+}
+
+static struct join_entry *
+join_entry(uint16_t i)
+{
+  return (struct join_entry *)&join.table->data[i * join.entry_size];
+}
+
+static db_result_t
+read_join_row(struct join_input *input, tuple_id_t tuple_id)
+{
+  if(join.partitions > 0) {
+    return storage_read(input->fd[join.partition], input->row,
+                        (unsigned long)tuple_id * input->rel->row_length,
+                        input->rel->row_length);
+  }
+  return storage_get_row(input->rel, &tuple_id, input->row);
+}
+
+static void
+close_partitions(struct join_input *input)
+{
+  int i;
+
+  for(i = 0; i < JOIN_PARTITION_SLOTS; i++) {
+    if(input->fd[i] >= 0) {
+      storage_close(input->fd[i]);
+      input->fd[i] = -1;
+    }
+  }
+}
+
+static void
+remove_partitions(struct join_input *input)
+{
+  int i;
+
+  close_partitions(input);
+  for(i = 0; i < JOIN_PARTITION_SLOTS; i++) {
+    if(input->filename[i][0] != '\0') {
+      storage_remove(input->filename[i]);
+      input->filename[i][0] = '\0';
+    }
+  }
+}
+
+static void
+join_cleanup(void)
+{
+  remove_partitions(&join.build);
+  remove_partitions(&join.probe);
+  if(join.table != NULL) {
+    memb_free(&join_table_memb, join.table);
+    join.table = NULL;
+  }
+}
+
+#if DB_JOIN_PARTITIONS > 0
+static db_result_t
+open_partitions(struct join_input *input, tuple_id_t rows)
+{
+  char *filename;
+  int i;
+
+  for(i = 0; i < join.partitions; i++) {
+    if(input->filename[i][0] == '\0') {
+      filename = storage_generate_file("join",
+                   (unsigned long)(rows / join.partitions + rows / 4 + 1) *
+                   input->rel->row_length);
+      if(filename == NULL) {
+        return DB_STORAGE_ERROR;
       }
-      handle->current_row++;
-      return DB_GOT_ROW;
+      strncpy(input->filename[i], filename, sizeof(input->filename[i]) - 1);
+    }
+    input->fd[i] = storage_open(input->filename[i]);
+    if(input->fd[i] < 0) {
+      return DB_STORAGE_ERROR;
     }
   }
+  return DB_OK;
+}
+
+/* The join memory is split into one write buffer per partition. */
+static unsigned
+spill_buffer_rows(struct join_input *input)
+{
+  return sizeof(join.table->data) / join.partitions / input->rel->row_length;
+}
 
+static db_result_t
+flush_partition(struct join_input *input, int i)
+{
+  unsigned row_length;
+  unsigned char *buf;
+
+  row_length = input->rel->row_length;
+  buf = &join.table->data[i * spill_buffer_rows(input) * row_length];
+  if(input->pending[i] > 0) {
+    if(DB_ERROR(storage_write(input->fd[i], buf,
+                              (unsigned long)input->count[i] * row_length,
+                              input->pending[i] * row_length))) {
+      return DB_STORAGE_ERROR;
+    }
+    input->count[i] += input->pending[i];
+    input->pending[i] = 0;
+  }
   return DB_OK;
+}
+#endif /* DB_JOIN_PARTITIONS > 0 */
 
-end_aggregation:
-  /* Generate aggregated result if requested. */
-  for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
-    result_attr = attr_map_ptr->to_attr;
-    to_ptr = result_row + attr_map_ptr->to_offset;
+static db_result_t
+load_join_block(void)
+{
+  struct join_entry *entry;
+  unsigned char *row;
+  attribute_value_t value;
+  db_result_t result;
+  uint16_t i;
+  uint16_t bucket;
 
-    intbuf[0] = result_attr->aggregation_value >> 8;
-    intbuf[1] = result_attr->aggregation_value & 0xff;
-    from_ptr = intbuf;
-    memcpy(to_ptr, from_ptr, result_attr->element_size);
+  for(i = 0; i < DB_JOIN_HASH_BUCKETS; i++) {
+    join.table->buckets[i] = JOIN_END;
   }
 
-  if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
-    if(DB_ERROR(storage_put_row(handle->result_rel, result_row))) {
-      PRINTF("DB: Failed to store a row in the result relation!\n");
+  for(i = 0; i < join.capacity && join.build_next < join.build_total; i++) {
+    result = read_join_row(&join.build, join.build_next);
+    if(DB_ERROR(result)) {
+      return result;
+    } else if(result == DB_FINISHED) {
+      join.build_total = join.build_next;
+      break;
+    }
+    join.build_next++;
+
+    entry = join_entry(i);
+    row = (unsigned char *)(entry + 1);
+    memcpy(row, join.build.row, join.build.rel->row_length);
+    if(DB_ERROR(join_key(&join.build, row, &value, &entry->hash))) {
+      return DB_TYPE_ERROR;
+    }
+    bucket = entry->hash % DB_JOIN_HASH_BUCKETS;
+    entry->next = join.table->buckets[bucket];
+    join.table->buckets[bucket] = i;
+  }
+
+  PRINTF("DB: Loaded %u rows of relation %s into the join memory\n",
+         i, join.build.rel->name);
+
+  join.chain = JOIN_END;
+  /* An empty block cannot produce any matches. */
+  join.probe_next = i > 0 ? 0 : join.probe_total;
+
+  return DB_OK;
+}
+
+static db_result_t
+start_join_pass(void)
+{
+  if(join.partitions > 0) {
+#if DB_JOIN_PARTITIONS > 0
+    close_partitions(&join.build);
+    close_partitions(&join.probe);
+    join.build.fd[join.partition] = storage_open(join.build.filename[join.partition]);
+    join.probe.fd[join.partition] = storage_open(join.probe.filename[join.partition]);
+    if(join.build.fd[join.partition] < 0 || join.probe.fd[join.partition] < 0) {
+      return DB_STORAGE_ERROR;
+    }
+    join.build_total = join.build.count[join.partition];
+    join.probe_total = join.probe.count[join.partition];
+#endif /* DB_JOIN_PARTITIONS > 0 */
+  } else {
+    join.build_total = relation_cardinality(join.build.rel);
+    join.probe_total = relation_cardinality(join.probe.rel);
+    if(join.build_total == INVALID_TUPLE || join.probe_total == INVALID_TUPLE) {
       return DB_STORAGE_ERROR;
     }
   }
 
-  handle->current_row = 1;
-  AQL_GET_FLAGS(adt) &= ~AQL_FLAG_AGGREGATE; /* Stop the aggregation. */
+  join.build_next = 0;
+  return load_join_block();
+}
 
-  return DB_GOT_ROW;
+#if DB_JOIN_PARTITIONS > 0
+/* Partition one row of the build or probe relation. */
+static db_result_t
+spill_join_row(void)
+{
+  struct join_input *input;
+  attribute_value_t value;
+  tuple_id_t tuple_id;
+  db_result_t result;
+  uint16_t hash;
+  unsigned i;
+  unsigned row_length;
+
+  input = join.phase == JOIN_PHASE_SPILL_BUILD ? &join.build : &join.probe;
+  row_length = input->rel->row_length;
+
+  tuple_id = join.spill_next;
+  result = storage_get_row(input->rel, &tuple_id, input->row);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  if(result != DB_FINISHED) {
+    join.spill_next++;
+    if(DB_ERROR(join_key(input, input->row, &value, &hash))) {
+      return DB_TYPE_ERROR;
+    }
+    i = (hash >> 8) % join.partitions;
+    if(input->pending[i] == spill_buffer_rows(input) &&
+       DB_ERROR(flush_partition(input, i))) {
+      return DB_STORAGE_ERROR;
+    }
+    memcpy(&join.table->data[(i * spill_buffer_rows(input) +
+                              input->pending[i]) * row_length],
+           input->row, row_length);
+    input->pending[i]++;
+    return DB_OK;
+  }
+
+  /* The relation has been partitioned. */
+  for(i = 0; i < join.partitions; i++) {
+    if(DB_ERROR(flush_partition(input, i))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+  close_partitions(input);
+
+  join.spill_next = 0;
+  if(join.phase == JOIN_PHASE_SPILL_BUILD) {
+    join.phase = JOIN_PHASE_SPILL_PROBE;
+    return open_partitions(&join.probe, relation_cardinality(join.probe.rel));
+  }
+
+  join.phase = JOIN_PHASE_PROBE;
+  join.partition = 0;
+  return start_join_pass();
 }
+#endif /* DB_JOIN_PARTITIONS > 0 */
 
-db_result_t
-relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
+static db_result_t
+process_hash_join(db_handle_t *handle)
+{
+  struct join_entry *entry;
+  attribute_value_t value;
+  unsigned char *row;
+  db_result_t result;
+  int advanced;
+
+#if DB_JOIN_PARTITIONS > 0
+  if(join.phase != JOIN_PHASE_PROBE) {
+    return spill_join_row();
+  }
+#endif
+
+  for(advanced = 0;;) {
+    /* Match the current probe row against the rows in its bucket. */
+    while(join.chain != JOIN_END) {
+      entry = join_entry(join.chain);
+      join.chain = entry->next;
+      if(entry->hash != join.probe_hash) {
+        continue;
+      }
+
+      row = (unsigned char *)(entry + 1);
+      if(DB_ERROR(db_phy_to_value(&value, join.build.attr,
+                                  row + join.build.key_offset))) {
+        return DB_TYPE_ERROR;
+      }
+      if(join_key_equal(&value, &join.probe_key)) {
+        memcpy(join.build.row, row, join.build.rel->row_length);
+        return emit_join_row(handle);
+      }
+    }
+
+    if(advanced) {
+      return DB_OK;
+    }
+
+    if(join.probe_next < join.probe_total) {
+      result = read_join_row(&join.probe, join.probe_next);
+      if(DB_ERROR(result)) {
+        return result;
+      } else if(result == DB_FINISHED) {
+        join.probe_total = join.probe_next;
+        continue;
+      }
+      join.probe_next++;
+      if(DB_ERROR(join_key(&join.probe, join.probe.row,
+                           &join.probe_key, &join.probe_hash))) {
+        return DB_TYPE_ERROR;
+      }
+      join.chain = join.table->buckets[join.probe_hash % DB_JOIN_HASH_BUCKETS];
+      advanced = 1;
+    } else if(join.build_next < join.build_total) {
+      /* Scan the probe relation again for the next block. */
+      result = load_join_block();
+      if(DB_ERROR(result)) {
+        return result;
+      }
+    } else if(join.partition + 1 < join.partitions) {
+      join.partition++;
+      result = start_join_pass();
+      if(DB_ERROR(result)) {
+        return result;
+      }
+    } else {
+      join_cleanup();
+      return DB_FINISHED;
+    }
+  }
+}
+
+static void
+reset_join_input(struct join_input *input)
 {
-  aql_adt_t *adt;
-  db_handle_t *handle;
-  char *name;
-  db_direction_t dir;
-  char *attribute_name;
-  attribute_t *attr;
   int i;
-  int normal_attributes;
 
-  adt = (aql_adt_t *)adt_ptr;
+  for(i = 0; i < JOIN_PARTITION_SLOTS; i++) {
+    input->fd[i] = -1;
+    input->count[i] = 0;
+    input->pending[i] = 0;
+    input->filename[i][0] = '\0';
+  }
+}
 
-  handle = (db_handle_t *)handle_ptr;
-  handle->rel = rel;
-  handle->adt = adt;
+static void
+init_join_input(struct join_input *input, relation_t *rel,
+                attribute_t *attr, unsigned char *row)
+{
+  input->rel = rel;
+  input->attr = attr;
+  input->row = row;
+  input->key_offset = get_attribute_value_offset(rel, attr);
+  reset_join_input(input);
+}
 
-  if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
-    name = adt->relations[0];
-    dir = DB_STORAGE;
+/* Choose between a hash join in memory, a block nested-loop join,
+   and a hash join that spills partitions to storage. */
+static db_result_t
+plan_hash_join(db_handle_t *handle)
+{
+  tuple_id_t left_cardinality;
+  tuple_id_t right_cardinality;
+  tuple_id_t build_cardinality;
+  tuple_id_t probe_cardinality;
+  unsigned long blocks;
+  unsigned entry_size;
+  unsigned max_row_length;
+
+  if((handle->left_join_attr->domain == DOMAIN_STRING) !=
+     (handle->right_join_attr->domain == DOMAIN_STRING)) {
+    PRINTF("DB: The join attributes have incompatible domains\n");
+    return DB_RELATIONAL_ERROR;
+  }
+
+  left_cardinality = relation_cardinality(handle->left_rel);
+  right_cardinality = relation_cardinality(handle->right_rel);
+  if(left_cardinality == INVALID_TUPLE || right_cardinality == INVALID_TUPLE) {
+    return DB_STORAGE_ERROR;
+  }
+
+  join_cleanup();
+  if(right_cardinality <= left_cardinality) {
+    init_join_input(&join.build, handle->right_rel, handle->right_join_attr, right_row);
+    init_join_input(&join.probe, handle->left_rel, handle->left_join_attr, left_row);
+    build_cardinality = right_cardinality;
+    probe_cardinality = left_cardinality;
   } else {
-    name = RESULT_RELATION;
-    dir = DB_MEMORY;
+    init_join_input(&join.build, handle->left_rel, handle->left_join_attr, left_row);
+    init_join_input(&join.probe, handle->right_rel, handle->right_join_attr, right_row);
+    build_cardinality = left_cardinality;
+    probe_cardinality = right_cardinality;
   }
-  relation_remove(name, 1);
-  relation_create(name, dir);
-  handle->result_rel = relation_load(name);
 
-  if(handle->result_rel == NULL) {
-    PRINTF("DB: Failed to load a relation for the query result\n");
+  join.table = memb_alloc(&join_table_memb);
+  if(join.table == NULL) {
+    PRINTF("DB: Failed to allocate the join memory\n");
     return DB_ALLOCATION_ERROR;
   }
 
-  for(i = normal_attributes = 0; i < AQL_ATTRIBUTE_COUNT(adt); i++) {
-    attribute_name = adt->attributes[i].name;
+  entry_size = sizeof(struct join_entry) + join.build.rel->row_length;
+  entry_size += entry_size % sizeof(uint16_t);
+  join.entry_size = entry_size;
+  join.capacity = sizeof(join.table->data) / entry_size;
+  if(join.capacity == 0) {
+    join_cleanup();
+    return DB_ALLOCATION_ERROR;
+  }
 
-    attr = relation_attribute_get(rel, attribute_name);
-    if(attr == NULL) {
-      PRINTF("DB: Select for invalid attribute %s in relation %s!\n",
-	     attribute_name, rel->name);
-      return DB_NAME_ERROR;
+  join.partitions = 0;
+  join.partition = 0;
+  join.phase = JOIN_PHASE_PROBE;
+  handle->flags |= DB_HANDLE_FLAG_HASH_JOIN;
+
+  blocks = (build_cardinality + join.capacity - 1) / join.capacity;
+
+#if DB_JOIN_PARTITIONS > 1
+  if(blocks > 1 &&
+     (unsigned long)(build_cardinality + probe_cardinality) *
+     (2 + DB_JOIN_WRITE_COST) <
+     build_cardinality + blocks * probe_cardinality) {
+    /* Leave some room for an uneven distribution of the keys. */
+    blocks += blocks / 4 + 1;
+    join.partitions = blocks < DB_JOIN_PARTITIONS ? blocks : DB_JOIN_PARTITIONS;
+
+    max_row_length = join.build.rel->row_length;
+    if(join.probe.rel->row_length > max_row_length) {
+      max_row_length = join.probe.rel->row_length;
     }
-
-    PRINTF("DB: Found attribute %s in relation %s\n",
-	attribute_name, rel->name);
-
-    attr = relation_attribute_add(handle->result_rel, dir,
-				  attribute_name, 
-				  adt->aggregators[i] ? DOMAIN_INT : attr->domain,
-				  attr->element_size);
-    if(attr == NULL) {
-      PRINTF("DB: Failed to add a result attribute\n");
-      relation_release(handle->result_rel);
-      return DB_ALLOCATION_ERROR;
+    while(join.partitions > 1 &&
+          sizeof(join.table->data) / join.partitions < max_row_length) {
+      join.partitions--;
     }
 
-    attr->aggregator = adt->aggregators[i];
-    switch(attr->aggregator) {
-    case AQL_NONE:
-      if(!(adt->attributes[i].flags & ATTRIBUTE_FLAG_NO_STORE)) {
-        /* Only count attributes projected into the result set. */
-        normal_attributes++;
-      }
-      break;
-    case AQL_MAX:
-      attr->aggregation_value = LONG_MIN;
-      break;
-    case AQL_MIN:
-      attr->aggregation_value = LONG_MAX;
-      break;
-    default:
-      attr->aggregation_value = 0;
-      break;
+    if(join.partitions > 1 &&
+       !DB_ERROR(open_partitions(&join.build, build_cardinality))) {
+      PRINTF("DB: Hash join with %u partitions\n", join.partitions);
+      join.phase = JOIN_PHASE_SPILL_BUILD;
+      join.spill_next = 0;
+      return DB_OK;
     }
 
-    attr->flags = adt->attributes[i].flags;
+    /* Fall back to a block nested-loop join if the spill fails. */
+    remove_partitions(&join.build);
+    join.partitions = 0;
   }
+#else
+  (void)max_row_length;
+#endif /* DB_JOIN_PARTITIONS > 1 */
 
-  /* Preclude mixes of normal attributes and aggregated ones in 
-     selection results. */
-  if(normal_attributes > 0 &&
-     handle->result_rel->attribute_count > normal_attributes) {
-     return DB_RELATIONAL_ERROR;
-  }
+  PRINTF("DB: Hash join over %lu blocks of %u rows\n",
+         blocks, join.capacity);
 
-  return generate_selection_result(handle, rel, adt);
+  return start_join_pass();
+}
+
+void
+relation_join_free(void *handle_ptr)
+{
+  db_handle_t *handle;
+
+  handle = (db_handle_t *)handle_ptr;
+  if(handle->flags & DB_HANDLE_FLAG_HASH_JOIN) {
+    join_cleanup();
+    handle->flags &= ~DB_HANDLE_FLAG_HASH_JOIN;
+  }
 }
 
-#if DB_FEATURE_JOIN
 db_result_t
 relation_process_join(void *handle_ptr)
 {
@@ -966,17 +2565,20 @@ relation_process_join(void *handle_ptr)
   db_result_t result;
   relation_t *left_rel;
   relation_t *right_rel;
-  relation_t *join_rel;
-  unsigned char *join_next_attribute_ptr;
-  size_t element_size;
   tuple_id_t right_tuple_id;
   attribute_value_t value;
-  int i;
 
   handle = (db_handle_t *)handle_ptr;
   left_rel = handle->left_rel;
   right_rel = handle->right_rel;
-  join_rel = handle->join_rel;
+
+  if(handle->flags & DB_HANDLE_FLAG_HASH_JOIN) {
+    result = process_hash_join(handle);
+    if(DB_ERROR(result)) {
+      relation_join_free(handle);
+    }
+    return result;
+  }
 
   if(!(handle->flags & DB_HANDLE_FLAG_INDEX_STEP)) {
     goto inner_loop;
@@ -1030,25 +2632,7 @@ inner_loop:
         return DB_IMPLEMENTATION_ERROR;
       }
 
-      /* Use the source attribute map to fill in the physical representation
-	 of the resulting tuple. */
-      join_next_attribute_ptr = join_row;
-
-      for(i = 0; i < join_rel->attribute_count; i++) {
-	element_size = source_map[i].attr->element_size;
-
-	memcpy(join_next_attribute_ptr, source_map[i].from_ptr, element_size);
-	join_next_attribute_ptr += element_size;
-      }
-
-      if(((aql_adt_t *)handle->adt)->flags & AQL_FLAG_ASSIGN) {
-        if(DB_ERROR(storage_put_row(join_rel, join_row))) {
-          return DB_STORAGE_ERROR;
-        }
-      }
-
-      handle->current_row++;
-      return DB_GOT_ROW;
+      return emit_join_row(handle);
     }
   }
 
@@ -1120,6 +2704,7 @@ relation_join(void *query_result, void *adt_ptr)
   int i;
   char *attribute_name;
   attribute_t *attr;
+  db_result_t result;
 
   adt = (aql_adt_t *)adt_ptr;
 
@@ -1137,7 +2722,7 @@ relation_join(void *query_result, void *adt_ptr)
     dir = DB_MEMORY;
   }
   relation_remove(name, 1);
-  relation_create(name, dir);
+  relation_create(name, dir, DB_FORMAT_ROW);
   join_rel = relation_load(name);
   handle->result_rel = join_rel;
 
@@ -1159,8 +2744,9 @@ relation_join(void *query_result, void *adt_ptr)
   }
 
   if(!index_exists(handle->right_join_attr)) {
-    PRINTF("DB: The attribute to join on is not indexed\n");
-    return DB_INDEX_ERROR;
+    PRINTF("DB: The attribute to join on is not indexed; using a hash join\n");
+    handle->flags &= ~DB_HANDLE_FLAG_INDEX_STEP;
+    handle->flags |= DB_HANDLE_FLAG_HASH_JOIN;
   }
 
   /*
@@ -1189,6 +2775,14 @@ relation_join(void *query_result, void *adt_ptr)
     handle->ncolumns++;
   }
 
+  if(handle->flags & DB_HANDLE_FLAG_HASH_JOIN) {
+    handle->flags &= ~DB_HANDLE_FLAG_HASH_JOIN;
+    result = plan_hash_join(handle);
+    if(DB_ERROR(result)) {
+      return result;
+    }
+  }
+
   return generate_join_result(handle);
 }
 #endif /* DB_FEATURE_JOIN */
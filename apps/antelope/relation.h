@@ -54,6 +54,12 @@ typedef enum db_direction {
   DB_STORAGE = 1
 } db_direction_t;
 
+/* The layout of the tuples of a relation in storage. */
+typedef enum db_storage_format {
+  DB_FORMAT_ROW = 0,
+  DB_FORMAT_COLUMN = 1
+} db_storage_format_t;
+
 #define RELATION_HAS_TUPLES(rel) ((rel)->tuple_storage >= 0)
 
 /*
@@ -70,6 +76,7 @@ struct relation {
   tuple_id_t next_row;
   db_storage_id_t tuple_storage;
   db_direction_t dir;
+  db_storage_format_t format;
   uint8_t references;
   char name[RELATION_NAME_LENGTH + 1];
   char tuple_filename[RELATION_NAME_LENGTH + 1];
@@ -84,7 +91,7 @@ db_result_t relation_process_select(void *);
 db_result_t relation_process_join(void *);
 relation_t *relation_load(char *);
 db_result_t relation_release(relation_t *);
-relation_t *relation_create(char *, db_direction_t);
+relation_t *relation_create(char *, db_direction_t, db_storage_format_t);
 db_result_t relation_rename(char *, char *);
 attribute_t *relation_attribute_add(relation_t *, db_direction_t, char *,
 				    domain_t, size_t);
@@ -97,6 +104,8 @@ db_result_t relation_remove(char *, int);
 db_result_t relation_insert(relation_t *, attribute_value_t *);
 db_result_t relation_select(void *, relation_t *, void *);
 db_result_t relation_join(void *, void *);
+void relation_join_free(void *);
+void relation_group_free(void *);
 tuple_id_t relation_cardinality(relation_t *);
 
 #endif /* RELATION_H */
@@ -102,8 +102,8 @@ db_phy_to_value(attribute_value_t *value, attribute_t *attr,
     PRINTF("DB: %s = %d\n", attr->name, int_value);
     break;
   case DOMAIN_LONG:
-    long_value = (long)ptr[0] << 24 | (long)ptr[1] << 16 |
-                 (long)ptr[2] << 8 | (long)ptr[3];
+    long_value = (int32_t)((uint32_t)ptr[0] << 24 | (uint32_t)ptr[1] << 16 |
+                           (uint32_t)ptr[2] << 8 | ptr[3]);
     VALUE_LONG(value) = long_value;
     PRINTF("DB: %s = %ld\n", attr->name, long_value);
     break;
@@ -166,6 +166,16 @@ db_value_to_long(attribute_value_t *value)
 db_result_t
 db_free(db_handle_t *handle)
 {
+#if DB_FEATURE_JOIN
+  if(handle->flags & DB_HANDLE_FLAG_HASH_JOIN) {
+    relation_join_free(handle);
+  }
+#endif /* DB_FEATURE_JOIN */
+#if DB_FEATURE_GROUP
+  if(handle->flags & DB_HANDLE_FLAG_GROUP) {
+    relation_group_free(handle);
+  }
+#endif /* DB_FEATURE_GROUP */
   if(handle->rel != NULL) {
     relation_release(handle->rel);
   }
@@ -35,6 +35,7 @@
  * 	Nicolas Tsiftes <nvt@sics.se>
  */
 
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -68,6 +69,94 @@ struct index_record {
 
 #define ROW_XOR 0xf6U
 
+#if DB_FEATURE_COLUMNAR && DB_STORAGE_BUFFER_SIZE == 0
+#error "Columnar relations require DB_STORAGE_BUFFER_SIZE > 0."
+#endif
+
+#if DB_STORAGE_BUFFER_SIZE > 0
+/*
+ * A storage buffer holds either a read-ahead window of the tuple
+ * file, or rows that have been inserted but not yet written. Rows are
+ * kept in their physical format, with the last byte encoded. Pending
+ * rows are written when the buffer fills up, before the relation is
+ * read, and when the relation is unloaded.
+ *
+ * For a columnar relation, the buffer instead holds the decoded rows
+ * of the segment at the given offset, or the rows of the next segment
+ * while it is being filled. The rows are not encoded in that case.
+ */
+struct storage_buffer {
+  relation_t *rel;
+  cfs_offset_t offset;
+  tuple_id_t row_count;
+#if DB_FEATURE_COLUMNAR
+  tuple_id_t first_row;
+  uint16_t segment_rows;
+  uint16_t segment_length;
+#endif /* DB_FEATURE_COLUMNAR */
+  uint16_t length;
+  uint8_t dirty;
+  unsigned char data[DB_STORAGE_BUFFER_SIZE];
+};
+
+static struct storage_buffer buffers[DB_STORAGE_BUFFER_LIMIT];
+#endif /* DB_STORAGE_BUFFER_SIZE > 0 */
+
+#if DB_FEATURE_COLUMNAR
+/*
+ * A columnar relation is stored as a sequence of segments, each of
+ * which holds as many rows as fit in a storage buffer. A segment
+ * consists of a header, one column header per attribute, the column
+ * data in attribute order, and a trailer:
+ *
+ *   header:  row count (2 bytes), segment length (2)
+ *   column:  encoding (1), data length (2), minimum (4), maximum (4)
+ *   trailer: total row count up to this segment (4), segment length (2),
+ *            end marker (1)
+ *
+ * Integer columns are stored either raw or as runs of equal deltas
+ * between consecutive values, whichever is shorter. The minimum and
+ * maximum values of a column form a zone map, which lets selections
+ * skip segments without decoding them. All numbers are big-endian.
+ */
+#define SEGMENT_HEADER_SIZE	4
+#define COLUMN_HEADER_SIZE	11
+#define SEGMENT_TRAILER_SIZE	7
+#define SEGMENT_END		0xc5
+
+#define COLUMN_RAW		0
+#define COLUMN_DELTA_RLE	1
+
+struct column_header {
+  long min;
+  long max;
+  uint16_t length;
+  uint8_t encoding;
+};
+
+/* Buffered output of an encoded segment. Bytes are only counted
+   if the file descriptor is negative. */
+struct segment_writer {
+  int fd;
+  unsigned long length;
+  uint8_t fill;
+  uint8_t error;
+  unsigned char data[16];
+};
+
+/* Buffered input of the column data in a segment. */
+struct segment_reader {
+  int fd;
+  unsigned remaining;
+  unsigned consumed;
+  uint8_t position;
+  uint8_t fill;
+  unsigned char data[16];
+};
+#endif /* DB_FEATURE_COLUMNAR */
+
+static db_result_t write_rows(relation_t *, unsigned char *, unsigned);
+
 static void
 merge_strings(char *dest, char *prefix, char *suffix)
 {
@@ -100,29 +189,792 @@ storage_generate_file(char *prefix, unsigned long size)
 #endif /* DB_FEATURE_COFFEE */
 }
 
+#if DB_FEATURE_COLUMNAR
+static void
+put_uint(unsigned char *ptr, uint32_t value, unsigned size)
+{
+  while(size-- > 0) {
+    ptr[size] = value & 0xff;
+    value >>= 8;
+  }
+}
+
+static uint32_t
+get_uint(const unsigned char *ptr, unsigned size)
+{
+  uint32_t value;
+
+  for(value = 0; size > 0; size--) {
+    value = value << 8 | *ptr++;
+  }
+  return value;
+}
+
+static int
+is_numeric(attribute_t *attr)
+{
+  return attr->domain == DOMAIN_INT || attr->domain == DOMAIN_LONG;
+}
+
+/* Get a value in the same way as it is given to the LVM, so that
+   zone maps can be compared with the ranges derived from conditions. */
+static long
+get_column_value(attribute_t *attr, unsigned char *ptr)
+{
+  if(attr->domain == DOMAIN_INT) {
+    return (long)get_uint(ptr, 2);
+  }
+  return (long)(int32_t)get_uint(ptr, 4);
+}
+
+static uint32_t
+zigzag_encode(uint32_t value)
+{
+  return value & 0x80000000UL ? ~(value << 1) : value << 1;
+}
+
+static uint32_t
+zigzag_decode(uint32_t value)
+{
+  return value & 1 ? ~(value >> 1) : value >> 1;
+}
+
+static void
+writer_flush(struct segment_writer *writer)
+{
+  if(writer->fd >= 0 && writer->fill > 0 &&
+     cfs_write(writer->fd, writer->data, writer->fill) != writer->fill) {
+    writer->error = 1;
+  }
+  writer->fill = 0;
+}
+
+static void
+writer_put(struct segment_writer *writer, unsigned char *ptr, unsigned length)
+{
+  writer->length += length;
+  if(writer->fd < 0) {
+    return;
+  }
+
+  while(length-- > 0) {
+    if(writer->fill == sizeof(writer->data)) {
+      writer_flush(writer);
+    }
+    writer->data[writer->fill++] = *ptr++;
+  }
+}
+
+static void
+writer_put_varint(struct segment_writer *writer, uint32_t value)
+{
+  unsigned char byte;
+
+  do {
+    byte = value & 0x7f;
+    value >>= 7;
+    if(value != 0) {
+      byte |= 0x80;
+    }
+    writer_put(writer, &byte, 1);
+  } while(value != 0);
+}
+
+static void
+encode_column(struct segment_writer *writer, struct storage_buffer *buffer,
+              attribute_t *attr, unsigned offset,
+              struct column_header *column)
+{
+  unsigned char *ptr;
+  unsigned char *end;
+  unsigned row_length;
+  uint32_t previous;
+  uint32_t value;
+  uint32_t delta;
+  uint32_t run_delta;
+  uint32_t run;
+
+  row_length = buffer->rel->row_length;
+  end = buffer->data + buffer->length;
+
+  if(column->encoding == COLUMN_RAW) {
+    for(ptr = buffer->data + offset; ptr < end; ptr += row_length) {
+      writer_put(writer, ptr, attr->element_size);
+    }
+    return;
+  }
+
+  previous = (uint32_t)column->min;
+  run_delta = run = 0;
+  for(ptr = buffer->data + offset; ptr < end; ptr += row_length) {
+    value = (uint32_t)get_column_value(attr, ptr);
+    delta = value - previous;
+    previous = value;
+    if(run > 0 && delta == run_delta) {
+      run++;
+      continue;
+    }
+    if(run > 0) {
+      writer_put_varint(writer, run);
+      writer_put_varint(writer, zigzag_encode(run_delta));
+    }
+    run_delta = delta;
+    run = 1;
+  }
+  if(run > 0) {
+    writer_put_varint(writer, run);
+    writer_put_varint(writer, zigzag_encode(run_delta));
+  }
+}
+
+static db_result_t
+read_bytes(relation_t *rel, cfs_offset_t offset,
+           unsigned char *ptr, unsigned length)
+{
+  if(cfs_seek(rel->tuple_storage, offset, CFS_SEEK_SET) == (cfs_offset_t)-1 ||
+     cfs_read(rel->tuple_storage, ptr, length) != length) {
+    return DB_STORAGE_ERROR;
+  }
+  return DB_OK;
+}
+
+static db_result_t
+get_column_row_amount(struct storage_buffer *buffer, tuple_id_t *amount)
+{
+  unsigned char trailer[SEGMENT_TRAILER_SIZE];
+  cfs_offset_t end;
+
+  if(buffer->row_count == INVALID_TUPLE) {
+    end = cfs_seek(buffer->rel->tuple_storage, 0, CFS_SEEK_END);
+    if(end == (cfs_offset_t)-1) {
+      return DB_STORAGE_ERROR;
+    }
+
+    if(end == 0) {
+      buffer->row_count = 0;
+    } else {
+      /* The trailer of the last segment holds the total row count. */
+      if(DB_ERROR(read_bytes(buffer->rel, end - sizeof(trailer),
+                             trailer, sizeof(trailer))) ||
+         trailer[SEGMENT_TRAILER_SIZE - 1] != SEGMENT_END) {
+        PRINTF("DB: Invalid segment trailer in relation %s\n",
+               buffer->rel->name);
+        return DB_STORAGE_ERROR;
+      }
+      buffer->row_count = get_uint(trailer, 4);
+    }
+  }
+
+  *amount = buffer->row_count;
+  return DB_OK;
+}
+
+/* Encode the rows in a buffer as a segment at an offset of the tuple
+   file. The rows remain in the buffer as the decoded segment. The 
+   segment is padded to min_length bytes before its trailer, so that it
+   covers a longer segment that it replaces. */
+static db_result_t
+write_segment(struct storage_buffer *buffer, cfs_offset_t offset,
+              tuple_id_t first_row, unsigned min_length)
+{
+  relation_t *rel;
+  struct column_header columns[DB_MAX_ATTRIBUTES_PER_RELATION];
+  struct column_header *column;
+  struct segment_writer writer;
+  unsigned char header[COLUMN_HEADER_SIZE];
+  unsigned char *ptr;
+  attribute_t *attr;
+  unsigned long segment_length;
+  unsigned long padding;
+  unsigned rows;
+  unsigned position;
+  long value;
+
+  rel = buffer->rel;
+  rows = buffer->length / rel->row_length;
+  if(rel->attribute_count > DB_MAX_ATTRIBUTES_PER_RELATION) {
+    return DB_LIMIT_ERROR;
+  }
+
+  /* Determine the zone map and the shortest encoding of each column. */
+  segment_length = SEGMENT_HEADER_SIZE + SEGMENT_TRAILER_SIZE;
+  for(position = 0, attr = list_head(rel->attributes), column = columns;
+      attr != NULL;
+      position += attr->element_size, attr = attr->next, column++) {
+    column->encoding = COLUMN_RAW;
+    column->length = rows * attr->element_size;
+    column->min = column->max = 0;
+
+    if(is_numeric(attr)) {
+      column->min = LONG_MAX;
+      column->max = LONG_MIN;
+      for(ptr = buffer->data + position;
+          ptr < buffer->data + buffer->length;
+          ptr += rel->row_length) {
+        value = get_column_value(attr, ptr);
+        if(value < column->min) {
+          column->min = value;
+        }
+        if(value > column->max) {
+          column->max = value;
+        }
+      }
+
+      memset(&writer, 0, sizeof(writer));
+      writer.fd = -1;
+      column->encoding = COLUMN_DELTA_RLE;
+      encode_column(&writer, buffer, attr, position, column);
+      if(writer.length < column->length) {
+        column->length = writer.length;
+      } else {
+        column->encoding = COLUMN_RAW;
+      }
+    }
+
+    segment_length += COLUMN_HEADER_SIZE + column->length;
+  }
+
+  padding = 0;
+  if(segment_length < min_length) {
+    padding = min_length - segment_length;
+    segment_length = min_length;
+  }
+
+  if(segment_length > 0xffff) {
+    return DB_LIMIT_ERROR;
+  }
+
+  if(cfs_seek(rel->tuple_storage, offset, CFS_SEEK_SET) == (cfs_offset_t)-1) {
+    return DB_STORAGE_ERROR;
+  }
+
+  memset(&writer, 0, sizeof(writer));
+  writer.fd = rel->tuple_storage;
+
+  put_uint(header, rows, 2);
+  put_uint(header + 2, segment_length, 2);
+  writer_put(&writer, header, SEGMENT_HEADER_SIZE);
+
+  for(column = columns; column < columns + rel->attribute_count; column++) {
+    header[0] = column->encoding;
+    put_uint(header + 1, column->length, 2);
+    put_uint(header + 3, (uint32_t)column->min, 4);
+    put_uint(header + 7, (uint32_t)column->max, 4);
+    writer_put(&writer, header, COLUMN_HEADER_SIZE);
+  }
+
+  for(position = 0, attr = list_head(rel->attributes), column = columns;
+      attr != NULL;
+      position += attr->element_size, attr = attr->next, column++) {
+    encode_column(&writer, buffer, attr, position, column);
+  }
+
+  /* The decoder skips any bytes between the column data and the trailer. */
+  header[0] = 0;
+  for(; padding > 0; padding--) {
+    writer_put(&writer, header, 1);
+  }
+
+  put_uint(header, first_row + rows, 4);
+  put_uint(header + 4, segment_length, 2);
+  header[6] = SEGMENT_END;
+  writer_put(&writer, header, SEGMENT_TRAILER_SIZE);
+  writer_flush(&writer);
+
+  if(writer.error) {
+    PRINTF("DB: Failed to write a segment of relation %s\n", rel->name);
+    buffer->row_count = INVALID_TUPLE;
+    buffer->segment_length = 0;
+    buffer->length = 0;
+    return DB_STORAGE_ERROR;
+  }
+
+  PRINTF("DB: Wrote a segment of %u rows in %lu bytes to relation %s\n",
+         rows, segment_length, rel->name);
+
+  buffer->offset = offset;
+  buffer->first_row = first_row;
+  buffer->segment_rows = rows;
+  buffer->segment_length = segment_length;
+  buffer->row_count = first_row + rows;
+
+  return DB_OK;
+}
+
+static db_result_t
+read_segment_header(struct storage_buffer *buffer)
+{
+  unsigned char header[SEGMENT_HEADER_SIZE];
+
+  buffer->length = 0;
+  buffer->segment_length = 0;
+  if(DB_ERROR(read_bytes(buffer->rel, buffer->offset,
+                         header, sizeof(header)))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  buffer->segment_rows = get_uint(header, 2);
+  buffer->segment_length = get_uint(header + 2, 2);
+  if(buffer->segment_rows == 0 ||
+     buffer->segment_length < SEGMENT_HEADER_SIZE + SEGMENT_TRAILER_SIZE) {
+    PRINTF("DB: Invalid segment header in relation %s\n", buffer->rel->name);
+    buffer->segment_length = 0;
+    return DB_STORAGE_ERROR;
+  }
+
+  return DB_OK;
+}
+
+/* Position a buffer at the segment that holds a tuple. The search
+   starts from the current position, since rows are mostly read in
+   order. */
+static db_result_t
+locate_segment(struct storage_buffer *buffer, tuple_id_t tuple_id)
+{
+  unsigned char trailer[SEGMENT_TRAILER_SIZE];
+
+  if(buffer->segment_length != 0 &&
+     tuple_id >= buffer->first_row &&
+     tuple_id < buffer->first_row + buffer->segment_rows) {
+    return DB_OK;
+  }
+
+  if(buffer->segment_length == 0 || tuple_id < buffer->first_row / 2) {
+    buffer->offset = 0;
+    buffer->first_row = 0;
+    if(DB_ERROR(read_segment_header(buffer))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  while(tuple_id < buffer->first_row) {
+    if(DB_ERROR(read_bytes(buffer->rel,
+                           buffer->offset - SEGMENT_TRAILER_SIZE,
+                           trailer, sizeof(trailer)))) {
+      buffer->segment_length = 0;
+      return DB_STORAGE_ERROR;
+    }
+    buffer->offset -= get_uint(trailer + 4, 2);
+    if(DB_ERROR(read_segment_header(buffer))) {
+      return DB_STORAGE_ERROR;
+    }
+    buffer->first_row -= buffer->segment_rows;
+  }
+
+  while(tuple_id >= buffer->first_row + buffer->segment_rows) {
+    buffer->offset += buffer->segment_length;
+    buffer->first_row += buffer->segment_rows;
+    if(DB_ERROR(read_segment_header(buffer))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  return DB_OK;
+}
+
+static int
+reader_get(struct segment_reader *reader)
+{
+  unsigned length;
+
+  if(reader->position == reader->fill) {
+    length = reader->remaining;
+    if(length > sizeof(reader->data)) {
+      length = sizeof(reader->data);
+    }
+    if(length == 0 || cfs_read(reader->fd, reader->data, length) != length) {
+      return -1;
+    }
+    reader->remaining -= length;
+    reader->fill = length;
+    reader->position = 0;
+  }
+
+  reader->consumed++;
+  return reader->data[reader->position++];
+}
+
+static int
+reader_get_varint(struct segment_reader *reader, uint32_t *value)
+{
+  unsigned shift;
+  int byte;
+
+  *value = 0;
+  for(shift = 0; shift < 32; shift += 7) {
+    byte = reader_get(reader);
+    if(byte < 0) {
+      return -1;
+    }
+    *value |= (uint32_t)(byte & 0x7f) << shift;
+    if(!(byte & 0x80)) {
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static db_result_t
+decode_column(struct segment_reader *reader, struct storage_buffer *buffer,
+              attribute_t *attr, unsigned offset, unsigned char *header)
+{
+  unsigned char *ptr;
+  unsigned char *end;
+  unsigned row_length;
+  unsigned start;
+  uint32_t value;
+  uint32_t delta;
+  uint32_t run;
+  unsigned i;
+  int byte;
+
+  row_length = buffer->rel->row_length;
+  end = buffer->data + buffer->length;
+  start = reader->consumed;
+
+  if(header[0] == COLUMN_RAW) {
+    for(ptr = buffer->data + offset; ptr < end; ptr += row_length) {
+      for(i = 0; i < attr->element_size; i++) {
+        byte = reader_get(reader);
+        if(byte < 0) {
+          return DB_STORAGE_ERROR;
+        }
+        ptr[i] = byte;
+      }
+    }
+  } else if(header[0] == COLUMN_DELTA_RLE && is_numeric(attr)) {
+    value = get_uint(header + 3, 4);
+    for(ptr = buffer->data + offset; ptr < end;) {
+      if(reader_get_varint(reader, &run) < 0 ||
+         reader_get_varint(reader, &delta) < 0 ||
+         run == 0 || run > (end - ptr + row_length - 1) / row_length) {
+        return DB_STORAGE_ERROR;
+      }
+      delta = zigzag_decode(delta);
+      for(; run > 0; run--, ptr += row_length) {
+        value += delta;
+        put_uint(ptr, value, attr->element_size);
+      }
+    }
+  } else {
+    return DB_STORAGE_ERROR;
+  }
+
+  return reader->consumed - start == get_uint(header + 1, 2) ?
+         DB_OK : DB_STORAGE_ERROR;
+}
+
+/* Decode the segment that a buffer is positioned at into rows. */
+static db_result_t
+decode_segment(struct storage_buffer *buffer)
+{
+  relation_t *rel;
+  struct segment_reader reader;
+  unsigned char headers[DB_MAX_ATTRIBUTES_PER_RELATION][COLUMN_HEADER_SIZE];
+  unsigned header_length;
+  unsigned offset;
+  attribute_t *attr;
+  int i;
+
+  rel = buffer->rel;
+  header_length = rel->attribute_count * COLUMN_HEADER_SIZE;
+  if(rel->attribute_count > DB_MAX_ATTRIBUTES_PER_RELATION ||
+     (unsigned long)buffer->segment_rows * rel->row_length >
+     sizeof(buffer->data) ||
+     buffer->segment_length < SEGMENT_HEADER_SIZE + header_length +
+                              SEGMENT_TRAILER_SIZE) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(DB_ERROR(read_bytes(rel, buffer->offset + SEGMENT_HEADER_SIZE,
+                         headers[0], header_length))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  /* The column data follows the headers, so continue reading from
+     the current file position. */
+  memset(&reader, 0, sizeof(reader));
+  reader.fd = rel->tuple_storage;
+  reader.remaining = buffer->segment_length - SEGMENT_HEADER_SIZE -
+                     header_length - SEGMENT_TRAILER_SIZE;
+
+  buffer->length = buffer->segment_rows * rel->row_length;
+  for(i = 0, offset = 0, attr = list_head(rel->attributes);
+      attr != NULL;
+      i++, offset += attr->element_size, attr = attr->next) {
+    if(DB_ERROR(decode_column(&reader, buffer, attr, offset, headers[i]))) {
+      PRINTF("DB: Failed to decode attribute %s in relation %s\n",
+             attr->name, rel->name);
+      buffer->length = 0;
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  PRINTF("DB: Decoded %u rows of relation %s starting at %lu\n",
+         buffer->segment_rows, rel->name, (unsigned long)buffer->first_row);
+
+  return DB_OK;
+}
+
+/*
+ * Determine where the buffered rows of a columnar relation are
+ * written. If the last segment has room for them, it is decoded in
+ * front of the buffered rows and rewritten in place, so that repeated
+ * insertions of a few rows do not fragment the relation into short
+ * segments. Otherwise, the rows are appended as a new segment.
+ *
+ * Adding rows may shorten an encoded column, since runs of equal deltas
+ * can merge. The length of the replaced segment is therefore returned
+ * in replaced_length, so that the new segment can be padded to end at
+ * the end of the file.
+ */
+static db_result_t
+merge_last_segment(struct storage_buffer *buffer, cfs_offset_t *offset,
+                   tuple_id_t *first_row, unsigned *replaced_length)
+{
+  relation_t *rel;
+  unsigned char trailer[SEGMENT_TRAILER_SIZE];
+  unsigned char *pending_rows;
+  unsigned pending;
+  unsigned segment_size;
+  db_result_t result;
+
+  rel = buffer->rel;
+  *replaced_length = 0;
+  if(DB_ERROR(get_column_row_amount(buffer, first_row))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  *offset = cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END);
+  if(*offset == (cfs_offset_t)-1) {
+    return DB_STORAGE_ERROR;
+  } else if(*offset == 0) {
+    return DB_OK;
+  }
+
+  pending = buffer->length;
+  if(DB_ERROR(read_bytes(rel, *offset - SEGMENT_TRAILER_SIZE,
+                         trailer, sizeof(trailer)))) {
+    return DB_STORAGE_ERROR;
+  }
+  buffer->offset = *offset - get_uint(trailer + 4, 2);
+  result = read_segment_header(buffer);
+  buffer->length = pending;
+  if(DB_ERROR(result)) {
+    return DB_STORAGE_ERROR;
+  }
+
+  segment_size = buffer->segment_rows * rel->row_length;
+  if(segment_size + pending > sizeof(buffer->data)) {
+    buffer->segment_length = 0;
+    return DB_OK;
+  }
+
+  /* Keep the buffered rows at the end of the buffer while decoding. */
+  pending_rows = buffer->data + sizeof(buffer->data) - pending;
+  memmove(pending_rows, buffer->data, pending);
+  buffer->first_row = *first_row - buffer->segment_rows;
+  result = decode_segment(buffer);
+  if(DB_ERROR(result)) {
+    segment_size = 0;
+    buffer->segment_length = 0;
+  }
+  memmove(buffer->data + segment_size, pending_rows, pending);
+  buffer->length = segment_size + pending;
+  if(DB_ERROR(result)) {
+    return DB_STORAGE_ERROR;
+  }
+
+  *offset = buffer->offset;
+  *first_row = buffer->first_row;
+  *replaced_length = buffer->segment_length;
+  return DB_OK;
+}
+#endif /* DB_FEATURE_COLUMNAR */
+
+#if DB_STORAGE_BUFFER_SIZE > 0
+static struct storage_buffer *
+buffer_find(relation_t *rel)
+{
+  int i;
+
+  for(i = 0; i < DB_STORAGE_BUFFER_LIMIT; i++) {
+    if(buffers[i].rel == rel) {
+      return &buffers[i];
+    }
+  }
+  return NULL;
+}
+
+static db_result_t
+buffer_flush(struct storage_buffer *buffer)
+{
+  db_result_t result;
+#if DB_FEATURE_COLUMNAR
+  cfs_offset_t offset;
+  tuple_id_t first_row;
+  unsigned replaced_length;
+#endif /* DB_FEATURE_COLUMNAR */
+
+  result = DB_OK;
+#if DB_FEATURE_COLUMNAR
+  if(buffer->rel->format == DB_FORMAT_COLUMN) {
+    if(buffer->dirty && buffer->length > 0) {
+      result = merge_last_segment(buffer, &offset, &first_row,
+                                  &replaced_length);
+      if(!DB_ERROR(result)) {
+        result = write_segment(buffer, offset, first_row, replaced_length);
+      }
+    }
+    if(!DB_ERROR(result)) {
+      buffer->dirty = 0;
+    }
+    return result;
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+  if(buffer->dirty && buffer->length > 0) {
+    PRINTF("DB: Writing %u buffered bytes to relation %s\n",
+           buffer->length, buffer->rel->name);
+    result = write_rows(buffer->rel, buffer->data, buffer->length);
+    if(DB_ERROR(result)) {
+      /* Keep the rows, which have been acknowledged, for another try. */
+      return result;
+    }
+  }
+  buffer->dirty = 0;
+  buffer->length = 0;
+  return result;
+}
+
+static struct storage_buffer *
+buffer_allocate(relation_t *rel)
+{
+  struct storage_buffer *buffer;
+
+  if(rel->row_length > sizeof(buffer->data)) {
+    return NULL;
+  }
+
+  buffer = buffer_find(rel);
+  if(buffer == NULL) {
+    buffer = buffer_find(NULL);
+    if(buffer == NULL) {
+      PRINTF("DB: No storage buffer available for relation %s\n", rel->name);
+      return NULL;
+    }
+  } else if(DB_ERROR(buffer_flush(buffer))) {
+    /* Keep the rows that could not be written. */
+    return buffer;
+  }
+
+  buffer->rel = rel;
+  buffer->offset = 0;
+  buffer->length = 0;
+  buffer->dirty = 0;
+  buffer->row_count = INVALID_TUPLE;
+#if DB_FEATURE_COLUMNAR
+  buffer->segment_length = 0;
+#endif /* DB_FEATURE_COLUMNAR */
+
+  return buffer;
+}
+
+static db_result_t
+buffer_free(relation_t *rel, int write)
+{
+  struct storage_buffer *buffer;
+
+  buffer = buffer_find(rel);
+  if(buffer != NULL) {
+    if(write && DB_ERROR(buffer_flush(buffer))) {
+      /* The buffer stays with the relation until it can be written. */
+      return DB_STORAGE_ERROR;
+    }
+    buffer->rel = NULL;
+  }
+  return DB_OK;
+}
+#endif /* DB_STORAGE_BUFFER_SIZE > 0 */
+
 db_result_t
 storage_load(relation_t *rel)
 {
+  if(RELATION_HAS_TUPLES(rel)) {
+    /* The relation is loaded already, or an earlier unload could not
+       write its buffered rows. */
+    return DB_OK;
+  }
+
+#if !DB_FEATURE_COLUMNAR
+  if(rel->format == DB_FORMAT_COLUMN) {
+    return DB_STORAGE_ERROR;
+  }
+#endif /* !DB_FEATURE_COLUMNAR */
+
+#if DB_STORAGE_BUFFER_SIZE > 0
+  if(buffer_allocate(rel) == NULL && rel->format == DB_FORMAT_COLUMN) {
+    PRINTF("DB: A columnar relation needs a storage buffer\n");
+    return DB_STORAGE_ERROR;
+  }
+#endif
+
   PRINTF("DB: Opening the tuple file %s\n", rel->tuple_filename);
   rel->tuple_storage = cfs_open(rel->tuple_filename,
                                 CFS_READ | CFS_WRITE | CFS_APPEND);
   if(rel->tuple_storage < 0) {
     PRINTF("DB: Failed to open the tuple file\n");
+#if DB_STORAGE_BUFFER_SIZE > 0
+    buffer_free(rel, 0);
+#endif
     return DB_STORAGE_ERROR;
   }
 
   return DB_OK;
 }
 
-void
+db_result_t
 storage_unload(relation_t *rel)
 {
   if(RELATION_HAS_TUPLES(rel)) {
     PRINTF("DB: Unload tuple file %s\n", rel->tuple_filename);
 
+#if DB_STORAGE_BUFFER_SIZE > 0
+    if(DB_ERROR(buffer_free(rel, 1))) {
+      /* Keep the tuple file open, so that the rows can be written by a
+         later flush or unload. */
+      PRINTF("DB: Failed to write the buffered rows of %s\n", rel->name);
+      return DB_STORAGE_ERROR;
+    }
+#endif
     cfs_close(rel->tuple_storage);
     rel->tuple_storage = -1;
   }
+  return DB_OK;
+}
+
+db_result_t
+storage_flush(relation_t *rel)
+{
+#if DB_STORAGE_BUFFER_SIZE > 0
+  struct storage_buffer *buffer;
+
+  if(rel == NULL) {
+    int i;
+
+    for(i = 0; i < DB_STORAGE_BUFFER_LIMIT; i++) {
+      if(buffers[i].rel != NULL && DB_ERROR(buffer_flush(&buffers[i]))) {
+        return DB_STORAGE_ERROR;
+      }
+    }
+    return DB_OK;
+  }
+
+  buffer = buffer_find(rel);
+  if(buffer != NULL) {
+    return buffer_flush(buffer);
+  }
+#endif /* DB_STORAGE_BUFFER_SIZE > 0 */
+  return DB_OK;
 }
 
 db_result_t
@@ -156,6 +1008,11 @@ storage_get_relation(relation_t *rel, char *name)
 
   rel->tuple_filename[sizeof(rel->tuple_filename) - 1] ^= ROW_XOR;
 
+  if(strncmp(rel->tuple_filename, COLUMN_FILE_PREFIX ".",
+             sizeof(COLUMN_FILE_PREFIX)) == 0) {
+    rel->format = DB_FORMAT_COLUMN;
+  }
+
   /* Read attribute records. */
   result = DB_OK;
   for(i = 0;; i++) {
@@ -212,7 +1069,9 @@ storage_put_relation(relation_t *rel)
   }
 
   if(rel->tuple_filename[0] == '\0') {
-    str = storage_generate_file("tuple", DB_COFFEE_RESERVE_SIZE);
+    str = storage_generate_file(rel->format == DB_FORMAT_COLUMN ?
+                                COLUMN_FILE_PREFIX : TUPLE_FILE_PREFIX,
+                                DB_COFFEE_RESERVE_SIZE);
     if(str == NULL) {
       cfs_close(fd);
       cfs_remove(rel->name);
@@ -279,6 +1138,15 @@ storage_put_attribute(relation_t *rel, attribute_t *attr)
 db_result_t
 storage_drop_relation(relation_t *rel, int remove_tuples)
 {
+#if DB_STORAGE_BUFFER_SIZE > 0
+  if(DB_ERROR(buffer_free(rel, !remove_tuples))) {
+    return DB_STORAGE_ERROR;
+  }
+#endif
+  if(rel->dir == DB_MEMORY) {
+    /* Relations in memory, such as query results, have no files. */
+    return DB_OK;
+  }
   if(remove_tuples && RELATION_HAS_TUPLES(rel)) {
     cfs_remove(rel->tuple_filename);
   }
@@ -298,6 +1166,11 @@ storage_rename_relation(char *old_name, char *new_name)
   result = DB_STORAGE_ERROR;
   old_fd = new_fd = -1;
 
+  /* The renamed relation may share a tuple file with a loaded one. */
+  if(DB_ERROR(storage_flush(NULL))) {
+    return DB_STORAGE_ERROR;
+  }
+
   old_fd = cfs_open(old_name, CFS_READ);
   new_fd = cfs_open(new_name, CFS_WRITE);
   if(old_fd < 0 || new_fd < 0) {
@@ -405,6 +1278,10 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
 {
   int r;
   tuple_id_t nrows;
+  cfs_offset_t offset;
+#if DB_STORAGE_BUFFER_SIZE > 0
+  struct storage_buffer *buffer;
+#endif
 
   if(DB_ERROR(storage_get_row_amount(rel, &nrows))) {
     return DB_STORAGE_ERROR;
@@ -414,7 +1291,61 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
     return DB_FINISHED;
   }
 
-  if(cfs_seek(rel->tuple_storage, *tuple_id * rel->row_length, CFS_SEEK_SET) ==
+#if DB_FEATURE_COLUMNAR
+  if(rel->format == DB_FORMAT_COLUMN) {
+    buffer = buffer_find(rel);
+    if(buffer == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+    if(buffer->length == 0 ||
+       *tuple_id < buffer->first_row ||
+       *tuple_id >= buffer->first_row + buffer->segment_rows) {
+      if(DB_ERROR(locate_segment(buffer, *tuple_id)) ||
+         DB_ERROR(decode_segment(buffer))) {
+        return DB_STORAGE_ERROR;
+      }
+    }
+    memcpy(row, &buffer->data[(*tuple_id - buffer->first_row) *
+                              rel->row_length], rel->row_length);
+    return DB_OK;
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
+  offset = (cfs_offset_t)*tuple_id * rel->row_length;
+
+#if DB_STORAGE_BUFFER_SIZE > 0
+  buffer = buffer_find(rel);
+  if(buffer != NULL) {
+    if(offset < buffer->offset ||
+       offset + rel->row_length > buffer->offset + buffer->length) {
+      /* Read ahead as many whole rows as the buffer can hold. */
+      if(cfs_seek(rel->tuple_storage, offset, CFS_SEEK_SET) ==
+         (cfs_offset_t)-1) {
+        return DB_STORAGE_ERROR;
+      }
+      buffer->length = 0;
+      r = cfs_read(rel->tuple_storage, buffer->data,
+                   sizeof(buffer->data) - sizeof(buffer->data) % rel->row_length);
+      if(r < 0) {
+        PRINTF("DB: Reading failed on fd %d\n", rel->tuple_storage);
+        return DB_STORAGE_ERROR;
+      } else if(r == 0) {
+        return DB_FINISHED;
+      } else if(r < rel->row_length) {
+        PRINTF("DB: Incomplete record: %d < %d\n", r, rel->row_length);
+        return DB_STORAGE_ERROR;
+      }
+      buffer->offset = offset;
+      buffer->length = r;
+    }
+
+    memcpy(row, &buffer->data[offset - buffer->offset], rel->row_length);
+    row[rel->row_length - 1] ^= ROW_XOR;
+    return DB_OK;
+  }
+#endif /* DB_STORAGE_BUFFER_SIZE > 0 */
+
+  if(cfs_seek(rel->tuple_storage, offset, CFS_SEEK_SET) ==
               (cfs_offset_t)-1) {
     return DB_STORAGE_ERROR;
   }
@@ -437,13 +1368,12 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
   return DB_OK;
 }
 
-db_result_t
-storage_put_row(relation_t *rel, storage_row_t row)
+/* Append one or more encoded rows to the tuple file. */
+static db_result_t
+write_rows(relation_t *rel, unsigned char *data, unsigned length)
 {
   cfs_offset_t end;
-  unsigned remaining;
   int r;
-  unsigned char *last_byte;
 #if DB_FEATURE_INTEGRITY
   int missing_bytes;
   char buf[rel->row_length];
@@ -465,34 +1395,106 @@ storage_put_row(relation_t *rel, storage_row_t row)
   }
 #endif
 
+  do {
+    r = cfs_write(rel->tuple_storage, data, length);
+    if(r <= 0) {
+      PRINTF("DB: Failed to store %u bytes\n", length);
+      return DB_STORAGE_ERROR;
+    }
+    data += r;
+    length -= r;
+  } while(length > 0);
+
+  return DB_OK;
+}
+
+db_result_t
+storage_put_row(relation_t *rel, storage_row_t row)
+{
+  unsigned char *last_byte;
+  db_result_t result;
+#if DB_STORAGE_BUFFER_SIZE > 0
+  struct storage_buffer *buffer;
+
+  buffer = buffer_find(rel);
+  if(buffer != NULL) {
+    if(!buffer->dirty) {
+      /* Drop the read-ahead window and start collecting rows. */
+      buffer->length = 0;
+      buffer->dirty = 1;
+    } else if(buffer->length + rel->row_length > sizeof(buffer->data)) {
+      if(DB_ERROR(buffer_flush(buffer))) {
+        return DB_STORAGE_ERROR;
+      }
+      buffer->length = 0;
+      buffer->dirty = 1;
+    }
+
+    memcpy(&buffer->data[buffer->length], row, rel->row_length);
+    buffer->length += rel->row_length;
+#if DB_FEATURE_COLUMNAR
+    if(rel->format == DB_FORMAT_COLUMN) {
+      /* The rows are encoded when the segment is written. */
+      return DB_OK;
+    }
+#endif /* DB_FEATURE_COLUMNAR */
+    buffer->data[buffer->length - 1] ^= ROW_XOR;
+    buffer->row_count = INVALID_TUPLE;
+
+    PRINTF("DB: Buffered a row of %d bytes\n", rel->row_length);
+    return DB_OK;
+  }
+#endif /* DB_STORAGE_BUFFER_SIZE > 0 */
+
+#if DB_FEATURE_COLUMNAR
+  if(rel->format == DB_FORMAT_COLUMN) {
+    return DB_STORAGE_ERROR;
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
   /* Ensure that last written byte is separated from 0, to make file
      lengths correct in Coffee. */
   last_byte = row + rel->row_length - 1;
   *last_byte ^= ROW_XOR;
 
-  remaining = rel->row_length;
-  do {
-    r = cfs_write(rel->tuple_storage, row, remaining);
-    if(r < 0) {
-      PRINTF("DB: Failed to store %u bytes\n", remaining);
-      *last_byte ^= ROW_XOR;
-      return DB_STORAGE_ERROR;
-    }
-    row += r;
-    remaining -= r;
-  } while(remaining > 0);
-
-  PRINTF("DB: Stored a of %d bytes\n", rel->row_length);
+  result = write_rows(rel, row, rel->row_length);
 
   *last_byte ^= ROW_XOR;
 
-  return DB_OK;
+  if(result == DB_OK) {
+    PRINTF("DB: Stored a of %d bytes\n", rel->row_length);
+  }
+
+  return result;
 }
 
 db_result_t
 storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
 {
   cfs_offset_t offset;
+#if DB_STORAGE_BUFFER_SIZE > 0
+  struct storage_buffer *buffer;
+
+  buffer = buffer_find(rel);
+  if(buffer != NULL) {
+    if(buffer->dirty && DB_ERROR(buffer_flush(buffer))) {
+      return DB_STORAGE_ERROR;
+    }
+    if(buffer->row_count != INVALID_TUPLE) {
+      *amount = buffer->row_count;
+      return DB_OK;
+    }
+  }
+#endif /* DB_STORAGE_BUFFER_SIZE > 0 */
+
+#if DB_FEATURE_COLUMNAR
+  if(rel->format == DB_FORMAT_COLUMN) {
+    if(buffer == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+    return get_column_row_amount(buffer, amount);
+  }
+#endif /* DB_FEATURE_COLUMNAR */
 
   if(rel->row_length == 0) {
     *amount = 0;
@@ -505,7 +1507,70 @@ storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
     *amount = (tuple_id_t)(offset / rel->row_length);
   }
 
+#if DB_STORAGE_BUFFER_SIZE > 0
+  if(buffer != NULL) {
+    buffer->row_count = *amount;
+  }
+#endif
+
+  return DB_OK;
+}
+
+db_result_t
+storage_get_zone(relation_t *rel, tuple_id_t tuple_id, attribute_t *attr,
+                 long *min, long *max, tuple_id_t *next)
+{
+#if DB_FEATURE_COLUMNAR
+  struct storage_buffer *buffer;
+  unsigned char header[COLUMN_HEADER_SIZE];
+  attribute_t *ptr;
+  tuple_id_t nrows;
+  unsigned i;
+
+  if(rel->format != DB_FORMAT_COLUMN) {
+    return DB_ARGUMENT_ERROR;
+  }
+
+  if(DB_ERROR(storage_get_row_amount(rel, &nrows))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(tuple_id >= nrows) {
+    return DB_FINISHED;
+  }
+
+  buffer = buffer_find(rel);
+  if(buffer == NULL || DB_ERROR(locate_segment(buffer, tuple_id))) {
+    return DB_STORAGE_ERROR;
+  }
+  *next = buffer->first_row + buffer->segment_rows;
+
+  if(!is_numeric(attr)) {
+    *min = LONG_MIN;
+    *max = LONG_MAX;
+    return DB_OK;
+  }
+
+  for(i = 0, ptr = list_head(rel->attributes);
+      ptr != NULL && ptr != attr;
+      i++, ptr = ptr->next);
+  if(ptr == NULL) {
+    return DB_NAME_ERROR;
+  }
+
+  /* Read the zone map from the column header without decoding
+     the segment. */
+  if(DB_ERROR(read_bytes(rel, buffer->offset + SEGMENT_HEADER_SIZE +
+                         i * COLUMN_HEADER_SIZE, header, sizeof(header)))) {
+    return DB_STORAGE_ERROR;
+  }
+  *min = (int32_t)get_uint(header + 3, 4);
+  *max = (int32_t)get_uint(header + 7, 4);
+
   return DB_OK;
+#else
+  return DB_ARGUMENT_ERROR;
+#endif /* DB_FEATURE_COLUMNAR */
 }
 
 db_storage_id_t
@@ -528,6 +1593,12 @@ storage_close(db_storage_id_t fd)
   cfs_close(fd);
 }
 
+db_result_t
+storage_remove(const char *filename)
+{
+  return cfs_remove(filename) < 0 ? DB_STORAGE_ERROR : DB_OK;
+}
+
 db_result_t
 storage_read(db_storage_id_t fd,
 	     void *buffer, unsigned long offset, unsigned length)
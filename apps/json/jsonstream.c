@@ -0,0 +1,592 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+#include "jsonstream.h"
+#include <string.h>
+
+/* What the tokenizer expects next. */
+enum {
+  EXPECT_VALUE,
+  EXPECT_VALUE_OR_END,
+  EXPECT_NAME,
+  EXPECT_NAME_OR_END,
+  EXPECT_COLON,
+  EXPECT_COMMA_OR_END,
+  IN_NAME,
+  IN_NAME_ESCAPE,
+  IN_STRING,
+  IN_STRING_ESCAPE,
+  IN_NUMBER,
+  IN_LITERAL,
+  EXPECT_NOTHING,
+  FAILED
+};
+
+#define IS_WHITESPACE(c) \
+  ((c) == ' ' || (c) == '\n' || (c) == '\r' || (c) == '\t')
+
+#define IS_NUMBER_CHAR(c) \
+  (((c) >= '0' && (c) <= '9') || (c) == '.' || (c) == '-' || \
+   (c) == '+' || (c) == 'e' || (c) == 'E')
+
+/*--------------------------------------------------------------------*/
+static const char *
+segment(const struct jsonstream_query *query, int depth)
+{
+  return query->path + query->offsets[depth];
+}
+/*--------------------------------------------------------------------*/
+static int
+is_wildcard(const char *seg)
+{
+  return seg[0] == '*' && (seg[1] == '/' || seg[1] == '\0');
+}
+/*--------------------------------------------------------------------*/
+static int
+matches_index(const char *seg, unsigned index)
+{
+  unsigned long value;
+
+  if(is_wildcard(seg)) {
+    return 1;
+  }
+  if(*seg == '/' || *seg == '\0') {
+    return 0;
+  }
+  for(value = 0; *seg != '/' && *seg != '\0'; seg++) {
+    if(*seg < '0' || *seg > '9' || value > 0xffff) {
+      return 0;
+    }
+    value = value * 10 + (*seg - '0');
+  }
+  return value == index;
+}
+/*--------------------------------------------------------------------*/
+static int
+fail(struct jsonstream_state *state, char error)
+{
+  state->expect = FAILED;
+  state->error = error;
+  return JSONSTREAM_ERROR;
+}
+/*--------------------------------------------------------------------*/
+/* call the callbacks of the matching queries with a value fragment */
+/*--------------------------------------------------------------------*/
+static void
+deliver(struct jsonstream_state *state, const char *value, int len,
+        uint8_t flags)
+{
+  struct jsonstream_query *query;
+  jsonstream_mask_t bit;
+
+  flags |= state->vflags;
+  state->vflags = 0;
+  for(query = state->queries, bit = 1;
+      query != NULL;
+      query = query->next, bit <<= 1) {
+    if(state->value_mask & bit) {
+      query->callback(state, query, state->vtype, value, len, flags);
+    }
+  }
+}
+/*--------------------------------------------------------------------*/
+/* determine the queries that match a value that starts at the current
+   depth, given the queries that match its path */
+/*--------------------------------------------------------------------*/
+static void
+begin_value(struct jsonstream_state *state, uint8_t type)
+{
+  struct jsonstream_query *query;
+  struct jsonstream_frame *parent;
+  jsonstream_mask_t candidates;
+  jsonstream_mask_t bit;
+
+  if(state->depth == 0) {
+    candidates = ~(jsonstream_mask_t)0;
+  } else {
+    parent = &state->stack[state->depth - 1];
+    if(parent->type == JSON_TYPE_ARRAY) {
+      candidates = 0;
+      for(query = state->queries, bit = 1;
+          query != NULL;
+          query = query->next, bit <<= 1) {
+        if((parent->mask & bit) &&
+           matches_index(segment(query, state->depth - 1), parent->index)) {
+          candidates |= bit;
+        }
+      }
+    } else {
+      /* The candidates were determined from the member name. */
+      candidates = state->value_mask;
+    }
+  }
+
+  /* Split the candidates into the queries that end at this value and
+     the ones that continue into it. */
+  state->value_mask = 0;
+  state->name_mask = 0;
+  for(query = state->queries, bit = 1;
+      query != NULL && candidates != 0;
+      query = query->next, bit <<= 1) {
+    if(candidates & bit) {
+      candidates &= ~bit;
+      if(query->segments == state->depth) {
+        state->value_mask |= bit;
+      } else {
+        state->name_mask |= bit;
+      }
+    }
+  }
+
+  state->vtype = type;
+  state->vflags = JSONSTREAM_FIRST;
+}
+/*--------------------------------------------------------------------*/
+static int
+push(struct jsonstream_state *state, char type)
+{
+  struct jsonstream_frame *frame;
+  jsonstream_mask_t mask;
+
+  mask = state->name_mask;
+  if(state->value_mask != 0) {
+    deliver(state, NULL, 0, JSONSTREAM_LAST);
+  }
+  if(state->depth == JSONSTREAM_MAX_DEPTH) {
+    return fail(state, JSON_ERROR_TOO_DEEP);
+  }
+
+  frame = &state->stack[state->depth++];
+  frame->type = type;
+  frame->index = 0;
+  frame->mask = mask;
+  state->expect = type == JSON_TYPE_OBJECT ?
+    EXPECT_NAME_OR_END : EXPECT_VALUE_OR_END;
+  return JSONSTREAM_MORE;
+}
+/*--------------------------------------------------------------------*/
+static void
+end_value(struct jsonstream_state *state)
+{
+  state->value_mask = 0;
+  state->expect = state->depth == 0 ? EXPECT_NOTHING : EXPECT_COMMA_OR_END;
+}
+/*--------------------------------------------------------------------*/
+static int
+pop(struct jsonstream_state *state, char type)
+{
+  if(state->depth == 0 || state->stack[state->depth - 1].type != type) {
+    return fail(state, type == JSON_TYPE_ARRAY ?
+                JSON_ERROR_UNEXPECTED_END_OF_ARRAY : JSON_ERROR_SYNTAX);
+  }
+  state->depth--;
+  end_value(state);
+  return JSONSTREAM_MORE;
+}
+/*--------------------------------------------------------------------*/
+/* start the value that begins with the character c */
+/*--------------------------------------------------------------------*/
+static int
+start_value(struct jsonstream_state *state, char c)
+{
+  switch(c) {
+  case '{':
+    begin_value(state, JSON_TYPE_OBJECT);
+    return push(state, JSON_TYPE_OBJECT);
+  case '[':
+    begin_value(state, JSON_TYPE_ARRAY);
+    return push(state, JSON_TYPE_ARRAY);
+  case '"':
+    begin_value(state, JSON_TYPE_STRING);
+    state->expect = IN_STRING;
+    return JSONSTREAM_MORE;
+  case 't':
+    begin_value(state, JSON_TYPE_TRUE);
+    state->literal = "rue";
+    break;
+  case 'f':
+    begin_value(state, JSON_TYPE_FALSE);
+    state->literal = "alse";
+    break;
+  case 'n':
+    begin_value(state, JSON_TYPE_NULL);
+    state->literal = "ull";
+    break;
+  default:
+    if(c == '-' || (c >= '0' && c <= '9')) {
+      begin_value(state, JSON_TYPE_NUMBER);
+      state->expect = IN_NUMBER;
+      return JSONSTREAM_MORE;
+    }
+    return fail(state, JSON_ERROR_SYNTAX);
+  }
+  state->expect = IN_LITERAL;
+  return JSONSTREAM_MORE;
+}
+/*--------------------------------------------------------------------*/
+/* start matching a member name against the queries of the object */
+/*--------------------------------------------------------------------*/
+static void
+begin_name(struct jsonstream_state *state)
+{
+  struct jsonstream_query *query;
+  struct jsonstream_frame *frame;
+  jsonstream_mask_t bit;
+
+  frame = &state->stack[state->depth - 1];
+  state->name_mask = 0;
+  state->name_pos = 0;
+  for(query = state->queries, bit = 1;
+      query != NULL;
+      query = query->next, bit <<= 1) {
+    if((frame->mask & bit) &&
+       !is_wildcard(segment(query, state->depth - 1))) {
+      state->name_mask |= bit;
+    }
+  }
+  state->expect = IN_NAME;
+}
+/*--------------------------------------------------------------------*/
+static void
+match_name(struct jsonstream_state *state, char c)
+{
+  struct jsonstream_query *query;
+  jsonstream_mask_t bit;
+  char s;
+
+  for(query = state->queries, bit = 1;
+      query != NULL;
+      query = query->next, bit <<= 1) {
+    if(state->name_mask & bit) {
+      s = segment(query, state->depth - 1)[state->name_pos];
+      if(s != c || s == '/') {
+        state->name_mask &= ~bit;
+      }
+    }
+  }
+
+  if(state->name_pos == 0xff) {
+    state->name_mask = 0;
+  } else {
+    state->name_pos++;
+  }
+}
+/*--------------------------------------------------------------------*/
+static void
+end_name(struct jsonstream_state *state)
+{
+  struct jsonstream_query *query;
+  struct jsonstream_frame *frame;
+  jsonstream_mask_t bit;
+  const char *seg;
+
+  frame = &state->stack[state->depth - 1];
+  state->value_mask = 0;
+  for(query = state->queries, bit = 1;
+      query != NULL;
+      query = query->next, bit <<= 1) {
+    if(frame->mask & bit) {
+      seg = segment(query, state->depth - 1);
+      if(is_wildcard(seg) ||
+         ((state->name_mask & bit) &&
+          (seg[state->name_pos] == '/' || seg[state->name_pos] == '\0'))) {
+        state->value_mask |= bit;
+      }
+    }
+  }
+  state->expect = EXPECT_COLON;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_query_compile(struct jsonstream_query *query, const char *path,
+                         jsonstream_callback_t callback, void *ptr)
+{
+  const char *p;
+
+  if(path[0] != '/') {
+    return -1;
+  }
+
+  query->next = NULL;
+  query->path = path;
+  query->callback = callback;
+  query->ptr = ptr;
+  query->segments = 0;
+
+  /* The path "/" has no segments. */
+  if(path[1] == '\0') {
+    return 0;
+  }
+
+  for(p = path; *p != '\0'; p++) {
+    if(*p == '/') {
+      if(p[1] == '/' || p[1] == '\0' ||
+         query->segments == JSONSTREAM_MAX_DEPTH || p - path >= 0xff) {
+        return -1;
+      }
+      query->offsets[query->segments++] = p - path + 1;
+    }
+  }
+  return 0;
+}
+/*--------------------------------------------------------------------*/
+void
+jsonstream_init(struct jsonstream_state *state)
+{
+  memset(state, 0, sizeof(*state));
+  state->expect = EXPECT_VALUE;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_add_query(struct jsonstream_state *state,
+                     struct jsonstream_query *query)
+{
+  struct jsonstream_query **last;
+
+  if(state->query_count == JSONSTREAM_MAX_QUERIES) {
+    return -1;
+  }
+
+  /* Queries are kept in the order of their bits in the masks. */
+  for(last = &state->queries; *last != NULL; last = &(*last)->next);
+  query->next = NULL;
+  *last = query;
+  state->query_count++;
+  return 0;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_feed(struct jsonstream_state *state, const char *data, int len)
+{
+  const char *end;
+  const char *start;
+  struct jsonstream_frame *frame;
+  char c;
+
+  end = data + len;
+
+  /* A string or number may continue from the previous fragment. */
+  start = data;
+
+  while(data < end) {
+    c = *data;
+    switch(state->expect) {
+    case IN_STRING:
+      /* Skip ordinary characters quickly. */
+      while(c != '"' && c != '\\' && (unsigned char)c >= 0x20) {
+        if(++data == end) {
+          goto out;
+        }
+        c = *data;
+      }
+      if(c == '"') {
+        if(state->value_mask != 0) {
+          deliver(state, start, data - start, JSONSTREAM_LAST);
+        }
+        end_value(state);
+      } else if(c == '\\') {
+        state->expect = IN_STRING_ESCAPE;
+      } else {
+        return fail(state, JSON_ERROR_SYNTAX);
+      }
+      data++;
+      continue;
+    case IN_STRING_ESCAPE:
+      state->expect = IN_STRING;
+      data++;
+      continue;
+    case IN_NUMBER:
+      while(IS_NUMBER_CHAR(c)) {
+        if(++data == end) {
+          goto out;
+        }
+        c = *data;
+      }
+      if(state->value_mask != 0) {
+        deliver(state, start, data - start, JSONSTREAM_LAST);
+      }
+      end_value(state);
+      /* The character that ended the number is processed next. */
+      continue;
+    case IN_LITERAL:
+      if(c != *state->literal) {
+        return fail(state, JSON_ERROR_SYNTAX);
+      }
+      data++;
+      if(*++state->literal == '\0') {
+        if(state->value_mask != 0) {
+          deliver(state, start, data - start, JSONSTREAM_LAST);
+        }
+        end_value(state);
+      }
+      continue;
+    case IN_NAME:
+      if(state->name_mask == 0) {
+        while(c != '"' && c != '\\' && (unsigned char)c >= 0x20) {
+          if(++data == end) {
+            goto out;
+          }
+          c = *data;
+        }
+      }
+      if(c == '"') {
+        end_name(state);
+      } else if((unsigned char)c < 0x20) {
+        return fail(state, JSON_ERROR_SYNTAX);
+      } else {
+        if(c == '\\') {
+          state->expect = IN_NAME_ESCAPE;
+        }
+        if(state->name_mask != 0) {
+          match_name(state, c);
+        }
+      }
+      data++;
+      continue;
+    case IN_NAME_ESCAPE:
+      state->expect = IN_NAME;
+      if(state->name_mask != 0) {
+        match_name(state, c);
+      }
+      data++;
+      continue;
+    case FAILED:
+      return JSONSTREAM_ERROR;
+    default:
+      break;
+    }
+
+    data++;
+    if(IS_WHITESPACE(c)) {
+      continue;
+    }
+
+    switch(state->expect) {
+    case EXPECT_VALUE_OR_END:
+      if(c == ']') {
+        pop(state, JSON_TYPE_ARRAY);
+        break;
+      }
+      /* Fall through. */
+    case EXPECT_VALUE:
+      start = c == '"' ? data : data - 1;
+      if(start_value(state, c) == JSONSTREAM_ERROR) {
+        return JSONSTREAM_ERROR;
+      }
+      break;
+    case EXPECT_NAME_OR_END:
+      if(c == '}') {
+        pop(state, JSON_TYPE_OBJECT);
+        break;
+      }
+      /* Fall through. */
+    case EXPECT_NAME:
+      if(c != '"') {
+        return fail(state, JSON_ERROR_UNEXPECTED_STRING);
+      }
+      begin_name(state);
+      break;
+    case EXPECT_COLON:
+      if(c != ':') {
+        return fail(state, JSON_ERROR_SYNTAX);
+      }
+      state->expect = EXPECT_VALUE;
+      break;
+    case EXPECT_COMMA_OR_END:
+      frame = &state->stack[state->depth - 1];
+      if(c == ',') {
+        frame->index++;
+        state->expect = frame->type == JSON_TYPE_OBJECT ?
+          EXPECT_NAME : EXPECT_VALUE;
+      } else if(c == '}' || c == ']') {
+        if(pop(state, c == '}' ? JSON_TYPE_OBJECT : JSON_TYPE_ARRAY) ==
+           JSONSTREAM_ERROR) {
+          return JSONSTREAM_ERROR;
+        }
+      } else {
+        return fail(state, JSON_ERROR_SYNTAX);
+      }
+      break;
+    default:
+      return fail(state, JSON_ERROR_SYNTAX);
+    }
+  }
+
+out:
+  /* Pass on the part of a matched value that ends this fragment. */
+  if(state->value_mask != 0 && start < end &&
+     (state->expect == IN_STRING || state->expect == IN_STRING_ESCAPE ||
+      state->expect == IN_NUMBER || state->expect == IN_LITERAL)) {
+    deliver(state, start, end - start, 0);
+  }
+
+  return state->expect == EXPECT_NOTHING ? JSONSTREAM_DONE : JSONSTREAM_MORE;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_finish(struct jsonstream_state *state)
+{
+  if(state->expect == IN_NUMBER && state->depth == 0) {
+    if(state->value_mask != 0) {
+      deliver(state, NULL, 0, JSONSTREAM_LAST);
+    }
+    end_value(state);
+  }
+
+  if(state->expect == FAILED) {
+    return JSONSTREAM_ERROR;
+  } else if(state->expect != EXPECT_NOTHING) {
+    return fail(state, JSON_ERROR_UNEXPECTED_END);
+  }
+  return JSONSTREAM_DONE;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_get_depth(struct jsonstream_state *state)
+{
+  return state->depth;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_get_index(struct jsonstream_state *state, int depth)
+{
+  if(depth < 0 || depth >= state->depth) {
+    return -1;
+  }
+  return state->stack[depth].index;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_get_error(struct jsonstream_state *state)
+{
+  return state->error;
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Incremental JSON tokenizer with path queries
+ *
+ *         The tokenizer consumes a JSON document in fragments of any
+ *         size, for instance as the blocks of a CoAP or HTTP request
+ *         body arrive, and keeps no more than a fixed-size state
+ *         between them. Instead of returning tokens, it calls the
+ *         callbacks of compiled path queries for the values that the
+ *         paths match. Values are passed as pointers into the current
+ *         fragment, so nothing is copied.
+ */
+
+#ifndef JSONSTREAM_H_
+#define JSONSTREAM_H_
+
+#include "contiki-conf.h"
+#include "json.h"
+
+#ifdef JSONSTREAM_CONF_MAX_DEPTH
+#define JSONSTREAM_MAX_DEPTH JSONSTREAM_CONF_MAX_DEPTH
+#else
+#define JSONSTREAM_MAX_DEPTH 10
+#endif /* JSONSTREAM_CONF_MAX_DEPTH */
+
+/* The number of queries that can be added to a tokenizer state. */
+#ifdef JSONSTREAM_CONF_MAX_QUERIES
+#define JSONSTREAM_MAX_QUERIES JSONSTREAM_CONF_MAX_QUERIES
+#else
+#define JSONSTREAM_MAX_QUERIES 8
+#endif /* JSONSTREAM_CONF_MAX_QUERIES */
+
+#if JSONSTREAM_MAX_QUERIES <= 8
+typedef uint8_t jsonstream_mask_t;
+#elif JSONSTREAM_MAX_QUERIES <= 16
+typedef uint16_t jsonstream_mask_t;
+#elif JSONSTREAM_MAX_QUERIES <= 32
+typedef uint32_t jsonstream_mask_t;
+#else
+#error "JSONSTREAM_MAX_QUERIES cannot be larger than 32"
+#endif
+
+/* Results of jsonstream_feed() and jsonstream_finish(). */
+#define JSONSTREAM_MORE  0      /* The document is incomplete. */
+#define JSONSTREAM_DONE  1      /* The document is complete. */
+#define JSONSTREAM_ERROR -1     /* The document is malformed. */
+
+/* Flags of the value fragments that are passed to query callbacks. */
+#define JSONSTREAM_FIRST 0x01   /* The fragment starts the value. */
+#define JSONSTREAM_LAST  0x02   /* The fragment ends the value. */
+
+struct jsonstream_state;
+struct jsonstream_query;
+
+/*
+ * A query callback receives the type of the matched value and one
+ * fragment of it. Atomic values that span several input fragments are
+ * passed in several calls; values that fit in one input fragment are
+ * passed in a single call with both JSONSTREAM_FIRST and
+ * JSONSTREAM_LAST set. Strings are passed without the quotes and with
+ * escape sequences left as they are. For objects and arrays, the
+ * callback is called once when the value starts, with an empty
+ * fragment.
+ */
+typedef void (* jsonstream_callback_t)(struct jsonstream_state *state,
+                                       struct jsonstream_query *query,
+                                       int type, const char *value,
+                                       int len, uint8_t flags);
+
+struct jsonstream_query {
+  struct jsonstream_query *next;
+  const char *path;
+  jsonstream_callback_t callback;
+  void *ptr;
+  uint8_t segments;
+  uint8_t offsets[JSONSTREAM_MAX_DEPTH];
+};
+
+struct jsonstream_frame {
+  uint16_t index;
+  jsonstream_mask_t mask;
+  char type;
+};
+
+struct jsonstream_state {
+  struct jsonstream_query *queries;
+  struct jsonstream_frame stack[JSONSTREAM_MAX_DEPTH];
+  const char *literal;
+  jsonstream_mask_t value_mask;
+  jsonstream_mask_t name_mask;
+  uint8_t query_count;
+  uint8_t depth;
+  uint8_t name_pos;
+  uint8_t vtype;
+  uint8_t vflags;
+  uint8_t expect;
+  char error;
+};
+
+/**
+ * \brief      Compile a path query.
+ * \param query A pointer to the query to compile
+ * \param path The path, which must stay valid while the query is used
+ * \param callback The function to call for the matched values
+ * \param ptr  An opaque pointer for the callback
+ * \return     Zero on success, or -1 if the path is invalid
+ *
+ *             A path consists of segments that each start with a
+ *             slash. A segment matches an object member with the same
+ *             name, or an array element with the same decimal index.
+ *             The segment "*" matches any member or element, and the
+ *             path "/" matches the document itself.
+ */
+int jsonstream_query_compile(struct jsonstream_query *query,
+                             const char *path,
+                             jsonstream_callback_t callback, void *ptr);
+
+/**
+ * \brief      Initialize a tokenizer state.
+ * \param state A pointer to a tokenizer state
+ *
+ *             This function initializes a tokenizer state for a new
+ *             document and removes all queries from it.
+ */
+void jsonstream_init(struct jsonstream_state *state);
+
+/**
+ * \brief      Add a compiled query to a tokenizer state.
+ * \return     Zero on success, or -1 if the state has too many queries
+ *
+ *             Queries must be added before the first fragment of a
+ *             document is fed to the tokenizer.
+ */
+int jsonstream_add_query(struct jsonstream_state *state,
+                         struct jsonstream_query *query);
+
+/**
+ * \brief      Feed the next fragment of a document to the tokenizer.
+ * \return     JSONSTREAM_MORE, JSONSTREAM_DONE, or JSONSTREAM_ERROR
+ *
+ *             The fragment only needs to stay valid during the call.
+ *             Once the document is done, only whitespace may follow.
+ */
+int jsonstream_feed(struct jsonstream_state *state,
+                    const char *data, int len);
+
+/**
+ * \brief      Signal the end of a document.
+ * \return     JSONSTREAM_DONE, or JSONSTREAM_ERROR if it is incomplete
+ *
+ *             A document that consists of a single number can only be
+ *             completed by this function.
+ */
+int jsonstream_finish(struct jsonstream_state *state);
+
+/* get the depth of the value that is being passed to a callback */
+int jsonstream_get_depth(struct jsonstream_state *state);
+
+/* get the array index or member number at a depth of the current path */
+int jsonstream_get_index(struct jsonstream_state *state, int depth);
+
+/* get the error code after a failure */
+int jsonstream_get_error(struct jsonstream_state *state);
+
+#endif /* JSONSTREAM_H_ */
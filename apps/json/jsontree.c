@@ -50,54 +50,86 @@
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+static void
+write_data(struct jsontree_context *js_ctx, const char *data, int len)
+{
+  int32_t from;
+  int32_t to;
+
+  if(js_ctx->buf == NULL) {
+    while(len-- > 0) {
+      js_ctx->putchar(*data++);
+    }
+    return;
+  }
+
+  /* Only the part that falls within the current block is stored. */
+  from = js_ctx->buf_start - js_ctx->buf_pos;
+  if(from < 0) {
+    from = 0;
+  }
+  to = js_ctx->buf_start + js_ctx->buf_size - js_ctx->buf_pos;
+  if(to > len) {
+    to = len;
+  }
+  if(to > from) {
+    memcpy(js_ctx->buf + (js_ctx->buf_pos + from - js_ctx->buf_start),
+           data + from, to - from);
+  }
+  js_ctx->buf_pos += len;
+}
 /*---------------------------------------------------------------------------*/
 void
-jsontree_write_atom(const struct jsontree_context *js_ctx, const char *text)
+jsontree_write_atom(struct jsontree_context *js_ctx, const char *text)
 {
   if(text == NULL) {
-    js_ctx->putchar('0');
+    write_data(js_ctx, "0", 1);
   } else {
-    while(*text != '\0') {
-      js_ctx->putchar(*text++);
-    }
+    write_data(js_ctx, text, strlen(text));
   }
 }
 /*---------------------------------------------------------------------------*/
 void
-jsontree_write_string(const struct jsontree_context *js_ctx, const char *text)
+jsontree_write_string(struct jsontree_context *js_ctx, const char *text)
 {
-  js_ctx->putchar('"');
+  const char *end;
+
+  write_data(js_ctx, "\"", 1);
   if(text != NULL) {
     while(*text != '\0') {
-      if(*text == '"') {
-        js_ctx->putchar('\\');
+      for(end = text; *end != '\0' && *end != '"'; end++);
+      write_data(js_ctx, text, end - text);
+      if(*end == '\0') {
+        break;
       }
-      js_ctx->putchar(*text++);
+      write_data(js_ctx, "\\\"", 2);
+      text = end + 1;
     }
   }
-  js_ctx->putchar('"');
+  write_data(js_ctx, "\"", 1);
 }
 /*---------------------------------------------------------------------------*/
 void
-jsontree_write_int(const struct jsontree_context *js_ctx, int value)
+jsontree_write_int(struct jsontree_context *js_ctx, int value)
 {
-  char buf[10];
+  char buf[11];
+  unsigned int u;
   int l;
 
-  if(value < 0) {
-    js_ctx->putchar('-');
-    value = -value;
-  }
+  u = value < 0 ? -(unsigned int)value : (unsigned int)value;
 
-  l = sizeof(buf) - 1;
+  l = sizeof(buf);
   do {
-    buf[l--] = '0' + (value % 10);
-    value /= 10;
-  } while(value > 0 && l >= 0);
+    buf[--l] = '0' + (u % 10);
+    u /= 10;
+  } while(u > 0 && l > 1);
 
-  while(++l < sizeof(buf)) {
-    js_ctx->putchar(buf[l]);
+  if(value < 0) {
+    buf[--l] = '-';
   }
+
+  write_data(js_ctx, &buf[l], sizeof(buf) - l);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -115,6 +147,9 @@ jsontree_reset(struct jsontree_context *js_ctx)
 {
   js_ctx->depth = 0;
   js_ctx->index[0] = 0;
+  js_ctx->buf = NULL;
+  js_ctx->buf_offset = 0;
+  js_ctx->buf_done = 0;
 }
 /*---------------------------------------------------------------------------*/
 const char *
@@ -144,24 +179,21 @@ jsontree_print_next(struct jsontree_context *js_ctx)
 
     index = js_ctx->index[js_ctx->depth];
     if(index == 0) {
-      js_ctx->putchar(v->type);
-      js_ctx->putchar('\n');
+      write_data(js_ctx, v->type == JSON_TYPE_OBJECT ? "{\n" : "[\n", 2);
     }
     if(index >= o->count) {
-      js_ctx->putchar('\n');
-      js_ctx->putchar(v->type + 2);
+      write_data(js_ctx, v->type == JSON_TYPE_OBJECT ? "\n}" : "\n]", 2);
       /* Default operation: back up one level! */
       break;
     }
 
     if(index > 0) {
-      js_ctx->putchar(',');
-      js_ctx->putchar('\n');
+      write_data(js_ctx, ",\n", 2);
     }
     if(v->type == JSON_TYPE_OBJECT) {
       jsontree_write_string(js_ctx,
                             ((struct jsontree_object *)o)->pairs[index].name);
-      js_ctx->putchar(':');
+      write_data(js_ctx, ":", 1);
       ov = ((struct jsontree_object *)o)->pairs[index].value;
     } else {
       ov = o->values[index];
@@ -212,6 +244,76 @@ jsontree_print_next(struct jsontree_context *js_ctx)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+int
+jsontree_print_block(struct jsontree_context *js_ctx, char *buf, int size,
+                     int32_t *offset)
+{
+  uint16_t index;
+  uint16_t parent_index;
+  uint8_t depth;
+  int callback_state;
+  int more;
+  int len;
+
+  if(*offset < js_ctx->buf_offset) {
+    /* The block precedes the current position: start over from the
+       value at which the output started. */
+    js_ctx->depth = js_ctx->path;
+    js_ctx->index[js_ctx->depth] = 0;
+    js_ctx->buf_offset = 0;
+    js_ctx->buf_done = 0;
+  }
+
+  js_ctx->buf = buf;
+  js_ctx->buf_size = size;
+  js_ctx->buf_start = *offset;
+  js_ctx->buf_pos = js_ctx->buf_offset;
+
+  while(!js_ctx->buf_done &&
+        js_ctx->buf_pos <= js_ctx->buf_start + js_ctx->buf_size) {
+    /* Remember the state before the step, in case it does not fit. */
+    depth = js_ctx->depth;
+    index = js_ctx->index[depth];
+    parent_index = depth > 0 ? js_ctx->index[depth - 1] : 0;
+    callback_state = js_ctx->callback_state;
+
+    more = jsontree_print_next(js_ctx);
+
+    if(js_ctx->buf_pos > js_ctx->buf_start + js_ctx->buf_size) {
+      /* The output of the step continues in the next block, which
+         repeats the step and discards what this block has received. */
+      js_ctx->depth = depth;
+      js_ctx->index[depth] = index;
+      if(depth > 0) {
+        js_ctx->index[depth - 1] = parent_index;
+      }
+      js_ctx->callback_state = callback_state;
+      js_ctx->buf_pos = js_ctx->buf_start + js_ctx->buf_size;
+      break;
+    }
+
+    js_ctx->buf_offset = js_ctx->buf_pos;
+    if(!more || js_ctx->depth < js_ctx->path) {
+      js_ctx->buf_done = 1;
+    }
+  }
+  js_ctx->buf = NULL;
+
+  len = js_ctx->buf_pos - js_ctx->buf_start;
+  if(len < 0) {
+    len = 0;
+  } else if(len > size) {
+    len = size;
+  }
+
+  if(js_ctx->buf_done && js_ctx->buf_offset <= *offset + len) {
+    *offset = -1;
+  } else {
+    *offset += len;
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
 static struct jsontree_value *
 find_next(struct jsontree_context *js_ctx)
 {
@@ -56,6 +56,13 @@ struct jsontree_context {
   uint8_t depth;
   uint8_t path;
   int callback_state;
+  /* state of the buffered output of jsontree_print_block() */
+  char *buf;
+  int32_t buf_start;
+  int32_t buf_pos;
+  int32_t buf_offset;
+  uint16_t buf_size;
+  uint8_t buf_done;
 };
 
 struct jsontree_value {
@@ -130,12 +137,37 @@ void jsontree_reset(struct jsontree_context *js_ctx);
 const char *jsontree_path_name(const struct jsontree_context *js_ctx,
                                int depth);
 
-void jsontree_write_int(const struct jsontree_context *js_ctx, int value);
-void jsontree_write_atom(const struct jsontree_context *js_ctx,
-                         const char *text);
-void jsontree_write_string(const struct jsontree_context *js_ctx,
-                           const char *text);
+void jsontree_write_int(struct jsontree_context *js_ctx, int value);
+void jsontree_write_atom(struct jsontree_context *js_ctx, const char *text);
+void jsontree_write_string(struct jsontree_context *js_ctx, const char *text);
 int jsontree_print_next(struct jsontree_context *js_ctx);
+
+/**
+ * \brief      Serialize a block of the JSON output into a buffer.
+ * \param js_ctx A context that has been set up for the output
+ * \param buf  The buffer for the block
+ * \param size The size of the block
+ * \param offset A pointer to the offset of the block in the output
+ * \return     The number of bytes written into the buffer
+ *
+ *             This function writes the part of the output that starts
+ *             at *offset into the buffer, instead of passing it to the
+ *             putchar function of the context. It then advances *offset
+ *             past the block, or sets it to -1 if the output ends within
+ *             the block, which is the convention of the CoAP Block2
+ *             resource handlers.
+ *
+ *             The context keeps its position between calls, so the
+ *             blocks that follow each other are serialized without
+ *             generating the output from the start again. A value that
+ *             crosses the end of a block is generated again for the
+ *             next block, so callbacks must keep their state in the
+ *             callback_state of the context. An offset that precedes
+ *             the position of the context, for instance when a client
+ *             requests the first block again, restarts the output.
+ */
+int jsontree_print_block(struct jsontree_context *js_ctx, char *buf, int size,
+                         int32_t *offset);
 struct jsontree_value *jsontree_find_next(struct jsontree_context *js_ctx,
                                           int type);
 
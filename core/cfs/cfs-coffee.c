@@ -55,6 +55,9 @@
 #endif
 
 #include "contiki-conf.h"
+#include "sys/clock.h"
+#include "sys/etimer.h"
+#include "sys/process.h"
 #include "cfs/cfs.h"
 #include "cfs-coffee-arch.h"
 #include "cfs/cfs-coffee.h"
@@ -90,6 +93,78 @@
 #define COFFEE_EXTENDED_WEAR_LEVELLING	1
 #endif
 
+/*
+ * The name index is an optional RAM hash table that maps file names to
+ * the pages of their extents. It is built by scanning the storage the
+ * first time a file is looked up, and is updated thereafter whenever
+ * a file is reserved or removed. This avoids full storage scans in
+ * cfs_open() for file systems that contain many files.
+ */
+#ifndef COFFEE_NAME_INDEX
+#define COFFEE_NAME_INDEX	0
+#endif
+
+/* The number of slots in the name index. Should be a power of two. */
+#ifndef COFFEE_NAME_INDEX_SIZE
+#define COFFEE_NAME_INDEX_SIZE	128
+#endif
+
+/*
+ * Incremental garbage collection keeps page statistics for each sector
+ * in RAM. Instead of erasing sectors within the file operation that
+ * runs out of space, a background process erases at most one sector per
+ * step, choosing victims by their share of obsolete pages and by their
+ * erase counts to level the wear. The RAM cost is a few bytes per
+ * sector, so this is intended for storage with large sectors.
+ */
+#ifndef COFFEE_GC_INCREMENTAL
+#define COFFEE_GC_INCREMENTAL	0
+#endif
+
+/* The time between two consecutive background erasures. */
+#ifndef COFFEE_GC_INTERVAL
+#define COFFEE_GC_INTERVAL	(CLOCK_SECOND / 8)
+#endif
+
+/* Background collection is started when the amount of free pages drops
+   below this threshold, or when a sector contains only obsolete pages. */
+#ifndef COFFEE_GC_FREE_THRESHOLD
+#define COFFEE_GC_FREE_THRESHOLD	(COFFEE_PAGE_COUNT / 4)
+#endif
+
+/* The obsolete page percentage that a sector must surpass for each
+   erasure more than the least erased sector in order to be chosen. */
+#ifndef COFFEE_GC_WEAR_WEIGHT
+#define COFFEE_GC_WEAR_WEIGHT	4
+#endif
+
+/*
+ * Append mode is an alternative file layout for files that are only
+ * appended to, such as data logs. An append-mode file is a chain of
+ * extents whose sizes grow geometrically. When the last extent is full,
+ * a new extent is linked to it instead of copying the file into a
+ * larger extent, and the extents of open append-mode files are indexed
+ * in RAM so that both appends and reads locate their data directly.
+ */
+#ifndef COFFEE_APPEND_MODE
+#define COFFEE_APPEND_MODE	0
+#endif
+
+/* The number of append-mode files whose extents can be indexed at once. */
+#ifndef COFFEE_APPEND_MAX_FILES
+#define COFFEE_APPEND_MAX_FILES	2
+#endif
+
+/* The maximum number of extents in an append-mode file. */
+#ifndef COFFEE_APPEND_MAX_EXTENTS
+#define COFFEE_APPEND_MAX_EXTENTS	16
+#endif
+
+/* The size limit, in pages, of the extents added to append-mode files. */
+#ifndef COFFEE_APPEND_MAX_EXTENT_PAGES
+#define COFFEE_APPEND_MAX_EXTENT_PAGES	COFFEE_PAGES_PER_SECTOR
+#endif
+
 #if COFFEE_START & (COFFEE_SECTOR_SIZE - 1)
 #error COFFEE_START must point to the first byte in a sector.
 #endif
@@ -100,6 +175,7 @@
 #define COFFEE_FD_APPEND	0x4
 
 #define COFFEE_FILE_MODIFIED	0x1
+#define COFFEE_FILE_APPEND	0x2
 
 #define INVALID_PAGE		((coffee_page_t)-1)
 #define UNKNOWN_OFFSET		((cfs_offset_t)-1)
@@ -123,6 +199,7 @@
 
 /* File object macros. */
 #define FILE_MODIFIED(file)	((file)->flags & COFFEE_FILE_MODIFIED)
+#define FILE_APPEND(file)	((file)->flags & COFFEE_FILE_APPEND)
 #define FILE_FREE(file)		((file)->max_pages == 0)
 #define FILE_UNREFERENCED(file)	((file)->references == 0)
 
@@ -133,6 +210,7 @@
 #define HDR_FLAG_MODIFIED	0x8	/* Modified file, log exists. */
 #define HDR_FLAG_LOG		0x10	/* Log file. */
 #define HDR_FLAG_ISOLATED	0x20	/* Isolated page. */
+#define HDR_FLAG_APPEND		0x40	/* Append-mode file extent. */
 
 /* File header macros. */
 #define CHECK_FLAG(hdr, flag)	((hdr).flags & (flag))
@@ -143,6 +221,13 @@
 #define HDR_MODIFIED(hdr)	CHECK_FLAG(hdr, HDR_FLAG_MODIFIED)
 #define HDR_ISOLATED(hdr)	CHECK_FLAG(hdr, HDR_FLAG_ISOLATED)
 #define HDR_OBSOLETE(hdr) 	CHECK_FLAG(hdr, HDR_FLAG_OBSOLETE)
+#define HDR_APPEND(hdr)		CHECK_FLAG(hdr, HDR_FLAG_APPEND)
+/*
+ * The extents of an append-mode file are linked through the log_page
+ * field. Since page zero is a valid extent, the log_records field is
+ * set once the link has been written.
+ */
+#define HDR_HAS_NEXT(hdr)	(HDR_APPEND(hdr) && (hdr).log_records != 0)
 #define HDR_ACTIVE(hdr)		(HDR_ALLOCATED(hdr) && \
 				!HDR_OBSOLETE(hdr)  && \
 				!HDR_ISOLATED(hdr))
@@ -217,6 +302,58 @@ static struct file_desc * const coffee_fd_set = protected_mem.coffee_fd_set;
 static coffee_page_t * const next_free = &protected_mem.next_free;
 static char * const gc_wait = &protected_mem.gc_wait;
 
+static struct cfs_coffee_gc_stats gc_stats;
+
+#if COFFEE_GC_INCREMENTAL
+#define SECTOR_ACTIVE		0
+#define SECTOR_OBSOLETE		1
+#define SECTOR_FREE		2
+#define SECTOR_NONE		3
+
+/* The RAM representation of the page statistics of a sector. */
+struct sector_info {
+  coffee_page_t pages[3];
+  /* Pages at the start of the sector that belong to a file extent
+     beginning in a previous sector. */
+  coffee_page_t head_pages;
+  uint16_t erase_count;
+};
+
+static struct sector_info sector_info[COFFEE_SECTOR_COUNT];
+static uint8_t sector_info_valid;
+
+PROCESS(coffee_gc_process, "Coffee GC");
+#endif /* COFFEE_GC_INCREMENTAL */
+
+#if COFFEE_APPEND_MODE
+struct append_extent {
+  coffee_page_t page;
+  coffee_page_t max_pages;
+};
+
+/* The RAM index of the extents of an append-mode file. */
+struct append_file {
+  uint8_t extent_count;
+  struct append_extent extents[COFFEE_APPEND_MAX_EXTENTS];
+};
+
+static struct append_file append_files[COFFEE_APPEND_MAX_FILES];
+#endif /* COFFEE_APPEND_MODE */
+
+#if COFFEE_NAME_INDEX
+#define NAME_INDEX_UNBUILT	0
+#define NAME_INDEX_COMPLETE	1
+#define NAME_INDEX_OVERFLOW	2
+
+struct name_index_entry {
+  coffee_page_t page;
+  uint16_t hash;
+};
+
+static struct name_index_entry name_index[COFFEE_NAME_INDEX_SIZE];
+static uint8_t name_index_state;
+#endif /* COFFEE_NAME_INDEX */
+
 /*---------------------------------------------------------------------------*/
 static void
 write_header(struct file_header *hdr, coffee_page_t page)
@@ -243,6 +380,28 @@ absolute_offset(coffee_page_t page, cfs_offset_t offset)
 }
 /*---------------------------------------------------------------------------*/
 static coffee_page_t
+next_file(coffee_page_t page, struct file_header *hdr)
+{
+  /*
+   * The quick-skip algorithm for finding file extents is the most 
+   * essential part of Coffee. The file allocation rules enables this 
+   * algorithm to quickly jump over free areas and allocated extents 
+   * after reading single headers and determining their status.
+   *
+   * The worst-case performance occurs when we encounter multiple long 
+   * sequences of isolated pages, but such sequences are uncommon and 
+   * always shorter than a sector.
+   */
+  if(HDR_FREE(*hdr)) {
+    return (page + COFFEE_PAGES_PER_SECTOR) & ~(COFFEE_PAGES_PER_SECTOR - 1);
+  } else if(HDR_ISOLATED(*hdr)) {
+    return page + 1;
+  }
+  return page + hdr->max_pages;    
+}
+/*---------------------------------------------------------------------------*/
+#if !COFFEE_GC_INCREMENTAL
+static coffee_page_t
 get_sector_status(uint16_t sector, struct sector_status *stats)
 {
   static coffee_page_t skip_pages;
@@ -341,6 +500,7 @@ get_sector_status(uint16_t sector, struct sector_status *stats)
   return (last_pages_are_active || (skip_pages >= COFFEE_PAGES_PER_SECTOR)) ?
 	0 : skip_pages;
 }
+#endif /* !COFFEE_GC_INCREMENTAL */
 /*---------------------------------------------------------------------------*/
 static void
 isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
@@ -363,14 +523,262 @@ isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
 }
 /*---------------------------------------------------------------------------*/
 static void
+erase_sector(uint16_t sector, coffee_page_t isolation_count)
+{
+  coffee_page_t first_page;
+
+  first_page = sector * COFFEE_PAGES_PER_SECTOR;
+  if(first_page < *next_free) {
+    *next_free = first_page;
+  }
+
+  if(isolation_count > 0) {
+    isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
+  }
+
+  COFFEE_ERASE(sector);
+  gc_stats.erases++;
+  PRINTF("Coffee: Erased sector %d!\n", sector);
+
+#if COFFEE_GC_INCREMENTAL
+  sector_info[sector].pages[SECTOR_ACTIVE] = 0;
+  sector_info[sector].pages[SECTOR_OBSOLETE] = 0;
+  sector_info[sector].pages[SECTOR_FREE] = COFFEE_PAGES_PER_SECTOR;
+  sector_info[sector].head_pages = 0;
+  sector_info[sector].erase_count++;
+  if(isolation_count > 0) {
+    /* The isolated pages are single-page extents of their own. */
+    sector_info[sector + 1].head_pages = 0;
+  }
+#endif
+}
+/*---------------------------------------------------------------------------*/
+#if COFFEE_GC_INCREMENTAL
+static void
+account_pages(coffee_page_t page, coffee_page_t count, int from, int to)
+{
+  uint16_t sector;
+  coffee_page_t start, n;
+
+  for(start = page; count > 0; page += n, count -= n) {
+    sector = page / COFFEE_PAGES_PER_SECTOR;
+    n = (sector + 1) * COFFEE_PAGES_PER_SECTOR - page;
+    if(n > count) {
+      n = count;
+    }
+    if(page != start) {
+      sector_info[sector].head_pages = n;
+    }
+    if(from != SECTOR_NONE) {
+      sector_info[sector].pages[from] -= n;
+    }
+    sector_info[sector].pages[to] += n;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_sector_info(void)
+{
+  struct file_header hdr;
+  coffee_page_t page, next;
+  uint16_t sector;
+
+  if(sector_info_valid) {
+    return;
+  }
+
+  for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+    memset(sector_info[sector].pages, 0, sizeof(sector_info[sector].pages));
+    sector_info[sector].head_pages = 0;
+  }
+
+  for(page = 0; page < COFFEE_PAGE_COUNT; page = next) {
+    read_header(&hdr, page);
+    next = next_file(page, &hdr);
+    if(HDR_FREE(hdr)) {
+      account_pages(page, next - page, SECTOR_NONE, SECTOR_FREE);
+    } else {
+      account_pages(page, next - page, SECTOR_NONE,
+                    HDR_ACTIVE(hdr) ? SECTOR_ACTIVE : SECTOR_OBSOLETE);
+    }
+  }
+
+  sector_info_valid = 1;
+}
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+isolation_pages(uint16_t sector)
+{
+  coffee_page_t head_pages;
+
+  /*
+   * An obsolete extent that continues into the next sector leaves
+   * pages without a header there once this sector has been erased.
+   * These pages must be isolated, unless the extent covers the whole
+   * next sector as well, in which case that sector is erasable too.
+   */
+  if(sector + 1 >= COFFEE_SECTOR_COUNT) {
+    return 0;
+  }
+  head_pages = sector_info[sector + 1].head_pages;
+  return head_pages >= COFFEE_PAGES_PER_SECTOR ? 0 : head_pages;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_erase_stats(void)
+{
+  uint16_t sector;
+
+  gc_stats.min_erase_count = gc_stats.max_erase_count =
+    sector_info[0].erase_count;
+  for(sector = 1; sector < COFFEE_SECTOR_COUNT; sector++) {
+    if(sector_info[sector].erase_count < gc_stats.min_erase_count) {
+      gc_stats.min_erase_count = sector_info[sector].erase_count;
+    }
+    if(sector_info[sector].erase_count > gc_stats.max_erase_count) {
+      gc_stats.max_erase_count = sector_info[sector].erase_count;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+select_victim(void)
+{
+  uint16_t sector;
+  struct sector_info *info;
+  int victim, score, best_score;
+
+  update_erase_stats();
+
+  /*
+   * Only sectors without active pages can be erased. Among these, the
+   * sector with the largest share of obsolete pages is preferred, but
+   * every erasure above the least erased sector reduces the score.
+   */
+  victim = -1;
+  best_score = INT_MIN;
+  for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+    info = &sector_info[sector];
+    if(info->pages[SECTOR_ACTIVE] > 0 || info->pages[SECTOR_OBSOLETE] == 0) {
+      continue;
+    }
+    if(sector + 1 < COFFEE_SECTOR_COUNT &&
+       sector_info[sector + 1].head_pages >= COFFEE_PAGES_PER_SECTOR) {
+      /* Leave extents spanning several sectors to the greedy collector. */
+      continue;
+    }
+    score = (int)(100L * info->pages[SECTOR_OBSOLETE] /
+                  COFFEE_PAGES_PER_SECTOR);
+    score -= COFFEE_GC_WEAR_WEIGHT *
+             (int)(info->erase_count - gc_stats.min_erase_count);
+    if(score > best_score) {
+      best_score = score;
+      victim = sector;
+    }
+  }
+
+  return victim;
+}
+/*---------------------------------------------------------------------------*/
+static int
+gc_needed(void)
+{
+  uint16_t sector;
+  unsigned long free_pages;
+
+  free_pages = 0;
+  for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+    if(sector_info[sector].pages[SECTOR_OBSOLETE] == COFFEE_PAGES_PER_SECTOR) {
+      return 1;
+    }
+    free_pages += sector_info[sector].pages[SECTOR_FREE];
+  }
+
+  return free_pages < COFFEE_GC_FREE_THRESHOLD;
+}
+/*---------------------------------------------------------------------------*/
+static int
+gc_step(void)
+{
+  int victim;
+
+  if(!sector_info_valid || !gc_needed()) {
+    return 0;
+  }
+
+  victim = select_victim();
+  if(victim < 0) {
+    return 0;
+  }
+
+  PRINTF("Coffee: Incremental GC erases sector %d (%u obsolete pages)\n",
+         victim, (unsigned)sector_info[victim].pages[SECTOR_OBSOLETE]);
+  erase_sector(victim, isolation_pages(victim));
+  gc_stats.incremental_steps++;
+  *gc_wait = 0;
+
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_gc(void)
+{
+  if(!gc_needed()) {
+    return;
+  }
+
+  if(!process_is_running(&coffee_gc_process)) {
+    process_start(&coffee_gc_process, NULL);
+  }
+  process_poll(&coffee_gc_process);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_gc_process, ev, data)
+{
+  static struct etimer et;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+    while(gc_step()) {
+      etimer_set(&et, COFFEE_GC_INTERVAL);
+      PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    }
+  }
+
+  PROCESS_END();
+}
+#endif /* COFFEE_GC_INCREMENTAL */
+/*---------------------------------------------------------------------------*/
+#if COFFEE_GC_INCREMENTAL
+static coffee_page_t
+get_sector_status(uint16_t sector, struct sector_status *stats)
+{
+  stats->active = sector_info[sector].pages[SECTOR_ACTIVE];
+  stats->obsolete = sector_info[sector].pages[SECTOR_OBSOLETE];
+  stats->free = sector_info[sector].pages[SECTOR_FREE];
+
+  return isolation_pages(sector);
+}
+#endif /* COFFEE_GC_INCREMENTAL */
+/*---------------------------------------------------------------------------*/
+static void
 collect_garbage(int mode)
 {
   uint16_t sector;
   struct sector_status stats;
-  coffee_page_t first_page, isolation_count;
+  coffee_page_t isolation_count;
+  clock_time_t start, stall;
 
   PRINTF("Coffee: Running the file system garbage collector in %s mode\n",
 	 mode == GC_RELUCTANT ? "reluctant" : "greedy");
+  start = clock_time();
+  gc_stats.collections++;
+#if COFFEE_GC_INCREMENTAL
+  build_sector_info();
+#endif
+
   /*
    * The garbage collector erases as many sectors as possible. A sector is
    * erasable if there are only free or obsolete pages in it.
@@ -387,44 +795,18 @@ collect_garbage(int mode)
 
     if((mode == GC_RELUCTANT && stats.free == 0) ||
        (mode == GC_GREEDY && stats.obsolete > 0)) {
-      first_page = sector * COFFEE_PAGES_PER_SECTOR;
-      if(first_page < *next_free) {
-        *next_free = first_page;
-      }
-
-      if(isolation_count > 0) {
-        isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
-      }
-
-      COFFEE_ERASE(sector);
-      PRINTF("Coffee: Erased sector %d!\n", sector);
+      erase_sector(sector, isolation_count);
 
       if(mode == GC_RELUCTANT && isolation_count > 0) {
         break;
       }
     }
   }
-}
-/*---------------------------------------------------------------------------*/
-static coffee_page_t
-next_file(coffee_page_t page, struct file_header *hdr)
-{
-  /*
-   * The quick-skip algorithm for finding file extents is the most 
-   * essential part of Coffee. The file allocation rules enables this 
-   * algorithm to quickly jump over free areas and allocated extents 
-   * after reading single headers and determining their status.
-   *
-   * The worst-case performance occurs when we encounter multiple long 
-   * sequences of isolated pages, but such sequences are uncommon and 
-   * always shorter than a sector.
-   */
-  if(HDR_FREE(*hdr)) {
-    return (page + COFFEE_PAGES_PER_SECTOR) & ~(COFFEE_PAGES_PER_SECTOR - 1);
-  } else if(HDR_ISOLATED(*hdr)) {
-    return page + 1;
+
+  stall = clock_time() - start;
+  if(stall > gc_stats.longest_stall) {
+    gc_stats.longest_stall = stall;
   }
-  return page + hdr->max_pages;    
 }
 /*---------------------------------------------------------------------------*/
 static struct file *
@@ -463,12 +845,146 @@ load_file(coffee_page_t start, struct file_header *hdr)
   if(HDR_MODIFIED(*hdr)) {
     file->flags |= COFFEE_FILE_MODIFIED;
   }
+  if(HDR_APPEND(*hdr)) {
+    file->flags |= COFFEE_FILE_APPEND;
+  }
   /* We don't know the amount of records yet. */
   file->record_count = -1;
 
   return file;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_NAME_INDEX
+static uint16_t
+name_hash(const char *name)
+{
+  uint16_t hash;
+  int i;
+
+  hash = 5381;
+  for(i = 0; i < COFFEE_NAME_LENGTH && name[i] != '\0'; i++) {
+    hash = ((hash << 5) + hash) ^ (uint8_t)name[i];
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_insert(const char *name, coffee_page_t page)
+{
+  uint16_t hash;
+  unsigned i, probes;
+
+  /* An unbuilt index will pick up the file when it is built. */
+  if(name_index_state == NAME_INDEX_UNBUILT) {
+    return;
+  }
+
+  hash = name_hash(name);
+  i = hash % COFFEE_NAME_INDEX_SIZE;
+  for(probes = 0; probes < COFFEE_NAME_INDEX_SIZE; probes++) {
+    if(name_index[i].page == INVALID_PAGE) {
+      name_index[i].page = page;
+      name_index[i].hash = hash;
+      return;
+    }
+    i = (i + 1) % COFFEE_NAME_INDEX_SIZE;
+  }
+
+  PRINTF("Coffee: The name index is full\n");
+  name_index_state = NAME_INDEX_OVERFLOW;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_remove(const char *name, coffee_page_t page)
+{
+  unsigned i, j, k, probes;
+
+  if(name_index_state == NAME_INDEX_UNBUILT) {
+    return;
+  }
+
+  i = name_hash(name) % COFFEE_NAME_INDEX_SIZE;
+  for(probes = 0; name_index[i].page != page; probes++) {
+    if(name_index[i].page == INVALID_PAGE ||
+       probes == COFFEE_NAME_INDEX_SIZE) {
+      return;
+    }
+    i = (i + 1) % COFFEE_NAME_INDEX_SIZE;
+  }
+
+  /*
+   * Shift back the entries that follow in the same probe sequence
+   * so that lookups do not stop prematurely at the freed slot.
+   */
+  for(j = i;;) {
+    j = (j + 1) % COFFEE_NAME_INDEX_SIZE;
+    if(name_index[j].page == INVALID_PAGE || j == i) {
+      break;
+    }
+    k = name_index[j].hash % COFFEE_NAME_INDEX_SIZE;
+    if(i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+      continue;
+    }
+    name_index[i] = name_index[j];
+    i = j;
+  }
+  name_index[i].page = INVALID_PAGE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_reset(void)
+{
+  unsigned i;
+
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    name_index[i].page = INVALID_PAGE;
+  }
+  name_index_state = NAME_INDEX_UNBUILT;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_build(void)
+{
+  struct file_header hdr;
+  coffee_page_t page;
+
+  name_index_reset();
+  name_index_state = NAME_INDEX_COMPLETE;
+
+  for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
+    read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr)) {
+      name_index_insert(hdr.name, page);
+    }
+  }
+  PRINTF("Coffee: Built the name index (%s)\n",
+         name_index_state == NAME_INDEX_COMPLETE ? "complete" : "overflow");
+}
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+name_index_lookup(const char *name, struct file_header *hdr)
+{
+  uint16_t hash;
+  unsigned i, probes;
+
+  hash = name_hash(name);
+  i = hash % COFFEE_NAME_INDEX_SIZE;
+  for(probes = 0; probes < COFFEE_NAME_INDEX_SIZE; probes++) {
+    if(name_index[i].page == INVALID_PAGE) {
+      break;
+    }
+    if(name_index[i].hash == hash) {
+      read_header(hdr, name_index[i].page);
+      if(HDR_ACTIVE(*hdr) && !HDR_LOG(*hdr) && strcmp(name, hdr->name) == 0) {
+        return name_index[i].page;
+      }
+    }
+    i = (i + 1) % COFFEE_NAME_INDEX_SIZE;
+  }
+  return INVALID_PAGE;
+}
+#endif /* COFFEE_NAME_INDEX */
+/*---------------------------------------------------------------------------*/
 static struct file *
 find_file(const char *name)
 {
@@ -488,6 +1004,22 @@ find_file(const char *name)
     }
   }
   
+#if COFFEE_NAME_INDEX
+  if(name_index_state == NAME_INDEX_UNBUILT) {
+    name_index_build();
+  }
+
+  page = name_index_lookup(name, &hdr);
+  if(page != INVALID_PAGE) {
+    return load_file(page, &hdr);
+  }
+
+  /* A complete index contains every file in the file system. */
+  if(name_index_state == NAME_INDEX_COMPLETE) {
+    return NULL;
+  }
+#endif /* COFFEE_NAME_INDEX */
+
   /* Scan the flash memory sequentially otherwise. */
   for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
     read_header(&hdr, page);
@@ -569,6 +1101,128 @@ find_contiguous_pages(coffee_page_t amount)
   return INVALID_PAGE;
 }
 /*---------------------------------------------------------------------------*/
+static int remove_by_page(coffee_page_t page, int remove_log, int close_fds,
+                          int gc_allowed);
+/*---------------------------------------------------------------------------*/
+#if COFFEE_APPEND_MODE
+static cfs_offset_t
+extent_capacity(coffee_page_t max_pages)
+{
+  return max_pages * COFFEE_PAGE_SIZE - sizeof(struct file_header);
+}
+/*---------------------------------------------------------------------------*/
+static cfs_offset_t
+append_file_end(coffee_page_t page, struct append_file *af)
+{
+  struct file_header hdr;
+  cfs_offset_t end;
+
+  /* All extents except the last one are full. */
+  if(af != NULL) {
+    af->extent_count = 0;
+  }
+  for(end = 0;; page = hdr.log_page) {
+    read_header(&hdr, page);
+    if(af != NULL) {
+      if(af->extent_count == COFFEE_APPEND_MAX_EXTENTS) {
+        return -1;
+      }
+      af->extents[af->extent_count].page = page;
+      af->extents[af->extent_count].max_pages = hdr.max_pages;
+      af->extent_count++;
+    }
+    if(!HDR_HAS_NEXT(hdr)) {
+      break;
+    }
+    end += extent_capacity(hdr.max_pages);
+  }
+
+  return end + file_end(page);
+}
+/*---------------------------------------------------------------------------*/
+static struct append_file *
+find_append_file(coffee_page_t page)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_APPEND_MAX_FILES; i++) {
+    if(append_files[i].extent_count > 0 &&
+       append_files[i].extents[0].page == page) {
+      return &append_files[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct append_file *
+load_append_file(struct file *file)
+{
+  struct append_file *af;
+  cfs_offset_t end;
+  int i, j;
+
+  af = find_append_file(file->page);
+  if(af != NULL) {
+    if(file->end == UNKNOWN_OFFSET) {
+      /* The file object has been reloaded, but the index is intact. */
+      for(end = 0, i = 0; i < af->extent_count - 1; i++) {
+        end += extent_capacity(af->extents[i].max_pages);
+      }
+      file->end = end + file_end(af->extents[i].page);
+    }
+    return af;
+  }
+
+  /* Reuse an index slot that is free or belongs to a closed file. */
+  for(i = 0; i < COFFEE_APPEND_MAX_FILES; i++) {
+    af = &append_files[i];
+    if(af->extent_count == 0) {
+      break;
+    }
+    for(j = 0; j < COFFEE_MAX_OPEN_FILES; j++) {
+      if(!FILE_UNREFERENCED(&coffee_files[j]) &&
+         coffee_files[j].page == af->extents[0].page) {
+        break;
+      }
+    }
+    if(j == COFFEE_MAX_OPEN_FILES) {
+      break;
+    }
+  }
+  if(i == COFFEE_APPEND_MAX_FILES) {
+    PRINTF("Coffee: No free slot in the append-mode file index\n");
+    return NULL;
+  }
+
+  end = append_file_end(file->page, af);
+  if(end < 0) {
+    af->extent_count = 0;
+    return NULL;
+  }
+  file->end = end;
+
+  return af;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_append_extents(coffee_page_t page, struct file_header *hdr)
+{
+  struct file_header next_hdr;
+  struct append_file *af;
+
+  af = find_append_file(page);
+  if(af != NULL) {
+    af->extent_count = 0;
+  }
+
+  for(next_hdr = *hdr; HDR_HAS_NEXT(next_hdr);) {
+    page = next_hdr.log_page;
+    read_header(&next_hdr, page);
+    remove_by_page(page, !REMOVE_LOG, !CLOSE_FDS, !ALLOW_GC);
+  }
+}
+#endif /* COFFEE_APPEND_MODE */
+/*---------------------------------------------------------------------------*/
 static int
 remove_by_page(coffee_page_t page, int remove_log, int close_fds,
                int gc_allowed)
@@ -581,15 +1235,35 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
     return -1;
   }
 
+#if COFFEE_GC_INCREMENTAL
+  build_sector_info();
+#endif
+
   if(remove_log && HDR_MODIFIED(hdr)) {
     if(remove_by_page(hdr.log_page, !REMOVE_LOG, !CLOSE_FDS, !ALLOW_GC) < 0) {
       return -1;
     }
   }
 
+#if COFFEE_APPEND_MODE
+  if(remove_log && HDR_APPEND(hdr)) {
+    remove_append_extents(page, &hdr);
+  }
+#endif
+
   hdr.flags |= HDR_FLAG_OBSOLETE;
   write_header(&hdr, page);
 
+#if COFFEE_NAME_INDEX
+  if(!HDR_LOG(hdr)) {
+    name_index_remove(hdr.name, page);
+  }
+#endif
+
+#if COFFEE_GC_INCREMENTAL
+  account_pages(page, hdr.max_pages, SECTOR_ACTIVE, SECTOR_OBSOLETE);
+#endif
+
   *gc_wait = 0;
 
   /* Close all file descriptors that reference the removed file. */
@@ -615,6 +1289,10 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
   }
 #endif
 
+#if COFFEE_GC_INCREMENTAL
+  request_gc();
+#endif
+
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -650,12 +1328,27 @@ reserve(const char *name, coffee_page_t pages,
     }
   }
 
+#if COFFEE_GC_INCREMENTAL
+  build_sector_info();
+#endif
+
   memset(&hdr, 0, sizeof(hdr));
   strncpy(hdr.name, name, sizeof(hdr.name) - 1);
   hdr.max_pages = pages;
   hdr.flags = HDR_FLAG_ALLOCATED | flags;
   write_header(&hdr, page);
 
+#if COFFEE_GC_INCREMENTAL
+  account_pages(page, pages, SECTOR_FREE, SECTOR_ACTIVE);
+  request_gc();
+#endif
+
+#if COFFEE_NAME_INDEX
+  if(!(flags & HDR_FLAG_LOG)) {
+    name_index_insert(hdr.name, page);
+  }
+#endif
+
   PRINTF("Coffee: Reserved %u pages starting from %u for file %s\n",
       pages, page, name);
 
@@ -979,6 +1672,132 @@ write_log_page(struct file *file, struct log_param *lp)
 }
 #endif /* COFFEE_MICRO_LOGS */
 /*---------------------------------------------------------------------------*/
+#if COFFEE_APPEND_MODE
+static int
+add_extent(struct append_file *af)
+{
+  struct file_header hdr;
+  struct append_extent *last;
+  coffee_page_t pages;
+  struct file *extent;
+
+  if(af->extent_count == COFFEE_APPEND_MAX_EXTENTS) {
+    return -1;
+  }
+
+  last = &af->extents[af->extent_count - 1];
+  pages = last->max_pages * 2;
+  if(pages > COFFEE_APPEND_MAX_EXTENT_PAGES) {
+    pages = COFFEE_APPEND_MAX_EXTENT_PAGES;
+  }
+  if(pages < last->max_pages) {
+    pages = last->max_pages;
+  }
+
+  read_header(&hdr, last->page);
+  extent = reserve(hdr.name, pages, 1, HDR_FLAG_LOG | HDR_FLAG_APPEND);
+  if(extent == NULL) {
+    return -1;
+  }
+
+  /* Link the new extent to the chain. */
+  hdr.log_page = extent->page;
+  hdr.log_records = 1;
+  write_header(&hdr, last->page);
+
+  PRINTF("Coffee: Added an extent of %u pages at page %u to file %s\n",
+         (unsigned)pages, (unsigned)extent->page, hdr.name);
+
+  af->extents[af->extent_count].page = extent->page;
+  af->extents[af->extent_count].max_pages = pages;
+  af->extent_count++;
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+append_read(struct file_desc *fdp, char *buf, unsigned size)
+{
+  struct append_file *af;
+  cfs_offset_t base, capacity;
+  unsigned n, left;
+  int i;
+
+  af = find_append_file(fdp->file->page);
+  if(af == NULL) {
+    return -1;
+  }
+
+  left = size;
+  for(i = 0, base = 0; i < af->extent_count && left > 0; i++) {
+    capacity = extent_capacity(af->extents[i].max_pages);
+    if(fdp->offset < base + capacity) {
+      n = base + capacity - fdp->offset;
+      if(n > left) {
+        n = left;
+      }
+      COFFEE_READ(buf, n, absolute_offset(af->extents[i].page,
+                                          fdp->offset - base));
+      buf += n;
+      fdp->offset += n;
+      left -= n;
+    }
+    base += capacity;
+  }
+
+  return size - left;
+}
+/*---------------------------------------------------------------------------*/
+static int
+append_write(struct file_desc *fdp, const char *buf, unsigned size)
+{
+  struct append_file *af;
+  struct append_extent *last;
+  cfs_offset_t base, capacity;
+  unsigned n, left;
+  int i;
+
+  /* Append-mode files do not support modifications. */
+  if(fdp->offset != fdp->file->end) {
+    return -1;
+  }
+
+  af = find_append_file(fdp->file->page);
+  if(af == NULL) {
+    return -1;
+  }
+
+  for(i = 0, base = 0; i < af->extent_count - 1; i++) {
+    base += extent_capacity(af->extents[i].max_pages);
+  }
+
+  for(left = size; left > 0;) {
+    last = &af->extents[af->extent_count - 1];
+    capacity = extent_capacity(last->max_pages);
+    if(fdp->offset >= base + capacity) {
+      if(add_extent(af) < 0) {
+        break;
+      }
+      base += capacity;
+      continue;
+    }
+
+    n = base + capacity - fdp->offset;
+    if(n > left) {
+      n = left;
+    }
+    COFFEE_WRITE(buf, n, absolute_offset(last->page, fdp->offset - base));
+    buf += n;
+    fdp->offset += n;
+    left -= n;
+  }
+
+  fdp->file->end = fdp->offset;
+
+  return left == size ? -1 : (int)(size - left);
+}
+#endif /* COFFEE_APPEND_MODE */
+/*---------------------------------------------------------------------------*/
 static int
 get_available_fd(void)
 {
@@ -1017,6 +1836,12 @@ cfs_open(const char *name, int flags)
       return -1;
     }
     fdp->file->end = 0;
+#if COFFEE_APPEND_MODE
+  } else if(FILE_APPEND(fdp->file)) {
+    if(load_append_file(fdp->file) == NULL) {
+      return -1;
+    }
+#endif
   } else if(fdp->file->end == UNKNOWN_OFFSET) {
     fdp->file->end = file_end(fdp->file->page);
   }
@@ -1060,7 +1885,14 @@ cfs_seek(int fd, cfs_offset_t offset, int whence)
   }
 
   if(new_offset < 0 || new_offset > fdp->file->max_pages * COFFEE_PAGE_SIZE) {
+#if COFFEE_APPEND_MODE
+    /* Append-mode files can be sought up to their end. */
+    if(!FILE_APPEND(fdp->file) || new_offset > fdp->file->end) {
+      return -1;
+    }
+#else
     return -1;
+#endif
   }
 
   if(fdp->file->end < new_offset) {
@@ -1111,6 +1943,12 @@ cfs_read(int fd, void *buf, unsigned size)
     size = file->end - fdp->offset;
   }
 
+#if COFFEE_APPEND_MODE
+  if(FILE_APPEND(file)) {
+    return append_read(fdp, buf, size);
+  }
+#endif
+
   /* If the file is allocated, read directly in the file. */
   if(!FILE_MODIFIED(file)) {
     COFFEE_READ(buf, size, absolute_offset(file->page, fdp->offset));
@@ -1166,6 +2004,12 @@ cfs_write(int fd, const void *buf, unsigned size)
   fdp = &coffee_fd_set[fd];
   file = fdp->file;
 
+#if COFFEE_APPEND_MODE
+  if(FILE_APPEND(file)) {
+    return append_write(fdp, buf, size);
+  }
+#endif
+
   /* Attempt to extend the file if we try to write past the end. */
 #if COFFEE_IO_SEMANTICS
   if(!(fdp->io_flags & CFS_COFFEE_IO_FIRM_SIZE)) {
@@ -1274,6 +2118,11 @@ cfs_readdir(struct cfs_dir *dir, struct cfs_dirent *record)
       coffee_page_t next_page;
       memcpy(record->name, hdr.name, sizeof(record->name));
       record->name[sizeof(record->name) - 1] = '\0';
+#if COFFEE_APPEND_MODE
+      if(HDR_APPEND(hdr)) {
+        record->size = append_file_end(page, NULL);
+      } else
+#endif
       record->size = file_end(page);
 
       next_page = next_file(page, &hdr);
@@ -1298,6 +2147,14 @@ cfs_coffee_reserve(const char *name, cfs_offset_t size)
   return reserve(name, page_count(size), 0, 0) == NULL ? -1 : 0;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_APPEND_MODE
+int
+cfs_coffee_reserve_append(const char *name, cfs_offset_t size)
+{
+  return reserve(name, page_count(size), 0, HDR_FLAG_APPEND) == NULL ? -1 : 0;
+}
+#endif
+/*---------------------------------------------------------------------------*/
 int
 cfs_coffee_configure_log(const char *filename, unsigned log_size,
 			 unsigned log_record_size)
@@ -1316,8 +2173,8 @@ cfs_coffee_configure_log(const char *filename, unsigned log_size,
   }
 
   read_header(&hdr, file->page);
-  if(HDR_MODIFIED(hdr)) {
-    /* Too late to customize the log. */
+  if(HDR_MODIFIED(hdr) || HDR_APPEND(hdr)) {
+    /* Too late to customize the log, or the file has no log. */
     return -1;
   }
 
@@ -1359,11 +2216,41 @@ cfs_coffee_format(void)
   /* Formatting invalidates the file information. */
   memset(&protected_mem, 0, sizeof(protected_mem));
 
+#if COFFEE_GC_INCREMENTAL
+  for(i = 0; i < COFFEE_SECTOR_COUNT; i++) {
+    memset(sector_info[i].pages, 0, sizeof(sector_info[i].pages));
+    sector_info[i].pages[SECTOR_FREE] = COFFEE_PAGES_PER_SECTOR;
+    sector_info[i].head_pages = 0;
+    sector_info[i].erase_count++;
+  }
+  sector_info_valid = 1;
+#endif
+
+#if COFFEE_APPEND_MODE
+  memset(append_files, 0, sizeof(append_files));
+#endif
+
+#if COFFEE_NAME_INDEX
+  /* The storage is empty, so the index is complete without a scan. */
+  name_index_reset();
+  name_index_state = NAME_INDEX_COMPLETE;
+#endif
+
   PRINTF(" done!\n");
 
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+void
+cfs_coffee_get_gc_stats(struct cfs_coffee_gc_stats *stats)
+{
+#if COFFEE_GC_INCREMENTAL
+  build_sector_info();
+  update_erase_stats();
+#endif
+  memcpy(stats, &gc_stats, sizeof(*stats));
+}
+/*---------------------------------------------------------------------------*/
 void *
 cfs_coffee_get_protected_mem(unsigned *size)
 {
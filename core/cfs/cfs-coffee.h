@@ -39,6 +39,7 @@
 #define CFS_COFFEE_H
 
 #include "cfs.h"
+#include "sys/clock.h"
 
 /**
  * Instruct Coffee that the access pattern to this file is adapted to 
@@ -63,6 +64,28 @@
  */
 #define CFS_COFFEE_IO_FIRM_SIZE		0x2
 
+/**
+ * Garbage collection statistics.
+ *
+ * The erase counts are only maintained when Coffee is configured
+ * with COFFEE_GC_INCREMENTAL, and are kept in RAM only.
+ *
+ * \sa cfs_coffee_get_gc_stats()
+ */
+struct cfs_coffee_gc_stats {
+  /* Number of erased sectors. */
+  unsigned long erases;
+  /* Number of garbage collections run synchronously within a file
+     operation. */
+  unsigned long collections;
+  /* Number of sectors erased by the background collector. */
+  unsigned long incremental_steps;
+  /* The longest time spent in a synchronous garbage collection. */
+  clock_time_t longest_stall;
+  uint16_t min_erase_count;
+  uint16_t max_erase_count;
+};
+
 /**
  * \file
  *	Header for the Coffee file system.
@@ -86,6 +109,20 @@
  */
 int cfs_coffee_reserve(const char *name, cfs_offset_t size);
 
+/**
+ * \brief Reserve space for an append-mode file.
+ * \param name The filename.
+ * \param size The size of the first extent of the file.
+ * \return 0 on success, -1 on failure.
+ *
+ * An append-mode file can only be written at its end. Instead of being
+ * copied into a larger extent when full, the file grows by linking new
+ * extents to it, and the extents are indexed in RAM while the file is
+ * used. This suits data logs that are appended to in small records.
+ * Requires that Coffee is configured with COFFEE_APPEND_MODE.
+ */
+int cfs_coffee_reserve_append(const char *name, cfs_offset_t size);
+
 /**
  * \brief Configure the on-demand log file.
  * \param file The filename.
@@ -126,6 +163,12 @@ int cfs_coffee_set_io_semantics(int fd, unsigned flags);
  */
 int cfs_coffee_format(void);
 
+/**
+ * \brief Get the garbage collection statistics.
+ * \param stats A pointer to the structure to fill with the statistics.
+ */
+void cfs_coffee_get_gc_stats(struct cfs_coffee_gc_stats *stats);
+
 /**
  * \brief Points out a memory region that may not be altered during
  * checkpointing operations that use the file system.
@@ -52,11 +52,18 @@ PROCESS(slip_process, "SLIP driver");
 
 uint8_t slip_active;
 
-#if 1
-#define SLIP_STATISTICS(statement)
+#ifdef SLIP_CONF_STATISTICS
+#define SLIP_STATISTICS_ENABLED SLIP_CONF_STATISTICS
 #else
+#define SLIP_STATISTICS_ENABLED 0
+#endif
+
+#if SLIP_STATISTICS_ENABLED
 uint16_t slip_rubbish, slip_twopackets, slip_overflow, slip_ip_drop;
+uint16_t slip_overrun, slip_frames;
 #define SLIP_STATISTICS(statement) statement
+#else
+#define SLIP_STATISTICS(statement)
 #endif
 
 /* Must be at least one byte larger than UIP_BUFSIZE! */
@@ -78,12 +85,19 @@ enum {
  * furthermore, if state == STATE_TWOPACKETS we have one more packet at
  * [pkt_end, end). If more bytes arrive in state STATE_TWOPACKETS
  * they are discarded.
+ *
+ * This gives double-buffered frame assembly: while the upper half
+ * hands the packet at [begin, pkt_end) to uIP, the next frame is
+ * assembled at [pkt_end, end). If a frame is cut short because both
+ * slots were full, lost is set and the rest of that frame is
+ * discarded once the upper half has made room again.
  */
 
 static uint8_t state = STATE_TWOPACKETS;
 static uint16_t begin, end;
 static uint8_t rxbuf[RX_BUFSIZE];
 static uint16_t pkt_end;		/* SLIP_END tracker. */
+static uint8_t lost;			/* Bytes dropped in STATE_TWOPACKETS. */
 
 static void (* input_callback)(void) = NULL;
 /*---------------------------------------------------------------------------*/
@@ -156,6 +170,7 @@ static void
 rxbuf_init(void)
 {
   begin = end = pkt_end = 0;
+  lost = 0;
   state = STATE_OK;
 }
 /*---------------------------------------------------------------------------*/
@@ -225,13 +240,8 @@ slip_poll_handler(uint8_t *outbuf, uint16_t blen)
       if(len > blen) {
 	len = 0;
       } else {
-	unsigned i;
-	for(i = begin; i < RX_BUFSIZE; i++) {
-	  *outbuf++ = rxbuf[i];
-	}
-	for(i = 0; i < pkt_end; i++) {
-	  *outbuf++ = rxbuf[i];
-	}
+	memcpy(outbuf, &rxbuf[begin], RX_BUFSIZE - begin);
+	memcpy(outbuf + (RX_BUFSIZE - begin), &rxbuf[0], pkt_end);
       }
     }
 
@@ -239,7 +249,9 @@ slip_poll_handler(uint8_t *outbuf, uint16_t blen)
     begin = pkt_end;
     if(state == STATE_TWOPACKETS) {
       pkt_end = end;
-      state = STATE_OK;		/* Assume no bytes where lost! */
+      /* Drop the tail of a frame that was cut short while we were full. */
+      state = lost ? STATE_RUBBISH : STATE_OK;
+      lost = 0;
       
       /* One more packet is buffered, need to be polled again! */
       process_poll(&slip_process);
@@ -326,6 +338,12 @@ slip_input_byte(unsigned char c)
     return 0;
     
   case STATE_TWOPACKETS:       /* Two packets are already buffered! */
+    if(c == SLIP_END) {
+      lost = 0;
+    } else if(!lost) {
+      lost = 1;
+      SLIP_STATISTICS(slip_overrun++);
+    }
     return 0;
 
   case STATE_ESC:
@@ -353,6 +371,7 @@ slip_input_byte(unsigned char c)
 	 * There may already be one packet buffered.
 	 */
       if(end != pkt_end) {	/* Non zero length. */
+	SLIP_STATISTICS(slip_frames++);
 	if(begin == pkt_end) {	/* None buffered. */
 	  pkt_end = end;
 	} else {
@@ -393,3 +412,68 @@ slip_input_byte(unsigned char c)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Copy a run of unescaped bytes, none of which is SLIP_END or
+ * SLIP_ESC, into rxbuf in at most two pieces.
+ */
+static int
+add_run(const uint8_t *run, uint16_t len)
+{
+  uint16_t space, first;
+
+  space = begin > end ? begin - end - 1 : RX_BUFSIZE - (end - begin) - 1;
+  if(len > space) {		/* rxbuf is full */
+    state = STATE_RUBBISH;
+    SLIP_STATISTICS(slip_overflow++);
+    end = pkt_end;		/* remove rubbish */
+    return 0;
+  }
+
+  first = RX_BUFSIZE - end;
+  if(first > len) {
+    first = len;
+  }
+  memcpy(&rxbuf[end], run, first);
+  memcpy(&rxbuf[0], run + first, len - first);
+  end = end + len < RX_BUFSIZE ? end + len : end + len - RX_BUFSIZE;
+
+  if(rxbuf[begin] == 'C' && memchr(run, 'T', len) != NULL) {
+    process_poll(&slip_process);
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_input_block(const uint8_t *buf, uint16_t len)
+{
+  const uint8_t *p;
+  uint16_t n;
+  int wakeup;
+
+  wakeup = 0;
+  while(len > 0) {
+    if(state == STATE_OK) {
+      /* Copy everything up to the next control byte in one go. */
+      for(n = 0; n < len && buf[n] != SLIP_END && buf[n] != SLIP_ESC; n++);
+      if(n > 0) {
+        wakeup |= add_run(buf, n);
+        buf += n;
+        len -= n;
+        continue;
+      }
+    } else if(state == STATE_RUBBISH) {
+      /* Skip to the end of the broken frame. */
+      p = memchr(buf, SLIP_END, len);
+      if(p == NULL) {
+        return wakeup;
+      }
+      len -= p - buf;
+      buf = p;
+    }
+    wakeup |= slip_input_byte(*buf++);
+    len--;
+  }
+  return wakeup;
+}
+/*---------------------------------------------------------------------------*/
@@ -62,13 +62,37 @@ uint8_t slip_send(void);
  */
 int slip_input_byte(unsigned char c);
 
+/**
+ * Input a block of SLIP encoded bytes.
+ *
+ * This function is called by device drivers that receive data in
+ * chunks, such as DMA-driven UARTs, USB serial and the native
+ * platform, to pass a block of incoming bytes to the SLIP driver. The
+ * block may start and end anywhere within a frame. Runs of bytes
+ * that need no unescaping are copied as a whole. The function can be
+ * called from an interrupt context, but must not be interleaved with
+ * calls to slip_input_byte().
+ *
+ * \param buf The data that is to be passed to the SLIP driver
+ * \param len The number of bytes in buf
+ *
+ * \return Non-zero if the CPU should be powered up, zero otherwise.
+ */
+int slip_input_block(const uint8_t *buf, uint16_t len);
+
 uint8_t slip_write(const void *ptr, int len);
 
 /* Did we receive any bytes lately? */
 extern uint8_t slip_active;
 
-/* Statistics. */
+/*
+ * Statistics, available when SLIP_CONF_STATISTICS is set. slip_rubbish
+ * counts framing errors, slip_overflow frames that did not fit in the
+ * receive buffer and slip_overrun frames cut short because two frames
+ * were already waiting for the upper half.
+ */
 extern uint16_t slip_rubbish, slip_twopackets, slip_overflow, slip_ip_drop;
+extern uint16_t slip_overrun, slip_frames;
 
 /**
  * Set a function to be called when there is activity on the SLIP
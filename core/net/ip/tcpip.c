@@ -571,13 +571,26 @@ tcpip_ipv6_output(void)
       nexthop = &UIP_IP_BUF->destipaddr;
     } else {
       uip_ds6_route_t *route;
+#if UIP_CONF_IPV6_RPL
+      /* The packet is routed in the RPL instance given by its RPL
+         option, or in the default instance if it has none. */
+      rpl_instance_t *instance;
+
+      instance = rpl_get_packet_instance();
+      route = rpl_lookup_route(instance, &UIP_IP_BUF->destipaddr);
+#else /* UIP_CONF_IPV6_RPL */
       /* Check if we have a route to the destination address. */
       route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
+#endif /* UIP_CONF_IPV6_RPL */
 
       /* No route was found - we send to the default route instead. */
       if(route == NULL) {
         PRINTF("tcpip_ipv6_output: no route found, using default route\n");
+#if UIP_CONF_IPV6_RPL
+        nexthop = rpl_get_default_nexthop(instance);
+#else /* UIP_CONF_IPV6_RPL */
         nexthop = uip_ds6_defrt_choose();
+#endif /* UIP_CONF_IPV6_RPL */
         if(nexthop == NULL) {
 #ifdef UIP_FALLBACK_INTERFACE
 	  PRINTF("FALLBACK: removing ext hdrs & setting proto %d %d\n", 
@@ -94,7 +94,6 @@ struct trickle_param {
   clock_time_t t_start;         /* Start of the interval (absolute clock_time) */
   clock_time_t t_end;           /* End of the interval (absolute clock_time) */
   clock_time_t t_next;          /* Clock ticks, randomised in [I/2, I) */
-  clock_time_t t_last_trigger;
   struct ctimer ct;
   uint8_t i_current;            /* Current doublings from i_min */
   uint8_t i_max;                /* Max number of doublings */
@@ -131,6 +130,12 @@ struct trickle_param {
  */
 #define TRICKLE_DWELL(t) ((uint32_t)(TRICKLE_IMAX(t) * t->t_dwell))
 
+/**
+ * \brief Longest time the expiry timer waits, well within the range of
+ * clock_time_t so that current_time() sees every wrap of the clock
+ */
+#define EXPIRY_MAX_WAIT ((uint32_t)(((clock_time_t)~0) >> 2) & 0x7FFFFFFF)
+
 /**
  * \brief Check if suppression is enabled for trickle_param t
  * t is a pointer to the timer
@@ -152,7 +157,6 @@ struct trickle_param {
   t[m].k = ROLL_TM_K_##m; \
   t[m].t_active = ROLL_TM_T_ACTIVE_##m; \
   t[m].t_dwell = ROLL_TM_T_DWELL_##m; \
-  t[m].t_last_trigger = clock_time(); \
 } while(0)
 /*---------------------------------------------------------------------------*/
 /* Sequence Values and Serial Number Arithmetic
@@ -201,6 +205,8 @@ struct trickle_param {
 /*---------------------------------------------------------------------------*/
 /* Sliding Windows */
 struct sliding_window {
+  struct sliding_window *next;  /* Hash chain if used, free list otherwise */
+  struct mcast_packet *packets; /* Buffered messages, by sequence value */
   seed_id_t seed_id;
   int16_t lower_bound;          /* lolipop */
   int16_t upper_bound;          /* lolipop */
@@ -231,7 +237,6 @@ struct sliding_window {
  * w: pointer to a sliding window
  */
 #define SLIDING_WINDOW_IS_USED_CLR(w) ((w)->flags &= ~SLIDING_WINDOW_U_BIT)
-#define window_free(w) SLIDING_WINDOW_IS_USED_CLR(w)
 
 /**
  * \brief Set 'Is Seen' bit for window w
@@ -271,18 +276,34 @@ struct sliding_window {
   ((uint8_t)(((w)->flags & SLIDING_WINDOW_M_BIT) == SLIDING_WINDOW_M_BIT))
 /*---------------------------------------------------------------------------*/
 /* Multicast Packet Buffers */
-struct mcast_packet {
-#if ROLL_TM_SHORT_SEEDS
-  /* Short seeds are stored inside the message */
-  seed_id_t seed_id;
+/* The longest datagram that the 16-bit lengths and offsets can describe */
+#define MCAST_PACKET_MAX_LEN 0xFFFF
+
+#if ROLL_TM_BUFF_SIZE > MCAST_PACKET_MAX_LEN
+#error "ROLL_TM_CONF_BUFF_SIZE must be at most 65535 bytes"
 #endif
-  uint32_t active;              /* Starts at 0 and increments */
-  uint32_t dwell;               /* Starts at 0 and increments */
+
+struct mcast_packet {
+  struct mcast_packet *next;    /* Next message of the window, free list */
+  struct mcast_packet *next_in; /* Next message with the same M, by time */
+  struct sliding_window *sw;    /* Pointer to the SW this packet belongs to */
+  uint32_t t_in;                /* Reception time (see current_time()) */
+  uint16_t offset;              /* Start of the datagram in buff_mem */
   uint16_t buff_len;
   uint16_t seq_val;             /* host-byte order */
-  struct sliding_window *sw;    /* Pointer to the SW this packet belongs to */
   uint8_t flags;                /* Is-Used, Must Send, Is Listed */
-  uint8_t buff[UIP_BUFSIZE - UIP_LLH_LEN];
+};
+
+/*
+ * Buffered messages with the same M, in order of reception. Since all of
+ * them stay active and dwell for the same time, they also end their active
+ * period and expire in this order: 'head' is the next one to expire and
+ * 'active' is the oldest one still in its active period.
+ */
+struct packet_queue {
+  struct mcast_packet *head;
+  struct mcast_packet *active;
+  struct mcast_packet *tail;
 };
 
 /* Flag bits */
@@ -290,20 +311,25 @@ struct mcast_packet {
 #define MCAST_PACKET_S_BIT       0x20   /* Must Send Next Pass */
 #define MCAST_PACKET_L_BIT       0x10   /* Is listed in ICMP message */
 
-/* Fetch a pointer to the Seed ID of a buffered message p */
-#if ROLL_TM_SHORT_SEEDS
-#define MCAST_PACKET_GET_SEED(p) ((seed_id_t *)&((p)->seed_id))
-#else
-#define MCAST_PACKET_GET_SEED(p) \
-    ((seed_id_t *)&((struct uip_ip_hdr *)&(p)->buff[UIP_LLH_LEN])->srcipaddr)
-#endif
+/**
+ * \brief Get a pointer to the datagram of a buffered packet
+ * p: pointer to a packet buffer
+ */
+#define MCAST_PACKET_BUFF(p) (&buff_mem[(p)->offset])
 
 /**
  * \brief Get the TTL of a buffered packet
  * p: pointer to a packet buffer
  */
 #define MCAST_PACKET_TTL(p) \
-    (((struct uip_ip_hdr *)(p)->buff)->ttl)
+    (((struct uip_ip_hdr *)MCAST_PACKET_BUFF(p))->ttl)
+
+/**
+ * \brief Is packet p still in its active period at time 'now'?
+ * p: pointer to a packet buffer
+ */
+#define MCAST_PACKET_IS_ACTIVE(p, now) \
+    ((now) - (p)->t_in < TRICKLE_ACTIVE((&t[SLIDING_WINDOW_GET_M((p)->sw)])))
 
 /**
  * \brief Set 'Is Used' bit for packet p
@@ -356,12 +382,6 @@ struct mcast_packet {
  * p: pointer to a struct mcast_packet
  */
 #define MCAST_PACKET_LISTED_CLR(p) ((p)->flags &= ~MCAST_PACKET_L_BIT)
-
-/**
- * \brief Free a multicast packet buffer
- * p: pointer to a struct mcast_packet
- */
-#define MCAST_PACKET_FREE(p) ((p)->flags = 0)
 /*---------------------------------------------------------------------------*/
 /* Sequence Lists in Multicast Trickle ICMP messages */
 struct sequence_list_header {
@@ -438,9 +458,15 @@ struct hbho_mcast {
 static struct roll_tm_stats stats;
 
 #define ROLL_TM_STATS_ADD(x) stats.x++
+#define ROLL_TM_STATS_PEAK(x, v) do { \
+  if((v) > stats.x) { \
+    stats.x = (v); \
+  } \
+} while(0)
 #define ROLL_TM_STATS_INIT() do { memset(&stats, 0, sizeof(stats)); } while(0)
 #else /* UIP_MCAST6_STATS */
 #define ROLL_TM_STATS_ADD(x)
+#define ROLL_TM_STATS_PEAK(x, v)
 #define ROLL_TM_STATS_INIT()
 #endif
 /*---------------------------------------------------------------------------*/
@@ -448,7 +474,20 @@ static struct roll_tm_stats stats;
 /*---------------------------------------------------------------------------*/
 static struct trickle_param t[2];
 static struct sliding_window windows[ROLL_TM_WINS];
+static struct sliding_window *window_table[ROLL_TM_WIN_HASH];
+static struct sliding_window *free_windows;
 static struct mcast_packet buffered_msgs[ROLL_TM_BUFF_NUM];
+static struct mcast_packet *free_msgs;
+static struct packet_queue queues[2];
+static struct ctimer expiry_timer;
+
+/* Buffered datagrams, stored back to back */
+static uint8_t buff_mem[ROLL_TM_BUFF_SIZE];
+static uint16_t buff_used;
+
+/* See current_time() */
+static uint32_t ticks;
+static clock_time_t ticks_last;
 /*---------------------------------------------------------------------------*/
 /* Temporary Stores */
 /*---------------------------------------------------------------------------*/
@@ -476,9 +515,11 @@ extern uint16_t uip_slen;
 /*---------------------------------------------------------------------------*/
 static void icmp_input(void);
 static void icmp_output(void);
-static void window_update_bounds(void);
 static void reset_trickle_timer(uint8_t);
 static void handle_timer(void *);
+static void handle_expiry(void *);
+static uint32_t current_time(void);
+static struct mcast_packet *queue_active(uint8_t, uint32_t);
 /*---------------------------------------------------------------------------*/
 /* ROLL TM ICMPv6 handler declaration */
 UIP_ICMP6_HANDLER(roll_tm_icmp_handler, ICMP6_ROLL_TM,
@@ -542,8 +583,7 @@ static void
 handle_timer(void *ptr)
 {
   struct trickle_param *param;
-  clock_time_t diff_last;       /* Time diff from last pass */
-  clock_time_t diff_start;      /* Time diff from interval start */
+  uint32_t now;
   uint8_t m;
 
   param = (struct trickle_param *)ptr;
@@ -564,80 +604,32 @@ handle_timer(void *ptr)
     return;
   }
 
-  VERBOSE_PRINTF("ROLL TM: M=%u Periodic at %lu, last=%lu\n",
-                 m, (unsigned long)clock_time(),
-                 (unsigned long)param->t_last_trigger);
-
-  /* Temporarily store 'now' in t_next and calculate diffs */
-  param->t_next = clock_time();
-  diff_last = param->t_next - param->t_last_trigger;
-  diff_start = param->t_next - param->t_start;
-  param->t_last_trigger = param->t_next;
-
-  VERBOSE_PRINTF
-    ("ROLL TM: M=%u Periodic diff from last %lu, from start %lu\n", m,
-     (unsigned long)diff_last, (unsigned long)diff_start);
-
-  /* Handle all buffered messages */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)
-       && (SLIDING_WINDOW_GET_M(locmpptr->sw) == m)) {
-
-      /*
-       * if()
-       * If the packet was received during the last interval, its reception
-       * caused an inconsistency (and thus a timer reset). This means that
-       * the packet was received at about t_start, we increment by diff_start
-       *
-       * else()
-       * If the packet was not received during the last window, it is safe to
-       * increase its lifetime counters by the time diff from last pass
-       *
-       * if active == dwell == 0 but i_current != 0, this is an oops
-       * (new packet that didn't reset us). We don't handle it
-       */
-      if(locmpptr->active == 0) {
-        locmpptr->active += diff_start;
-        locmpptr->dwell += diff_start;
-      } else {
-        locmpptr->active += diff_last;
-        locmpptr->dwell += diff_last;
-      }
-
-      VERBOSE_PRINTF("ROLL TM: M=%u Packet %u active %lu of %lu\n",
-                     m, locmpptr->seq_val, locmpptr->active,
-                     TRICKLE_ACTIVE(param));
-
-      if(locmpptr->dwell > TRICKLE_DWELL(param)) {
-        locmpptr->sw->count--;
-        PRINTF("ROLL TM: M=%u Free Packet %u (%lu > %lu), Window now at %u\n",
-               m, locmpptr->seq_val, locmpptr->dwell,
-               TRICKLE_DWELL(param), locmpptr->sw->count);
-        if(locmpptr->sw->count == 0) {
-          PRINTF("ROLL TM: M=%u Free Window ", m);
-          PRINT_SEED(&locmpptr->sw->seed_id);
-          PRINTF("\n");
-          window_free(locmpptr->sw);
-        }
-        MCAST_PACKET_FREE(locmpptr);
-      } else if(MCAST_PACKET_TTL(locmpptr) > 0) {
-        /* Handle multicast transmissions */
-        if(locmpptr->active < TRICKLE_ACTIVE(param) &&
-           ((SUPPRESSION_ENABLED(param) && MCAST_PACKET_MUST_SEND(locmpptr)) ||
-           SUPPRESSION_DISABLED(param))) {
-          PRINTF("ROLL TM: M=%u Periodic - Sending packet from Seed ", m);
-          PRINT_SEED(&locmpptr->sw->seed_id);
-          PRINTF(" seq %u\n", locmpptr->seq_val);
-          uip_len = locmpptr->buff_len;
-          memcpy(UIP_IP_BUF, &locmpptr->buff, uip_len);
-
-          UIP_MCAST6_STATS_ADD(mcast_fwd);
-          tcpip_output(NULL);
-          MCAST_PACKET_SEND_CLR(locmpptr);
-          watchdog_periodic();
-        }
-      }
+  VERBOSE_PRINTF("ROLL TM: M=%u Periodic at %lu\n",
+                 m, (unsigned long)clock_time());
+
+  now = current_time();
+
+  /* Handle multicast transmissions of all messages still active */
+  for(locmpptr = queue_active(m, now); locmpptr != NULL;
+      locmpptr = locmpptr->next_in) {
+    VERBOSE_PRINTF("ROLL TM: M=%u Packet %u active %lu of %lu\n",
+                   m, locmpptr->seq_val,
+                   (unsigned long)(now - locmpptr->t_in),
+                   (unsigned long)TRICKLE_ACTIVE(param));
+
+    if(MCAST_PACKET_TTL(locmpptr) > 0 &&
+       ((SUPPRESSION_ENABLED(param) && MCAST_PACKET_MUST_SEND(locmpptr)) ||
+        SUPPRESSION_DISABLED(param))) {
+      PRINTF("ROLL TM: M=%u Periodic - Sending packet from Seed ", m);
+      PRINT_SEED(&locmpptr->sw->seed_id);
+      PRINTF(" seq %u\n", locmpptr->seq_val);
+      uip_len = locmpptr->buff_len;
+      memcpy(UIP_IP_BUF, MCAST_PACKET_BUFF(locmpptr), uip_len);
+
+      UIP_MCAST6_STATS_ADD(mcast_fwd);
+      tcpip_output(NULL);
+      MCAST_PACKET_SEND_CLR(locmpptr);
+      watchdog_periodic();
     }
   }
 
@@ -652,8 +644,6 @@ handle_timer(void *ptr)
   param->inconsistency = 0;
   param->c = 0;
 
-  window_update_bounds();
-
   /* Temporarily store 'now' in t_next */
   param->t_next = clock_time();
   if(param->t_next >= param->t_end) {
@@ -688,27 +678,88 @@ reset_trickle_timer(uint8_t index)
   ctimer_set(&t[index].ct, t[index].t_next, handle_timer, (void *)&t[index]);
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Return the current time in clock ticks, extended to 32 bits so that it
+ * does not wrap during the dwell time of a message. The expiry timer keeps
+ * calling us at least once every EXPIRY_MAX_WAIT while messages are
+ * buffered, so no wrap of clock_time() goes unnoticed.
+ */
+static uint32_t
+current_time()
+{
+  clock_time_t now = clock_time();
+
+  ticks += (clock_time_t)(now - ticks_last);
+  ticks_last = now;
+  return ticks;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+window_hash(const seed_id_t *s, uint8_t m)
+{
+  const uint8_t *p = (const uint8_t *)s;
+  uint8_t h = m;
+  uint8_t i;
+
+  for(i = 0; i < sizeof(seed_id_t); i++) {
+    h = ((h << 1) | (h >> 7)) ^ p[i];
+  }
+  return h % ROLL_TM_WIN_HASH;
+}
+/*---------------------------------------------------------------------------*/
 static struct sliding_window *
-window_allocate()
+window_allocate(seed_id_t *s, uint8_t m)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
-    if(!SLIDING_WINDOW_IS_USED(iterswptr)) {
-      iterswptr->count = 0;
-      iterswptr->lower_bound = -1;
-      iterswptr->upper_bound = -1;
-      iterswptr->min_listed = -1;
-      return iterswptr;
+  struct sliding_window **bucket;
+
+  iterswptr = free_windows;
+  if(iterswptr == NULL) {
+    return NULL;
+  }
+  free_windows = iterswptr->next;
+
+  memset(iterswptr, 0, sizeof(struct sliding_window));
+  iterswptr->lower_bound = -1;
+  iterswptr->upper_bound = -1;
+  iterswptr->min_listed = -1;
+  seed_id_cpy(&iterswptr->seed_id, s);
+  if(m) {
+    SLIDING_WINDOW_M_SET(iterswptr);
+  }
+  SLIDING_WINDOW_IS_USED_SET(iterswptr);
+
+  bucket = &window_table[window_hash(s, m)];
+  iterswptr->next = *bucket;
+  *bucket = iterswptr;
+  return iterswptr;
+}
+/*---------------------------------------------------------------------------*/
+static void
+window_free(struct sliding_window *w)
+{
+  struct sliding_window **prev;
+
+  PRINTF("ROLL TM: M=%u Free Window ", SLIDING_WINDOW_GET_M(w));
+  PRINT_SEED(&w->seed_id);
+  PRINTF("\n");
+
+  for(prev = &window_table[window_hash(&w->seed_id, SLIDING_WINDOW_GET_M(w))];
+      *prev != NULL; prev = &(*prev)->next) {
+    if(*prev == w) {
+      *prev = w->next;
+      break;
     }
   }
-  return NULL;
+  SLIDING_WINDOW_IS_USED_CLR(w);
+  w->next = free_windows;
+  free_windows = w;
 }
 /*---------------------------------------------------------------------------*/
 static struct sliding_window *
 window_lookup(seed_id_t *s, uint8_t m)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
+  for(iterswptr = window_table[window_hash(s, m)]; iterswptr != NULL;
+      iterswptr = iterswptr->next) {
     VERBOSE_PRINTF("ROLL TM: M=%u (%u) ", SLIDING_WINDOW_GET_M(iterswptr), m);
     VERBOSE_PRINT_SEED(&iterswptr->seed_id);
     VERBOSE_PRINTF("\n");
@@ -720,85 +771,239 @@ window_lookup(seed_id_t *s, uint8_t m)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+/* Return the buffered message of window w with sequence value seq, if any */
+static struct mcast_packet *
+window_find(struct sliding_window *w, uint16_t seq)
+{
+  for(locmpptr = w->packets; locmpptr != NULL; locmpptr = locmpptr->next) {
+    if(SEQ_VAL_IS_EQ(locmpptr->seq_val, seq)) {
+      return locmpptr;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Add message p to the list of its window, in order of sequence value */
 static void
-window_update_bounds()
+window_insert(struct mcast_packet *p)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
-    iterswptr->lower_bound = -1;
+  struct sliding_window *w = p->sw;
+  struct mcast_packet **prev;
+
+  for(prev = &w->packets; *prev != NULL; prev = &(*prev)->next) {
+    if(!SEQ_VAL_IS_LT((*prev)->seq_val, p->seq_val)) {
+      break;
+    }
   }
+  p->next = *prev;
+  *prev = p;
 
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)) {
-      iterswptr = locmpptr->sw;
-      VERBOSE_PRINTF("ROLL TM: Update Bounds: [%d - %d] vs %u\n",
-                     iterswptr->lower_bound, iterswptr->upper_bound,
-                     locmpptr->seq_val);
-      if(iterswptr->lower_bound < 0
-         || SEQ_VAL_IS_LT(locmpptr->seq_val, iterswptr->lower_bound)) {
-        iterswptr->lower_bound = locmpptr->seq_val;
+  /* If this is a new Seq Num, update the window upper bound */
+  if(w->count == 0 || SEQ_VAL_IS_GT(p->seq_val, w->upper_bound)) {
+    w->upper_bound = p->seq_val;
+    VERBOSE_PRINTF("ROLL TM: New Upper Bound %u\n", w->upper_bound);
+  }
+  w->lower_bound = w->packets->seq_val;
+  w->count++;
+}
+/*---------------------------------------------------------------------------*/
+/* Add message p to the reception queue of its M */
+static void
+queue_append(struct mcast_packet *p)
+{
+  struct packet_queue *q = &queues[SLIDING_WINDOW_GET_M(p->sw)];
+
+  p->next_in = NULL;
+  if(q->tail == NULL) {
+    q->head = p;
+  } else {
+    q->tail->next_in = p;
+  }
+  q->tail = p;
+  if(q->active == NULL) {
+    q->active = p;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Return the oldest message with trickle parametrization m that is still in
+ * its active period. All messages after it in the queue are active too */
+static struct mcast_packet *
+queue_active(uint8_t m, uint32_t now)
+{
+  struct packet_queue *q = &queues[m];
+
+  while(q->active != NULL && !MCAST_PACKET_IS_ACTIVE(q->active, now)) {
+    q->active = q->active->next_in;
+  }
+  return q->active;
+}
+/*---------------------------------------------------------------------------*/
+static void
+buffer_free(struct mcast_packet *p)
+{
+  struct sliding_window *w = p->sw;
+  struct packet_queue *q = &queues[SLIDING_WINDOW_GET_M(w)];
+  struct mcast_packet **prev;
+  struct mcast_packet *last;
+  struct mcast_packet *other;
+
+  /* Remove it from its window */
+  for(prev = &w->packets; *prev != NULL; prev = &(*prev)->next) {
+    if(*prev == p) {
+      *prev = p->next;
+      break;
+    }
+  }
+  w->count--;
+  w->lower_bound = w->packets != NULL ? w->packets->seq_val : -1;
+
+  /* Remove it from its reception queue */
+  last = NULL;
+  for(prev = &q->head; *prev != NULL; prev = &(*prev)->next_in) {
+    if(*prev == p) {
+      *prev = p->next_in;
+      break;
+    }
+    last = *prev;
+  }
+  if(q->tail == p) {
+    q->tail = last;
+  }
+  if(q->active == p) {
+    q->active = p->next_in;
+  }
+
+  /* Close the gap in buffer memory */
+  memmove(&buff_mem[p->offset], &buff_mem[p->offset + p->buff_len],
+          buff_used - p->offset - p->buff_len);
+  buff_used -= p->buff_len;
+  for(other = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
+      other >= buffered_msgs; other--) {
+    if(MCAST_PACKET_IS_USED(other) && other->offset > p->offset) {
+      other->offset -= p->buff_len;
+    }
+  }
+
+  PRINTF("ROLL TM: M=%u Free Packet %u, Window now at %u\n",
+         SLIDING_WINDOW_GET_M(w), p->seq_val, w->count);
+
+  p->flags = 0;
+  p->next = free_msgs;
+  free_msgs = p;
+
+  if(w->count == 0) {
+    window_free(w);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Schedule the expiry timer for the message whose dwell time ends first */
+static void
+schedule_expiry(void)
+{
+  uint32_t now;
+  uint32_t left;
+  uint32_t wait;
+  uint8_t m;
+
+  now = current_time();
+  wait = EXPIRY_MAX_WAIT;
+  for(m = 0; m < 2; m++) {
+    if(queues[m].head != NULL) {
+      left = queues[m].head->t_in + TRICKLE_DWELL((&t[m])) - now;
+      if((int32_t)left < 0) {
+        left = 0;
       }
-      if(iterswptr->upper_bound < 0 ||
-         SEQ_VAL_IS_GT(locmpptr->seq_val, iterswptr->upper_bound)) {
-        iterswptr->upper_bound = locmpptr->seq_val;
+      if(left < wait) {
+        wait = left;
       }
     }
   }
+
+  if(queues[0].head == NULL && queues[1].head == NULL) {
+    ctimer_stop(&expiry_timer);
+  } else {
+    ctimer_set(&expiry_timer, (clock_time_t)wait + 1, handle_expiry, NULL);
+  }
 }
 /*---------------------------------------------------------------------------*/
-static struct mcast_packet *
+/* Free all messages that have reached the end of their dwell time */
+static void
+handle_expiry(void *ptr)
+{
+  uint32_t now;
+  uint8_t m;
+
+  now = current_time();
+  for(m = 0; m < 2; m++) {
+    while(queues[m].head != NULL &&
+          now - queues[m].head->t_in > TRICKLE_DWELL((&t[m]))) {
+      buffer_free(queues[m].head);
+    }
+  }
+  schedule_expiry();
+}
+/*---------------------------------------------------------------------------*/
+/* Free the oldest message of the largest window. Return 0 on failure */
+static uint8_t
 buffer_reclaim()
 {
   struct sliding_window *largest = windows;
-  struct mcast_packet *rv;
 
   for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
       iterswptr--) {
-    if(iterswptr->count > largest->count) {
+    if(SLIDING_WINDOW_IS_USED(iterswptr) &&
+       iterswptr->count > largest->count) {
       largest = iterswptr;
     }
   }
 
-  if(largest->count == 1) {
+  if(largest->count <= 1) {
     /* Can't reclaim last entry for a window and this is the largest window */
-    return NULL;
+    return 0;
   }
 
   PRINTF("ROLL TM: Reclaim from Seed ");
   PRINT_SEED(&largest->seed_id);
   PRINTF(" M=%u, count was %u\n",
          SLIDING_WINDOW_GET_M(largest), largest->count);
-  /* Find the packet at the lowest bound for the largest window */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr) && (locmpptr->sw == largest) &&
-       SEQ_VAL_IS_EQ(locmpptr->seq_val, largest->lower_bound)) {
-      rv = locmpptr;
-      PRINTF("ROLL TM: Reclaim seq. val %u\n", locmpptr->seq_val);
-      MCAST_PACKET_FREE(rv);
-      largest->count--;
-      window_update_bounds();
-      VERBOSE_PRINTF("ROLL TM: Reclaim - new bounds [%u , %u]\n",
-                     largest->lower_bound, largest->upper_bound);
-      return rv;
-    }
-  }
+  PRINTF("ROLL TM: Reclaim seq. val %u\n", largest->packets->seq_val);
 
-  /* oops */
-  return NULL;
+  buffer_free(largest->packets);
+  ROLL_TM_STATS_ADD(buff_reclaim);
+
+  VERBOSE_PRINTF("ROLL TM: Reclaim - new bounds [%u , %u]\n",
+                 largest->lower_bound, largest->upper_bound);
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
+/* Allocate a message with len bytes of buffer memory, reclaiming older
+ * messages if necessary */
 static struct mcast_packet *
-buffer_allocate()
+buffer_allocate(uint16_t len)
 {
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(!MCAST_PACKET_IS_USED(locmpptr)) {
-      return locmpptr;
+  struct mcast_packet *p;
+
+  if(len > ROLL_TM_BUFF_SIZE) {
+    return NULL;
+  }
+
+  while(free_msgs == NULL || ROLL_TM_BUFF_SIZE - buff_used < len) {
+    PRINTF("ROLL TM: Buffer allocation failed, reclaiming\n");
+    if(!buffer_reclaim()) {
+      return NULL;
     }
   }
-  return NULL;
+
+  p = free_msgs;
+  free_msgs = p->next;
+
+  memset(p, 0, sizeof(struct mcast_packet));
+  p->offset = buff_used;
+  p->buff_len = len;
+  buff_used += len;
+  ROLL_TM_STATS_PEAK(buff_peak, buff_used);
+  MCAST_PACKET_USED_SET(p);
+  return p;
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -806,7 +1011,9 @@ icmp_output()
 {
   struct sequence_list_header *sl;
   uint8_t *buffer;
+  uint8_t *end;
   uint16_t payload_len;
+  uint32_t now;
 
   PRINTF("ROLL TM: ICMPv6 Out\n");
 
@@ -817,13 +1024,19 @@ icmp_output()
   UIP_IP_BUF->ttl = ROLL_TM_IP_HOP_LIMIT;
 
   sl = (struct sequence_list_header *)UIP_ICMP_PAYLOAD;
+  end = &uip_buf[UIP_BUFSIZE];
   payload_len = 0;
+  now = current_time();
 
   VERBOSE_PRINTF("ROLL TM: ICMPv6 Out - Hdr @ %p, payload @ %p\n", UIP_ICMP_BUF, sl);
 
   for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
       iterswptr--) {
     if(SLIDING_WINDOW_IS_USED(iterswptr) && iterswptr->count > 0) {
+      if((uint8_t *)sl + sizeof(struct sequence_list_header) + 2 > end) {
+        /* No room for more sequence lists. Advertise the rest next time */
+        break;
+      }
       memset(sl, 0, sizeof(struct sequence_list_header));
 #if ROLL_TM_SHORT_SEEDS
       sl->flags = SEQUENCE_LIST_S_BIT;
@@ -838,18 +1051,16 @@ icmp_output()
 
       buffer = (uint8_t *)sl + sizeof(struct sequence_list_header);
 
-      for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-          locmpptr >= buffered_msgs; locmpptr--) {
-        if(MCAST_PACKET_IS_USED(locmpptr) &&
-           locmpptr->active < TRICKLE_ACTIVE((&t[SLIDING_WINDOW_GET_M(iterswptr)]))) {
-          if(locmpptr->sw == iterswptr) {
-            sl->seq_len++;
-            PRINTF(", %u", locmpptr->seq_val);
-            *buffer = (uint8_t)(locmpptr->seq_val >> 8);
-            buffer++;
-            *buffer = (uint8_t)(locmpptr->seq_val & 0xFF);
-            buffer++;
-          }
+      for(locmpptr = iterswptr->packets;
+          locmpptr != NULL && buffer + 2 <= end;
+          locmpptr = locmpptr->next) {
+        if(MCAST_PACKET_IS_ACTIVE(locmpptr, now)) {
+          sl->seq_len++;
+          PRINTF(", %u", locmpptr->seq_val);
+          *buffer = (uint8_t)(locmpptr->seq_val >> 8);
+          buffer++;
+          *buffer = (uint8_t)(locmpptr->seq_val & 0xFF);
+          buffer++;
         }
       }
       PRINTF(", Len=%u\n", sl->seq_len);
@@ -922,6 +1133,18 @@ accept(uint8_t in)
   }
 #endif
 
+  /*
+   * Buffered datagrams are stored with 16-bit lengths. The length in the
+   * IPv6 header does not include the header itself, so it can describe a
+   * datagram that is longer than that.
+   */
+  if(UIP_IPH_LEN + ((uint32_t)UIP_IP_BUF->len[0] << 8) +
+     UIP_IP_BUF->len[1] > MCAST_PACKET_MAX_LEN) {
+    PRINTF("ROLL TM: Mcast I/O, datagram too long\n");
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+
   /* Check the Next Header field: Must be HBHO */
   if(UIP_IP_BUF->proto != UIP_PROTO_HBHO) {
     PRINTF("ROLL TM: Mcast I/O, bad proto\n");
@@ -984,17 +1207,11 @@ accept(uint8_t in)
       UIP_MCAST6_STATS_ADD(mcast_dropped);
       return UIP_MCAST6_DROP;
     }
-    for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-        locmpptr >= buffered_msgs; locmpptr--) {
-      if(MCAST_PACKET_IS_USED(locmpptr) &&
-         locmpptr->sw == locswptr &&
-         SLIDING_WINDOW_GET_M(locmpptr->sw) == m &&
-         SEQ_VAL_IS_EQ(seq_val, locmpptr->seq_val)) {
-        /* Seen before , drop */
-        PRINTF("ROLL TM: Seen before\n");
-        UIP_MCAST6_STATS_ADD(mcast_dropped);
-        return UIP_MCAST6_DROP;
-      }
+    if(window_find(locswptr, seq_val) != NULL) {
+      /* Seen before , drop */
+      PRINTF("ROLL TM: Seen before\n");
+      UIP_MCAST6_STATS_ADD(mcast_dropped);
+      return UIP_MCAST6_DROP;
     }
   }
 
@@ -1003,32 +1220,29 @@ accept(uint8_t in)
   /* We have not seen this message before */
   /* Allocate a window if we have to */
   if(!locswptr) {
-    locswptr = window_allocate();
+    locswptr = window_allocate(seed_ptr, m);
     PRINTF("ROLL TM: New seed\n");
   }
   if(!locswptr) {
     /* Couldn't allocate window, drop */
     PRINTF("ROLL TM: Failed to allocate window\n");
+    ROLL_TM_STATS_ADD(win_full);
     UIP_MCAST6_STATS_ADD(mcast_dropped);
     return UIP_MCAST6_DROP;
   }
 
   /* Allocate a buffer */
-  locmpptr = buffer_allocate();
-  if(!locmpptr) {
-    PRINTF("ROLL TM: Buffer allocation failed, reclaiming\n");
-    locmpptr = buffer_reclaim();
-  }
-
+  locmpptr = buffer_allocate(uip_len);
   if(!locmpptr) {
     /* Failed to allocate / reclaim a buffer. If the window has only just been
      * allocated, free it before dropping */
     PRINTF("ROLL TM: Buffer reclaim failed\n");
     if(locswptr->count == 0) {
       window_free(locswptr);
-      UIP_MCAST6_STATS_ADD(mcast_dropped);
-      return UIP_MCAST6_DROP;
     }
+    ROLL_TM_STATS_ADD(buff_full);
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
   }
 #if UIP_MCAST6_STATS
   if(in == ROLL_TM_DGRAM_IN) {
@@ -1037,38 +1251,13 @@ accept(uint8_t in)
 #endif
 
   /* We have a window and we have a buffer. Accept this message */
-  /* Set the seed ID and correct M for this window */
-  SLIDING_WINDOW_M_CLR(locswptr);
-  if(m) {
-    SLIDING_WINDOW_M_SET(locswptr);
-  }
-  SLIDING_WINDOW_IS_USED_SET(locswptr);
-  seed_id_cpy(&locswptr->seed_id, seed_ptr);
-  PRINTF("ROLL TM: Window for seed ");
-  PRINT_SEED(&locswptr->seed_id);
-  PRINTF(" M=%u, count=%u\n",
-         SLIDING_WINDOW_GET_M(locswptr), locswptr->count);
-
-  /* If this window was previously empty, set its lower bound to this packet */
-  if(locswptr->count == 0) {
-    locswptr->lower_bound = seq_val;
-    VERBOSE_PRINTF("ROLL TM: New Lower Bound %u\n", locswptr->lower_bound);
-  }
-
-  /* If this is a new Seq Num, update the window upper bound */
-  if(locswptr->count == 0 || SEQ_VAL_IS_GT(seq_val, locswptr->upper_bound)) {
-    locswptr->upper_bound = seq_val;
-    VERBOSE_PRINTF("ROLL TM: New Upper Bound %u\n", locswptr->upper_bound);
-  }
-
-  locswptr->count++;
-
-  memset(locmpptr, 0, sizeof(struct mcast_packet));
-  memcpy(&locmpptr->buff, UIP_IP_BUF, uip_len);
+  memcpy(MCAST_PACKET_BUFF(locmpptr), UIP_IP_BUF, uip_len);
   locmpptr->sw = locswptr;
-  locmpptr->buff_len = uip_len;
   locmpptr->seq_val = seq_val;
-  MCAST_PACKET_USED_SET(locmpptr);
+  locmpptr->t_in = current_time();
+  window_insert(locmpptr);
+  queue_append(locmpptr);
+  schedule_expiry();
 
   PRINTF("ROLL TM: Window for seed ");
   PRINT_SEED(&locswptr->seed_id);
@@ -1142,16 +1331,14 @@ icmp_input()
 
   ROLL_TM_STATS_ADD(icmp_in);
 
-  /* Reset Is-Listed bit for all windows */
+  /* Reset Is-Listed bit for all windows and their cached packets */
   for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
       iterswptr--) {
     SLIDING_WINDOW_LISTED_CLR(iterswptr);
-  }
-
-  /* Reset Is-Listed bit for all cached packets */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    MCAST_PACKET_LISTED_CLR(locmpptr);
+    for(locmpptr = iterswptr->packets; locmpptr != NULL;
+        locmpptr = locmpptr->next) {
+      MCAST_PACKET_LISTED_CLR(locmpptr);
+    }
   }
 
   locslhptr = (struct sequence_list_header *)UIP_ICMP_PAYLOAD;
@@ -1228,23 +1415,16 @@ icmp_input()
 
           inconsistency = 1;
           /* Check if the advertised sequence is in our buffer */
-          for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-              locmpptr >= buffered_msgs; locmpptr--) {
-            if(MCAST_PACKET_IS_USED(locmpptr) && locmpptr->sw == locswptr) {
-              if(SEQ_VAL_IS_EQ(locmpptr->seq_val, val)) {
-
-                inconsistency = 0;
-                MCAST_PACKET_LISTED_SET(locmpptr);
-                PRINTF("ROLL TM: ICMPv6 In, %u listed\n", locmpptr->seq_val);
-
-                /* Update lowest seq. num listed for this window
-                 * We need this to check for "we have new" */
-                if(locswptr->min_listed == -1 ||
-                   SEQ_VAL_IS_LT(val, locswptr->min_listed)) {
-                  locswptr->min_listed = val;
-                }
-                break;
-              }
+          if(window_find(locswptr, val) != NULL) {
+            inconsistency = 0;
+            MCAST_PACKET_LISTED_SET(locmpptr);
+            PRINTF("ROLL TM: ICMPv6 In, %u listed\n", locmpptr->seq_val);
+
+            /* Update lowest seq. num listed for this window
+             * We need this to check for "we have new" */
+            if(locswptr->min_listed == -1 ||
+               SEQ_VAL_IS_LT(val, locswptr->min_listed)) {
+              locswptr->min_listed = val;
             }
           }
           if(inconsistency) {
@@ -1271,17 +1451,17 @@ icmp_input()
 
   /* Check for "We have new */
   PRINTF("ROLL TM: ICMPv6 In, Check our buffer\n");
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)) {
-      locswptr = locmpptr->sw;
+  for(locswptr = &windows[ROLL_TM_WINS - 1]; locswptr >= windows;
+      locswptr--) {
+    /* Point to the sliding window's trickle param */
+    loctpptr = &t[SLIDING_WINDOW_GET_M(locswptr)];
+    for(locmpptr = locswptr->packets; locmpptr != NULL;
+        locmpptr = locmpptr->next) {
       PRINTF("ROLL TM: ICMPv6 In, ");
       PRINTF("Check %u, Seed L: %u, This L: %u Min L: %d\n",
              locmpptr->seq_val, SLIDING_WINDOW_IS_LISTED(locswptr),
              MCAST_PACKET_IS_LISTED(locmpptr), locswptr->min_listed);
 
-      /* Point to the sliding window's trickle param */
-      loctpptr = &t[SLIDING_WINDOW_GET_M(locswptr)];
       if(!SLIDING_WINDOW_IS_LISTED(locswptr)) {
         /* If a buffered packet's Seed ID was not listed */
         PRINTF("ROLL TM: Inconsistency - Seed ID ");
@@ -1418,8 +1598,13 @@ init()
   PRINTF("ROLL TM: ROLL Multicast - Draft #%u\n", ROLL_TM_VER);
 
   memset(windows, 0, sizeof(windows));
+  memset(window_table, 0, sizeof(window_table));
   memset(buffered_msgs, 0, sizeof(buffered_msgs));
+  memset(queues, 0, sizeof(queues));
   memset(t, 0, sizeof(t));
+  buff_used = 0;
+  ticks = 0;
+  ticks_last = clock_time();
 
   ROLL_TM_STATS_INIT();
   UIP_MCAST6_STATS_INIT(&stats);
@@ -1427,11 +1612,21 @@ init()
   /* Register the ICMPv6 input handler */
   uip_icmp6_register_input_handler(&roll_tm_icmp_handler);
 
+  /* Chain all windows and message buffers in their free lists */
+  free_windows = NULL;
   for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
       iterswptr--) {
     iterswptr->lower_bound = -1;
     iterswptr->upper_bound = -1;
     iterswptr->min_listed = -1;
+    iterswptr->next = free_windows;
+    free_windows = iterswptr;
+  }
+  free_msgs = NULL;
+  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
+      locmpptr >= buffered_msgs; locmpptr--) {
+    locmpptr->next = free_msgs;
+    free_msgs = locmpptr;
   }
 
   TIMER_CONFIGURE(0);
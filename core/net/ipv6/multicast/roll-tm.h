@@ -166,18 +166,47 @@
 #define ROLL_TM_WINS 2
 #endif
 /*---------------------------------------------------------------------------*/
+/*
+ * Number of buckets of the hash table used to look sliding windows up by
+ * Seed ID and M. Windows are looked up for every incoming datagram and for
+ * every sequence list in incoming ICMPv6 messages
+ */
+#ifdef ROLL_TM_CONF_WIN_HASH
+#define ROLL_TM_WIN_HASH ROLL_TM_CONF_WIN_HASH
+#else
+#define ROLL_TM_WIN_HASH 8
+#endif
+/*---------------------------------------------------------------------------*/
 /*
  * Maximum Number of Buffered Multicast Messages
  * This buffer is shared across all Seed IDs, therefore a new very active Seed
  * may eventually occupy all slots. It would make little sense (if any) to
  * define support for fewer buffered messages than seeds*2
+ *
+ * If only ROLL_TM_CONF_BUFF_SIZE is defined, this defaults to the number of
+ * 64-byte messages that fit in the buffer
  */
 #ifdef ROLL_TM_CONF_BUFF_NUM
 #define ROLL_TM_BUFF_NUM ROLL_TM_CONF_BUFF_NUM
+#elif defined(ROLL_TM_CONF_BUFF_SIZE)
+#define ROLL_TM_BUFF_NUM (ROLL_TM_CONF_BUFF_SIZE / 64)
 #else
 #define ROLL_TM_BUFF_NUM 6
 #endif
 /*---------------------------------------------------------------------------*/
+/*
+ * Memory for Buffered Multicast Messages, in bytes (at most 65535)
+ * Messages are stored back to back, so the same memory holds many small
+ * messages or a few large ones. When it runs out, the oldest message of the
+ * largest window is dropped. By default, it holds ROLL_TM_BUFF_NUM messages
+ * of the maximum size
+ */
+#ifdef ROLL_TM_CONF_BUFF_SIZE
+#define ROLL_TM_BUFF_SIZE ROLL_TM_CONF_BUFF_SIZE
+#else
+#define ROLL_TM_BUFF_SIZE (ROLL_TM_BUFF_NUM * (UIP_BUFSIZE - UIP_LLH_LEN))
+#endif
+/*---------------------------------------------------------------------------*/
 /*
  * Use Short Seed IDs [short: 2, long: 16 (default)]
  * It can be argued that we should (and it would be easy to) support both at
@@ -219,6 +248,10 @@ struct roll_tm_stats {
   UIP_MCAST6_STATS_DATATYPE icmp_in;
   UIP_MCAST6_STATS_DATATYPE icmp_out;
   UIP_MCAST6_STATS_DATATYPE icmp_bad;
+  UIP_MCAST6_STATS_DATATYPE win_full;     /* Dropped, no free sliding window */
+  UIP_MCAST6_STATS_DATATYPE buff_full;    /* Dropped, no buffer memory */
+  UIP_MCAST6_STATS_DATATYPE buff_reclaim; /* Freed before the end of Tdwell */
+  UIP_MCAST6_STATS_DATATYPE buff_peak;    /* Most buffer memory used (bytes) */
 };
 
 #endif /* ROLL_TM_H_ */
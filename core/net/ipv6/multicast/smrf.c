@@ -47,6 +47,8 @@
 #include "net/ipv6/multicast/smrf.h"
 #include "net/rpl/rpl.h"
 #include "net/netstack.h"
+#include "lib/crc16.h"
+#include "lib/memb.h"
 #include <string.h>
 
 #define DEBUG DEBUG_NONE
@@ -63,12 +65,40 @@
 /*---------------------------------------------------------------------------*/
 /* Internal Data */
 /*---------------------------------------------------------------------------*/
-static struct ctimer mcast_periodic;
-static uint8_t mcast_len;
-static uip_buf_t mcast_buf;
+/* A datagram waiting for its forwarding delay */
+struct fwd_entry {
+  struct ctimer timer;
+  uint16_t len;
+  uint8_t buf[UIP_BUFSIZE - UIP_LLH_LEN];
+};
+
+#if SMRF_DUP_CHECK
+/* A recently seen datagram */
+struct dup_entry {
+  uip_ipaddr_t src;
+  clock_time_t time;
+  uint16_t hash;
+};
+
+static struct dup_entry dup_cache[SMRF_DUP_CACHE_SIZE];
+static uint8_t dup_next;
+#endif /* SMRF_DUP_CHECK */
+
+MEMB(fwd_memb, struct fwd_entry, SMRF_FWD_QUEUE_SIZE);
 static uint8_t fwd_delay;
 static uint8_t fwd_spread;
 /*---------------------------------------------------------------------------*/
+/* Maintain Stats */
+#if UIP_MCAST6_STATS
+static struct smrf_stats stats;
+
+#define SMRF_STATS_ADD(x) stats.x++
+#define SMRF_STATS_INIT() do { memset(&stats, 0, sizeof(stats)); } while(0)
+#else /* UIP_MCAST6_STATS */
+#define SMRF_STATS_ADD(x)
+#define SMRF_STATS_INIT()
+#endif
+/*---------------------------------------------------------------------------*/
 /* uIPv6 Pointers */
 /*---------------------------------------------------------------------------*/
 #define UIP_IP_BUF        ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
@@ -76,13 +106,75 @@ static uint8_t fwd_spread;
 static void
 mcast_fwd(void *p)
 {
-  memcpy(uip_buf, &mcast_buf, mcast_len);
-  uip_len = mcast_len;
+  struct fwd_entry *e = p;
+
+  memcpy(UIP_IP_BUF, e->buf, e->len);
+  uip_len = e->len;
+  memb_free(&fwd_memb, e);
+
   UIP_IP_BUF->ttl--;
   tcpip_output(NULL);
   uip_len = 0;
 }
 /*---------------------------------------------------------------------------*/
+#if SMRF_DUP_CHECK
+/* How long a datagram stays in the duplicate cache */
+static clock_time_t
+dup_lifetime(void)
+{
+#if SMRF_DUP_LIFETIME
+  return SMRF_DUP_LIFETIME;
+#else
+  clock_time_t d;
+
+  /* The longest delay that in() picks before forwarding a datagram */
+  d = SMRF_FWD_DELAY();
+  if(d < SMRF_MIN_FWD_DELAY) {
+    d = SMRF_MIN_FWD_DELAY;
+  }
+  if(SMRF_MAX_SPREAD > 1) {
+    d *= SMRF_MAX_SPREAD;
+  }
+  return d > 0 ? d : 1;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Check the datagram in uip_buf against the duplicate cache and remember it.
+ * The hash covers the destination and everything after the extension
+ * headers, which is what stays the same from hop to hop
+ */
+static uint8_t
+is_duplicate(void)
+{
+  struct dup_entry *e;
+  clock_time_t lifetime;
+  uint16_t hash;
+
+  hash = crc16_data((unsigned char *)&UIP_IP_BUF->destipaddr,
+                    sizeof(uip_ipaddr_t), 0);
+  hash = crc16_data((unsigned char *)UIP_IP_BUF + UIP_IPH_LEN + uip_ext_len,
+                    uip_len - UIP_IPH_LEN - uip_ext_len, hash);
+
+  lifetime = dup_lifetime();
+  for(e = dup_cache; e < &dup_cache[SMRF_DUP_CACHE_SIZE]; e++) {
+    if(e->hash == hash &&
+       uip_ipaddr_cmp(&e->src, &UIP_IP_BUF->srcipaddr) &&
+       clock_time() - e->time < lifetime) {
+      return 1;
+    }
+  }
+
+  /* Not seen before, replace the oldest entry */
+  e = &dup_cache[dup_next];
+  dup_next = (dup_next + 1) % SMRF_DUP_CACHE_SIZE;
+  uip_ipaddr_copy(&e->src, &UIP_IP_BUF->srcipaddr);
+  e->time = clock_time();
+  e->hash = hash;
+  return 0;
+}
+#endif /* SMRF_DUP_CHECK */
+/*---------------------------------------------------------------------------*/
 static uint8_t
 in()
 {
@@ -130,14 +222,21 @@ in()
   }
 
   UIP_MCAST6_STATS_ADD(mcast_in_all);
+
+#if SMRF_DUP_CHECK
+  if(is_duplicate()) {
+    PRINTF("SMRF: Seen before\n");
+    SMRF_STATS_ADD(dup);
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+#endif /* SMRF_DUP_CHECK */
+
   UIP_MCAST6_STATS_ADD(mcast_in_unique);
 
   /* If we have an entry in the mcast routing table, something with
    * a higher RPL rank (somewhere down the tree) is a group member */
   if(uip_mcast6_route_lookup(&UIP_IP_BUF->destipaddr)) {
-    /* If we enter here, we will definitely forward */
-    UIP_MCAST6_STATS_ADD(mcast_fwd);
-
     /*
      * Add a delay (D) of at least SMRF_FWD_DELAY() to compensate for how
      * contikimac handles broadcasts. We can't start our TX before the sender
@@ -154,10 +253,13 @@ in()
 
     if(fwd_delay == 0) {
       /* No delay required, send it, do it now, why wait? */
+      UIP_MCAST6_STATS_ADD(mcast_fwd);
       UIP_IP_BUF->ttl--;
       tcpip_output(NULL);
       UIP_IP_BUF->ttl++;        /* Restore before potential upstack delivery */
     } else {
+      struct fwd_entry *e;
+
       /* Randomise final delay in [D , D*Spread], step D */
       fwd_spread = SMRF_INTERVAL_COUNT;
       if(fwd_spread > SMRF_MAX_SPREAD) {
@@ -167,9 +269,17 @@ in()
         fwd_delay = fwd_delay * (1 + ((random_rand() >> 11) % fwd_spread));
       }
 
-      memcpy(&mcast_buf, uip_buf, uip_len);
-      mcast_len = uip_len;
-      ctimer_set(&mcast_periodic, fwd_delay, mcast_fwd, NULL);
+      /* Each queued datagram waits for its own delay */
+      e = memb_alloc(&fwd_memb);
+      if(e == NULL) {
+        PRINTF("SMRF: Forwarding queue full\n");
+        SMRF_STATS_ADD(fwd_queue_full);
+      } else {
+        UIP_MCAST6_STATS_ADD(mcast_fwd);
+        memcpy(e->buf, UIP_IP_BUF, uip_len);
+        e->len = uip_len;
+        ctimer_set(&e->timer, fwd_delay, mcast_fwd, e);
+      }
     }
     PRINTF("SMRF: %u bytes: fwd in %u [%u]\n",
            uip_len, fwd_delay, fwd_spread);
@@ -189,7 +299,14 @@ in()
 static void
 init()
 {
-  UIP_MCAST6_STATS_INIT(NULL);
+  SMRF_STATS_INIT();
+  UIP_MCAST6_STATS_INIT(&stats);
+
+  memb_init(&fwd_memb);
+#if SMRF_DUP_CHECK
+  memset(dup_cache, 0, sizeof(dup_cache));
+  dup_next = 0;
+#endif /* SMRF_DUP_CHECK */
 
   uip_mcast6_route_init();
 }
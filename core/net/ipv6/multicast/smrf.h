@@ -41,6 +41,7 @@
 #define SMRF_H_
 
 #include "contiki-conf.h"
+#include "net/ipv6/multicast/uip-mcast6-stats.h"
 
 #include <stdint.h>
 /*---------------------------------------------------------------------------*/
@@ -59,17 +60,58 @@
 #else
 #define SMRF_MAX_SPREAD 4
 #endif
+
+/*
+ * Number of datagrams waiting for their forwarding delay. Each of them takes
+ * a full uIP buffer. When all are taken, new datagrams are still delivered
+ * locally but not forwarded
+ */
+#ifdef SMRF_CONF_FWD_QUEUE_SIZE
+#define SMRF_FWD_QUEUE_SIZE SMRF_CONF_FWD_QUEUE_SIZE
+#else
+#define SMRF_FWD_QUEUE_SIZE 2
+#endif
+
+/*
+ * Drop copies of datagrams that arrive again, e.g. from a new preferred
+ * parent that forwards a datagram the old one already delivered. SMRF
+ * datagrams carry no sequence number, so the cache can only recognise a
+ * datagram by its source address and a CRC-16 of its destination and
+ * payload. As a consequence, a source that sends the same payload again
+ * within SMRF_DUP_LIFETIME has it dropped, and so is a different datagram
+ * whose CRC collides with a remembered one. Set to 0 for applications
+ * that send identical datagrams in quick succession
+ */
+#ifdef SMRF_CONF_DUP_CHECK
+#define SMRF_DUP_CHECK SMRF_CONF_DUP_CHECK
+#else
+#define SMRF_DUP_CHECK 1
+#endif
+
+/* Number of recent datagrams in the duplicate cache */
+#ifdef SMRF_CONF_DUP_CACHE_SIZE
+#define SMRF_DUP_CACHE_SIZE SMRF_CONF_DUP_CACHE_SIZE
+#else
+#define SMRF_DUP_CACHE_SIZE 8
+#endif
+
+/*
+ * How long a datagram is remembered in the duplicate cache (clock ticks).
+ * Copies arrive within about one forwarding delay of each other, so a
+ * longer lifetime mostly drops datagrams that the source repeated. 0, the
+ * default, uses the longest forwarding delay of the node: D * Max Spread
+ */
+#ifdef SMRF_CONF_DUP_LIFETIME
+#define SMRF_DUP_LIFETIME SMRF_CONF_DUP_LIFETIME
+#else
+#define SMRF_DUP_LIFETIME 0
+#endif
 /*---------------------------------------------------------------------------*/
 /* Stats datatype */
 /*---------------------------------------------------------------------------*/
 struct smrf_stats {
-  uint16_t mcast_in_unique;
-  uint16_t mcast_in_all;        /* At layer 3 */
-  uint16_t mcast_in_ours;       /* Unique and we are a group member */
-  uint16_t mcast_fwd;           /* Forwarded by us but we are not the seed */
-  uint16_t mcast_out;           /* We are the seed */
-  uint16_t mcast_bad;
-  uint16_t mcast_dropped;
+  UIP_MCAST6_STATS_DATATYPE dup;            /* Dropped, seen before */
+  UIP_MCAST6_STATS_DATATYPE fwd_queue_full; /* Not forwarded, queue full */
 };
 
 #endif /* SMRF_H_ */
@@ -76,10 +76,12 @@ extern uip_mcast6_stats_t uip_mcast6_stats;
 #define UIP_MCAST6_STATS_ADD(x) uip_mcast6_stats.x++
 #define UIP_MCAST6_STATS_GET(x) uip_mcast6_stats.x
 #define UIP_MCAST6_STATS_INIT(s) uip_mcast6_stats_init(s)
+#define UIP_MCAST6_STATS_ENGINE() uip_mcast6_stats.engine_stats
 #else /* UIP_MCAST6_STATS */
 #define UIP_MCAST6_STATS_ADD(x)
 #define UIP_MCAST6_STATS_GET(x) 0
 #define UIP_MCAST6_STATS_INIT(s)
+#define UIP_MCAST6_STATS_ENGINE() NULL
 #endif /* UIP_MCAST6_STATS */
 /*---------------------------------------------------------------------------*/
 /**
@@ -65,6 +65,7 @@
 #include "net/ipv6/uip-ds6.h"
 #include "net/rime/rime.h"
 #include "net/ipv6/sicslowpan.h"
+#include "net/link-stats.h"
 #include "net/netstack.h"
 
 #if UIP_CONF_IPV6
@@ -1609,6 +1610,7 @@ input(void)
   /* Save the RSSI of the incoming packet in case the upper layer will
      want to query us for it later. */
   last_rssi = (signed short)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+  link_stats_input_callback(packetbuf_addr(PACKETBUF_ADDR_SENDER));
 #if SICSLOWPAN_CONF_FRAG
   /* if reassembly timed out, cancel it */
   if(timer_expired(&reass_timer)) {
@@ -1864,6 +1866,8 @@ sicslowpan_init(void)
    */
   tcpip_set_outputfunc(output);
 
+  link_stats_init();
+
 #if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
 /* Preinitialize any address contexts for better header compression
  * (Saves up to 13 bytes per 6lowpan packet)
@@ -48,6 +48,7 @@
 #include <stddef.h>
 #include "lib/list.h"
 #include "net/linkaddr.h"
+#include "net/link-stats.h"
 #include "net/packetbuf.h"
 #include "net/ipv6/uip-ds6-nbr.h"
 
@@ -198,6 +199,8 @@ uip_ds6_link_neighbor_callback(int status, int numtx)
     return;
   }
 
+  link_stats_packet_sent(dest, status, numtx);
+
   LINK_NEIGHBOR_CALLBACK(dest, status, numtx);
 
 #if UIP_DS6_LL_NUD
@@ -197,6 +197,13 @@ uip_ds6_route_num_routes(void)
 /*---------------------------------------------------------------------------*/
 uip_ds6_route_t *
 uip_ds6_route_lookup(uip_ipaddr_t *addr)
+{
+  return uip_ds6_route_lookup_filtered(addr, NULL, NULL);
+}
+/*---------------------------------------------------------------------------*/
+uip_ds6_route_t *
+uip_ds6_route_lookup_filtered(uip_ipaddr_t *addr,
+                              uip_ds6_route_filter_t filter, const void *arg)
 {
   uip_ds6_route_t *r;
   uip_ds6_route_t *found_route;
@@ -212,6 +219,9 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
   for(r = uip_ds6_route_head();
       r != NULL;
       r = uip_ds6_route_next(r)) {
+    if(filter != NULL && !filter(r, arg)) {
+      continue;
+    }
     if(r->length >= longestmatch &&
        uip_ipaddr_prefixcmp(addr, &r->ipaddr, r->length)) {
       longestmatch = r->length;
@@ -244,6 +254,14 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
 uip_ds6_route_t *
 uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 		  uip_ipaddr_t *nexthop)
+{
+  return uip_ds6_route_add_filtered(ipaddr, length, nexthop, NULL, NULL);
+}
+/*---------------------------------------------------------------------------*/
+uip_ds6_route_t *
+uip_ds6_route_add_filtered(uip_ipaddr_t *ipaddr, uint8_t length,
+                           uip_ipaddr_t *nexthop,
+                           uip_ds6_route_filter_t filter, const void *arg)
 {
   uip_ds6_route_t *r;
   struct uip_ds6_route_neighbor_route *nbrr;
@@ -264,7 +282,7 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
   /* First make sure that we don't add a route twice. If we find an
      existing route for our destination, we'll just update the old
      one. */
-  r = uip_ds6_route_lookup(ipaddr);
+  r = uip_ds6_route_lookup_filtered(ipaddr, filter, arg);
   if(r != NULL) {
     PRINTF("uip_ds6_route_add: old route already found, updating this one instead: ");
     PRINT6ADDR(ipaddr);
@@ -314,6 +332,9 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
         return NULL;
       }
       LIST_STRUCT_INIT(routes, route_list);
+      /* Keep the next hop in the neighbor tables for as long as routes
+         go through it. */
+      nbr_table_lock(nbr_routes, routes);
     }
 
     /* Allocate a routing entry and populate it. */
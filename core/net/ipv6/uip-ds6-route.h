@@ -142,11 +142,25 @@ void uip_ds6_defrt_periodic(void);
 /** @} */
 
 
+/** \brief A route filter returns non-zero for the routes that a
+    lookup may consider. It lets a routing protocol keep several
+    independent sets of routes, one per topology, in the same table. */
+typedef int (* uip_ds6_route_filter_t)(const uip_ds6_route_t *route,
+                                       const void *arg);
+
 /** \name Routing Table basic routines */
 /** @{ */
 uip_ds6_route_t *uip_ds6_route_lookup(uip_ipaddr_t *destipaddr);
 uip_ds6_route_t *uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
                                    uip_ipaddr_t *next_hop);
+uip_ds6_route_t *uip_ds6_route_lookup_filtered(uip_ipaddr_t *destipaddr,
+                                               uip_ds6_route_filter_t filter,
+                                               const void *arg);
+uip_ds6_route_t *uip_ds6_route_add_filtered(uip_ipaddr_t *ipaddr,
+                                            uint8_t length,
+                                            uip_ipaddr_t *next_hop,
+                                            uip_ds6_route_filter_t filter,
+                                            const void *arg);
 void uip_ds6_route_rm(uip_ds6_route_t *route);
 void uip_ds6_route_rm_by_nexthop(uip_ipaddr_t *nexthop);
 
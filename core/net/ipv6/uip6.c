@@ -1527,6 +1527,10 @@ uip_process(uint8_t flag)
     goto drop;
   }
   uip_len = uip_slen + UIP_IPUDPH_LEN;
+  /* The headers are built from scratch, without extension headers. An
+     RPL option that was added to the previous packet must not move the
+     UDP header of this one. */
+  uip_ext_len = 0;
 
   /* For IPv6, the IP length field does not include the IPv6 IP header
      length. */
@@ -1547,10 +1551,6 @@ uip_process(uint8_t flag)
 
   uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_IPTCPH_LEN];
 
-#if UIP_CONF_IPV6_RPL
-  rpl_insert_header();
-#endif /* UIP_CONF_IPV6_RPL */
-
 #if UIP_UDP_CHECKSUMS
   /* Calculate UDP checksum. */
   UIP_UDP_BUF->udpchksum = ~(uip_udpchksum());
@@ -1558,6 +1558,12 @@ uip_process(uint8_t flag)
     UIP_UDP_BUF->udpchksum = 0xffff;
   }
 #endif /* UIP_UDP_CHECKSUMS */
+
+#if UIP_CONF_IPV6_RPL
+  /* The RPL option is not covered by the checksum, and inserting it
+     moves the UDP header. */
+  rpl_insert_header();
+#endif /* UIP_CONF_IPV6_RPL */
   UIP_STAT(++uip_stat.udp.sent);
   goto ip_send_nolen;
 #endif /* UIP_UDP */
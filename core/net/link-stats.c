@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Link statistics of the neighbors
+ */
+
+#include "contiki.h"
+#include "net/link-stats.h"
+#include "net/mac/mac.h"
+#include "net/nbr-table.h"
+#include "net/packetbuf.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/* The upper bound of the count of recent transmissions. */
+#define FRESHNESS_MAX 16
+
+NBR_TABLE(struct link_stats, link_stats);
+
+static struct ctimer periodic_timer;
+
+/*---------------------------------------------------------------------------*/
+static struct link_stats *
+add(const linkaddr_t *lladdr)
+{
+  struct link_stats *stats;
+
+  stats = nbr_table_get_from_lladdr(link_stats, lladdr);
+  if(stats == NULL) {
+    stats = nbr_table_add_lladdr(link_stats, lladdr);
+    if(stats != NULL) {
+      stats->etx = LINK_STATS_INIT_ETX * LINK_STATS_ETX_DIVISOR;
+      stats->rssi = LINK_STATS_RSSI_UNKNOWN;
+    }
+  }
+  return stats;
+}
+/*---------------------------------------------------------------------------*/
+const struct link_stats *
+link_stats_from_lladdr(const linkaddr_t *lladdr)
+{
+  return nbr_table_get_from_lladdr(link_stats, lladdr);
+}
+/*---------------------------------------------------------------------------*/
+int
+link_stats_is_fresh(const struct link_stats *stats)
+{
+  return stats != NULL &&
+    stats->freshness >= LINK_STATS_FRESHNESS_TARGET &&
+    clock_time() - stats->last_tx_time < LINK_STATS_FRESHNESS_EXPIRATION;
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx)
+{
+  struct link_stats *stats;
+  uint16_t packet_etx;
+
+  /* Collisions and transmission errors say nothing about the link. */
+  if(status != MAC_TX_OK && status != MAC_TX_NOACK) {
+    return;
+  }
+  if(lladdr == NULL || linkaddr_cmp(lladdr, &linkaddr_null) || numtx <= 0) {
+    return;
+  }
+
+  stats = add(lladdr);
+  if(stats == NULL) {
+    return;
+  }
+
+  if(status == MAC_TX_NOACK || numtx > LINK_STATS_NOACK_ETX) {
+    packet_etx = LINK_STATS_NOACK_ETX * LINK_STATS_ETX_DIVISOR;
+  } else {
+    packet_etx = numtx * LINK_STATS_ETX_DIVISOR;
+  }
+
+  stats->etx = ((uint32_t)stats->etx * LINK_STATS_ETX_ALPHA +
+                (uint32_t)packet_etx * (100 - LINK_STATS_ETX_ALPHA)) / 100;
+  stats->last_tx_time = clock_time();
+  if(stats->freshness < FRESHNESS_MAX) {
+    stats->freshness++;
+  }
+
+  PRINTF("link-stats: %d.%d ETX %u (packet %u)\n",
+         lladdr->u8[0], lladdr->u8[1],
+         (unsigned)stats->etx, (unsigned)packet_etx);
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_input_callback(const linkaddr_t *lladdr)
+{
+  struct link_stats *stats;
+  int16_t packet_rssi;
+
+  if(lladdr == NULL || linkaddr_cmp(lladdr, &linkaddr_null)) {
+    return;
+  }
+
+  stats = add(lladdr);
+  if(stats == NULL) {
+    return;
+  }
+
+  packet_rssi = (int16_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+  if(stats->rssi == LINK_STATS_RSSI_UNKNOWN) {
+    stats->rssi = packet_rssi;
+  } else {
+    stats->rssi = ((int32_t)stats->rssi * LINK_STATS_RSSI_ALPHA +
+                   (int32_t)packet_rssi * (100 - LINK_STATS_RSSI_ALPHA)) / 100;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+periodic(void *ptr)
+{
+  struct link_stats *stats;
+
+  /* Let the count of recent transmissions decay. */
+  for(stats = nbr_table_head(link_stats);
+      stats != NULL;
+      stats = nbr_table_next(link_stats, stats)) {
+    stats->freshness >>= 1;
+  }
+  ctimer_reset(&periodic_timer);
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_init(void)
+{
+  static uint8_t initialized;
+
+  /* A second registration would take another neighbor table. */
+  if(initialized) {
+    return;
+  }
+  initialized = 1;
+
+  nbr_table_register_cache(link_stats, NULL);
+  ctimer_set(&periodic_timer, LINK_STATS_FRESHNESS_HALF_LIFE, periodic, NULL);
+}
+/*---------------------------------------------------------------------------*/
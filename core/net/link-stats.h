@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Link statistics of the neighbors
+ *
+ *         The link statistics module keeps an estimate of the number of
+ *         transmissions (ETX) and of the received signal strength of
+ *         each neighbor, in a neighbor table that is shared by the
+ *         routing protocols. The network layer updates the statistics
+ *         when the MAC layer reports the outcome of a unicast
+ *         transmission, and when a packet is received.
+ */
+
+#ifndef LINK_STATS_H_
+#define LINK_STATS_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+/* The fixed-point unit of the ETX estimates. */
+#define LINK_STATS_ETX_DIVISOR 128
+
+/* The ETX of a neighbor before any unicast transmission to it. */
+#ifdef LINK_STATS_CONF_INIT_ETX
+#define LINK_STATS_INIT_ETX LINK_STATS_CONF_INIT_ETX
+#else /* LINK_STATS_CONF_INIT_ETX */
+#define LINK_STATS_INIT_ETX 2
+#endif /* LINK_STATS_CONF_INIT_ETX */
+
+/* The ETX that a transmission without an acknowledgement counts as. */
+#ifdef LINK_STATS_CONF_NOACK_ETX
+#define LINK_STATS_NOACK_ETX LINK_STATS_CONF_NOACK_ETX
+#else /* LINK_STATS_CONF_NOACK_ETX */
+#define LINK_STATS_NOACK_ETX 10
+#endif /* LINK_STATS_CONF_NOACK_ETX */
+
+/* The weights, in percent, of the previous ETX and RSSI estimates in
+   the exponentially weighted moving averages. */
+#ifdef LINK_STATS_CONF_ETX_ALPHA
+#define LINK_STATS_ETX_ALPHA LINK_STATS_CONF_ETX_ALPHA
+#else /* LINK_STATS_CONF_ETX_ALPHA */
+#define LINK_STATS_ETX_ALPHA 90
+#endif /* LINK_STATS_CONF_ETX_ALPHA */
+
+#ifdef LINK_STATS_CONF_RSSI_ALPHA
+#define LINK_STATS_RSSI_ALPHA LINK_STATS_CONF_RSSI_ALPHA
+#else /* LINK_STATS_CONF_RSSI_ALPHA */
+#define LINK_STATS_RSSI_ALPHA 80
+#endif /* LINK_STATS_CONF_RSSI_ALPHA */
+
+/* The number of recent transmissions that make an ETX estimate fresh,
+   and the time after which an estimate is stale regardless. */
+#ifdef LINK_STATS_CONF_FRESHNESS_TARGET
+#define LINK_STATS_FRESHNESS_TARGET LINK_STATS_CONF_FRESHNESS_TARGET
+#else /* LINK_STATS_CONF_FRESHNESS_TARGET */
+#define LINK_STATS_FRESHNESS_TARGET 4
+#endif /* LINK_STATS_CONF_FRESHNESS_TARGET */
+
+#ifdef LINK_STATS_CONF_FRESHNESS_EXPIRATION
+#define LINK_STATS_FRESHNESS_EXPIRATION LINK_STATS_CONF_FRESHNESS_EXPIRATION
+#else /* LINK_STATS_CONF_FRESHNESS_EXPIRATION */
+#define LINK_STATS_FRESHNESS_EXPIRATION (10 * 60 * (clock_time_t)CLOCK_SECOND)
+#endif /* LINK_STATS_CONF_FRESHNESS_EXPIRATION */
+
+/* The interval at which the count of recent transmissions is halved. */
+#ifdef LINK_STATS_CONF_FRESHNESS_HALF_LIFE
+#define LINK_STATS_FRESHNESS_HALF_LIFE LINK_STATS_CONF_FRESHNESS_HALF_LIFE
+#else /* LINK_STATS_CONF_FRESHNESS_HALF_LIFE */
+#define LINK_STATS_FRESHNESS_HALF_LIFE (20 * 60 * (clock_time_t)CLOCK_SECOND)
+#endif /* LINK_STATS_CONF_FRESHNESS_HALF_LIFE */
+
+/* The RSSI of a neighbor from which no packet has been received. */
+#define LINK_STATS_RSSI_UNKNOWN -32768
+
+struct link_stats {
+  clock_time_t last_tx_time;
+  uint16_t etx;         /* ETX, in units of 1/LINK_STATS_ETX_DIVISOR */
+  int16_t rssi;         /* RSSI of received packets */
+  uint8_t freshness;    /* number of recent transmissions */
+};
+
+/**
+ * \brief      Initialize the link statistics
+ *
+ *             This function registers the neighbor table of the link
+ *             statistics as a cache: a new neighbor never displaces one
+ *             that the routing protocols keep in their own tables. It
+ *             is called by the network layer.
+ */
+void link_stats_init(void);
+
+/**
+ * \brief      Get the link statistics of a neighbor
+ * \param lladdr The link-layer address of the neighbor
+ * \return     The statistics, or NULL if the neighbor is unknown
+ */
+const struct link_stats *link_stats_from_lladdr(const linkaddr_t *lladdr);
+
+/**
+ * \brief      Tell whether the ETX estimate of a neighbor is fresh
+ * \return     Non-zero if enough transmissions to the neighbor have
+ *             been made recently, zero otherwise
+ */
+int link_stats_is_fresh(const struct link_stats *stats);
+
+/**
+ * \brief      Update the statistics after a unicast transmission
+ * \param lladdr The link-layer address of the receiver
+ * \param status The MAC status of the transmission
+ * \param numtx The number of transmissions that were made
+ */
+void link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx);
+
+/**
+ * \brief      Update the statistics after a packet has been received
+ * \param lladdr The link-layer address of the sender
+ *
+ *             This function reads the RSSI of the packet from the
+ *             packet buffer attributes.
+ */
+void link_stats_input_callback(const linkaddr_t *lladdr);
+
+#endif /* LINK_STATS_H_ */
@@ -68,6 +68,13 @@
 #else
 #define WITH_CONTIKIMAC_HEADER       1
 #endif
+/* Send all frames that the MAC layer has queued for a neighbor in one
+   burst, with FRAME_PENDING set, once the neighbor is awake */
+#ifdef CONTIKIMAC_CONF_WITH_BURST
+#define WITH_BURST                   CONTIKIMAC_CONF_WITH_BURST
+#else
+#define WITH_BURST                   1
+#endif
 /* More aggressive radio sleeping when channel is busy with other traffic */
 #ifndef WITH_FAST_SLEEP
 #define WITH_FAST_SLEEP              1
@@ -191,6 +198,11 @@ static int we_are_receiving_burst = 0;
    a transmitted should begin transmitting packets. */
 #define GUARD_TIME                         10 * CHECK_TIME + CHECK_TIME_TX
 
+/* MIN_GUARD_TIME is the shortest guard time, used for neighbors whose
+   phase has been predicted accurately. The phase module adds a margin
+   that follows the error of the predictions. */
+#define MIN_GUARD_TIME                     2 * CHECK_TIME + CHECK_TIME_TX
+
 /* INTER_PACKET_INTERVAL is the interval between two successive packet transmissions */
 #ifdef CONTIKIMAC_CONF_INTER_PACKET_INTERVAL
 #define INTER_PACKET_INTERVAL              CONTIKIMAC_CONF_INTER_PACKET_INTERVAL
@@ -208,7 +220,8 @@ static int we_are_receiving_burst = 0;
 #endif
 
 /* MAX_PHASE_STROBE_TIME is the time that we transmit repeated packets
-   to a neighbor for which we have a phase lock. */
+   to a neighbor for which we have a phase lock, or which is awake
+   because it is receiving a burst from us. */
 #define MAX_PHASE_STROBE_TIME              RTIMER_ARCH_SECOND / 60
 
 
@@ -238,6 +251,10 @@ static volatile uint8_t contikimac_keep_radio_on = 0;
 static volatile unsigned char we_are_sending = 0;
 static volatile unsigned char radio_is_on = 0;
 
+#if CONTIKIMAC_CONF_STATS
+struct contikimac_stats contikimac_stats;
+#endif /* CONTIKIMAC_CONF_STATS */
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -641,7 +658,7 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   if(!is_broadcast && !is_receiver_awake) {
 #if WITH_PHASE_OPTIMIZATION
     ret = phase_wait(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
-                     CYCLE_TIME, GUARD_TIME,
+                     CYCLE_TIME, GUARD_TIME, MIN_GUARD_TIME,
                      mac_callback, mac_callback_ptr, buf_list);
     if(ret == PHASE_DEFERRED) {
       return MAC_TX_DEFERRED;
@@ -671,8 +688,11 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   }
   
   /* Switch off the radio to ensure that we didn't start sending while
-     the radio was doing a channel check. */
-  off();
+     the radio was doing a channel check. Within a burst, the radio
+     is kept on between the frames. */
+  if(!is_receiver_awake) {
+    off();
+  }
 
 
   strobes = 0;
@@ -737,13 +757,15 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
 
     watchdog_periodic();
 
+    if(!is_broadcast && (is_receiver_awake
 #if WITH_PHASE_OPTIMIZATION
-    if(!is_broadcast && (is_receiver_awake || is_known_receiver) &&
+                         || is_known_receiver
+#endif /* WITH_PHASE_OPTIMIZATION */
+                         ) &&
        !RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + MAX_PHASE_STROBE_TIME)) {
       PRINTF("miss to %d\n", packetbuf_addr(PACKETBUF_ADDR_RECEIVER)->u8[0]);
       break;
     }
-#endif /* WITH_PHASE_OPTIMIZATION */
 
     len = 0;
 
@@ -797,7 +819,13 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
     }
   }
 
-  off();
+  /* If the receiver acknowledged a frame with FRAME_PENDING set, it
+     stays awake for the next frame of the burst, so we keep the radio
+     on for it as well. qsend_list() turns it off after the burst. */
+  if(!got_strobe_ack || is_broadcast ||
+     !packetbuf_attr(PACKETBUF_ATTR_PENDING)) {
+    off();
+  }
 
   PRINTF("contikimac: send (strobes=%u, len=%u, %s, %s), done\n", strobes,
          packetbuf_totlen(),
@@ -833,6 +861,24 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
     ret = MAC_TX_OK;
   }
 
+  if(!is_broadcast && is_receiver_awake && collisions == 0) {
+    CONTIKIMAC_STATS_ADD(burst_tx, 1);
+    CONTIKIMAC_STATS_ADD(burst_strobes, strobes + got_strobe_ack);
+  } else if(!is_broadcast && collisions == 0) {
+    /* The loop leaves strobes one short when it ends on an ACK. */
+#if WITH_PHASE_OPTIMIZATION
+    if(is_known_receiver) {
+      CONTIKIMAC_STATS_ADD(phase_tx, 1);
+      CONTIKIMAC_STATS_ADD(phase_strobes, strobes + got_strobe_ack);
+      CONTIKIMAC_STATS_ADD(phase_misses, !got_strobe_ack);
+    } else
+#endif /* WITH_PHASE_OPTIMIZATION */
+    {
+      CONTIKIMAC_STATS_ADD(tx, 1);
+      CONTIKIMAC_STATS_ADD(strobes, strobes + got_strobe_ack);
+    }
+  }
+
 #if WITH_PHASE_OPTIMIZATION
   if(is_known_receiver && got_strobe_ack) {
     PRINTF("no miss %d wake-ups %d\n",
@@ -843,7 +889,7 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   if(!is_broadcast) {
     if(collisions == 0 && is_receiver_awake == 0) {
       phase_update(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
-		   encounter_time, ret);
+		   encounter_time, CYCLE_TIME, ret);
     }
   }
 #endif /* WITH_PHASE_OPTIMIZATION */
@@ -884,11 +930,16 @@ qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
   do { /* A loop sending a burst of packets from buf_list */
     next = list_item_next(curr);
 
-    /* Prepare the packetbuf */
+#if !WITH_BURST
+    /* Leave the rest of the list to the MAC layer, which hands it
+       back to us one frame at a time */
+    next = NULL;
+#endif /* !WITH_BURST */
+
+    /* Prepare the packetbuf. The pending flag is always set here, as
+       the queuebuf may hold the flag of an earlier, aborted burst. */
     queuebuf_to_packetbuf(curr->buf);
-    if(next != NULL) {
-      packetbuf_set_attr(PACKETBUF_ATTR_PENDING, 1);
-    }
+    packetbuf_set_attr(PACKETBUF_ATTR_PENDING, next != NULL);
 
     /* Send the current packet */
     ret = send_packet(sent, ptr, curr, is_receiver_awake);
@@ -907,6 +958,10 @@ qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
       next = NULL;
     }
   } while(next != NULL);
+
+  if(is_receiver_awake) {
+    off();
+  }
 }
 /*---------------------------------------------------------------------------*/
 /* Timer callback triggered when receiving a burst, after having
@@ -1011,6 +1066,8 @@ init(void)
 
   contikimac_is_on = 1;
 
+  mac_sequence_init();
+
 #if WITH_PHASE_OPTIMIZATION
   phase_init();
 #endif /* WITH_PHASE_OPTIMIZATION */
@@ -46,4 +46,28 @@
 
 extern const struct rdc_driver contikimac_driver;
 
+/* Strobe statistics of the unicast transmissions to sleeping
+   receivers. Dividing the strobes by the packets gives the number of
+   strobes per packet, which is what the phase optimization cuts. */
+struct contikimac_stats {
+  /* Transmissions to receivers with an unknown phase. */
+  unsigned long tx, strobes;
+  /* Transmissions to receivers with a known phase, and how many of
+     them missed the receiver. */
+  unsigned long phase_tx, phase_strobes, phase_misses;
+  /* Frames that followed the first one of a burst. */
+  unsigned long burst_tx, burst_strobes;
+};
+
+#if CONTIKIMAC_CONF_STATS
+/* Don't access this variable directly, use CONTIKIMAC_STATS_GET */
+extern struct contikimac_stats contikimac_stats;
+
+#define CONTIKIMAC_STATS_ADD(x, n) contikimac_stats.x += (n)
+#define CONTIKIMAC_STATS_GET(x) contikimac_stats.x
+#else /* CONTIKIMAC_CONF_STATS */
+#define CONTIKIMAC_STATS_ADD(x, n)
+#define CONTIKIMAC_STATS_GET(x) 0UL
+#endif /* CONTIKIMAC_CONF_STATS */
+
 #endif /* CONTIKIMAC_H */
@@ -164,7 +164,7 @@ transmit_packet_list(void *ptr)
 }
 /*---------------------------------------------------------------------------*/
 static void
-free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
+free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
 {
   if(p != NULL) {
     /* Remove packet from list and deallocate */
@@ -180,8 +180,14 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
       n->transmissions = 0;
       n->collisions = 0;
       n->deferrals = 0;
-      /* Set a timer for next transmissions */
-      ctimer_set(&n->transmit_timer, default_timebase(),
+      /* Set a timer for next transmissions. After a successful
+         transmission, the rest of the queue is handed to the RDC
+         layer right away, so that it can send it as a burst while the
+         neighbor is known to be reachable. A burst that is in
+         progress sends the next packets before the timer fires, and
+         then stops or resets the timer. */
+      ctimer_set(&n->transmit_timer,
+                 status == MAC_TX_OK ? 0 : default_timebase(),
                  transmit_packet_list, n);
     } else {
       /* This was the last packet in the queue, we free the neighbor */
@@ -286,7 +292,7 @@ packet_sent(void *ptr, int status, int num_transmissions)
         } else {
           PRINTF("csma: drop with status %d after %d transmissions, %d collisions\n",
                  status, n->transmissions, n->collisions);
-          free_packet(n, q);
+          free_packet(n, q, status);
           mac_call_sent_callback(sent, cptr, status, num_tx);
         }
       } else {
@@ -295,7 +301,7 @@ packet_sent(void *ptr, int status, int num_transmissions)
         } else {
           PRINTF("csma: rexmit failed %d: %d\n", n->transmissions, status);
         }
-        free_packet(n, q);
+        free_packet(n, q, status);
         mac_call_sent_callback(sent, cptr, status, num_tx);
       }
     }
@@ -53,6 +53,43 @@
 #define PRINTADDR(addr)
 #endif
 
+/* The number of destinations for which the frame header is kept as a
+   template. create() copies the template and only patches it with the
+   sequence number and the frame pending and ACK request bits. On native,
+   this is no faster than building the header, and it has not been
+   measured on the targets, so templates are off by default. */
+#ifdef FRAMER_802154_CONF_TEMPLATES
+#define FRAMER_802154_TEMPLATES FRAMER_802154_CONF_TEMPLATES
+#else
+#define FRAMER_802154_TEMPLATES 0
+#endif
+
+/* The longest header that create() makes: FCF, sequence number, PAN
+   IDs and two long addresses. */
+#define MAX_HDRLEN            (3 + 2 + 8 + 2 + 8)
+
+/* Bits of the first byte of the FCF */
+#define FCF0_TYPE_MASK        0x07
+#define FCF0_SECURITY         0x08
+#define FCF0_FRAME_PENDING    0x10
+#define FCF0_ACK_REQUIRED     0x20
+#define FCF0_PANID_COMP       0x40
+
+struct header_template {
+  linkaddr_t dest;
+  uint8_t len;
+  uint8_t used;
+  uint8_t hdr[MAX_HDRLEN];
+};
+
+#if FRAMER_802154_TEMPLATES > 0
+static struct header_template templates[FRAMER_802154_TEMPLATES];
+static uint8_t template_count;
+static uint8_t template_hand;
+/* The node address that the templates were made with. */
+static linkaddr_t template_src;
+#endif /* FRAMER_802154_TEMPLATES > 0 */
+
 /**  \brief The sequence number (0x00 - 0xff) added to the transmitted
  *   data or MAC command frame. The default is a random value within
  *   the range.
@@ -77,6 +114,9 @@ static uint16_t mac_src_pan_id = IEEE802154_PANID;
 void framer_802154_set_panid(uint16_t panid){
         mac_dst_pan_id = panid;
         mac_src_pan_id = panid;
+#if FRAMER_802154_TEMPLATES > 0
+        template_count = 0;
+#endif /* FRAMER_802154_TEMPLATES > 0 */
 }
 /*---------------------------------------------------------------------------*/
 uint16_t framer_802154_get_panid(){
@@ -96,43 +136,23 @@ is_broadcast_addr(uint8_t mode, uint8_t *addr)
   return 1;
 }
 /*---------------------------------------------------------------------------*/
-static int
-create(void)
+static void
+build_template(struct header_template *t, const linkaddr_t *dest)
 {
   frame802154_t params;
-  int len;
 
   /* init to zeros */
   memset(&params, 0, sizeof(params));
 
-  if(!initialized) {
-    initialized = 1;
-    mac_dsn = random_rand() & 0xff;
-  }
-
-  /* Build the FCF. */
+  /* Build the FCF. The frame pending and ACK request bits and the
+     sequence number are set for each frame in create(). */
   params.fcf.frame_type = FRAME802154_DATAFRAME;
   params.fcf.security_enabled = 0;
-  params.fcf.frame_pending = packetbuf_attr(PACKETBUF_ATTR_PENDING);
-  if(linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null)) {
-    params.fcf.ack_required = 0;
-  } else {
-    params.fcf.ack_required = packetbuf_attr(PACKETBUF_ATTR_MAC_ACK);
-  }
   params.fcf.panid_compression = 0;
 
   /* Insert IEEE 802.15.4 (2003) version bit. */
   params.fcf.frame_version = FRAME802154_IEEE802154_2003;
 
-  /* Increment and set the data sequence number. */
-  if(packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO)) {
-    params.seq = packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO);
-  } else {
-    params.seq = mac_dsn++;
-    packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, params.seq);
-  }
-/*   params.seq = packetbuf_attr(PACKETBUF_ATTR_PACKET_ID); */
-
   /* Complete the addressing fields. */
   /**
      \todo For phase 1 the addresses are all long. We'll need a mechanism
@@ -150,15 +170,14 @@ create(void)
    *  If the output address is NULL in the Rime buf, then it is broadcast
    *  on the 802.15.4 network.
    */
-  if(linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null)) {
+  if(linkaddr_cmp(dest, &linkaddr_null)) {
     /* Broadcast requires short address mode. */
     params.fcf.dest_addr_mode = FRAME802154_SHORTADDRMODE;
     params.dest_addr[0] = 0xFF;
     params.dest_addr[1] = 0xFF;
 
   } else {
-    linkaddr_copy((linkaddr_t *)&params.dest_addr,
-                  packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+    linkaddr_copy((linkaddr_t *)&params.dest_addr, dest);
     /* Use short address mode if linkaddr size is small */
     if(sizeof(linkaddr_t) == 2) {
       params.fcf.dest_addr_mode = FRAME802154_SHORTADDRMODE;
@@ -176,20 +195,183 @@ create(void)
    */
   linkaddr_copy((linkaddr_t *)&params.src_addr, &linkaddr_node_addr);
 
-  params.payload = packetbuf_dataptr();
-  params.payload_len = packetbuf_datalen();
-  len = frame802154_hdrlen(&params);
-  if(packetbuf_hdralloc(len)) {
-    frame802154_create(&params, packetbuf_hdrptr(), len);
+  linkaddr_copy(&t->dest, dest);
+  t->len = frame802154_create(&params, t->hdr, sizeof(t->hdr));
+}
+/*---------------------------------------------------------------------------*/
+static const struct header_template *
+get_template(const linkaddr_t *dest, struct header_template *scratch)
+{
+#if FRAMER_802154_TEMPLATES > 0
+  struct header_template *t;
+  uint8_t i;
+
+  if(!linkaddr_cmp(&template_src, &linkaddr_node_addr)) {
+    /* The node address has changed since the templates were made. */
+    linkaddr_copy(&template_src, &linkaddr_node_addr);
+    template_count = 0;
+  }
 
-    PRINTF("15.4-OUT: %2X", params.fcf.frame_type);
-    PRINTADDR(params.dest_addr);
-    PRINTF("%d %u (%u)\n", len, packetbuf_datalen(), packetbuf_totlen());
-    return len;
+  for(i = 0; i < template_count; i++) {
+    if(linkaddr_cmp(&templates[i].dest, dest)) {
+      templates[i].used = 1;
+      return &templates[i];
+    }
+  }
+
+  if(template_count < FRAMER_802154_TEMPLATES) {
+    t = &templates[template_count++];
   } else {
-    PRINTF("15.4-OUT: too large header: %u\n", len);
+    /* Replace the next template that has not been used since we last
+       passed it, so that the destinations that we send to most often,
+       such as the parent and broadcast, keep their templates. */
+    while(templates[template_hand].used) {
+      templates[template_hand].used = 0;
+      template_hand = (template_hand + 1) % FRAMER_802154_TEMPLATES;
+    }
+    t = &templates[template_hand];
+    template_hand = (template_hand + 1) % FRAMER_802154_TEMPLATES;
+  }
+  t->used = 0;
+  build_template(t, dest);
+  return t;
+#else /* FRAMER_802154_TEMPLATES > 0 */
+  build_template(scratch, dest);
+  return scratch;
+#endif /* FRAMER_802154_TEMPLATES > 0 */
+}
+/*---------------------------------------------------------------------------*/
+static int
+create(void)
+{
+  struct header_template scratch;
+  const struct header_template *t;
+  const linkaddr_t *dest;
+  uint8_t *hdr;
+  uint8_t seq;
+  uint8_t i;
+
+  if(!initialized) {
+    initialized = 1;
+    mac_dsn = random_rand() & 0xff;
+  }
+
+  /* Increment and set the data sequence number. */
+  if(packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO)) {
+    seq = packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO);
+  } else {
+    seq = mac_dsn++;
+    packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, seq);
+  }
+/*   params.seq = packetbuf_attr(PACKETBUF_ATTR_PACKET_ID); */
+
+  dest = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+  t = get_template(dest, &scratch);
+
+  if(packetbuf_hdralloc(t->len)) {
+    hdr = packetbuf_hdrptr();
+    /* The header is short, so copy it bytewise rather than have the
+       compiler set up a block move. */
+    for(i = 0; i < t->len; i++) {
+      hdr[i] = t->hdr[i];
+    }
+    if(packetbuf_attr(PACKETBUF_ATTR_PENDING) & 1) {
+      hdr[0] |= FCF0_FRAME_PENDING;
+    }
+    if(!linkaddr_cmp(dest, &linkaddr_null) &&
+       (packetbuf_attr(PACKETBUF_ATTR_MAC_ACK) & 1)) {
+      hdr[0] |= FCF0_ACK_REQUIRED;
+    }
+    hdr[2] = seq;
+
+    PRINTF("15.4-OUT: %2X", hdr[0] & FCF0_TYPE_MASK);
+    PRINTADDR(&t->dest);
+    PRINTF("%d %u (%u)\n", t->len, packetbuf_datalen(), packetbuf_totlen());
+    return t->len;
+  } else {
+    PRINTF("15.4-OUT: too large header: %u\n", t->len);
+    return FRAMER_FAILED;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Copy an address from a frame into the byte order of frame802154_t. */
+static void
+copy_addr(uint8_t *addr, const uint8_t *p, uint8_t mode)
+{
+  int c;
+
+  if(mode == FRAME802154_SHORTADDRMODE) {
+    linkaddr_copy((linkaddr_t *)addr, &linkaddr_null);
+    addr[0] = p[1];
+    addr[1] = p[0];
+  } else {
+    for(c = 0; c < 8; c++) {
+      addr[c] = p[7 - c];
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Parse the data frames that we send, without security and with PAN ID
+ * compression and two short or long addresses, without going through
+ * frame802154_t. Returns the header length, zero if the frame has some
+ * other shape, or FRAMER_FAILED.
+ */
+static int
+parse_data_frame(uint8_t *data, int len)
+{
+  uint8_t dest_addr[8];
+  uint8_t src_addr[8];
+  uint8_t dest_mode, src_mode;
+  uint16_t dest_pid;
+  int hdrlen;
+
+  if(len < 3 ||
+     (data[0] & (FCF0_TYPE_MASK | FCF0_SECURITY | FCF0_PANID_COMP)) !=
+     (FRAME802154_DATAFRAME | FCF0_PANID_COMP)) {
+    return 0;
+  }
+  dest_mode = (data[1] >> 2) & 3;
+  src_mode = (data[1] >> 6) & 3;
+  if(dest_mode < FRAME802154_SHORTADDRMODE ||
+     src_mode < FRAME802154_SHORTADDRMODE) {
+    return 0;
+  }
+
+  hdrlen = 5 + (dest_mode == FRAME802154_SHORTADDRMODE ? 2 : 8) +
+    (src_mode == FRAME802154_SHORTADDRMODE ? 2 : 8);
+  if(hdrlen > len) {
+    return FRAMER_FAILED;
+  }
+
+  dest_pid = data[3] + (data[4] << 8);
+  if(dest_pid != mac_src_pan_id &&
+     dest_pid != FRAME802154_BROADCASTPANDID) {
+    /* Packet to another PAN */
+    PRINTF("15.4: for another pan %u\n", dest_pid);
+    return FRAMER_FAILED;
+  }
+
+  copy_addr(dest_addr, &data[5], dest_mode);
+  copy_addr(src_addr, &data[hdrlen - (src_mode == FRAME802154_SHORTADDRMODE ? 2 : 8)],
+            src_mode);
+
+  if(!packetbuf_hdrreduce(hdrlen)) {
     return FRAMER_FAILED;
   }
+  if(!is_broadcast_addr(dest_mode, dest_addr)) {
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, (linkaddr_t *)dest_addr);
+  }
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, (linkaddr_t *)src_addr);
+  packetbuf_set_attr(PACKETBUF_ATTR_PENDING, (data[0] >> 4) & 1);
+  packetbuf_set_attr(PACKETBUF_ATTR_PACKET_ID, data[2]);
+
+  PRINTF("15.4-IN: %2X", FRAME802154_DATAFRAME);
+  PRINTADDR(packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  PRINTADDR(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  PRINTF("%u (%u)\n", packetbuf_datalen(), len);
+
+  return hdrlen;
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -197,7 +379,14 @@ parse(void)
 {
   frame802154_t frame;
   int len;
+  int hdrlen;
+
   len = packetbuf_datalen();
+  hdrlen = parse_data_frame(packetbuf_dataptr(), len);
+  if(hdrlen != 0) {
+    return hdrlen;
+  }
+
   if(frame802154_parse(packetbuf_dataptr(), len, &frame) &&
      packetbuf_hdrreduce(len - frame.payload_len)) {
     if(frame.fcf.dest_addr_mode) {
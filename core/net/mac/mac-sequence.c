@@ -46,40 +46,93 @@
 
 #include "contiki-net.h"
 #include "net/mac/mac-sequence.h"
+#include "net/nbr-table.h"
 #include "net/packetbuf.h"
 #include "net/rime/rime.h"
 
-struct seqno {
-  linkaddr_t sender;
-  uint8_t seqno;
-};
-
+/*
+ * The number of recent sequence numbers that are remembered for each
+ * neighbor. A frame is a duplicate if its sequence number is among
+ * them, so frames that are retransmitted after other frames from the
+ * same sender are detected as well.
+ */
 #ifdef NETSTACK_CONF_MAC_SEQNO_HISTORY
 #define MAX_SEQNOS NETSTACK_CONF_MAC_SEQNO_HISTORY
 #else /* NETSTACK_CONF_MAC_SEQNO_HISTORY */
 #define MAX_SEQNOS 16
 #endif /* NETSTACK_CONF_MAC_SEQNO_HISTORY */
-static struct seqno received_seqnos[MAX_SEQNOS];
 
+#if MAX_SEQNOS <= 8
+typedef uint8_t seqno_window_t;
+#elif MAX_SEQNOS <= 16
+typedef uint16_t seqno_window_t;
+#elif MAX_SEQNOS <= 32
+typedef uint32_t seqno_window_t;
+#else
+#error "NETSTACK_CONF_MAC_SEQNO_HISTORY cannot be larger than 32"
+#endif
+
+/*
+ * Bit i of the window is set if the sequence number that is i less
+ * than the highest one received from the neighbor has been received.
+ */
+struct seqno {
+  seqno_window_t window;
+  uint8_t seqno;
+};
+
+NBR_TABLE(struct seqno, received_seqnos);
+
+/* The entry of the sender of the last checked packet. */
+static struct seqno *last_entry;
+
+static unsigned long duplicates;
+
+/*---------------------------------------------------------------------------*/
+static struct seqno *
+lookup(void)
+{
+  const linkaddr_t *sender;
+
+  sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  if(last_entry == NULL ||
+     !linkaddr_cmp(sender, nbr_table_get_lladdr(received_seqnos, last_entry))) {
+    last_entry = nbr_table_get_from_lladdr(received_seqnos, sender);
+  }
+  return last_entry;
+}
+/*---------------------------------------------------------------------------*/
+static void
+removed(struct seqno *entry)
+{
+  if(entry == last_entry) {
+    last_entry = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+mac_sequence_init(void)
+{
+  nbr_table_register_cache(received_seqnos, (nbr_table_callback *)removed);
+}
 /*---------------------------------------------------------------------------*/
 int
 mac_sequence_is_duplicate(void)
 {
-  int i;
+  struct seqno *entry;
+  uint8_t behind;
 
-  /*
-   * Check for duplicate packet by comparing the sequence number of the incoming
-   * packet with the last few ones we saw.
-   */
-  for(i = 0; i < MAX_SEQNOS; ++i) {
-    if(linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_SENDER),
-                    &received_seqnos[i].sender)) {
-      if(packetbuf_attr(PACKETBUF_ATTR_PACKET_ID) == received_seqnos[i].seqno) {
-        /* Duplicate packet. */
-        return 1;
-      }
-      break;
-    }
+  entry = lookup();
+  if(entry == NULL) {
+    return 0;
+  }
+
+  /* Sequence numbers more than half the number space behind the
+     highest one are treated as newer, after a wrap-around. */
+  behind = entry->seqno - (uint8_t)packetbuf_attr(PACKETBUF_ATTR_PACKET_ID);
+  if(behind < MAX_SEQNOS && (entry->window & ((seqno_window_t)1 << behind))) {
+    duplicates++;
+    return 1;
   }
   return 0;
 }
@@ -87,23 +140,38 @@ mac_sequence_is_duplicate(void)
 void
 mac_sequence_register_seqno(void)
 {
-  int i, j;
+  struct seqno *entry;
+  uint8_t seqno;
+  uint8_t ahead;
 
-  /* Locate possible previous sequence number for this address. */
-  for(i = 0; i < MAX_SEQNOS; ++i) {
-    if(linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_SENDER),
-                    &received_seqnos[i].sender)) {
-      i++;
-      break;
+  seqno = packetbuf_attr(PACKETBUF_ATTR_PACKET_ID);
+  entry = lookup();
+  if(entry == NULL) {
+    entry = nbr_table_add_lladdr(received_seqnos,
+                                 packetbuf_addr(PACKETBUF_ADDR_SENDER));
+    if(entry == NULL) {
+      return;
     }
+    last_entry = entry;
+    entry->seqno = seqno;
+    entry->window = 1;
+    return;
   }
 
-  /* Keep the last sequence number for each address as per 802.15.4e. */
-  for(j = i - 1; j > 0; --j) {
-    memcpy(&received_seqnos[j], &received_seqnos[j - 1], sizeof(struct seqno));
+  ahead = seqno - entry->seqno;
+  if(ahead < 0x80) {
+    /* Slide the window forward to the new highest sequence number. */
+    entry->window = ahead < MAX_SEQNOS ? entry->window << ahead : 0;
+    entry->window |= 1;
+    entry->seqno = seqno;
+  } else if((uint8_t)-ahead < MAX_SEQNOS) {
+    entry->window |= (seqno_window_t)1 << (uint8_t)-ahead;
   }
-  received_seqnos[0].seqno = packetbuf_attr(PACKETBUF_ATTR_PACKET_ID);
-  linkaddr_copy(&received_seqnos[0].sender,
-                packetbuf_addr(PACKETBUF_ADDR_SENDER));
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+mac_sequence_get_duplicates(void)
+{
+  return duplicates;
 }
 /*---------------------------------------------------------------------------*/
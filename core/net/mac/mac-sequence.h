@@ -45,13 +45,24 @@
 #ifndef MAC_SEQUENCE_H
 #define MAC_SEQUENCE_H
 
+/**
+ * \brief      Initialize the sequence number history
+ *
+ *             This function registers the neighbor table that keeps the
+ *             recent sequence numbers of each neighbor. It must be called
+ *             by the RDC driver before any packet is received. The table
+ *             is a cache: a new sender never displaces a neighbor that
+ *             the network layer keeps in its own tables.
+ */
+void mac_sequence_init(void);
+
 /**
  * \brief      Tell whether the packetbuf is a duplicate packet
  * \return     Non-zero if the packetbuf is a duplicate packet, zero otherwise
  *
  *             This function is used to check for duplicate packet by comparing
  *             the sequence number of the incoming packet with the last few ones
- *             we saw, filtering with the Rime address.
+ *             we saw from the same sender.
  */
 int mac_sequence_is_duplicate(void);
 
@@ -63,4 +74,11 @@ int mac_sequence_is_duplicate(void);
  */
 void mac_sequence_register_seqno(void);
 
+/**
+ * \brief      Get the number of duplicate packets
+ * \return     The number of packets that mac_sequence_is_duplicate() has
+ *             reported as duplicates
+ */
+unsigned long mac_sequence_get_duplicates(void);
+
 #endif /* MAC_SEQUENCE_H */
@@ -359,6 +359,9 @@ channel_check_interval(void)
 static void
 init(void)
 {
+#if NULLRDC_802154_AUTOACK || NULLRDC_802154_AUTOACK_HW
+  mac_sequence_init();
+#endif /* NULLRDC_802154_AUTOACK || NULLRDC_802154_AUTOACK_HW */
   on();
 }
 /*---------------------------------------------------------------------------*/
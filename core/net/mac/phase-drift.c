@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Prediction of the phase of a neighbor from a linear fit to the
+ *         drift of its clock
+ */
+
+#include "net/mac/phase-drift.h"
+
+/* The longest time, in seconds, that a drift is extrapolated over. */
+#define MAX_EXTRAPOLATION     0x7fffUL
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+/*---------------------------------------------------------------------------*/
+/* Reduce a phase difference to the interval (-cycle_time/2, cycle_time/2]. */
+static int32_t
+phase_diff(rtimer_clock_t diff, rtimer_clock_t cycle_time)
+{
+  rtimer_clock_t r;
+
+  if(!(cycle_time & (cycle_time - 1))) {
+    r = diff & (cycle_time - 1);
+  } else {
+    r = diff % cycle_time;
+  }
+  if(r > cycle_time / 2) {
+    return (int32_t)r - (int32_t)cycle_time;
+  }
+  return r;
+}
+/*---------------------------------------------------------------------------*/
+/* The drift of the phase since the last observation, in ticks. */
+static int32_t
+drift_since(const struct phase_drift *d, unsigned long seconds)
+{
+  unsigned long dt;
+  uint32_t drift;
+  int32_t ticks;
+
+  dt = seconds - d->history[0].seconds;
+  if(dt > MAX_EXTRAPOLATION) {
+    dt = MAX_EXTRAPOLATION;
+  }
+  drift = d->drift < 0 ? -d->drift : d->drift;
+  /* Multiply the integer and fractional parts separately, so that
+     long periods do not overflow. */
+  ticks = (drift >> PHASE_DRIFT_SHIFT) * dt +
+    (((drift & ((1 << PHASE_DRIFT_SHIFT) - 1)) * dt +
+      (1 << (PHASE_DRIFT_SHIFT - 1))) >> PHASE_DRIFT_SHIFT);
+  return d->drift < 0 ? -ticks : ticks;
+}
+/*---------------------------------------------------------------------------*/
+/* Divide and round to the nearest integer. */
+static int32_t
+div_round(int32_t a, int32_t b)
+{
+  if((a < 0) != (b < 0)) {
+    return (a - b / 2) / b;
+  }
+  return (a + b / 2) / b;
+}
+/*---------------------------------------------------------------------------*/
+/* Fit a line to the observations with least squares, and move the
+   phase onto it. The sums are scaled by the number of observations
+   so that the means are never rounded. */
+static void
+fit_drift(struct phase_drift *d)
+{
+  int32_t x, sum_x, sum_y, sum_xx, sum_xy, sxx, sxy, q, r, intercept;
+  uint8_t i, n;
+
+  n = d->observations;
+  if(n < 2) {
+    return;
+  }
+
+  sum_x = sum_y = sum_xx = sum_xy = 0;
+  for(i = 0; i < n; i++) {
+    x = -(int32_t)(d->history[0].seconds - d->history[i].seconds);
+    sum_x += x;
+    sum_y += d->history[i].offset;
+    sum_xx += x * x;
+    sum_xy += x * d->history[i].offset;
+  }
+  sxx = n * sum_xx - sum_x * sum_x;
+  sxy = n * sum_xy - sum_x * sum_y;
+  if(sxx == 0) {
+    return;
+  }
+
+  /* Divide in two steps to keep the fixed-point scaling in range. */
+  q = sxy / sxx;
+  r = sxy % sxx;
+  d->drift = q * (1 << PHASE_DRIFT_SHIFT) +
+    div_round(r * (1 << PHASE_DRIFT_SHIFT), sxx);
+
+  intercept = div_round(sum_y -
+                        div_round(d->drift * sum_x, 1 << PHASE_DRIFT_SHIFT),
+                        n);
+  d->time += intercept;
+  for(i = 0; i < n; i++) {
+    d->history[i].offset -= intercept;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+phase_drift_init(struct phase_drift *d, rtimer_clock_t time,
+                 unsigned long seconds)
+{
+  d->time = time;
+  d->error = PHASE_DRIFT_ERROR_UNKNOWN;
+  d->drift = 0;
+  d->history[0].seconds = seconds;
+  d->history[0].offset = 0;
+  d->observations = 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+phase_drift_observe(struct phase_drift *d, rtimer_clock_t time,
+                    rtimer_clock_t cycle_time, unsigned long seconds)
+{
+  int32_t drift, err;
+  uint32_t abs_err;
+  uint8_t i, n;
+
+  drift = drift_since(d, seconds);
+  err = phase_diff(time - (rtimer_clock_t)(d->time + drift), cycle_time);
+  abs_err = err < 0 ? -err : err;
+
+  PRINTF("phase error %ld (drift %ld)\n", (long)err, (long)d->drift);
+
+  /* Smooth the error in fixed point, rounded to nearest. */
+  if(d->error == PHASE_DRIFT_ERROR_UNKNOWN) {
+    d->error = abs_err << PHASE_DRIFT_ERROR_SHIFT;
+  } else {
+    d->error = (d->error * 3 + (abs_err << PHASE_DRIFT_ERROR_SHIFT) + 2) / 4;
+  }
+
+  if(abs_err > cycle_time / 4) {
+    /* The neighbor has switched phase, so the old observations no
+       longer fit. The drift of its clock is kept. */
+    d->observations = 0;
+  }
+
+  /* Move the phase to the predicted one, and keep one observation
+     per second so that the history spans as long a time as possible. */
+  d->time += drift;
+  n = d->observations;
+  if(n == 0 || d->history[0].seconds != seconds) {
+    if(n == PHASE_HISTORY) {
+      n--;
+    }
+    for(i = n; i > 0; i--) {
+      d->history[i] = d->history[i - 1];
+      d->history[i].offset -= drift;
+    }
+    n++;
+  }
+  d->history[0].seconds = seconds;
+  d->history[0].offset = err;
+
+  for(i = 1; i < n; i++) {
+    if(seconds - d->history[i].seconds > PHASE_HISTORY_AGE) {
+      break;
+    }
+  }
+  d->observations = i;
+
+  if(d->observations == 1) {
+    d->time = time;
+    d->history[0].offset = 0;
+  } else {
+    fit_drift(d);
+  }
+}
+/*---------------------------------------------------------------------------*/
+rtimer_clock_t
+phase_drift_predict(const struct phase_drift *d, unsigned long seconds)
+{
+  return d->time + drift_since(d, seconds);
+}
+/*---------------------------------------------------------------------------*/
+rtimer_clock_t
+phase_drift_guard(const struct phase_drift *d, rtimer_clock_t guard_time,
+                  rtimer_clock_t min_guard_time)
+{
+  uint32_t guard;
+
+  if(d->observations < 2 || d->error == PHASE_DRIFT_ERROR_UNKNOWN) {
+    return guard_time;
+  }
+  guard = min_guard_time +
+    (((uint32_t)PHASE_GUARD_ERROR_FACTOR * d->error +
+      (1 << PHASE_DRIFT_ERROR_SHIFT) - 1) >> PHASE_DRIFT_ERROR_SHIFT);
+  return guard < guard_time ? guard : guard_time;
+}
+/*---------------------------------------------------------------------------*/
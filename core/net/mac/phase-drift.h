@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Prediction of the phase of a neighbor from a linear fit to the
+ *         drift of its clock
+ */
+
+#ifndef PHASE_DRIFT_H
+#define PHASE_DRIFT_H
+
+#include "contiki.h"
+#include "sys/rtimer.h"
+
+/* The number of recent phase observations of a neighbor that the
+   drift of its clock is fitted to. */
+#ifdef PHASE_CONF_HISTORY
+#define PHASE_HISTORY PHASE_CONF_HISTORY
+#else
+#define PHASE_HISTORY 4
+#endif
+
+/* Observations that are older than this, in seconds, are left out of
+   the fit. The fit is computed with 32-bit integers, so PHASE_HISTORY
+   times PHASE_HISTORY_AGE must stay below 5000. */
+#ifdef PHASE_CONF_HISTORY_AGE
+#define PHASE_HISTORY_AGE PHASE_CONF_HISTORY_AGE
+#else
+#define PHASE_HISTORY_AGE 600
+#endif
+
+/* The guard time of a neighbor is the minimum guard time plus this
+   many times the smoothed error of its phase predictions. */
+#ifdef PHASE_CONF_GUARD_ERROR_FACTOR
+#define PHASE_GUARD_ERROR_FACTOR PHASE_CONF_GUARD_ERROR_FACTOR
+#else
+#define PHASE_GUARD_ERROR_FACTOR 2
+#endif
+
+/* The drift is kept in 1/2^PHASE_DRIFT_SHIFT ticks per second. */
+#define PHASE_DRIFT_SHIFT         8
+
+/* The error is kept in 1/2^PHASE_DRIFT_ERROR_SHIFT ticks, so that
+   the smoothing does not round errors of a few ticks down to zero. */
+#define PHASE_DRIFT_ERROR_SHIFT   4
+#define PHASE_DRIFT_ERROR_UNKNOWN 0xffffffffUL
+
+struct phase_observation {
+  unsigned long seconds;
+  int32_t offset;
+};
+
+struct phase_drift {
+  /* The phase on the fitted line at the time of the last observation. */
+  rtimer_clock_t time;
+  /* The smoothed error of the predictions, in fixed point, or
+     PHASE_DRIFT_ERROR_UNKNOWN. */
+  uint32_t error;
+  /* The drift of the phase, in fixed point. */
+  int32_t drift;
+  /* The most recent observations first, with offsets relative to time. */
+  struct phase_observation history[PHASE_HISTORY];
+  uint8_t observations;
+};
+
+/**
+ * \brief      Start a prediction from a first observed phase
+ * \param d    The prediction
+ * \param time The observed phase
+ * \param seconds The time of the observation, from clock_seconds()
+ */
+void phase_drift_init(struct phase_drift *d, rtimer_clock_t time,
+                      unsigned long seconds);
+
+/**
+ * \brief      Add an observed phase and refit the drift
+ * \param d    The prediction
+ * \param time The observed phase
+ * \param cycle_time The wake-up interval of the neighbor
+ * \param seconds The time of the observation, from clock_seconds()
+ *
+ *             An observation that deviates from the prediction by more
+ *             than a quarter cycle clears the history, but the drift
+ *             estimate is kept.
+ */
+void phase_drift_observe(struct phase_drift *d, rtimer_clock_t time,
+                         rtimer_clock_t cycle_time, unsigned long seconds);
+
+/**
+ * \brief      Predict the phase at a given time
+ * \param d    The prediction
+ * \param seconds The time, from clock_seconds()
+ * \return     The predicted phase
+ */
+rtimer_clock_t phase_drift_predict(const struct phase_drift *d,
+                                   unsigned long seconds);
+
+/**
+ * \brief      The guard time before a predicted phase
+ * \param d    The prediction
+ * \param guard_time The guard time for an unknown error
+ * \param min_guard_time The shortest guard time
+ * \return     The guard time
+ *
+ *             Once the predictions have proven accurate, the guard
+ *             time follows their error, rounded up to whole ticks.
+ */
+rtimer_clock_t phase_drift_guard(const struct phase_drift *d,
+                                 rtimer_clock_t guard_time,
+                                 rtimer_clock_t min_guard_time);
+
+#endif /* PHASE_DRIFT_H */
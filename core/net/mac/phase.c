@@ -38,23 +38,15 @@
  */
 
 #include "net/mac/phase.h"
+#include "net/mac/phase-drift.h"
 #include "net/packetbuf.h"
 #include "sys/clock.h"
 #include "sys/ctimer.h"
 #include "net/queuebuf.h"
 #include "net/nbr-table.h"
 
-#if PHASE_CONF_DRIFT_CORRECT
-#define PHASE_DRIFT_CORRECT PHASE_CONF_DRIFT_CORRECT
-#else
-#define PHASE_DRIFT_CORRECT 0
-#endif
-
 struct phase {
-  rtimer_clock_t time;
-#if PHASE_DRIFT_CORRECT
-  rtimer_clock_t drift;
-#endif
+  struct phase_drift prediction;
   uint8_t noacks;
   struct timer noacks_timer;
 };
@@ -89,7 +81,7 @@ NBR_TABLE(struct phase, nbr_phase);
 /*---------------------------------------------------------------------------*/
 void
 phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
-             int mac_status)
+             rtimer_clock_t cycle_time, int mac_status)
 {
   struct phase *e;
 
@@ -97,16 +89,16 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
   e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
   if(e != NULL) {
     if(mac_status == MAC_TX_OK) {
-#if PHASE_DRIFT_CORRECT
-      e->drift = time-e->time;
-#endif
-      e->time = time;
+      phase_drift_observe(&e->prediction, time, cycle_time, clock_seconds());
     }
     /* If the neighbor didn't reply to us, it may have switched
-       phase (rebooted). We try a number of transmissions to it
+       phase (rebooted), or the prediction was too far off for the
+       guard time. We fall back to the full guard time until the
+       next observation, and try a number of transmissions to it
        before we drop it from the phase list. */
     if(mac_status == MAC_TX_NOACK) {
       PRINTF("phase noacks %d to %d.%d\n", e->noacks, neighbor->u8[0], neighbor->u8[1]);
+      e->prediction.error = PHASE_DRIFT_ERROR_UNKNOWN;
       e->noacks++;
       if(e->noacks == 1) {
         timer_set(&e->noacks_timer, MAX_NOACKS_TIME);
@@ -124,11 +116,8 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
     if(mac_status == MAC_TX_OK && e == NULL) {
       e = nbr_table_add_lladdr(nbr_phase, neighbor);
       if(e) {
-        e->time = time;
-#if PHASE_DRIFT_CORRECT
-      e->drift = 0;
-#endif
-      e->noacks = 0;
+        phase_drift_init(&e->prediction, time, clock_seconds());
+        e->noacks = 0;
       }
     }
   }
@@ -152,7 +141,7 @@ send_packet(void *ptr)
 /*---------------------------------------------------------------------------*/
 phase_status_t
 phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
-           rtimer_clock_t guard_time,
+           rtimer_clock_t guard_time, rtimer_clock_t min_guard_time,
            mac_callback_t mac_callback, void *mac_callback_ptr,
            struct rdc_buf_list *buf_list)
 {
@@ -166,35 +155,19 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
   if(e != NULL) {
     rtimer_clock_t wait, now, expected, sync;
     clock_time_t ctimewait;
-    
+
     /* We expect phases to happen every CYCLE_TIME time
        units. The next expected phase is at time e->time +
-       CYCLE_TIME. To compute a relative offset, we subtract
-       with clock_time(). Because we are only interested in turning
-       on the radio within the CYCLE_TIME period, we compute the
-       waiting time with modulo CYCLE_TIME. */
-    
-    /*      printf("neighbor phase 0x%02x (cycle 0x%02x)\n", e->time & (cycle_time - 1),
-            cycle_time);*/
-
-    /*      if(e->noacks > 0) {
-            printf("additional wait %d\n", additional_wait);
-            }*/
-    
+       CYCLE_TIME, corrected for the drift of the neighbor's clock
+       since then. To compute a relative offset, we subtract with
+       clock_time(). Because we are only interested in turning on the
+       radio within the CYCLE_TIME period, we compute the waiting time
+       with modulo CYCLE_TIME. */
     now = RTIMER_NOW();
+    sync = phase_drift_predict(&e->prediction, clock_seconds());
 
-    sync = (e == NULL) ? now : e->time;
-
-#if PHASE_DRIFT_CORRECT
-    {
-      int32_t s;
-      if(e->drift > cycle_time) {
-        s = e->drift % cycle_time / (e->drift / cycle_time);  /* drift per cycle */
-        s = s * (now - sync) / cycle_time;                    /* estimated drift to now */
-        sync += s;                                            /* add it in */
-      }
-    }
-#endif
+    guard_time = phase_drift_guard(&e->prediction, guard_time,
+                                   min_guard_time);
 
     /* Check if cycle_time is a power of two */
     if(!(cycle_time & (cycle_time - 1))) {
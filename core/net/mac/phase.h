@@ -55,12 +55,22 @@ typedef enum {
 
 
 void phase_init(void);
+
+/*
+ * Wait for the next expected phase of a neighbor, or defer the
+ * transmission if it is far off. The phase is predicted from a linear
+ * fit to the recent observations, to compensate for the drift of the
+ * neighbor's clock. The transmission starts guard_time before the
+ * phase, or less, down to min_guard_time, when the predictions for the
+ * neighbor have been accurate.
+ */
 phase_status_t phase_wait(const linkaddr_t *neighbor,
-                          rtimer_clock_t cycle_time, rtimer_clock_t wait_before,
+                          rtimer_clock_t cycle_time, rtimer_clock_t guard_time,
+                          rtimer_clock_t min_guard_time,
                           mac_callback_t mac_callback, void *mac_callback_ptr,
                           struct rdc_buf_list *buf_list);
-void phase_update(const linkaddr_t *neighbor,
-                  rtimer_clock_t time, int mac_status);
+void phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
+                  rtimer_clock_t cycle_time, int mac_status);
 void phase_remove(const linkaddr_t *neighbor);
 
 #endif /* PHASE_H */
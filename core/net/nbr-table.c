@@ -51,6 +51,8 @@ typedef struct nbr_table_key {
 static uint8_t used_map[NBR_TABLE_MAX_NEIGHBORS];
 /* For each neighbor, a map of the tables that lock the neighbor */
 static uint8_t locked_map[NBR_TABLE_MAX_NEIGHBORS];
+/* A map of the tables that only cache data about the neighbors */
+static uint8_t cache_map;
 /* The maximum number of tables */
 #define MAX_NUM_TABLES 8
 /* A list of pointers to tables in use */
@@ -157,7 +159,7 @@ nbr_set_bit(uint8_t *bitmap, nbr_table_t *table, nbr_table_item_t *item, int val
 }
 /*---------------------------------------------------------------------------*/
 static nbr_table_key_t *
-nbr_table_allocate(void)
+nbr_table_allocate(nbr_table_t *table)
 {
   nbr_table_key_t *key;
   int least_used_count = 0;
@@ -169,8 +171,10 @@ nbr_table_allocate(void)
   } else { /* No more space, try to free a neighbor.
             * The replacement policy is the following: remove neighbor that is:
             * (1) not locked
-            * (2) used by fewest tables
+            * (2) used by fewest tables, not counting cache tables
             * (3) oldest (the list is ordered by insertion time)
+            * A cache table may only replace a neighbor that no other
+            * kind of table uses.
             * */
     /* Get item from first key */
     key = list_head(nbr_table_keys);
@@ -179,7 +183,7 @@ nbr_table_allocate(void)
       int locked = locked_map[item_index];
       /* Never delete a locked item */
       if(!locked) {
-        int used = used_map[item_index];
+        int used = used_map[item_index] & ~cache_map;
         int used_count = 0;
         /* Count how many tables are using this item */
         while(used != 0) {
@@ -202,6 +206,10 @@ nbr_table_allocate(void)
     if(least_used_key == NULL) {
       /* We haven't found any unlocked item, allocation fails */
       return NULL;
+    } else if(least_used_count > 0 &&
+              (cache_map & (1 << table->index)) != 0) {
+      /* Caches never replace neighbors that other tables need */
+      return NULL;
     } else {
       /* Reuse least used item */
       int i;
@@ -240,6 +248,19 @@ nbr_table_register(nbr_table_t *table, nbr_table_callback *callback)
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Register a neighbor table that only caches data about the neighbors.
+ * Its entries are replaced before those of other tables, and adding to
+ * it never replaces a neighbor that another kind of table uses. */
+int
+nbr_table_register_cache(nbr_table_t *table, nbr_table_callback *callback)
+{
+  if(nbr_table_register(table, callback)) {
+    cache_map |= 1 << table->index;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 /* Returns the first item of the current table */
 nbr_table_item_t *
 nbr_table_head(nbr_table_t *table)
@@ -283,7 +304,7 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr)
 
   if((index = index_from_lladdr(lladdr)) == -1) {
      /* Neighbor not yet in table, let's try to allocate one */
-    key = nbr_table_allocate();
+    key = nbr_table_allocate(table);
 
     /* No space available for new entry */
     if(key == NULL) {
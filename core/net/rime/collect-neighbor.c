@@ -51,6 +51,7 @@
 
 #include "net/rime/collect-neighbor.h"
 #include "net/rime/collect.h"
+#include "net/link-stats.h"
 
 #ifdef COLLECT_NEIGHBOR_CONF_MAX_COLLECT_NEIGHBORS
 #define MAX_COLLECT_NEIGHBORS COLLECT_NEIGHBOR_CONF_MAX_COLLECT_NEIGHBORS
@@ -374,6 +375,23 @@ collect_neighbor_rx(struct collect_neighbor *n)
   n->age = 0;
 }
 /*---------------------------------------------------------------------------*/
+static uint16_t
+link_estimate(struct collect_neighbor *n)
+{
+  const struct link_stats *stats;
+
+  /* Until collect has estimated the link itself, use the ETX that the
+     link statistics have gathered from other traffic to the neighbor. */
+  if(collect_link_estimate_num_estimates(&n->le) == 0) {
+    stats = link_stats_from_lladdr(&n->addr);
+    if(stats != NULL && link_stats_is_fresh(stats)) {
+      return (uint32_t)stats->etx * COLLECT_LINK_ESTIMATE_UNIT /
+        LINK_STATS_ETX_DIVISOR;
+    }
+  }
+  return collect_link_estimate(&n->le);
+}
+/*---------------------------------------------------------------------------*/
 uint16_t
 collect_neighbor_link_estimate(struct collect_neighbor *n)
 {
@@ -385,9 +403,9 @@ collect_neighbor_link_estimate(struct collect_neighbor *n)
            n->addr.u8[0], n->addr.u8[1],
            collect_link_estimate(&n->le),
            collect_link_estimate(&n->le) + CONGESTION_PENALTY);*/
-    return collect_link_estimate(&n->le) + CONGESTION_PENALTY;
+    return link_estimate(n) + CONGESTION_PENALTY;
   } else {
-    return collect_link_estimate(&n->le);
+    return link_estimate(n);
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -397,7 +415,7 @@ collect_neighbor_rtmetric_link_estimate(struct collect_neighbor *n)
   if(n == NULL) {
     return 0;
   }
-  return n->rtmetric + collect_link_estimate(&n->le);
+  return n->rtmetric + link_estimate(n);
 }
 /*---------------------------------------------------------------------------*/
 uint16_t
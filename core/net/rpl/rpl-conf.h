@@ -70,6 +70,19 @@
 #define RPL_OF rpl_mrhof
 #endif /* RPL_CONF_OF */
 
+/*
+ * The objective functions that the node can run. An instance that is
+ * joined uses the objective function whose OCP is announced by the
+ * DAG root, so nodes that take part in several instances with
+ * different objective functions list all of them here, e.g.,
+ * {&rpl_mrhof, &rpl_of0}. RPL_OF should be in the list.
+ */
+#ifdef RPL_CONF_SUPPORTED_OFS
+#define RPL_SUPPORTED_OFS RPL_CONF_SUPPORTED_OFS
+#else
+#define RPL_SUPPORTED_OFS {&RPL_OF}
+#endif /* RPL_CONF_SUPPORTED_OFS */
+
 /* This value decides which DAG instance we should participate in by default. */
 #ifdef RPL_CONF_DEFAULT_INSTANCE
 #define RPL_DEFAULT_INSTANCE RPL_CONF_DEFAULT_INSTANCE
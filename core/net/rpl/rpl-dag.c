@@ -46,6 +46,7 @@
 #include "net/rpl/rpl-private.h"
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-nd6.h"
+#include "net/link-stats.h"
 #include "net/nbr-table.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 #include "lib/list.h"
@@ -60,8 +61,7 @@
 
 #if UIP_CONF_IPV6
 /*---------------------------------------------------------------------------*/
-extern rpl_of_t RPL_OF;
-static rpl_of_t * const objective_functions[] = {&RPL_OF};
+static rpl_of_t * const objective_functions[] = RPL_SUPPORTED_OFS;
 
 /*---------------------------------------------------------------------------*/
 /* RPL definitions. */
@@ -74,7 +74,7 @@ static rpl_of_t * const objective_functions[] = {&RPL_OF};
 
 /*---------------------------------------------------------------------------*/
 /* Per-parent RPL information */
-NBR_TABLE(rpl_parent_t, rpl_parents);
+NBR_TABLE_GLOBAL(rpl_parent_t, rpl_parents);
 /*---------------------------------------------------------------------------*/
 /* Allocate instance table. */
 rpl_instance_t instance_table[RPL_MAX_INSTANCES];
@@ -104,14 +104,16 @@ rpl_get_parent_rank(uip_lladdr_t *addr)
 }
 /*---------------------------------------------------------------------------*/
 uint16_t
-rpl_get_parent_link_metric(const uip_lladdr_t *addr)
+rpl_get_parent_link_metric(rpl_parent_t *p)
 {
-  rpl_parent_t *p = nbr_table_get_from_lladdr(rpl_parents, (const linkaddr_t *)addr);
-  if(p != NULL) {
-    return p->link_metric;
-  } else {
-    return 0;
+  const struct link_stats *stats;
+
+  stats = link_stats_from_lladdr(nbr_table_get_lladdr(rpl_parents, p));
+  if(stats == NULL) {
+    return RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
   }
+  return (uint32_t)stats->etx * RPL_DAG_MC_ETX_DIVISOR /
+    LINK_STATS_ETX_DIVISOR;
 }
 /*---------------------------------------------------------------------------*/
 uip_ipaddr_t *
@@ -147,6 +149,98 @@ rpl_set_preferred_parent(rpl_dag_t *dag, rpl_parent_t *p)
   }
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * The candidate parents of a DAG are kept in a binary min-heap on the
+ * path cost that the objective function gives them. The best candidate
+ * is thereby always at the top, and a parent whose cost has changed is
+ * moved along one branch of the heap instead of having the whole
+ * neighbor table compared again.
+ */
+static void
+parent_set_place(rpl_dag_t *dag, rpl_parent_t *p, int i)
+{
+  dag->parent_set[i] = p;
+  p->set_index = i + 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+parent_set_sift(rpl_dag_t *dag, int i)
+{
+  rpl_parent_t *p;
+  int child;
+
+  p = dag->parent_set[i];
+
+  while(i > 0 && p->cost < dag->parent_set[(i - 1) / 2]->cost) {
+    parent_set_place(dag, dag->parent_set[(i - 1) / 2], i);
+    i = (i - 1) / 2;
+  }
+
+  for(;;) {
+    child = 2 * i + 1;
+    if(child >= dag->parent_count) {
+      break;
+    }
+    if(child + 1 < dag->parent_count &&
+       dag->parent_set[child + 1]->cost < dag->parent_set[child]->cost) {
+      child++;
+    }
+    if(dag->parent_set[child]->cost >= p->cost) {
+      break;
+    }
+    parent_set_place(dag, dag->parent_set[child], i);
+    i = child;
+  }
+
+  parent_set_place(dag, p, i);
+}
+/*---------------------------------------------------------------------------*/
+static void
+parent_set_remove(rpl_parent_t *p)
+{
+  rpl_dag_t *dag;
+  int i;
+
+  dag = p->dag;
+  if(dag == NULL || p->set_index == 0) {
+    return;
+  }
+
+  i = p->set_index - 1;
+  p->set_index = 0;
+  dag->parent_count--;
+  if(i < dag->parent_count) {
+    dag->parent_set[i] = dag->parent_set[dag->parent_count];
+    parent_set_sift(dag, i);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Recompute the path cost of a parent and reposition it in the parent set
+   of its DAG. Parents with an infinite rank are kept out of the set. */
+static void
+parent_set_update(rpl_parent_t *p)
+{
+  rpl_dag_t *dag;
+
+  dag = p->dag;
+  if(dag == NULL || dag->instance == NULL || dag->instance->of == NULL) {
+    return;
+  }
+
+  if(p->rank == INFINITE_RANK) {
+    parent_set_remove(p);
+    return;
+  }
+
+  p->cost = dag->instance->of->parent_path_cost(p);
+  if(p->set_index == 0) {
+    dag->parent_set[dag->parent_count++] = p;
+    parent_set_sift(dag, dag->parent_count - 1);
+  } else {
+    parent_set_sift(dag, p->set_index - 1);
+  }
+}
+/*---------------------------------------------------------------------------*/
 /* Greater-than function for the lollipop counter.                      */
 /*---------------------------------------------------------------------------*/
 static int
@@ -242,6 +336,12 @@ get_dag(uint8_t instance_id, uip_ipaddr_t *dag_id)
 /*---------------------------------------------------------------------------*/
 rpl_dag_t *
 rpl_set_root(uint8_t instance_id, uip_ipaddr_t *dag_id)
+{
+  return rpl_set_root_with_of(instance_id, dag_id, &RPL_OF);
+}
+/*---------------------------------------------------------------------------*/
+rpl_dag_t *
+rpl_set_root_with_of(uint8_t instance_id, uip_ipaddr_t *dag_id, rpl_of_t *of)
 {
   rpl_dag_t *dag;
   rpl_instance_t *instance;
@@ -271,7 +371,7 @@ rpl_set_root(uint8_t instance_id, uip_ipaddr_t *dag_id)
   dag->joined = 1;
   dag->grounded = RPL_GROUNDED;
   instance->mop = RPL_MOP_DEFAULT;
-  instance->of = &RPL_OF;
+  instance->of = of;
   rpl_set_preferred_parent(dag, NULL);
 
   memcpy(&dag->dag_id, dag_id, sizeof(dag->dag_id));
@@ -300,7 +400,11 @@ rpl_set_root(uint8_t instance_id, uip_ipaddr_t *dag_id)
   instance->current_dag = dag;
   instance->dtsn_out = RPL_LOLLIPOP_INIT;
   instance->of->update_metric_container(instance);
-  default_instance = instance;
+  /* The root of a second instance leaves the default instance as it is.
+     Use rpl_set_default_instance() to change it. */
+  if(default_instance == NULL) {
+    default_instance = instance;
+  }
 
   PRINTF("RPL: Node set to be a DAG root with DAG ID ");
   PRINT6ADDR(&dag->dag_id);
@@ -405,6 +509,23 @@ rpl_set_prefix(rpl_dag_t *dag, uip_ipaddr_t *prefix, unsigned len)
   return 1;
 }
 /*---------------------------------------------------------------------------*/
+static int
+default_route_shared(rpl_instance_t *instance)
+{
+  rpl_instance_t *other, *end;
+
+  /* Instances that have the same preferred parent share its entry in
+     the default router list. */
+  for(other = &instance_table[0], end = other + RPL_MAX_INSTANCES;
+      other < end; ++other) {
+    if(other != instance && other->used &&
+       other->def_route == instance->def_route) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 int
 rpl_set_default_route(rpl_instance_t *instance, uip_ipaddr_t *from)
 {
@@ -412,7 +533,9 @@ rpl_set_default_route(rpl_instance_t *instance, uip_ipaddr_t *from)
     PRINTF("RPL: Removing default route through ");
     PRINT6ADDR(&instance->def_route->ipaddr);
     PRINTF("\n");
-    uip_ds6_defrt_rm(instance->def_route);
+    if(!default_route_shared(instance)) {
+      uip_ds6_defrt_rm(instance->def_route);
+    }
     instance->def_route = NULL;
   }
 
@@ -535,9 +658,10 @@ rpl_free_dag(rpl_dag_t *dag)
     if((dag->prefix_info.flags & UIP_ND6_RA_FLAG_AUTONOMOUS)) {
       check_prefix(&dag->prefix_info, NULL);
     }
-
-    remove_parents(dag, 0);
   }
+
+  /* The parents refer to the DAG and to its parent set. */
+  remove_parents(dag, 0);
   dag->used = 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -553,6 +677,12 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
   PRINT6ADDR(addr);
   PRINTF("\n");
   if(lladdr != NULL) {
+    /* An existing entry is reinitialized below, so it must first leave
+       the parent set it is in. */
+    p = nbr_table_get_from_lladdr(rpl_parents, (linkaddr_t *)lladdr);
+    if(p != NULL) {
+      parent_set_remove(p);
+    }
     /* Add parent in rpl_parents */
     p = nbr_table_add_lladdr(rpl_parents, (linkaddr_t *)lladdr);
     if(p == NULL) {
@@ -561,7 +691,6 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
       p->dag = dag;
       p->rank = dio->rank;
       p->dtsn = dio->dtsn;
-      p->link_metric = RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
       memcpy(&p->mc, &dio->mc, sizeof(p->mc));
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
@@ -706,20 +835,20 @@ rpl_select_dag(rpl_instance_t *instance, rpl_parent_t *p)
 static rpl_parent_t *
 best_parent(rpl_dag_t *dag)
 {
-  rpl_parent_t *p, *best;
+  rpl_parent_t *best;
 
-  best = NULL;
+  if(dag->parent_count == 0) {
+    return NULL;
+  }
 
-  p = nbr_table_head(rpl_parents);
-  while(p != NULL) {
-    if(p->rank == INFINITE_RANK) {
-      /* ignore this neighbor */
-    } else if(best == NULL) {
-      best = p;
-    } else {
-      best = dag->instance->of->best_parent(best, p);
-    }
-    p = nbr_table_next(rpl_parents, p);
+  /* The parent set is ordered by path cost alone. The objective function
+     applies its hysteresis only here, when deciding whether the cheapest
+     candidate should replace the preferred parent. */
+  best = dag->parent_set[0];
+  if(dag->preferred_parent != NULL && dag->preferred_parent != best &&
+     dag->preferred_parent->dag == dag &&
+     dag->preferred_parent->set_index != 0) {
+    best = dag->instance->of->best_parent(dag->preferred_parent, best);
   }
 
   return best;
@@ -745,6 +874,7 @@ rpl_remove_parent(rpl_parent_t *parent)
   PRINTF("\n");
 
   rpl_nullify_parent(parent);
+  parent_set_remove(parent);
 
   nbr_table_remove(rpl_parents, parent);
 }
@@ -798,7 +928,9 @@ rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent)
   PRINT6ADDR(rpl_get_parent_ipaddr(parent));
   PRINTF("\n");
 
+  parent_set_remove(parent);
   parent->dag = dag_dst;
+  parent_set_update(parent);
 }
 /*---------------------------------------------------------------------------*/
 rpl_dag_t *
@@ -806,6 +938,11 @@ rpl_get_any_dag(void)
 {
   int i;
 
+  if(default_instance != NULL && default_instance->current_dag != NULL &&
+     default_instance->current_dag->joined) {
+    return default_instance->current_dag;
+  }
+
   for(i = 0; i < RPL_MAX_INSTANCES; ++i) {
     if(instance_table[i].used && instance_table[i].current_dag->joined) {
       return instance_table[i].current_dag;
@@ -912,6 +1049,7 @@ rpl_join_instance(uip_ipaddr_t *from, rpl_dio_t *dio)
   /* Copy prefix information from the DIO into the DAG object. */
   memcpy(&dag->prefix_info, &dio->prefix_info, sizeof(rpl_prefix_t));
 
+  parent_set_update(p);
   rpl_set_preferred_parent(dag, p);
   instance->of->update_metric_container(instance);
   dag->rank = instance->of->calculate_rank(p, 0);
@@ -1105,6 +1243,10 @@ rpl_process_parent_event(rpl_instance_t *instance, rpl_parent_t *p)
 
   return_value = 1;
 
+  /* The rank, metric container or link metric of the parent may have
+     changed since it was last placed in the parent set. */
+  parent_set_update(p);
+
   if(!acceptable_rank(p->dag, p->rank)) {
     /* The candidate parent is no longer valid: the rank increase resulting
        from the choice of it as a parent would be too high. */
@@ -1278,7 +1420,8 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio)
   PRINTF(", rank %u, min_rank %u, ",
 	 instance->current_dag->rank, instance->current_dag->min_rank);
   PRINTF("parent rank %u, parent etx %u, link metric %u, instance etx %u\n",
-	 p->rank, -1/*p->mc.obj.etx*/, p->link_metric, instance->mc.obj.etx);
+	 p->rank, -1/*p->mc.obj.etx*/, rpl_get_parent_link_metric(p),
+	 instance->mc.obj.etx);
 
   /* We have allocated a candidate parent; process the DIO further. */
 
@@ -63,6 +63,9 @@
 #define UIP_EXT_HDR_OPT_RPL_BUF   ((struct uip_ext_hdr_opt_rpl *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 /*---------------------------------------------------------------------------*/
 #if UIP_CONF_IPV6
+/* The instance of the next packet that this node originates. */
+static rpl_instance_t *output_instance;
+/*---------------------------------------------------------------------------*/
 int
 rpl_verify_header(int uip_ext_opt_offset)
 {
@@ -89,7 +92,7 @@ rpl_verify_header(int uip_ext_opt_offset)
        the packet to be forwareded in the first place. We drop any
        routes that go through the neighbor that sent the packet to
        us. */
-    route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
+    route = rpl_lookup_route(instance, &UIP_IP_BUF->destipaddr);
     if(route != NULL) {
       uip_ds6_route_rm(route);
 
@@ -217,7 +220,7 @@ rpl_update_header_empty(void)
        general not go back up again. If this happens, a
        RPL_HDR_OPT_FWD_ERR should be flagged. */
     if((UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_DOWN)) {
-      if(uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr) == NULL) {
+      if(rpl_lookup_route(instance, &UIP_IP_BUF->destipaddr) == NULL) {
         UIP_EXT_HDR_OPT_RPL_BUF->flags |= RPL_HDR_OPT_FWD_ERR;
         PRINTF("RPL forwarding error\n");
       }
@@ -225,7 +228,7 @@ rpl_update_header_empty(void)
       /* Set the down extension flag correctly as described in Section
          11.2 of RFC6550. If the packet progresses along a DAO route,
          the down flag should be set. */
-      if(uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr) == NULL) {
+      if(rpl_lookup_route(instance, &UIP_IP_BUF->destipaddr) == NULL) {
         /* No route was found, so this packet will go towards the RPL
            root. If so, we should not set the down flag. */
         UIP_EXT_HDR_OPT_RPL_BUF->flags &= ~RPL_HDR_OPT_DOWN;
@@ -284,6 +287,51 @@ rpl_update_header_final(uip_ipaddr_t *addr)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+rpl_instance_t *
+rpl_get_packet_instance(void)
+{
+  rpl_instance_t *instance;
+  int uip_ext_opt_offset;
+  int last_uip_ext_len;
+
+  last_uip_ext_len = uip_ext_len;
+  uip_ext_len = 0;
+  uip_ext_opt_offset = 2;
+
+  /* An RPL option without a sender rank has just been added by this
+     node, and its instance ID is not set until rpl_update_header_final()
+     is called. */
+  instance = NULL;
+  if(UIP_IP_BUF->proto == UIP_PROTO_HBHO &&
+     UIP_HBHO_BUF->len == RPL_HOP_BY_HOP_LEN - 8 &&
+     UIP_EXT_HDR_OPT_BUF->type == UIP_EXT_HDR_OPT_RPL &&
+     UIP_EXT_HDR_OPT_RPL_BUF->senderrank != 0) {
+    instance = rpl_get_instance(UIP_EXT_HDR_OPT_RPL_BUF->instance);
+  }
+  uip_ext_len = last_uip_ext_len;
+
+  if(instance == NULL || instance->current_dag == NULL ||
+     !instance->current_dag->joined) {
+    return default_instance;
+  }
+  return instance;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_set_output_instance(uint8_t instance_id)
+{
+  rpl_instance_t *instance;
+
+  instance = rpl_get_instance(instance_id);
+  if(instance == NULL || instance->current_dag == NULL ||
+     !instance->current_dag->joined) {
+    output_instance = NULL;
+    return 0;
+  }
+  output_instance = instance;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_remove_header(void)
 {
@@ -348,7 +396,30 @@ void
 rpl_insert_header(void)
 {
   uint8_t uip_ext_opt_offset;
-  if(default_instance != NULL) {
+  rpl_instance_t *instance;
+
+  /* The selected instance only applies to a single packet. */
+  instance = output_instance;
+  output_instance = NULL;
+
+  if(instance != NULL && instance != default_instance) {
+    /* Packets of the default instance get their RPL option on the first
+       hop. For the other instances, the option has to be added here so
+       that the forwarders know which routes to use. */
+    if(UIP_IP_BUF->proto == UIP_PROTO_HBHO ||
+       uip_len + RPL_HOP_BY_HOP_LEN > UIP_BUFSIZE) {
+      PRINTF("RPL: Unable to add the RPL option for instance %u\n",
+             instance->instance_id);
+      return;
+    }
+    uip_ext_len = 0;
+    uip_ext_opt_offset = 2;
+    set_rpl_opt(uip_ext_opt_offset);
+    UIP_EXT_HDR_OPT_RPL_BUF->instance = instance->instance_id;
+    uip_ext_len = RPL_HOP_BY_HOP_LEN;
+    /* Set the sender rank and the direction of the packet. */
+    rpl_update_header_empty();
+  } else if(default_instance != NULL) {
     uip_ext_opt_offset = 2;
     if(UIP_EXT_HDR_OPT_BUF->type == UIP_EXT_HDR_OPT_RPL) {
       rpl_update_header_empty();
@@ -51,6 +51,9 @@
 #include "net/rpl/rpl-private.h"
 #include "net/packetbuf.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "lib/random.h"
 
 #include <limits.h>
 #include <string.h>
@@ -91,6 +94,25 @@ extern rpl_of_t RPL_OF;
 #if RPL_CONF_MULTICAST
 static uip_mcast6_route_t *mcast_group;
 #endif
+
+#define DAO_TARGET_LEN(prefixlen)        (4 + ((prefixlen) + 7) / CHAR_BIT)
+#define DAO_TRANSIT_LEN                  6
+
+/* DAO targets that wait to be sent to the preferred parent. */
+struct dao_target {
+  struct dao_target *next;
+  rpl_instance_t *instance;
+  uip_ipaddr_t prefix;
+  uint8_t length;
+  uint8_t lifetime;
+};
+
+MEMB(dao_target_memb, struct dao_target, RPL_DAO_MAX_TARGETS);
+LIST(dao_targets);
+static struct ctimer aggregation_timer;
+
+static int queue_target(rpl_instance_t *, uip_ipaddr_t *, uint8_t, uint8_t);
+static void unqueue_targets(struct dao_target *);
 /*---------------------------------------------------------------------------*/
 /* Initialise RPL ICMPv6 message handlers */
 UIP_ICMP6_HANDLER(dis_handler, ICMP6_RPL, RPL_CODE_DIS, dis_input);
@@ -570,6 +592,114 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 #endif /* RPL_LEAF_ONLY */
 }
 /*---------------------------------------------------------------------------*/
+static int
+dao_input_target(rpl_instance_t *instance, rpl_parent_t *parent,
+                 uip_ipaddr_t *dao_sender_addr, int learned_from,
+                 uip_ipaddr_t *prefix, uint8_t prefixlen, uint8_t lifetime)
+{
+  rpl_dag_t *dag;
+  uip_ds6_route_t *rep;
+  uip_ds6_nbr_t *nbr;
+
+  dag = instance->current_dag;
+
+  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
+          (unsigned)lifetime, (unsigned)prefixlen);
+  PRINT6ADDR(prefix);
+  PRINTF("\n");
+
+#if RPL_CONF_MULTICAST
+  if(uip_is_addr_mcast_global(prefix)) {
+    mcast_group = uip_mcast6_route_add(prefix);
+    if(mcast_group) {
+      mcast_group->dag = dag;
+      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
+    }
+    return learned_from == RPL_ROUTE_FROM_UNICAST_DAO;
+  }
+#endif
+
+  /* Only the routes of the instance of the DAO are refreshed or
+     withdrawn, not those of the other instances. */
+  rep = rpl_lookup_route(instance, prefix);
+
+  if(lifetime == RPL_ZERO_LIFETIME) {
+    PRINTF("RPL: No-Path DAO received\n");
+    /* No-Path DAO received; invoke the route purging routine. */
+    if(rep != NULL &&
+       rep->state.nopath_received == 0 &&
+       rep->length == prefixlen &&
+       uip_ds6_route_nexthop(rep) != NULL &&
+       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), dao_sender_addr)) {
+      PRINTF("RPL: Setting expiration timer for prefix ");
+      PRINT6ADDR(prefix);
+      PRINTF("\n");
+      rep->state.nopath_received = 1;
+      rep->state.lifetime = DAO_EXPIRATION_TIMEOUT;
+      /* The no-path information is forwarded to our parent. */
+      return 1;
+    }
+    return 0;
+  }
+
+  PRINTF("RPL: adding DAO route\n");
+
+  if((nbr = uip_ds6_nbr_lookup(dao_sender_addr)) == NULL) {
+    if((nbr = uip_ds6_nbr_add(dao_sender_addr,
+                              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                              0, NBR_REACHABLE)) != NULL) {
+      /* set reachable timer */
+      stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+      PRINTF("RPL: Neighbor added to neighbor cache ");
+      PRINT6ADDR(dao_sender_addr);
+      PRINTF(", ");
+      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("\n");
+    } else {
+      PRINTF("RPL: Out of Memory, dropping DAO from ");
+      PRINT6ADDR(dao_sender_addr);
+      PRINTF(", ");
+      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("\n");
+      return -1;
+    }
+  } else {
+    PRINTF("RPL: Neighbor already in neighbor cache\n");
+  }
+
+  rpl_lock_parent(parent);
+
+  rep = rpl_add_route(dag, prefix, prefixlen, dao_sender_addr);
+  if(rep == NULL) {
+    RPL_STAT(rpl_stats.mem_overflows++);
+    PRINTF("RPL: Could not add a route after receiving a DAO\n");
+    return -1;
+  }
+
+  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
+  rep->state.learned_from = learned_from;
+
+  return learned_from == RPL_ROUTE_FROM_UNICAST_DAO;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the length of the DAO option at pos, or 0 if the option does
+   not fit in the buffer. */
+static int
+dao_option_length(const unsigned char *buffer, int pos, int buffer_length)
+{
+  int len;
+
+  if(buffer[pos] == RPL_OPTION_PAD1) {
+    return 1;
+  }
+  /* The option consists of a two-byte header and a payload. */
+  if(pos + 1 >= buffer_length) {
+    return 0;
+  }
+  len = 2 + buffer[pos + 1];
+  return pos + len <= buffer_length ? len : 0;
+}
+/*---------------------------------------------------------------------------*/
 static void
 dao_input(void)
 {
@@ -588,16 +718,19 @@ dao_input(void)
   uint8_t pathsequence;
   */
   uip_ipaddr_t prefix;
-  uip_ds6_route_t *rep;
-  uint8_t buffer_length;
+  uint16_t buffer_length;
   int pos;
   int len;
+  int transit_len;
   int i;
+  int j;
   int learned_from;
+  int accepted;
+  int queued;
+  int result;
   rpl_parent_t *parent;
-  uip_ds6_nbr_t *nbr;
+  struct dao_target *last;
 
-  prefixlen = 0;
   parent = NULL;
 
   uip_ipaddr_copy(&dao_sender_addr, &UIP_IP_BUF->srcipaddr);
@@ -620,8 +753,6 @@ dao_input(void)
     return;
   }
 
-  lifetime = instance->default_lifetime;
-
   flags = buffer[pos++];
   /* reserved */
   pos++;
@@ -665,137 +796,334 @@ dao_input(void)
     }
   }
 
-  /* Check if there are any RPL options present. */
+  /*
+   * A DAO may carry several targets. Each group of Target options is
+   * followed by the Transit Information option that applies to it, and
+   * targets without one get the default lifetime. The targets that are
+   * to be propagated upwards are queued, so that they can be forwarded
+   * together with those of other DAOs.
+   */
+  accepted = 0;
+  queued = 1;
+  last = list_tail(dao_targets);
   for(i = pos; i < buffer_length; i += len) {
+    len = dao_option_length(buffer, i, buffer_length);
+    if(len == 0) {
+      PRINTF("RPL: Invalid DAO packet\n");
+      RPL_STAT(rpl_stats.malformed_msgs++);
+      break;
+    }
+
     subopt_type = buffer[i];
-    if(subopt_type == RPL_OPTION_PAD1) {
-      len = 1;
-    } else {
-      /* The option consists of a two-byte header and a payload. */
-      len = 2 + buffer[i + 1];
+    if(subopt_type != RPL_OPTION_TARGET) {
+      continue;
     }
 
-    switch(subopt_type) {
-    case RPL_OPTION_TARGET:
-      /* Handle the target option. */
-      prefixlen = buffer[i + 3];
-      memset(&prefix, 0, sizeof(prefix));
-      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
-      break;
-    case RPL_OPTION_TRANSIT:
-      /* The path sequence and control are ignored. */
-      /*      pathcontrol = buffer[i + 3];
-              pathsequence = buffer[i + 4];*/
-      lifetime = buffer[i + 5];
-      /* The parent address is also ignored. */
+    /* The prefix length is only read from options that are long
+       enough to hold it. */
+    if(len < DAO_TARGET_LEN(0) ||
+       buffer[i + 3] > sizeof(prefix) * CHAR_BIT ||
+       len < DAO_TARGET_LEN(buffer[i + 3])) {
+      PRINTF("RPL: Ignoring a malformed DAO target\n");
+      continue;
+    }
+    prefixlen = buffer[i + 3];
+    memset(&prefix, 0, sizeof(prefix));
+    memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+
+    /* The path sequence and control are ignored, and so is the
+       parent address. */
+    lifetime = instance->default_lifetime;
+    for(j = i + len; j < buffer_length; j += transit_len) {
+      transit_len = dao_option_length(buffer, j, buffer_length);
+      if(transit_len == 0) {
+        break;
+      }
+      if(buffer[j] == RPL_OPTION_TRANSIT) {
+        if(transit_len >= DAO_TRANSIT_LEN) {
+          lifetime = buffer[j + 5];
+        }
+        break;
+      }
+    }
+
+    result = dao_input_target(instance, parent, &dao_sender_addr,
+                              learned_from, &prefix, prefixlen, lifetime);
+    if(result < 0) {
       break;
     }
+    if(result > 0) {
+      accepted = 1;
+      if(queued && dag->preferred_parent != NULL &&
+         !queue_target(instance, &prefix, prefixlen, lifetime)) {
+        queued = 0;
+      }
+    }
   }
 
-  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
-          (unsigned)lifetime, (unsigned)prefixlen);
-  PRINT6ADDR(&prefix);
-  PRINTF("\n");
+  if(!queued && dag->preferred_parent != NULL &&
+     rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
+    /* There is no room for the targets, so the DAO is forwarded as it
+       is. The targets that it queued before running out of room would
+       otherwise be sent twice. */
+    unqueue_targets(last);
+    PRINTF("RPL: Forwarding DAO to parent ");
+    PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
+    PRINTF("\n");
+    uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
+                   ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+    RPL_STAT(rpl_stats.dao_sent++);
+  }
 
-#if RPL_CONF_MULTICAST
-  if(uip_is_addr_mcast_global(&prefix)) {
-    mcast_group = uip_mcast6_route_add(&prefix);
-    if(mcast_group) {
-      mcast_group->dag = dag;
-      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
+  if(accepted && (flags & RPL_DAO_K_FLAG)) {
+    dao_ack_output(instance, &dao_sender_addr, sequence);
+  }
+  uip_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+dao_header(rpl_dag_t *dag, unsigned char *buffer)
+{
+  int pos;
+
+  RPL_LOLLIPOP_INCREMENT(dao_sequence);
+  pos = 0;
+
+  buffer[pos++] = dag->instance->instance_id;
+  buffer[pos] = 0;
+#if RPL_DAO_SPECIFY_DAG
+  buffer[pos] |= RPL_DAO_D_FLAG;
+#endif /* RPL_DAO_SPECIFY_DAG */
+#if RPL_CONF_DAO_ACK
+  buffer[pos] |= RPL_DAO_K_FLAG;
+#endif /* RPL_CONF_DAO_ACK */
+  ++pos;
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = dao_sequence;
+#if RPL_DAO_SPECIFY_DAG
+  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
+  pos+=sizeof(dag->dag_id);
+#endif /* RPL_DAO_SPECIFY_DAG */
+
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static int
+dao_target(unsigned char *buffer, int pos,
+           uip_ipaddr_t *prefix, uint8_t prefixlen)
+{
+  buffer[pos++] = RPL_OPTION_TARGET;
+  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = prefixlen;
+  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
+  pos += ((prefixlen + 7) / CHAR_BIT);
+
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static int
+dao_transit(unsigned char *buffer, int pos, uint8_t lifetime)
+{
+  buffer[pos++] = RPL_OPTION_TRANSIT;
+  buffer[pos++] = 4;
+  buffer[pos++] = 0; /* flags - ignored */
+  buffer[pos++] = 0; /* path control - ignored */
+  buffer[pos++] = 0; /* path seq - ignored */
+  buffer[pos++] = lifetime;
+
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_aggregation_timer(void *ptr)
+{
+  dao_output_queued();
+}
+/*---------------------------------------------------------------------------*/
+static int
+queue_target(rpl_instance_t *instance, uip_ipaddr_t *prefix,
+             uint8_t prefixlen, uint8_t lifetime)
+{
+  struct dao_target *target;
+
+  for(target = list_head(dao_targets);
+      target != NULL;
+      target = list_item_next(target)) {
+    if(target->instance == instance && target->length == prefixlen &&
+       memcmp(&target->prefix, prefix, (prefixlen + 7) / CHAR_BIT) == 0) {
+      /* The newer lifetime replaces the one that is waiting. */
+      target->lifetime = lifetime;
+      RPL_STAT(rpl_stats.dao_replaced++);
+      return 1;
     }
-    goto fwd_dao;
   }
-#endif
 
-  rep = uip_ds6_route_lookup(&prefix);
+  target = memb_alloc(&dao_target_memb);
+  if(target == NULL) {
+    PRINTF("RPL: No room for another DAO target\n");
+    return 0;
+  }
+  target->instance = instance;
+  memset(&target->prefix, 0, sizeof(target->prefix));
+  memcpy(&target->prefix, prefix, (prefixlen + 7) / CHAR_BIT);
+  target->length = prefixlen;
+  target->lifetime = lifetime;
+  list_add(dao_targets, target);
+
+  /* The first target opens the aggregation window. */
+  if(ctimer_expired(&aggregation_timer)) {
+    ctimer_set(&aggregation_timer, RPL_DAO_AGGREGATION_WINDOW / 2 +
+               random_rand() % (RPL_DAO_AGGREGATION_WINDOW / 2 + 1),
+               handle_aggregation_timer, NULL);
+  }
 
-  if(lifetime == RPL_ZERO_LIFETIME) {
-    PRINTF("RPL: No-Path DAO received\n");
-    /* No-Path DAO received; invoke the route purging routine. */
-    if(rep != NULL &&
-       rep->state.nopath_received == 0 &&
-       rep->length == prefixlen &&
-       uip_ds6_route_nexthop(rep) != NULL &&
-       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
-      PRINTF("RPL: Setting expiration timer for prefix ");
-      PRINT6ADDR(&prefix);
-      PRINTF("\n");
-      rep->state.nopath_received = 1;
-      rep->state.lifetime = DAO_EXPIRATION_TIMEOUT;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove the targets that have been queued after the given one. */
+static void
+unqueue_targets(struct dao_target *last)
+{
+  struct dao_target *target;
+
+  while((target = list_tail(dao_targets)) != last) {
+    list_chop(dao_targets);
+    memb_free(&dao_target_memb, target);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_target(rpl_instance_t *instance, uip_ipaddr_t *prefix, uint8_t lifetime)
+{
+  if(!queue_target(instance, prefix, sizeof(*prefix) * CHAR_BIT, lifetime)) {
+    dao_output_queued();
+    queue_target(instance, prefix, sizeof(*prefix) * CHAR_BIT, lifetime);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+dao_output_queued(void)
+{
+  struct dao_target *target;
+  struct dao_target *next;
+  rpl_instance_t *instance;
+  uip_ipaddr_t *addr;
+  unsigned char *buffer;
+  uint8_t lifetime;
+  int needed;
+  int count;
+  int pos;
+
+  ctimer_stop(&aggregation_timer);
+
+  buffer = UIP_ICMP_PAYLOAD;
 
-      /* We forward the incoming no-path DAO to our parent, if we have
-         one. */
-      if(dag->preferred_parent != NULL &&
-         rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-        PRINTF("RPL: Forwarding no-path DAO to parent ");
-        PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-        PRINTF("\n");
-        uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                       ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+  /* Each round sends one DAO with as many targets of the instance of the
+     first waiting target as fit in it. Consecutive targets with the same
+     lifetime share a Transit Information option. */
+  while((target = list_head(dao_targets)) != NULL) {
+    instance = target->instance;
+    addr = NULL;
+    if(instance->used && instance->current_dag != NULL &&
+       instance->current_dag->preferred_parent != NULL) {
+      addr = rpl_get_parent_ipaddr(instance->current_dag->preferred_parent);
+    }
+    if(addr == NULL) {
+      PRINTF("RPL: No DAO parent, dropping the DAO targets\n");
+    }
+
+    pos = 0;
+    if(addr != NULL) {
+      pos = dao_header(instance->current_dag, buffer);
+    }
+    count = 0;
+    lifetime = 0;
+    for(; target != NULL; target = next) {
+      next = list_item_next(target);
+      if(target->instance != instance) {
+        continue;
       }
-      if(flags & RPL_DAO_K_FLAG) {
-        dao_ack_output(instance, &dao_sender_addr, sequence);
+      if(addr != NULL) {
+        needed = DAO_TARGET_LEN(target->length) + DAO_TRANSIT_LEN;
+        if(count > 0 && target->lifetime != lifetime) {
+          needed += DAO_TRANSIT_LEN;
+        }
+        if(count > 0 && pos + needed > RPL_DAO_MAX_LENGTH) {
+          break;
+        }
+        if(count > 0 && target->lifetime != lifetime) {
+          pos = dao_transit(buffer, pos, lifetime);
+        }
+        pos = dao_target(buffer, pos, &target->prefix, target->length);
+        lifetime = target->lifetime;
+        count++;
       }
+      list_remove(dao_targets, target);
+      memb_free(&dao_target_memb, target);
     }
-    return;
-  }
 
-  PRINTF("RPL: adding DAO route\n");
+    if(count > 0) {
+      pos = dao_transit(buffer, pos, lifetime);
 
-  if((nbr = uip_ds6_nbr_lookup(&dao_sender_addr)) == NULL) {
-    if((nbr = uip_ds6_nbr_add(&dao_sender_addr,
-                              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
-                              0, NBR_REACHABLE)) != NULL) {
-      /* set reachable timer */
-      stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
-      PRINTF("RPL: Neighbor added to neighbor cache ");
-      PRINT6ADDR(&dao_sender_addr);
-      PRINTF(", ");
-      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-      PRINTF("\n");
-    } else {
-      PRINTF("RPL: Out of Memory, dropping DAO from ");
-      PRINT6ADDR(&dao_sender_addr);
-      PRINTF(", ");
-      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("RPL: Sending DAO with %d targets to ", count);
+      PRINT6ADDR(addr);
       PRINTF("\n");
-      return;
+
+      uip_icmp6_send(addr, ICMP6_RPL, RPL_CODE_DAO, pos);
+      RPL_STAT(rpl_stats.dao_sent++);
+      RPL_STAT(rpl_stats.dao_merged += count - 1);
     }
-  } else {
-    PRINTF("RPL: Neighbor already in neighbor cache\n");
   }
+}
+/*---------------------------------------------------------------------------*/
+void
+dao_output_all(rpl_instance_t *instance, uint8_t lifetime)
+{
+  uip_ipaddr_t prefix;
+#if RPL_CONF_MULTICAST
+  uip_mcast6_route_t *mcast_route;
+  uint8_t i;
+#endif
 
-  rpl_lock_parent(parent);
-
-  rep = rpl_add_route(dag, &prefix, prefixlen, &dao_sender_addr);
-  if(rep == NULL) {
-    RPL_STAT(rpl_stats.mem_overflows++);
-    PRINTF("RPL: Could not add a route after receiving a DAO\n");
+  /* If we are in feather mode, we should not send any DAOs */
+  if(rpl_get_mode() == RPL_MODE_FEATHER) {
     return;
   }
 
-  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
-  rep->state.learned_from = learned_from;
+  if(get_global_addr(&prefix) == 0) {
+    PRINTF("RPL: No global address set for this node - suppressing DAO\n");
+  } else {
+    add_target(instance, &prefix, lifetime);
+  }
 
 #if RPL_CONF_MULTICAST
-fwd_dao:
-#endif
-
-  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
-    if(dag->preferred_parent != NULL &&
-       rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-      PRINTF("RPL: Forwarding DAO to parent ");
-      PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-      PRINTF("\n");
-      uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                     ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+  /* Send DAOs for multicast prefixes only if the instance is in MOP 3 */
+  if(instance->mop == RPL_MOP_STORING_MULTICAST) {
+    /* Send a DAO for own multicast addresses */
+    for(i = 0; i < UIP_DS6_MADDR_NB; i++) {
+      if(uip_ds6_if.maddr_list[i].isused
+          && uip_is_addr_mcast_global(&uip_ds6_if.maddr_list[i].ipaddr)) {
+        add_target(instance, &uip_ds6_if.maddr_list[i].ipaddr,
+                   RPL_MCAST_LIFETIME);
+      }
     }
-    if(flags & RPL_DAO_K_FLAG) {
-      dao_ack_output(instance, &dao_sender_addr, sequence);
+
+    /* Iterate over multicast routes and send DAOs */
+    mcast_route = uip_mcast6_route_list_head();
+    while(mcast_route != NULL) {
+      /* Don't send if it's also our own address, done that already */
+      if(uip_ds6_maddr_lookup(&mcast_route->group) == NULL) {
+        add_target(instance, &mcast_route->group, RPL_MCAST_LIFETIME);
+      }
+      mcast_route = list_item_next(mcast_route);
     }
   }
-  uip_len = 0;
+#endif
+
+  /* The targets of this node are sent together with those that are
+     waiting to be forwarded. */
+  dao_output_queued();
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -819,7 +1147,6 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
   rpl_dag_t *dag;
   rpl_instance_t *instance;
   unsigned char *buffer;
-  uint8_t prefixlen;
   int pos;
 
   /* Destination Advertisement Object */
@@ -856,41 +1183,9 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
 
   buffer = UIP_ICMP_PAYLOAD;
 
-  RPL_LOLLIPOP_INCREMENT(dao_sequence);
-  pos = 0;
-
-  buffer[pos++] = instance->instance_id;
-  buffer[pos] = 0;
-#if RPL_DAO_SPECIFY_DAG
-  buffer[pos] |= RPL_DAO_D_FLAG;
-#endif /* RPL_DAO_SPECIFY_DAG */
-#if RPL_CONF_DAO_ACK
-  buffer[pos] |= RPL_DAO_K_FLAG;
-#endif /* RPL_CONF_DAO_ACK */
-  ++pos;
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = dao_sequence;
-#if RPL_DAO_SPECIFY_DAG
-  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
-  pos+=sizeof(dag->dag_id);
-#endif /* RPL_DAO_SPECIFY_DAG */
-
-  /* create target subopt */
-  prefixlen = sizeof(*prefix) * CHAR_BIT;
-  buffer[pos++] = RPL_OPTION_TARGET;
-  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = prefixlen;
-  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
-  pos += ((prefixlen + 7) / CHAR_BIT);
-
-  /* Create a transit information sub-option. */
-  buffer[pos++] = RPL_OPTION_TRANSIT;
-  buffer[pos++] = 4;
-  buffer[pos++] = 0; /* flags - ignored */
-  buffer[pos++] = 0; /* path control - ignored */
-  buffer[pos++] = 0; /* path seq - ignored */
-  buffer[pos++] = lifetime;
+  pos = dao_header(dag, buffer);
+  pos = dao_target(buffer, pos, prefix, sizeof(*prefix) * CHAR_BIT);
+  pos = dao_transit(buffer, pos, lifetime);
 
   PRINTF("RPL: Sending DAO with prefix ");
   PRINT6ADDR(prefix);
@@ -900,6 +1195,7 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
 
   if(rpl_get_parent_ipaddr(parent) != NULL) {
     uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
+    RPL_STAT(rpl_stats.dao_sent++);
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -925,6 +1221,7 @@ dao_ack_input(void)
   PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
   PRINTF("\n");
 #endif /* DEBUG */
+  RPL_STAT(rpl_stats.dao_acked++);
   uip_len = 0;
 }
 /*---------------------------------------------------------------------------*/
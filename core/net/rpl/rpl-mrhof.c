@@ -39,7 +39,8 @@
  *
  *         This implementation uses the estimated number of
  *         transmissions (ETX) as the additive routing metric,
- *         and also provides stubs for the energy metric.
+ *         and also provides stubs for the energy metric. The link
+ *         ETX of the parents is taken from the link statistics.
  *
  * \author Joakim Eriksson <joakime@sics.se>, Nicolas Tsiftes <nvt@sics.se>
  */
@@ -51,29 +52,23 @@
 #include "net/ip/uip-debug.h"
 
 static void reset(rpl_dag_t *);
-static void neighbor_link_callback(rpl_parent_t *, int, int);
 static rpl_parent_t *best_parent(rpl_parent_t *, rpl_parent_t *);
+static uint16_t parent_path_cost(rpl_parent_t *);
 static rpl_dag_t *best_dag(rpl_dag_t *, rpl_dag_t *);
 static rpl_rank_t calculate_rank(rpl_parent_t *, rpl_rank_t);
 static void update_metric_container(rpl_instance_t *);
 
 rpl_of_t rpl_mrhof = {
   reset,
-  neighbor_link_callback,
+  NULL,
   best_parent,
+  parent_path_cost,
   best_dag,
   calculate_rank,
   update_metric_container,
   1
 };
 
-/* Constants for the ETX moving average */
-#define ETX_SCALE   100
-#define ETX_ALPHA   90
-
-/* Reject parents that have a higher link metric than the following. */
-#define MAX_LINK_METRIC			10
-
 /* Reject parents that have a higher path cost than the following. */
 #define MAX_PATH_COST			100
 
@@ -93,44 +88,26 @@ calculate_path_metric(rpl_parent_t *p)
   }
 
 #if RPL_DAG_MC == RPL_DAG_MC_NONE
-  return p->rank + (uint16_t)p->link_metric;
+  return p->rank + rpl_get_parent_link_metric(p);
 #elif RPL_DAG_MC == RPL_DAG_MC_ETX
-  return p->mc.obj.etx + (uint16_t)p->link_metric;
+  return p->mc.obj.etx + rpl_get_parent_link_metric(p);
 #elif RPL_DAG_MC == RPL_DAG_MC_ENERGY
-  return p->mc.obj.energy.energy_est + (uint16_t)p->link_metric;
+  return p->mc.obj.energy.energy_est + rpl_get_parent_link_metric(p);
 #else
 #error "Unsupported RPL_DAG_MC configured. See rpl.h."
 #endif /* RPL_DAG_MC */
 }
 
-static void
-reset(rpl_dag_t *dag)
+static uint16_t
+parent_path_cost(rpl_parent_t *p)
 {
-  PRINTF("RPL: Reset MRHOF\n");
+  return calculate_path_metric(p);
 }
 
 static void
-neighbor_link_callback(rpl_parent_t *p, int status, int numtx)
+reset(rpl_dag_t *dag)
 {
-  uint16_t recorded_etx = p->link_metric;
-  uint16_t packet_etx = numtx * RPL_DAG_MC_ETX_DIVISOR;
-  uint16_t new_etx;
-
-  /* Do not penalize the ETX when collisions or transmission errors occur. */
-  if(status == MAC_TX_OK || status == MAC_TX_NOACK) {
-    if(status == MAC_TX_NOACK) {
-      packet_etx = MAX_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
-    }
-
-    new_etx = ((uint32_t)recorded_etx * ETX_ALPHA +
-               (uint32_t)packet_etx * (ETX_SCALE - ETX_ALPHA)) / ETX_SCALE;
-
-    PRINTF("RPL: ETX changed from %u to %u (packet ETX = %u)\n",
-        (unsigned)(recorded_etx / RPL_DAG_MC_ETX_DIVISOR),
-        (unsigned)(new_etx  / RPL_DAG_MC_ETX_DIVISOR),
-        (unsigned)(packet_etx / RPL_DAG_MC_ETX_DIVISOR));
-    p->link_metric = new_etx;
-  }
+  PRINTF("RPL: Reset MRHOF\n");
 }
 
 static rpl_rank_t
@@ -145,7 +122,7 @@ calculate_rank(rpl_parent_t *p, rpl_rank_t base_rank)
     }
     rank_increase = RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
   } else {
-    rank_increase = p->link_metric;
+    rank_increase = rpl_get_parent_link_metric(p);
     if(base_rank == 0) {
       base_rank = p->rank;
     }
@@ -110,6 +110,30 @@
 #define RPL_DAO_LATENCY                 (CLOCK_SECOND * 4)
 #endif /* RPL_DAO_LATENCY */
 
+/* The window in which a router collects the DAO targets of its children
+   before it forwards them in aggregated DAOs. The targets are sent at a
+   random time in the second half of the window. */
+#ifdef RPL_CONF_DAO_AGGREGATION_WINDOW
+#define RPL_DAO_AGGREGATION_WINDOW      RPL_CONF_DAO_AGGREGATION_WINDOW
+#else /* RPL_CONF_DAO_AGGREGATION_WINDOW */
+#define RPL_DAO_AGGREGATION_WINDOW      (CLOCK_SECOND / 2)
+#endif /* RPL_CONF_DAO_AGGREGATION_WINDOW */
+
+/* The number of DAO targets that can wait to be sent. */
+#ifdef RPL_CONF_DAO_MAX_TARGETS
+#define RPL_DAO_MAX_TARGETS             RPL_CONF_DAO_MAX_TARGETS
+#else /* RPL_CONF_DAO_MAX_TARGETS */
+#define RPL_DAO_MAX_TARGETS             8
+#endif /* RPL_CONF_DAO_MAX_TARGETS */
+
+/* The maximum length of a DAO, excluding the IPv6 and ICMPv6 headers. */
+#ifdef RPL_CONF_DAO_MAX_LENGTH
+#define RPL_DAO_MAX_LENGTH              RPL_CONF_DAO_MAX_LENGTH
+#else /* RPL_CONF_DAO_MAX_LENGTH */
+#define RPL_DAO_MAX_LENGTH              (UIP_BUFSIZE - UIP_LLH_LEN - \
+                                         UIP_IPH_LEN - UIP_ICMPH_LEN)
+#endif /* RPL_CONF_DAO_MAX_LENGTH */
+
 /* Special value indicating immediate removal. */
 #define RPL_ZERO_LIFETIME               0
 
@@ -265,6 +289,10 @@ struct rpl_stats {
   uint16_t malformed_msgs;
   uint16_t resets;
   uint16_t parent_switch;
+  uint16_t dao_sent;
+  uint16_t dao_merged;  /* DAO targets sent in the DAO of another target. */
+  uint16_t dao_replaced; /* Waiting DAO targets replaced by a newer one. */
+  uint16_t dao_acked;
 };
 typedef struct rpl_stats rpl_stats_t;
 
@@ -288,6 +316,8 @@ void dis_output(uip_ipaddr_t *addr);
 void dio_output(rpl_instance_t *, uip_ipaddr_t *uc_addr);
 void dao_output(rpl_parent_t *, uint8_t lifetime);
 void dao_output_target(rpl_parent_t *, uip_ipaddr_t *, uint8_t lifetime);
+void dao_output_all(rpl_instance_t *, uint8_t lifetime);
+void dao_output_queued(void);
 void dao_ack_output(rpl_instance_t *, uip_ipaddr_t *, uint8_t);
 void rpl_icmp6_register_handlers(void);
 
@@ -305,6 +335,7 @@ void rpl_free_dag(rpl_dag_t *);
 void rpl_free_instance(rpl_instance_t *);
 
 /* DAG parent management function. */
+NBR_TABLE_DECLARE(rpl_parents);
 rpl_parent_t *rpl_add_parent(rpl_dag_t *, rpl_dio_t *dio, uip_ipaddr_t *);
 rpl_parent_t *rpl_find_parent(rpl_dag_t *, uip_ipaddr_t *);
 rpl_parent_t *rpl_find_parent_any_dag(rpl_instance_t *instance, uip_ipaddr_t *addr);
@@ -314,6 +345,7 @@ void rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *paren
 rpl_parent_t *rpl_select_parent(rpl_dag_t *dag);
 rpl_dag_t *rpl_select_dag(rpl_instance_t *instance,rpl_parent_t *parent);
 void rpl_recalculate_ranks(void);
+void rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx);
 
 /* RPL routing table functions. */
 void rpl_remove_routes(rpl_dag_t *dag);
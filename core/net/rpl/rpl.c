@@ -134,13 +134,17 @@ rpl_purge_routes(void)
       /* Routes with lifetime == 1 have only just been decremented from 2 to 1,
        * thus we want to keep them. Hence < and not <= */
       uip_ipaddr_copy(&prefix, &r->ipaddr);
+      /* The No-Path DAO goes up in the instance of the route. */
+      dag = r->state.dag;
+      if(dag == NULL) {
+        dag = default_instance->current_dag;
+      }
       uip_ds6_route_rm(r);
       r = uip_ds6_route_head();
       PRINTF("No more routes to ");
       PRINT6ADDR(&prefix);
-      dag = default_instance->current_dag;
       /* Propagate this information with a No-Path DAO to preferred parent if we are not a RPL Root */
-      if(dag->rank != ROOT_RANK(default_instance)) {
+      if(dag->rank != ROOT_RANK(dag->instance)) {
         PRINTF(" -> generate No-Path DAO\n");
         dao_output_target(dag->preferred_parent, &prefix, RPL_ZERO_LIFETIME);
         /* Don't schedule more than 1 No-Path DAO, let next iteration handle that */
@@ -219,13 +223,27 @@ rpl_remove_routes_by_nexthop(uip_ipaddr_t *nexthop, rpl_dag_t *dag)
   ANNOTATE("#L %u 0\n", nexthop->u8[sizeof(uip_ipaddr_t) - 1]);
 }
 /*---------------------------------------------------------------------------*/
+static int
+route_in_instance(const uip_ds6_route_t *route, const void *instance)
+{
+  const rpl_dag_t *dag;
+
+  /* Routes that were not installed by RPL are shared by all instances. */
+  dag = route->state.dag;
+  return dag == NULL || dag->instance == instance;
+}
+/*---------------------------------------------------------------------------*/
 uip_ds6_route_t *
 rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix, int prefix_len,
               uip_ipaddr_t *next_hop)
 {
   uip_ds6_route_t *rep;
 
-  if((rep = uip_ds6_route_add(prefix, prefix_len, next_hop)) == NULL) {
+  /* Each instance has its own downward routes, so a target that is
+     reachable in several instances gets one route entry per instance. */
+  rep = uip_ds6_route_add_filtered(prefix, prefix_len, next_hop,
+                                   route_in_instance, dag->instance);
+  if(rep == NULL) {
     PRINTF("RPL: No space for more route entries\n");
     return NULL;
   }
@@ -243,6 +261,34 @@ rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix, int prefix_len,
   return rep;
 }
 /*---------------------------------------------------------------------------*/
+uip_ds6_route_t *
+rpl_lookup_route(rpl_instance_t *instance, uip_ipaddr_t *addr)
+{
+  if(instance == NULL) {
+    return uip_ds6_route_lookup(addr);
+  }
+  return uip_ds6_route_lookup_filtered(addr, route_in_instance, instance);
+}
+/*---------------------------------------------------------------------------*/
+uip_ipaddr_t *
+rpl_get_default_nexthop(rpl_instance_t *instance)
+{
+  rpl_dag_t *dag;
+
+  if(instance == NULL || instance == default_instance) {
+    return uip_ds6_defrt_choose();
+  }
+
+  /* Upward traffic of the other instances must stay in their own DAGs,
+     so it goes to the preferred parent rather than to whichever default
+     router comes first. */
+  dag = instance->current_dag;
+  if(dag == NULL || !dag->joined || dag->preferred_parent == NULL) {
+    return NULL;
+  }
+  return rpl_get_parent_ipaddr(dag->preferred_parent);
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
 {
@@ -43,6 +43,7 @@
 #include "lib/list.h"
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-ds6.h"
+#include "net/nbr-table.h"
 #include "sys/ctimer.h"
 
 /*---------------------------------------------------------------------------*/
@@ -111,11 +112,17 @@ struct rpl_parent {
   rpl_metric_container_t mc;
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
   rpl_rank_t rank;
-  uint16_t link_metric;
+  uint16_t cost;      /* The path cost by which the parent set is ordered. */
+  uint8_t set_index;  /* One more than the position in the parent set,
+                         or zero if the parent is not in the set. */
   uint8_t dtsn;
   uint8_t updated;
 };
 typedef struct rpl_parent rpl_parent_t;
+
+#if NBR_TABLE_MAX_NEIGHBORS > 255
+#error "The RPL parent set cannot hold more than 255 parents"
+#endif
 /*---------------------------------------------------------------------------*/
 /* RPL DIO prefix suboption */
 struct rpl_prefix {
@@ -137,6 +144,10 @@ struct rpl_dag {
   /* live data for the DAG */
   uint8_t joined;
   rpl_parent_t *preferred_parent;
+  /* The candidate parents with a finite rank, kept as a binary
+     min-heap on their path cost. */
+  rpl_parent_t *parent_set[NBR_TABLE_MAX_NEIGHBORS];
+  uint8_t parent_count;
   rpl_rank_t rank;
   struct rpl_instance *instance;
   rpl_prefix_t prefix_info;
@@ -160,7 +171,15 @@ typedef struct rpl_instance rpl_instance_t;
  *
  * best_parent(parent1, parent2)
  *
- *  Compares two parents and returns the best one, according to the OF.
+ *  Compares the preferred parent (parent1) with the best candidate in the
+ *  parent set (parent2) and returns the best one, according to the OF.
+ *  This is where the OF applies its hysteresis against parent switches.
+ *
+ * parent_path_cost(parent)
+ *
+ *  Returns the cost of the path to the root through a parent. The parent
+ *  set of a DAG is ordered by this cost, so it must only depend on the
+ *  information about the parent itself.
  *
  * best_dag(dag1, dag2)
  *
@@ -183,6 +202,7 @@ struct rpl_of {
   void (*reset)(struct rpl_dag *);
   void (*neighbor_link_callback)(rpl_parent_t *, int, int);
   rpl_parent_t *(*best_parent)(rpl_parent_t *, rpl_parent_t *);
+  uint16_t (*parent_path_cost)(rpl_parent_t *);
   rpl_dag_t *(*best_dag)(rpl_dag_t *, rpl_dag_t *);
   rpl_rank_t (*calculate_rank)(rpl_parent_t *, rpl_rank_t);
   void (*update_metric_container)( rpl_instance_t *);
@@ -192,6 +212,9 @@ typedef struct rpl_of rpl_of_t;
 
 /* Declare the selected objective function. */
 extern rpl_of_t RPL_OF;
+/* Declare the objective functions that can be run in an instance. */
+extern rpl_of_t rpl_of0;
+extern rpl_of_t rpl_mrhof;
 /*---------------------------------------------------------------------------*/
 /* Instance */
 struct rpl_instance {
@@ -232,11 +255,19 @@ struct rpl_instance {
 void rpl_init(void);
 void uip_rpl_input(void);
 rpl_dag_t *rpl_set_root(uint8_t instance_id, uip_ipaddr_t * dag_id);
+rpl_dag_t *rpl_set_root_with_of(uint8_t instance_id, uip_ipaddr_t *dag_id,
+                                rpl_of_t *of);
 int rpl_set_prefix(rpl_dag_t *dag, uip_ipaddr_t *prefix, unsigned len);
 int rpl_repair_root(uint8_t instance_id);
 int rpl_set_default_route(rpl_instance_t *instance, uip_ipaddr_t *from);
 rpl_dag_t *rpl_get_any_dag(void);
 rpl_instance_t *rpl_get_instance(uint8_t instance_id);
+void rpl_set_default_instance(rpl_instance_t *instance);
+int rpl_set_output_instance(uint8_t instance_id);
+rpl_instance_t *rpl_get_packet_instance(void);
+uip_ds6_route_t *rpl_lookup_route(rpl_instance_t *instance,
+                                  uip_ipaddr_t *addr);
+uip_ipaddr_t *rpl_get_default_nexthop(rpl_instance_t *instance);
 void rpl_update_header_empty(void);
 int rpl_update_header_final(uip_ipaddr_t *addr);
 int rpl_verify_header(int);
@@ -245,7 +276,7 @@ void rpl_remove_header(void);
 uint8_t rpl_invert_header(void);
 uip_ipaddr_t *rpl_get_parent_ipaddr(rpl_parent_t *nbr);
 rpl_rank_t rpl_get_parent_rank(uip_lladdr_t *addr);
-uint16_t rpl_get_parent_link_metric(const uip_lladdr_t *addr);
+uint16_t rpl_get_parent_link_metric(rpl_parent_t *p);
 void rpl_dag_init(void);
 
 
@@ -0,0 +1,156 @@
+/* -*- C -*- */
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         SLIP driver for the native platform. By default a pseudo
+ *         terminal is created and its name printed, so that tunslip6
+ *         can be attached with -s. Set SLIP_ARCH_CONF_DEVICE to use
+ *         a serial device instead. Incoming data is read in blocks
+ *         and passed to slip_input_block().
+ */
+
+#define _XOPEN_SOURCE 600
+#include "contiki.h"
+#include "dev/slip.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifdef SLIP_ARCH_CONF_READ_SIZE
+#define READ_SIZE SLIP_ARCH_CONF_READ_SIZE
+#else
+#define READ_SIZE 512
+#endif
+
+#define SLIP_END 0300
+
+static int slip_fd = -1;
+static uint8_t outbuf[READ_SIZE];
+static int outlen;
+/*---------------------------------------------------------------------------*/
+static void
+flush_output(void)
+{
+  int written, n;
+
+  for(written = 0; written < outlen; written += n) {
+    n = write(slip_fd, &outbuf[written], outlen - written);
+    if(n < 0) {
+      if(errno == EINTR || errno == EAGAIN) {
+        n = 0;
+        continue;
+      }
+      perror("slip-arch: write");
+      break;
+    }
+  }
+  outlen = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_arch_writeb(unsigned char c)
+{
+  if(slip_fd < 0) {
+    return;
+  }
+  outbuf[outlen++] = c;
+  if(c == SLIP_END || outlen == sizeof(outbuf)) {
+    flush_output();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+set_fd(fd_set *rset, fd_set *wset)
+{
+  FD_SET(slip_fd, rset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_fd(fd_set *rset, fd_set *wset)
+{
+  uint8_t buf[READ_SIZE];
+  int len;
+
+  if(FD_ISSET(slip_fd, rset)) {
+    len = read(slip_fd, buf, sizeof(buf));
+    if(len > 0) {
+      slip_input_block(buf, len);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct select_callback slip_callback = { set_fd, handle_fd };
+/*---------------------------------------------------------------------------*/
+void
+slip_arch_init(unsigned long ubr)
+{
+  struct termios tty;
+
+#ifdef SLIP_ARCH_CONF_DEVICE
+  slip_fd = open(SLIP_ARCH_CONF_DEVICE, O_RDWR | O_NOCTTY | O_NONBLOCK);
+#else
+  slip_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if(slip_fd >= 0 && (grantpt(slip_fd) < 0 || unlockpt(slip_fd) < 0)) {
+    close(slip_fd);
+    slip_fd = -1;
+  }
+#endif
+  if(slip_fd < 0) {
+    perror("slip-arch: open");
+    return;
+  }
+
+  if(tcgetattr(slip_fd, &tty) == 0) {
+    tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR |
+                     ICRNL | IXON);
+    tty.c_oflag &= ~OPOST;
+    tty.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    tty.c_cflag &= ~(CSIZE | PARENB);
+    tty.c_cflag |= CS8;
+    tcsetattr(slip_fd, TCSANOW, &tty);
+  }
+  fcntl(slip_fd, F_SETFL, O_NONBLOCK);
+
+#ifndef SLIP_ARCH_CONF_DEVICE
+  printf("slip-arch: SLIP on %s\n", ptsname(slip_fd));
+#endif
+
+  select_set_callback(slip_fd, &slip_callback);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \file
+ *         LVM predicate evaluation benchmark for Antelope on the native
+ *         platform.
+ *
+ *         The benchmark compiles a few selection predicates and
+ *         evaluates them over the same generated rows, first one row at
+ *         a time with lvm_execute(), and then in batches of
+ *         LVM_BATCH_SIZE rows with lvm_execute_batch().
+ */
+
+#include "contiki.h"
+
+#include "antelope.h"
+#include "lvm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ROW_COUNT	20000
+#define ROUNDS		50
+
+PROCESS(lvm_bench_process, "Antelope LVM benchmark");
+AUTOSTART_PROCESSES(&lvm_bench_process);
+
+static const char *conditions[] = {
+  "a > 500",
+  "a > 200 AND b < 300",
+  "a >= 100 AND a <= 900 AND b <> c",
+  "a * 2 + b > 1500 OR c = 7",
+  "40 > c OR a - b >= c * 3"
+};
+
+static long a[ROW_COUNT];
+static long b[ROW_COUNT];
+static long c[ROW_COUNT];
+
+static lvm_column_t columns[LVM_MAX_VARIABLE_ID];
+static lvm_row_t selection[LVM_BATCH_SIZE];
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message)
+{
+  printf("%s\n", message);
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+elapsed_ms(clock_time_t start)
+{
+  return (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static void
+generate_rows(void)
+{
+  unsigned long seed;
+  int i;
+
+  seed = 1;
+  for(i = 0; i < ROW_COUNT; i++) {
+    seed = seed * 1103515245UL + 12345;
+    a[i] = (seed >> 16) % 1000;
+    seed = seed * 1103515245UL + 12345;
+    b[i] = (seed >> 16) % 1000;
+    seed = seed * 1103515245UL + 12345;
+    c[i] = (seed >> 16) % 100;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_value(char *name, long l)
+{
+  operand_value_t value;
+
+  value.l = l;
+  lvm_set_variable_value(name, value);
+}
+/*---------------------------------------------------------------------------*/
+static long
+run_per_row(lvm_instance_t *p)
+{
+  lvm_status_t status;
+  long selected;
+  int i;
+
+  selected = 0;
+  for(i = 0; i < ROW_COUNT; i++) {
+    set_value("a", a[i]);
+    set_value("b", b[i]);
+    set_value("c", c[i]);
+    status = lvm_execute(p);
+    if(LVM_ERROR(status)) {
+      fail("Failed to execute the predicate");
+    }
+    selected += status == TRUE;
+  }
+
+  return selected;
+}
+/*---------------------------------------------------------------------------*/
+static long
+run_batched(lvm_instance_t *p, variable_id_t *ids)
+{
+  long selected;
+  unsigned count;
+  int rows;
+  int i, j;
+
+  selected = 0;
+  for(i = 0; i < ROW_COUNT; i += rows) {
+    rows = ROW_COUNT - i < LVM_BATCH_SIZE ? ROW_COUNT - i : LVM_BATCH_SIZE;
+    for(j = 0; j < rows; j++) {
+      columns[ids[0]][j] = a[i + j];
+      columns[ids[1]][j] = b[i + j];
+      columns[ids[2]][j] = c[i + j];
+      selection[j] = j;
+    }
+    count = rows;
+    if(LVM_ERROR(lvm_execute_batch(p, columns, selection, &count))) {
+      fail("Failed to execute the predicate in batch mode");
+    }
+    selected += count;
+  }
+
+  return selected;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_condition(const char *condition)
+{
+  static aql_adt_t adt;
+  static char query[100];
+  variable_id_t ids[3];
+  clock_time_t start;
+  unsigned long per_row_ms;
+  unsigned long batched_ms;
+  long per_row_selected;
+  long batched_selected;
+  int round;
+
+  snprintf(query, sizeof(query), "SELECT a, b, c FROM r WHERE %s;",
+           condition);
+  if(AQL_ERROR(aql_parse(&adt, query)) || adt.lvm_instance == NULL) {
+    fail("Failed to compile the predicate");
+  }
+
+  /* Make sure that all columns have a variable, including those that
+     are not used by the predicate. */
+  lvm_register_variable("a", LVM_LONG);
+  lvm_register_variable("b", LVM_LONG);
+  lvm_register_variable("c", LVM_LONG);
+  ids[0] = lvm_get_variable_id("a");
+  ids[1] = lvm_get_variable_id("b");
+  ids[2] = lvm_get_variable_id("c");
+
+  per_row_selected = batched_selected = 0;
+
+  start = clock_time();
+  for(round = 0; round < ROUNDS; round++) {
+    per_row_selected = run_per_row(adt.lvm_instance);
+  }
+  per_row_ms = elapsed_ms(start);
+
+  start = clock_time();
+  for(round = 0; round < ROUNDS; round++) {
+    batched_selected = run_batched(adt.lvm_instance, ids);
+  }
+  batched_ms = elapsed_ms(start);
+
+  if(per_row_selected != batched_selected) {
+    printf("Per-row evaluation selected %ld rows, batches selected %ld\n",
+           per_row_selected, batched_selected);
+    fail("The evaluation modes disagree");
+  }
+
+  printf("WHERE %s: %ld of %d rows, %lu ms per row, %lu ms batched\n",
+         condition, per_row_selected, ROW_COUNT, per_row_ms, batched_ms);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(lvm_bench_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  generate_rows();
+
+  printf("Evaluating %d rows %d times, %d rows per batch\n",
+         ROW_COUNT, ROUNDS, LVM_BATCH_SIZE);
+  for(i = 0; i < sizeof(conditions) / sizeof(conditions[0]); i++) {
+    run_condition(conditions[i]);
+  }
+
+  printf("Antelope LVM benchmark done\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
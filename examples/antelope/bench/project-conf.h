@@ -0,0 +1,13 @@
+#undef DB_COFFEE_RESERVE_SIZE
+#define DB_COFFEE_RESERVE_SIZE               (640 * 1024UL)
+
+#undef DB_RELATION_POOL_SIZE
+#define DB_RELATION_POOL_SIZE                4
+
+/* Operands take 16 bytes each on 64-bit hosts. */
+#undef DB_VM_BYTECODE_SIZE
+#define DB_VM_BYTECODE_SIZE                  256
+
+/* Evaluate scan conditions over batches of rows, as for bulk analysis. */
+#undef DB_SELECT_BATCH_MEMORY
+#define DB_SELECT_BATCH_MEMORY               128
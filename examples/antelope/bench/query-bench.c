@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \file
+ *         Prepared statement benchmark for Antelope on the native platform.
+ *
+ *         The benchmark runs the same insertions and indexed selections
+ *         with different constants, first by formatting and parsing
+ *         each query with db_query(), and then by binding parameters
+ *         to statements that have been prepared once.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs-coffee.h"
+
+#include "antelope.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ROW_COUNT	5000L
+#define QUERY_ROUNDS	20000L
+
+PROCESS(query_bench_process, "Antelope prepared statement benchmark");
+AUTOSTART_PROCESSES(&query_bench_process);
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message, db_result_t result)
+{
+  printf("%s: %s\n", message, db_get_result_message(result));
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+elapsed_ms(clock_time_t start)
+{
+  return (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static long
+fetch_value(db_handle_t *handle, db_result_t result)
+{
+  attribute_value_t value;
+  long found;
+
+  if(DB_ERROR(result)) {
+    fail("Failed to select", result);
+  }
+
+  found = -1;
+  while(db_processing(handle)) {
+    result = db_process(handle);
+    if(result == DB_GOT_ROW) {
+      if(DB_ERROR(db_get_value(&value, handle, 1))) {
+        fail("Failed to get a value", DB_IMPLEMENTATION_ERROR);
+      }
+      found = db_value_to_long(&value);
+    } else if(result == DB_FINISHED) {
+      break;
+    } else if(DB_ERROR(result)) {
+      fail("Failed to process the selection", result);
+    }
+  }
+  db_free(handle);
+
+  return found;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_value(long id, long value)
+{
+  if(value != id % 1000) {
+    printf("Unexpected value %ld for id %ld\n", value, id);
+    exit(EXIT_FAILURE);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_relation(void)
+{
+  db_result_t result;
+
+  if(DB_ERROR(result = db_query(NULL, "CREATE RELATION samples;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE id DOMAIN LONG IN samples;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN samples;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE INDEX samples.id TYPE INLINE;"))) {
+    fail("Failed to create the relation", result);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(query_bench_process, ev, data)
+{
+  static db_handle_t handle;
+  db_statement_t *insert;
+  db_statement_t *select;
+  db_result_t result;
+  clock_time_t start;
+  long i;
+  long id;
+
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+  db_init();
+
+  create_relation();
+
+  start = clock_time();
+  for(i = 0; i < ROW_COUNT; i++) {
+    id = i;
+    result = db_query(NULL, "INSERT (%ld, %ld) INTO samples;", id, id % 1000);
+    if(DB_ERROR(result)) {
+      fail("Failed to insert a row", result);
+    }
+  }
+  printf("Inserted %ld rows with db_query() in %lu ms\n",
+         ROW_COUNT, elapsed_ms(start));
+
+  start = clock_time();
+  insert = db_prepare("INSERT (?, ?) INTO samples;");
+  if(insert == NULL) {
+    fail("Failed to prepare the insertion", DB_PARSING_ERROR);
+  }
+  for(i = 0; i < ROW_COUNT; i++) {
+    id = ROW_COUNT + i;
+    db_bind_long(insert, 0, id);
+    db_bind_long(insert, 1, id % 1000);
+    result = db_execute(NULL, insert);
+    if(DB_ERROR(result)) {
+      fail("Failed to insert a row", result);
+    }
+  }
+  db_finalize(insert);
+  printf("Inserted %ld rows with a prepared statement in %lu ms\n",
+         ROW_COUNT, elapsed_ms(start));
+
+  start = clock_time();
+  for(i = 0; i < QUERY_ROUNDS; i++) {
+    id = (i * 7919) % (2 * ROW_COUNT);
+    result = db_query(&handle, "SELECT id, value FROM samples WHERE id = %ld;", id);
+    check_value(id, fetch_value(&handle, result));
+  }
+  printf("Ran %ld selections with db_query() in %lu ms\n",
+         QUERY_ROUNDS, elapsed_ms(start));
+
+  start = clock_time();
+  select = db_prepare("SELECT id, value FROM samples WHERE id = ?;");
+  if(select == NULL) {
+    fail("Failed to prepare the selection", DB_PARSING_ERROR);
+  }
+  for(i = 0; i < QUERY_ROUNDS; i++) {
+    id = (i * 7919) % (2 * ROW_COUNT);
+    db_bind_long(select, 0, id);
+    result = db_execute(&handle, select);
+    check_value(id, fetch_value(&handle, result));
+  }
+  db_finalize(select);
+  printf("Ran %ld selections with a prepared statement in %lu ms\n",
+         QUERY_ROUNDS, elapsed_ms(start));
+
+  printf("Antelope prepared statement benchmark done\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Storage benchmark for Antelope on the native platform.
+ *
+ *         The benchmark fills a sensor log relation with a large
+ *         number of rows while holding a reference to the relation,
+ *         so that inserted rows can be batched, and then measures
+ *         repeated full scans and range selections of the relation
+ *         through AQL. The relation is stored both row by row and
+ *         column by column, if the columnar format is enabled.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+
+#include "antelope.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ROW_COUNT	50000UL
+#define SCAN_ROUNDS	20
+#define RANGE_ROUNDS	200
+#define RANGE_ROWS	100
+
+PROCESS(storage_bench_process, "Antelope storage benchmark");
+AUTOSTART_PROCESSES(&storage_bench_process);
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message, db_result_t result)
+{
+  printf("%s: %s\n", message, db_get_result_message(result));
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+elapsed_ms(clock_time_t start)
+{
+  return (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+select_rows(const char *query, unsigned long *sum)
+{
+  static db_handle_t handle;
+  attribute_value_t value;
+  db_result_t result;
+  unsigned long rows;
+
+  result = db_query(&handle, query);
+  if(DB_ERROR(result)) {
+    fail("Failed to select", result);
+  }
+
+  rows = *sum = 0;
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW) {
+      if(DB_ERROR(db_get_value(&value, &handle, 0))) {
+        fail("Failed to get a value", DB_IMPLEMENTATION_ERROR);
+      }
+      rows++;
+      *sum += VALUE_INT(&value);
+    } else if(result == DB_FINISHED) {
+      break;
+    } else if(DB_ERROR(result)) {
+      fail("Failed to process the selection", result);
+    }
+  }
+  db_free(&handle);
+
+  return rows;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_benchmark(const char *format, const char *create_query)
+{
+  relation_t *rel;
+  attribute_value_t values[3];
+  db_result_t result;
+  clock_time_t start;
+  unsigned long i;
+  unsigned long rows;
+  unsigned long sum;
+  long size;
+  int round;
+  int fd;
+
+  printf("Benchmarking the %s format\n", format);
+
+  /* Each relation takes most of the flash, so start from scratch. */
+  cfs_coffee_format();
+  db_init();
+
+  if(DB_ERROR(result = db_query(NULL, create_query)) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE id DOMAIN LONG IN log;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE time DOMAIN LONG IN log;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN log;"))) {
+    fail("Failed to create the relation", result);
+  }
+
+  rel = relation_load("log");
+  if(rel == NULL) {
+    fail("Failed to load the relation", DB_NAME_ERROR);
+  }
+
+  start = clock_time();
+  for(i = 0; i < ROW_COUNT; i++) {
+    values[0].domain = DOMAIN_LONG;
+    VALUE_LONG(&values[0]) = i;
+    values[1].domain = DOMAIN_LONG;
+    VALUE_LONG(&values[1]) = 1000 + i * 30;
+    values[2].domain = DOMAIN_INT;
+    VALUE_INT(&values[2]) = i % 1000;
+    result = relation_insert(rel, values);
+    if(DB_ERROR(result)) {
+      fail("Failed to insert a row", result);
+    }
+  }
+  printf("Inserted %lu rows in %lu ms\n", ROW_COUNT, elapsed_ms(start));
+
+  /* Write any buffered rows before measuring the file size. */
+  relation_release(rel);
+  rel = relation_load("log");
+  if(rel == NULL) {
+    fail("Failed to load the relation", DB_NAME_ERROR);
+  }
+  fd = cfs_open(rel->tuple_filename, CFS_READ);
+  size = fd < 0 ? -1 : (long)cfs_seek(fd, 0, CFS_SEEK_END);
+  cfs_close(fd);
+  relation_release(rel);
+  printf("The tuple file takes %ld bytes\n", size);
+
+  start = clock_time();
+  for(round = 0; round < SCAN_ROUNDS; round++) {
+    rows = select_rows("SELECT value FROM log;", &sum);
+    if(rows != ROW_COUNT ||
+       sum != (ROW_COUNT / 1000) * (999UL * 1000 / 2)) {
+      printf("Unexpected scan result: %lu rows, sum %lu\n", rows, sum);
+      exit(EXIT_FAILURE);
+    }
+  }
+  printf("Scanned %lu rows %d times in %lu ms\n",
+         ROW_COUNT, SCAN_ROUNDS, elapsed_ms(start));
+
+  /* Select a short time window in the middle of the log. */
+  start = clock_time();
+  for(round = 0; round < RANGE_ROUNDS; round++) {
+    rows = select_rows("SELECT value FROM log WHERE time >= 750000 AND time < 753000;",
+                       &sum);
+    if(rows != RANGE_ROWS) {
+      printf("Unexpected range result: %lu rows\n", rows);
+      exit(EXIT_FAILURE);
+    }
+  }
+  printf("Selected %d rows %d times in %lu ms\n",
+         RANGE_ROWS, RANGE_ROUNDS, elapsed_ms(start));
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(storage_bench_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  run_benchmark("row", "CREATE RELATION log;");
+#if DB_FEATURE_COLUMNAR
+  run_benchmark("columnar", "CREATE RELATION log TYPE COLUMNAR;");
+#endif /* DB_FEATURE_COLUMNAR */
+
+  printf("Antelope storage benchmark done\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
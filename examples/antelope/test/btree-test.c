@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \file
+ *         B+-tree index tests for Antelope on the native platform.
+ *
+ *         Each test fills a relation, creates a B+-tree index over it,
+ *         which bulk-loads the existing rows, and compares range
+ *         searches through the index with full scans of a copy of
+ *         the indexed attribute and with the rows expected in C. The
+ *         ranges include open-ended ones and bounds beyond the 32-bit
+ *         keys of the tree. The relation sizes cover a bulk load
+ *         that sorts all keys in RAM, one that merges runs once, and
+ *         one that needs several merge passes.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs-coffee.h"
+
+#include "antelope.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define KEY_MIN		100
+#define KEY_COUNT	1000
+#define EXTRA_ROWS	100
+
+PROCESS(btree_test_process, "Antelope B+-tree test");
+AUTOSTART_PROCESSES(&btree_test_process);
+/*---------------------------------------------------------------------------*/
+static const long sizes[] = {20, 200, 3000};
+
+/* A range has a lower and an upper bound, either of which may be
+   left open with a NULL operator. */
+static const struct {
+  const char *lower;
+  long min;
+  const char *upper;
+  long max;
+} ranges[] = {
+  {">=", KEY_MIN, "<=", KEY_MIN + KEY_COUNT - 1},
+  {">=", KEY_MIN - 10, "<=", KEY_MIN + 5},
+  {">=", KEY_MIN, "<=", KEY_MIN},
+  {">=", 117, "<=", 117},
+  {">=", 499, "<=", 501},
+  {">=", 300, "<=", 600},
+  {">=", 1050, "<=", 2000},
+  {">=", 0, "<=", 50},
+  {">=", 600, "<=", 500},
+  {">", 150, NULL, 0},
+  {">=", KEY_MIN + KEY_COUNT - 10, NULL, 0},
+  {NULL, 0, "<", KEY_MIN + 20},
+  {NULL, 0, "<=", 300},
+  {">", 200, "<", 210},
+  {">", -2147483647L, "<", 2147483647L},
+#if LONG_MAX > 2147483647L
+  /* Bounds beyond the 32-bit keys of the B+-tree. */
+  {">", -5000000000L, "<=", 300},
+  {">=", 500, "<", 5000000000L},
+  {">", 5000000000L, NULL, 0},
+  {NULL, 0, "<", -5000000000L},
+  {">", -5000000000L, "<", 5000000000L},
+#endif
+};
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message, db_result_t result)
+{
+  printf("%s: %s\n", message, db_get_result_message(result));
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+static int
+row_key(long i)
+{
+  return (int)((i * 7919) % KEY_COUNT) + KEY_MIN;
+}
+/*---------------------------------------------------------------------------*/
+static void
+insert_rows(long first, long count)
+{
+  db_result_t result;
+  long i;
+
+  for(i = first; i < first + count; i++) {
+    result = db_query(NULL, "INSERT (%d, %d, %ld) INTO r;",
+                      row_key(i), row_key(i), i);
+    if(DB_ERROR(result)) {
+      fail("Failed to insert a row", result);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+in_range(int i, long key)
+{
+  if(ranges[i].lower != NULL &&
+     (ranges[i].lower[1] == '=' ? key < ranges[i].min : key <= ranges[i].min)) {
+    return 0;
+  }
+  if(ranges[i].upper != NULL &&
+     (ranges[i].upper[1] == '=' ? key > ranges[i].max : key >= ranges[i].max)) {
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+select_range(const char *attribute, int i,
+             unsigned long *rows, unsigned long *sum)
+{
+  static db_handle_t handle;
+  attribute_value_t value;
+  db_result_t result;
+
+  if(ranges[i].lower == NULL) {
+    result = db_query(&handle, "SELECT v FROM r WHERE %s %s %ld;",
+                      attribute, ranges[i].upper, ranges[i].max);
+  } else if(ranges[i].upper == NULL) {
+    result = db_query(&handle, "SELECT v FROM r WHERE %s %s %ld;",
+                      attribute, ranges[i].lower, ranges[i].min);
+  } else {
+    result = db_query(&handle, "SELECT v FROM r WHERE %s %s %ld AND %s %s %ld;",
+                      attribute, ranges[i].lower, ranges[i].min,
+                      attribute, ranges[i].upper, ranges[i].max);
+  }
+  if(DB_ERROR(result)) {
+    fail("Failed to select", result);
+  }
+
+  *rows = 0;
+  *sum = 0;
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW) {
+      if(DB_ERROR(db_get_value(&value, &handle, 0))) {
+        fail("Failed to get a value", DB_IMPLEMENTATION_ERROR);
+      }
+      (*rows)++;
+      *sum += (unsigned long)db_value_to_long(&value) * 2654435761UL;
+    } else if(result == DB_FINISHED) {
+      break;
+    } else if(DB_ERROR(result)) {
+      fail("Failed to process the selection", result);
+    }
+  }
+  db_free(&handle);
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_ranges(long size)
+{
+  unsigned long index_rows;
+  unsigned long index_sum;
+  unsigned long scan_rows;
+  unsigned long scan_sum;
+  unsigned long expected_rows;
+  unsigned long expected_sum;
+  long j;
+  int i;
+
+  for(i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+    expected_rows = 0;
+    expected_sum = 0;
+    for(j = 0; j < size; j++) {
+      if(in_range(i, row_key(j))) {
+        expected_rows++;
+        expected_sum += (unsigned long)j * 2654435761UL;
+      }
+    }
+
+    select_range("k", i, &index_rows, &index_sum);
+    select_range("s", i, &scan_rows, &scan_sum);
+    if(index_rows != expected_rows || index_sum != expected_sum ||
+       scan_rows != expected_rows || scan_sum != expected_sum) {
+      printf("B+-tree test with %ld rows failed for range %d: the index found %lu rows, the scan %lu rows, expected %lu rows\n",
+             size, i, index_rows, scan_rows, expected_rows);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_test(long size)
+{
+  db_result_t result;
+
+  db_query(NULL, "REMOVE RELATION r;");
+
+  if(DB_ERROR(result = db_query(NULL, "CREATE RELATION r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE k DOMAIN INT IN r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE s DOMAIN INT IN r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE v DOMAIN LONG IN r;"))) {
+    fail("Failed to create the relation", result);
+  }
+
+  insert_rows(0, size);
+
+  result = db_query(NULL, "CREATE INDEX r.k TYPE BTREE;");
+  if(DB_ERROR(result)) {
+    fail("Failed to create the index", result);
+  }
+  check_ranges(size);
+
+  /* Insertions split the pages that the bulk load filled. */
+  insert_rows(size, EXTRA_ROWS);
+  check_ranges(size + EXTRA_ROWS);
+
+  printf("B+-tree test with %ld rows passed\n", size);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(btree_test_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+  db_init();
+
+  for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    run_test(sizes[i]);
+  }
+
+  printf("Antelope B+-tree tests passed\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \file
+ *         GROUP BY tests for Antelope on the native platform.
+ *
+ *         The tests aggregate a relation by one or two attributes and
+ *         compare each returned group with aggregates computed in C.
+ *         With the default DB_GROUP_MEMORY, a few dozen groups fit in
+ *         memory, so the larger tests spill many runs of groups to
+ *         storage and merge them repeatedly.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs-coffee.h"
+
+#include "antelope.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROW_COUNT	5000L
+#define MAX_GROUPS	600
+
+PROCESS(group_test_process, "Antelope GROUP BY test");
+AUTOSTART_PROCESSES(&group_test_process);
+/*---------------------------------------------------------------------------*/
+struct group {
+  long count;
+  long sum;
+  long min;
+  long max;
+  int seen;
+};
+
+static struct group groups[MAX_GROUPS];
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message, db_result_t result)
+{
+  printf("%s: %s\n", message, db_get_result_message(result));
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+static long
+row_group(long i, long group_count)
+{
+  return (i * 7919) % group_count;
+}
+/*---------------------------------------------------------------------------*/
+static long
+row_value(long i)
+{
+  return (i * 37) % 1000 - 200;
+}
+/*---------------------------------------------------------------------------*/
+static long
+key_g(long i)
+{
+  return row_group(i, MAX_GROUPS) % 200;
+}
+/*---------------------------------------------------------------------------*/
+static long
+key_h(long i)
+{
+  return row_group(i, MAX_GROUPS) / 200;
+}
+/*---------------------------------------------------------------------------*/
+/* Groups of both g and h are numbered g + 200 * h. */
+static long
+key_gh(long i)
+{
+  return row_group(i, MAX_GROUPS);
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_relation(void)
+{
+  db_result_t result;
+  long i;
+
+  if(DB_ERROR(result = db_query(NULL, "CREATE RELATION r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE g DOMAIN INT IN r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE h DOMAIN INT IN r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE v DOMAIN LONG IN r;"))) {
+    fail("Failed to create the relation", result);
+  }
+
+  /* Together, g and h form MAX_GROUPS groups. */
+  for(i = 0; i < ROW_COUNT; i++) {
+    result = db_query(NULL, "INSERT (%ld, %ld, %ld) INTO r;",
+                      key_g(i), key_h(i), row_value(i));
+    if(DB_ERROR(result)) {
+      fail("Failed to insert a row", result);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Compute the expected aggregates of the groups over the rows whose
+   value is at least min_value. */
+static long
+expect_groups(long (*key)(long), long min_value)
+{
+  struct group *group;
+  long count;
+  long i;
+
+  memset(groups, 0, sizeof(groups));
+  count = 0;
+  for(i = 0; i < ROW_COUNT; i++) {
+    if(row_value(i) < min_value) {
+      continue;
+    }
+    group = &groups[key(i)];
+    if(group->count == 0) {
+      group->min = LONG_MAX;
+      group->max = LONG_MIN;
+      count++;
+    }
+    group->count++;
+    group->sum += row_value(i);
+    if(row_value(i) < group->min) {
+      group->min = row_value(i);
+    }
+    if(row_value(i) > group->max) {
+      group->max = row_value(i);
+    }
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static long
+get_long(db_handle_t *handle, int column)
+{
+  attribute_value_t value;
+
+  if(DB_ERROR(db_get_value(&value, handle, column))) {
+    fail("Failed to get a value", DB_IMPLEMENTATION_ERROR);
+  }
+  return db_value_to_long(&value);
+}
+/*---------------------------------------------------------------------------*/
+/* Check the groups of a query whose first columns are the group
+   attributes, followed by the aggregates in the order given. */
+static void
+check_query(const char *name, const char *query, long (*key)(long),
+            long min_value, int group_columns, const char *aggregates)
+{
+  static db_handle_t handle;
+  struct group *group;
+  db_result_t result;
+  long expected_groups;
+  long rows;
+  long index;
+  long expected;
+  long value;
+  int i;
+
+  expected_groups = expect_groups(key, min_value);
+
+  result = db_query(&handle, query);
+  if(DB_ERROR(result)) {
+    fail("Failed to select", result);
+  }
+
+  rows = 0;
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_FINISHED) {
+      break;
+    } else if(DB_ERROR(result)) {
+      fail("Failed to process the selection", result);
+    } else if(result != DB_GOT_ROW) {
+      continue;
+    }
+
+    rows++;
+    index = get_long(&handle, 0);
+    if(group_columns == 2) {
+      index += 200 * get_long(&handle, 1);
+    }
+    if(index < 0 || index >= MAX_GROUPS) {
+      printf("GROUP BY test \"%s\" returned an invalid group %ld\n",
+             name, index);
+      exit(EXIT_FAILURE);
+    }
+    group = &groups[index];
+    if(group->count == 0 || group->seen) {
+      printf("GROUP BY test \"%s\" returned group %ld unexpectedly\n",
+             name, index);
+      exit(EXIT_FAILURE);
+    }
+    group->seen = 1;
+
+    for(i = 0; aggregates[i] != '\0'; i++) {
+      switch(aggregates[i]) {
+      case 'c':
+        expected = group->count;
+        break;
+      case 's':
+        expected = group->sum;
+        break;
+      case 'n':
+        expected = group->min;
+        break;
+      case 'x':
+        expected = group->max;
+        break;
+      default:
+        expected = group->sum / group->count;
+        break;
+      }
+      value = get_long(&handle, group_columns + i);
+      if(value != expected) {
+        printf("GROUP BY test \"%s\": group %ld has %ld in column %d, expected %ld\n",
+               name, index, value, group_columns + i, expected);
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+  db_free(&handle);
+
+  if(rows != expected_groups) {
+    printf("GROUP BY test \"%s\" returned %ld groups, expected %ld\n",
+           name, rows, expected_groups);
+    exit(EXIT_FAILURE);
+  }
+  printf("GROUP BY test \"%s\": %ld groups\n", name, rows);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(group_test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+  db_init();
+
+  create_relation();
+
+  check_query("few groups",
+              "SELECT h, COUNT(v), SUM(v), MIN(v), MAX(v) FROM r GROUP BY h;",
+              key_h, LONG_MIN, 1, "csnx");
+  check_query("spilled groups",
+              "SELECT g, COUNT(v), SUM(v), MIN(v), MAX(v) FROM r GROUP BY g;",
+              key_g, LONG_MIN, 1, "csnx");
+  check_query("spilled means",
+              "SELECT g, MEAN(v) FROM r WHERE v >= 100 GROUP BY g;",
+              key_g, 100, 1, "m");
+  check_query("spilled groups of two attributes",
+              "SELECT g, h, SUM(v), MAX(v) FROM r GROUP BY g, h;",
+              key_gh, LONG_MIN, 2, "sx");
+
+  printf("Antelope GROUP BY tests passed\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \file
+ *         Hash join tests for Antelope on the native platform.
+ *
+ *         Each test joins two relations on an attribute without an
+ *         index, which makes Antelope use a hash join, and compares
+ *         the result with a nested-loop join computed in C. The
+ *         relation sizes are chosen so that the smaller relation fits
+ *         in DB_JOIN_MEMORY, needs a block nested-loop join, or is
+ *         partitioned to storage. A join that cannot create its
+ *         partition files must fall back to a block nested-loop join.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs-coffee.h"
+#include "cfs-coffee-arch.h"
+
+#include "antelope.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+PROCESS(join_test_process, "Antelope hash join test");
+AUTOSTART_PROCESSES(&join_test_process);
+/*---------------------------------------------------------------------------*/
+struct join_case {
+  const char *name;
+  long left_rows;
+  long left_keys;
+  long right_rows;
+  long right_keys;
+  int fill_storage;
+};
+
+/*
+ * With the default DB_JOIN_MEMORY, a hash table holds about 50 rows
+ * of these relations. The last cases thus cover the block nested-loop
+ * join and the partitioned join chosen by the planner.
+ */
+static const struct join_case cases[] = {
+  {"unique keys", 40, 40, 30, 30, 0},
+  {"duplicate keys", 40, 7, 30, 5, 0},
+  {"no matching keys", 20, 1, 20, 1, 0},
+  {"empty left", 0, 1, 30, 5, 0},
+  {"empty right", 40, 7, 0, 1, 0},
+  {"block nested loop", 300, 60, 200, 40, 0},
+  {"partitioned", 800, 90, 600, 70, 0},
+  {"partitioned without space", 800, 90, 600, 70, 1},
+};
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message, db_result_t result)
+{
+  printf("%s: %s\n", message, db_get_result_message(result));
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+/* The right relation gets keys that are offset from the left keys
+   in the "no matching keys" case. */
+static long
+left_key(const struct join_case *c, long i)
+{
+  return i % c->left_keys;
+}
+/*---------------------------------------------------------------------------*/
+static long
+right_key(const struct join_case *c, long i)
+{
+  return (i * 3) % c->right_keys + (c->left_keys == 1 ? 1 : 0);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+pair_checksum(long left_value, long right_value)
+{
+  return (unsigned long)left_value * 65599UL + (unsigned long)right_value;
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_relations(const struct join_case *c)
+{
+  db_result_t result;
+  long i;
+
+  db_query(NULL, "REMOVE RELATION l;");
+  db_query(NULL, "REMOVE RELATION r;");
+
+  if(DB_ERROR(result = db_query(NULL, "CREATE RELATION l;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE k DOMAIN INT IN l;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE lv DOMAIN LONG IN l;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE RELATION r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE k DOMAIN INT IN r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE rv DOMAIN LONG IN r;"))) {
+    fail("Failed to create the relations", result);
+  }
+
+  for(i = 0; i < c->left_rows; i++) {
+    result = db_query(NULL, "INSERT (%ld, %ld) INTO l;", left_key(c, i), i);
+    if(DB_ERROR(result)) {
+      fail("Failed to insert a row", result);
+    }
+  }
+  for(i = 0; i < c->right_rows; i++) {
+    result = db_query(NULL, "INSERT (%ld, %ld) INTO r;", right_key(c, i),
+                      1000 + i);
+    if(DB_ERROR(result)) {
+      fail("Failed to insert a row", result);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Reserve the free space of the file system, so that no partition
+   files can be created. */
+static int
+fill_storage(void)
+{
+  char name[24];
+  unsigned long size;
+  int files;
+
+  files = 0;
+  for(size = COFFEE_SIZE; size >= COFFEE_PAGE_SIZE;) {
+    snprintf(name, sizeof(name), "fill.%d", files);
+    if(cfs_coffee_reserve(name, size) < 0) {
+      size /= 2;
+    } else {
+      files++;
+    }
+  }
+  return files;
+}
+/*---------------------------------------------------------------------------*/
+static void
+release_storage(int files)
+{
+  char name[24];
+
+  while(files-- > 0) {
+    snprintf(name, sizeof(name), "fill.%d", files);
+    cfs_remove(name);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_case(const struct join_case *c)
+{
+  static db_handle_t handle;
+  attribute_value_t left_value;
+  attribute_value_t right_value;
+  db_result_t result;
+  unsigned long expected_rows;
+  unsigned long expected_sum;
+  unsigned long rows;
+  unsigned long sum;
+  long i;
+  long j;
+  int fill_files;
+
+  create_relations(c);
+  fill_files = c->fill_storage ? fill_storage() : 0;
+
+  expected_rows = 0;
+  expected_sum = 0;
+  for(i = 0; i < c->left_rows; i++) {
+    for(j = 0; j < c->right_rows; j++) {
+      if(left_key(c, i) == right_key(c, j)) {
+        expected_rows++;
+        expected_sum += pair_checksum(i, 1000 + j);
+      }
+    }
+  }
+
+  result = db_query(&handle, "JOIN l, r ON k PROJECT lv, rv;");
+  if(DB_ERROR(result)) {
+    fail("Failed to join", result);
+  }
+
+  rows = 0;
+  sum = 0;
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW) {
+      if(DB_ERROR(db_get_value(&left_value, &handle, 0)) ||
+         DB_ERROR(db_get_value(&right_value, &handle, 1))) {
+        fail("Failed to get a value", DB_IMPLEMENTATION_ERROR);
+      }
+      rows++;
+      sum += pair_checksum(db_value_to_long(&left_value),
+                           db_value_to_long(&right_value));
+    } else if(result == DB_FINISHED) {
+      break;
+    } else if(DB_ERROR(result)) {
+      fail("Failed to process the join", result);
+    }
+  }
+  db_free(&handle);
+  release_storage(fill_files);
+
+  if(rows != expected_rows || sum != expected_sum) {
+    printf("Join test \"%s\" failed: got %lu rows (checksum %lu), expected %lu rows (checksum %lu)\n",
+           c->name, rows, sum, expected_rows, expected_sum);
+    exit(EXIT_FAILURE);
+  }
+  printf("Join test \"%s\": %lu rows\n", c->name, rows);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(join_test_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+  db_init();
+
+  for(i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    run_case(&cases[i]);
+  }
+
+  printf("Antelope hash join tests passed\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Query tests for Antelope on the native platform.
+ *
+ *         Each test runs queries over a relation whose rows are known,
+ *         with an index on one attribute, and compares the number of
+ *         selected or remaining rows with the number expected in C.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs-coffee.h"
+
+#include "antelope.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ROWS		200
+
+PROCESS(query_test_process, "Antelope query test");
+AUTOSTART_PROCESSES(&query_test_process);
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message, db_result_t result)
+{
+  printf("%s: %s\n", message, db_get_result_message(result));
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+/* Create the relation r with ROWS rows and an index on k. The
+   attributes s, a and b are copies of k, and v is 1000 times k. */
+static void
+create_relation(void)
+{
+  db_result_t result;
+  long i;
+
+  db_query(NULL, "REMOVE RELATION r;");
+
+  if(DB_ERROR(result = db_query(NULL, "CREATE RELATION r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE k DOMAIN INT IN r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE s DOMAIN INT IN r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE a DOMAIN INT IN r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE b DOMAIN INT IN r;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE v DOMAIN LONG IN r;"))) {
+    fail("Failed to create the relation", result);
+  }
+
+  /* An inline index over an empty relation is ready at once. The rows
+     are inserted in the order of k, as the inline index requires. */
+  result = db_query(NULL, "CREATE INDEX r.k TYPE INLINE;");
+  if(DB_ERROR(result)) {
+    fail("Failed to create the index", result);
+  }
+
+  for(i = 0; i < ROWS; i++) {
+    result = db_query(NULL, "INSERT (%ld, %ld, %ld, %ld, %ld) INTO r;",
+                      i, i, i, i, i * 1000);
+    if(DB_ERROR(result)) {
+      fail("Failed to insert a row", result);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *query, long expected)
+{
+  static db_handle_t handle;
+  db_result_t result;
+  long rows;
+
+  result = db_query(&handle, query);
+  if(DB_ERROR(result)) {
+    fail(query, result);
+  }
+
+  rows = 0;
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW) {
+      rows++;
+    } else if(result == DB_FINISHED) {
+      break;
+    } else if(DB_ERROR(result)) {
+      fail(query, result);
+    }
+  }
+  db_free(&handle);
+
+  if(rows != expected) {
+    printf("%s: got %ld rows, expected %ld rows\n", query, rows, expected);
+    exit(EXIT_FAILURE);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(const char *query)
+{
+  static db_handle_t handle;
+  db_result_t result;
+
+  result = db_query(&handle, query);
+  if(DB_ERROR(result)) {
+    fail(query, result);
+  }
+
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_FINISHED) {
+      break;
+    } else if(DB_ERROR(result)) {
+      fail(query, result);
+    }
+  }
+  db_free(&handle);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_variables(void)
+{
+  /* The condition refers to AQL_ATTRIBUTE_LIMIT attributes. */
+  check("SELECT k FROM r WHERE k + s > 20 AND a + b > 40 AND v > 30000;",
+        ROWS - 31);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_stale_derivations(void)
+{
+  /* The range of k derived for the first query must not restrict the
+     second one to the index entry of k = 5. */
+  check("SELECT s FROM r WHERE k = 5;", 1);
+  check("SELECT s FROM r WHERE s > 150;", ROWS - 151);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_mirrored_comparisons(void)
+{
+  /* The constant is the left operand of the first comparison. */
+  check("SELECT s FROM r WHERE 150 < k AND k >= 100 AND k <= 180;", 30);
+  check("SELECT s FROM r WHERE 10 >= k AND k >= 5 AND k <= 50;", 6);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_or(void)
+{
+  /* Only one side of the OR restricts k, so the index cannot be used. */
+  check("SELECT s FROM r WHERE k < 10 OR s > 189;", 20);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_remove(void)
+{
+  /* A removal keeps the tuples outside of the range of k. */
+  run("REMOVE FROM r WHERE k < 10;");
+  check("SELECT k FROM r;", ROWS - 10);
+  create_relation();
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_repeated_remove(void)
+{
+  /* The second removal replaces r again with a result relation by
+     the same name as the first one. */
+  run("REMOVE FROM r WHERE s = 50;");
+  run("REMOVE FROM r WHERE s = 60;");
+  check("SELECT k FROM r;", ROWS - 2);
+  create_relation();
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_aggregate(void)
+{
+  static db_handle_t handle;
+  attribute_t *attr;
+  db_result_t result;
+
+  /* Ungrouped aggregates are INT values, also of LONG attributes. */
+  result = db_query(&handle, "SELECT MAX(v) FROM r;");
+  if(DB_ERROR(result)) {
+    fail("Failed to aggregate", result);
+  }
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_FINISHED) {
+      break;
+    } else if(DB_ERROR(result)) {
+      fail("Failed to aggregate", result);
+    }
+  }
+  attr = list_head(handle.result_rel->attributes);
+  if(attr->domain != DOMAIN_INT || attr->element_size != 2) {
+    printf("An INT aggregate has %d-byte values\n", (int)attr->element_size);
+    exit(EXIT_FAILURE);
+  }
+  db_free(&handle);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(query_test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+  db_init();
+
+  create_relation();
+  test_variables();
+  test_stale_derivations();
+  test_mirrored_comparisons();
+  test_or();
+  test_remove();
+  test_repeated_remove();
+  test_aggregate();
+
+  printf("Antelope query tests passed\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \file
+ *         Columnar storage tests for Antelope on the native platform.
+ *
+ *         Rows are inserted one query at a time, so that the last
+ *         segment of the relation is decoded and rewritten with each
+ *         row. The values are chosen so that runs of equal deltas merge
+ *         and the rewritten segment becomes shorter than the old one.
+ *         All rows must be read back in order after each insertion.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs-coffee.h"
+
+#include "antelope.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EXTRA_ROWS	200
+
+PROCESS(storage_test_process, "Antelope storage test");
+AUTOSTART_PROCESSES(&storage_test_process);
+/*---------------------------------------------------------------------------*/
+/* The deltas +10 +10 -5 -5 ... form runs that merge as rows are added. */
+static const long values[] = {10, 20, 30, 25, 20, 15, 10, 5, 0};
+#define VALUE_COUNT	(sizeof(values) / sizeof(values[0]))
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message, db_result_t result)
+{
+  printf("%s: %s\n", message, db_get_result_message(result));
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+static long
+row_value(long i)
+{
+  if(i < VALUE_COUNT) {
+    return values[i];
+  }
+  /* Continue with a pattern that alternates between long runs and
+     single deltas. */
+  return (i % 7 < 5 ? i : i * 3) % 1000;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_rows(long count)
+{
+  static db_handle_t handle;
+  attribute_value_t value;
+  db_result_t result;
+  long rows;
+
+  result = db_query(&handle, "SELECT id, value FROM samples;");
+  if(DB_ERROR(result)) {
+    fail("Failed to select", result);
+  }
+
+  rows = 0;
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW) {
+      if(DB_ERROR(db_get_value(&value, &handle, 0)) ||
+         db_value_to_long(&value) != rows ||
+         DB_ERROR(db_get_value(&value, &handle, 1)) ||
+         db_value_to_long(&value) != row_value(rows)) {
+        printf("Row %ld of %ld has unexpected values\n", rows, count);
+        exit(EXIT_FAILURE);
+      }
+      rows++;
+    } else if(result == DB_FINISHED) {
+      break;
+    } else if(DB_ERROR(result)) {
+      printf("Failed to read row %ld of %ld\n", rows, count);
+      fail("Failed to process the selection", result);
+    }
+  }
+  db_free(&handle);
+
+  if(rows != count) {
+    printf("Read %ld rows, expected %ld\n", rows, count);
+    exit(EXIT_FAILURE);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(storage_test_process, ev, data)
+{
+  db_result_t result;
+  long i;
+
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+  db_init();
+
+  if(DB_ERROR(result = db_query(NULL, "CREATE RELATION samples TYPE COLUMNAR;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE id DOMAIN LONG IN samples;")) ||
+     DB_ERROR(result = db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN samples;"))) {
+    fail("Failed to create the relation", result);
+  }
+
+  for(i = 0; i < VALUE_COUNT + EXTRA_ROWS; i++) {
+    result = db_query(NULL, "INSERT (%ld, %ld) INTO samples;", i, row_value(i));
+    if(DB_ERROR(result)) {
+      fail("Failed to insert a row", result);
+    }
+    check_rows(i + 1);
+  }
+
+  printf("Antelope storage tests passed\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
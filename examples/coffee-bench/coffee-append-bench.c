@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Append benchmark for Coffee on the native platform.
+ *
+ *         The benchmark appends small records to an ordinary file, which
+ *         Coffee copies into a larger extent whenever it becomes full,
+ *         and to an append-mode file, which grows by linking new extents.
+ *         Both files are then read back sequentially and verified.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_SIZE	32
+#define RECORD_COUNT	6000
+#define ROUNDS		50
+
+PROCESS(coffee_append_bench_process, "Coffee append benchmark");
+AUTOSTART_PROCESSES(&coffee_append_bench_process);
+/*---------------------------------------------------------------------------*/
+static void
+make_record(unsigned char *record, unsigned i)
+{
+  memset(record, i & 0xff, RECORD_SIZE);
+  record[0] = i >> 8;
+  record[1] = i & 0xff;
+  record[RECORD_SIZE - 1] = 0xff;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+erases(void)
+{
+  struct cfs_coffee_gc_stats stats;
+
+  cfs_coffee_get_gc_stats(&stats);
+  return stats.erases;
+}
+/*---------------------------------------------------------------------------*/
+static int
+run(const char *name, const char *label,
+    clock_time_t *append_time, clock_time_t *read_time)
+{
+  unsigned char record[RECORD_SIZE];
+  unsigned char expected[RECORD_SIZE];
+  clock_time_t start;
+  unsigned i;
+  int fd;
+
+  fd = cfs_open(name, CFS_WRITE | CFS_APPEND);
+  if(fd < 0) {
+    printf("%s: failed to open the file\n", label);
+    return -1;
+  }
+
+  start = clock_time();
+  for(i = 0; i < RECORD_COUNT; i++) {
+    make_record(record, i);
+    if(cfs_write(fd, record, sizeof(record)) != sizeof(record)) {
+      printf("%s: failed to append record %u\n", label, i);
+      cfs_close(fd);
+      return -1;
+    }
+  }
+  *append_time += clock_time() - start;
+  cfs_close(fd);
+
+  fd = cfs_open(name, CFS_READ);
+  if(fd < 0) {
+    printf("%s: failed to reopen the file\n", label);
+    return -1;
+  }
+
+  start = clock_time();
+  for(i = 0; i < RECORD_COUNT; i++) {
+    make_record(expected, i);
+    if(cfs_read(fd, record, sizeof(record)) != sizeof(record) ||
+       memcmp(record, expected, sizeof(record)) != 0) {
+      printf("%s: record %u is corrupt\n", label, i);
+      cfs_close(fd);
+      return -1;
+    }
+  }
+  *read_time += clock_time() - start;
+
+  if(cfs_read(fd, record, sizeof(record)) != 0) {
+    printf("%s: the file is longer than expected\n", label);
+    cfs_close(fd);
+    return -1;
+  }
+  cfs_close(fd);
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(const char *label, clock_time_t append_time, clock_time_t read_time,
+       unsigned long erase_count)
+{
+  printf("%s: appended %lu records in %lu ms, read them in %lu ms\n",
+         label, (unsigned long)RECORD_COUNT * ROUNDS,
+         (unsigned long)(append_time * 1000 / CLOCK_SECOND),
+         (unsigned long)(read_time * 1000 / CLOCK_SECOND));
+  printf("%s: %lu sector erasures\n", label, erase_count);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_append_bench_process, ev, data)
+{
+  clock_time_t plain_append, plain_read, log_append, log_read;
+  unsigned long plain_erases, log_erases, start;
+  unsigned round;
+  int failed;
+
+  PROCESS_BEGIN();
+
+  plain_append = plain_read = log_append = log_read = 0;
+  plain_erases = log_erases = 0;
+  failed = 0;
+
+  cfs_coffee_format();
+
+  for(round = 0; round < ROUNDS && !failed; round++) {
+    start = erases();
+    failed = run("plain", "Ordinary file", &plain_append, &plain_read) < 0;
+    plain_erases += erases() - start;
+
+    if(cfs_coffee_reserve_append("log", 512) < 0) {
+      printf("Failed to reserve the append-mode file\n");
+      exit(EXIT_FAILURE);
+    }
+    start = erases();
+    failed |= run("log", "Append-mode file", &log_append, &log_read) < 0;
+    log_erases += erases() - start;
+
+    /* The space of all extents must be reclaimable after removal. */
+    failed |= cfs_remove("plain") < 0;
+    failed |= cfs_remove("log") < 0;
+  }
+
+  report("Ordinary file", plain_append, plain_read, plain_erases);
+  report("Append-mode file", log_append, log_read, log_erases);
+
+  exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
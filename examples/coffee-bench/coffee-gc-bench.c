@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Garbage collection benchmark for Coffee on the native platform.
+ *
+ *         The benchmark rewrites a set of files in a round-robin manner
+ *         until the storage has been filled several times, and reports
+ *         the longest time spent in a single file operation together
+ *         with the garbage collection statistics.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILE_COUNT	16
+#define FILE_SIZE	8192
+#define ITERATIONS	400
+
+PROCESS(coffee_gc_bench_process, "Coffee GC benchmark");
+AUTOSTART_PROCESSES(&coffee_gc_bench_process);
+/*---------------------------------------------------------------------------*/
+static int
+write_file(unsigned i, clock_time_t *longest)
+{
+  char name[16];
+  char buf[256];
+  clock_time_t start, elapsed;
+  int fd, r;
+  unsigned written;
+
+  snprintf(name, sizeof(name), "file-%u", i % FILE_COUNT);
+  memset(buf, i, sizeof(buf));
+
+  cfs_remove(name);
+
+  start = clock_time();
+  fd = cfs_open(name, CFS_WRITE);
+  elapsed = clock_time() - start;
+  if(elapsed > *longest) {
+    *longest = elapsed;
+  }
+  if(fd < 0) {
+    return -1;
+  }
+
+  for(written = 0; written < FILE_SIZE; written += r) {
+    start = clock_time();
+    r = cfs_write(fd, buf, sizeof(buf));
+    elapsed = clock_time() - start;
+    if(elapsed > *longest) {
+      *longest = elapsed;
+    }
+    if(r != sizeof(buf)) {
+      cfs_close(fd);
+      return -1;
+    }
+  }
+
+  cfs_close(fd);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+verify_file(unsigned i)
+{
+  char name[16];
+  char buf[256];
+  unsigned j, total;
+  int fd, r;
+
+  snprintf(name, sizeof(name), "file-%u", i % FILE_COUNT);
+  fd = cfs_open(name, CFS_READ);
+  if(fd < 0) {
+    return -1;
+  }
+
+  for(total = 0; (r = cfs_read(fd, buf, sizeof(buf))) > 0; total += r) {
+    for(j = 0; j < r; j++) {
+      if(buf[j] != (char)i) {
+        cfs_close(fd);
+        return -1;
+      }
+    }
+  }
+
+  cfs_close(fd);
+  return total == FILE_SIZE ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_gc_bench_process, ev, data)
+{
+  static struct etimer et;
+  static unsigned i;
+  static clock_time_t longest;
+  static unsigned failures;
+  struct cfs_coffee_gc_stats stats;
+
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+
+  longest = 0;
+  failures = 0;
+  for(i = 0; i < ITERATIONS; i++) {
+    if(write_file(i, &longest) < 0) {
+      failures++;
+    }
+    /* Give the background garbage collector a chance to run. */
+    etimer_set(&et, CLOCK_SECOND / 100);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  }
+
+  for(i = ITERATIONS - FILE_COUNT; i < ITERATIONS; i++) {
+    if(verify_file(i) < 0) {
+      printf("File %u has been corrupted\n", i % FILE_COUNT);
+      failures++;
+    }
+  }
+
+  cfs_coffee_get_gc_stats(&stats);
+  printf("Wrote %u files with %u failures\n", ITERATIONS, failures);
+  printf("Longest file operation: %lu ms\n",
+         (unsigned long)(longest * 1000 / CLOCK_SECOND));
+  printf("Synchronous collections: %lu, longest: %lu ms\n",
+         stats.collections,
+         (unsigned long)(stats.longest_stall * 1000 / CLOCK_SECOND));
+  printf("Erased sectors: %lu (%lu in the background)\n",
+         stats.erases, stats.incremental_steps);
+  printf("Sector erase counts: min %u, max %u\n",
+         stats.min_erase_count, stats.max_erase_count);
+
+  exit(failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Open-latency benchmark for Coffee on the native platform.
+ *
+ *         The benchmark fills the file system with a large number of
+ *         small files and measures the time needed to open existing
+ *         and non-existing files. Since Coffee only caches the metadata
+ *         of COFFEE_MAX_OPEN_FILES files, most opens must locate the
+ *         file either through the name index or by scanning the storage.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FILE_COUNT	500
+#define FILE_SIZE	128
+#define ROUNDS		20
+
+PROCESS(coffee_open_bench_process, "Coffee open benchmark");
+AUTOSTART_PROCESSES(&coffee_open_bench_process);
+/*---------------------------------------------------------------------------*/
+static void
+file_name(char *name, unsigned size, unsigned i)
+{
+  snprintf(name, size, "file-%u", i);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+open_files(unsigned offset)
+{
+  char name[16];
+  unsigned i, round;
+  unsigned long opened;
+  int fd;
+
+  opened = 0;
+  for(round = 0; round < ROUNDS; round++) {
+    for(i = 0; i < FILE_COUNT; i++) {
+      file_name(name, sizeof(name), i + offset);
+      fd = cfs_open(name, CFS_READ);
+      if(fd >= 0) {
+        cfs_close(fd);
+        opened++;
+      }
+    }
+  }
+  return opened;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_open_bench_process, ev, data)
+{
+  char name[16];
+  unsigned i;
+  unsigned long opened;
+  clock_time_t start, elapsed;
+  int fd;
+
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+
+  for(i = 0; i < FILE_COUNT; i++) {
+    file_name(name, sizeof(name), i);
+    if(cfs_coffee_reserve(name, FILE_SIZE) < 0) {
+      printf("Failed to reserve file %u\n", i);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  start = clock_time();
+  opened = open_files(0);
+  elapsed = clock_time() - start;
+  printf("Opened %lu existing files in %lu ms\n",
+         opened, (unsigned long)(elapsed * 1000 / CLOCK_SECOND));
+  if(opened != (unsigned long)FILE_COUNT * ROUNDS) {
+    printf("Failed to open all files\n");
+    exit(EXIT_FAILURE);
+  }
+
+  start = clock_time();
+  opened = open_files(FILE_COUNT);
+  elapsed = clock_time() - start;
+  printf("Looked up %lu non-existing files in %lu ms\n",
+         (unsigned long)FILE_COUNT * ROUNDS,
+         (unsigned long)(elapsed * 1000 / CLOCK_SECOND));
+  if(opened != 0) {
+    printf("Opened a non-existing file\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Remove every other file and verify that the rest can be found. */
+  for(i = 0; i < FILE_COUNT; i += 2) {
+    file_name(name, sizeof(name), i);
+    cfs_remove(name);
+  }
+  for(i = 0; i < FILE_COUNT; i++) {
+    file_name(name, sizeof(name), i);
+    fd = cfs_open(name, CFS_READ);
+    if((fd >= 0) != (i & 1)) {
+      printf("Lookup of file %u is inconsistent after removal\n", i);
+      exit(EXIT_FAILURE);
+    }
+    cfs_close(fd);
+  }
+
+  printf("Coffee open benchmark done\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ *
+ */
+/**
+ * \file
+ *         IEEE 802.15.4 framer benchmark on the native platform.
+ *
+ *         The benchmark makes a corpus of outgoing packets, most of
+ *         them to a few neighbors as in a routed network, and a corpus
+ *         of incoming frames of several shapes. It checks that
+ *         framer_802154 creates and parses them exactly like the plain
+ *         frame802154 functions, and then times both.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/mac/frame802154.h"
+#include "net/mac/framer-802154.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NEIGHBORS	8
+#define CORPUS_SIZE	256
+#define PAYLOAD_SIZE	60
+#define ROUNDS		20000
+
+struct packet {
+  linkaddr_t receiver;
+  uint8_t pending;
+  uint8_t seqno;
+};
+
+struct frame {
+  uint8_t data[PAYLOAD_SIZE + 32];
+  int len;
+};
+
+struct parse_result {
+  int ret;
+  int datalen;
+  linkaddr_t sender;
+  linkaddr_t receiver;
+  uint16_t pending;
+  uint16_t packet_id;
+};
+
+static linkaddr_t neighbors[NEIGHBORS];
+static struct packet packets[CORPUS_SIZE];
+static struct frame frames[CORPUS_SIZE];
+static uint8_t payload[PAYLOAD_SIZE];
+
+PROCESS(framer_bench_process, "802.15.4 framer benchmark");
+AUTOSTART_PROCESSES(&framer_bench_process);
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message)
+{
+  printf("%s\n", message);
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+elapsed_ms(clock_time_t start)
+{
+  return (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static void
+make_addr(linkaddr_t *addr, unsigned i)
+{
+  unsigned j;
+
+  for(j = 0; j < sizeof(addr->u8); j++) {
+    addr->u8[j] = (uint8_t)(i * 37 + j * 11 + 1);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Create the header as framer_802154 did before it had templates. */
+static int
+reference_create(void)
+{
+  frame802154_t params;
+  int len;
+
+  memset(&params, 0, sizeof(params));
+  params.fcf.frame_type = FRAME802154_DATAFRAME;
+  params.fcf.frame_pending = packetbuf_attr(PACKETBUF_ATTR_PENDING);
+  if(linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null)) {
+    params.fcf.ack_required = 0;
+  } else {
+    params.fcf.ack_required = packetbuf_attr(PACKETBUF_ATTR_MAC_ACK);
+  }
+  params.fcf.frame_version = FRAME802154_IEEE802154_2003;
+  params.seq = packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO);
+  if(sizeof(linkaddr_t) == 2) {
+    params.fcf.src_addr_mode = FRAME802154_SHORTADDRMODE;
+  } else {
+    params.fcf.src_addr_mode = FRAME802154_LONGADDRMODE;
+  }
+  params.dest_pid = framer_802154_get_panid();
+  if(linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null)) {
+    params.fcf.dest_addr_mode = FRAME802154_SHORTADDRMODE;
+    params.dest_addr[0] = 0xFF;
+    params.dest_addr[1] = 0xFF;
+  } else {
+    linkaddr_copy((linkaddr_t *)&params.dest_addr,
+                  packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+    if(sizeof(linkaddr_t) == 2) {
+      params.fcf.dest_addr_mode = FRAME802154_SHORTADDRMODE;
+    } else {
+      params.fcf.dest_addr_mode = FRAME802154_LONGADDRMODE;
+    }
+  }
+  params.src_pid = framer_802154_get_panid();
+  linkaddr_copy((linkaddr_t *)&params.src_addr, &linkaddr_node_addr);
+  params.payload = packetbuf_dataptr();
+  params.payload_len = packetbuf_datalen();
+
+  len = frame802154_hdrlen(&params);
+  if(packetbuf_hdralloc(len)) {
+    frame802154_create(&params, packetbuf_hdrptr(), len);
+    return len;
+  }
+  return FRAMER_FAILED;
+}
+/*---------------------------------------------------------------------------*/
+/* Parse a frame as framer_802154 did before it had a fast path. */
+static int
+reference_parse(void)
+{
+  frame802154_t frame;
+  int len;
+
+  len = packetbuf_datalen();
+  if(frame802154_parse(packetbuf_dataptr(), len, &frame) &&
+     packetbuf_hdrreduce(len - frame.payload_len)) {
+    if(frame.fcf.dest_addr_mode) {
+      if(frame.dest_pid != framer_802154_get_panid() &&
+         frame.dest_pid != FRAME802154_BROADCASTPANDID) {
+        return FRAMER_FAILED;
+      }
+      if(!(frame.dest_addr[0] == 0xff && frame.dest_addr[1] == 0xff &&
+           (frame.fcf.dest_addr_mode == FRAME802154_SHORTADDRMODE ||
+            memcmp(frame.dest_addr, "\xff\xff\xff\xff\xff\xff\xff\xff", 8) == 0))) {
+        packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, (linkaddr_t *)&frame.dest_addr);
+      }
+    }
+    packetbuf_set_addr(PACKETBUF_ADDR_SENDER, (linkaddr_t *)&frame.src_addr);
+    packetbuf_set_attr(PACKETBUF_ATTR_PENDING, frame.fcf.frame_pending);
+    packetbuf_set_attr(PACKETBUF_ATTR_PACKET_ID, frame.seq);
+    return len - frame.payload_len;
+  }
+  return FRAMER_FAILED;
+}
+/*---------------------------------------------------------------------------*/
+static int
+no_create(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+no_parse(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Most packets go to the first neighbor, as to a parent in a routed
+   network, and some are broadcast. */
+static void
+make_packets(void)
+{
+  unsigned i, r;
+
+  for(i = 0; i < NEIGHBORS; i++) {
+    make_addr(&neighbors[i], i);
+  }
+  for(i = 0; i < PAYLOAD_SIZE; i++) {
+    payload[i] = i;
+  }
+
+  for(i = 0; i < CORPUS_SIZE; i++) {
+    r = (i * 7919) % 100;
+    if(r < 60) {
+      linkaddr_copy(&packets[i].receiver, &neighbors[0]);
+    } else if(r < 80) {
+      linkaddr_copy(&packets[i].receiver, &linkaddr_null);
+    } else {
+      linkaddr_copy(&packets[i].receiver, &neighbors[1 + r % (NEIGHBORS - 1)]);
+    }
+    packets[i].pending = (i % 5) == 0;
+    packets[i].seqno = 1 + i % 255;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Incoming frames in the shapes that framer_802154 makes, and in shapes
+   that it does not: without PAN ID compression, with mixed address
+   modes, to another PAN, truncated, and ACK frames. */
+static void
+make_frames(void)
+{
+  frame802154_t params;
+  unsigned i, shape;
+  int len;
+
+  for(i = 0; i < CORPUS_SIZE; i++) {
+    shape = i % 16;
+    memset(&params, 0, sizeof(params));
+    params.fcf.frame_type = shape == 15 ?
+      FRAME802154_ACKFRAME : FRAME802154_DATAFRAME;
+    params.fcf.frame_pending = i & 1;
+    params.fcf.ack_required = (i >> 1) & 1;
+    params.fcf.frame_version = shape == 11 ?
+      FRAME802154_IEEE802154_2006 : FRAME802154_IEEE802154_2003;
+    params.seq = i;
+    params.fcf.src_addr_mode = shape == 12 ?
+      FRAME802154_SHORTADDRMODE : FRAME802154_LONGADDRMODE;
+    params.fcf.dest_addr_mode = shape == 13 ?
+      FRAME802154_SHORTADDRMODE : FRAME802154_LONGADDRMODE;
+    if(sizeof(linkaddr_t) == 2) {
+      params.fcf.src_addr_mode = params.fcf.dest_addr_mode =
+        FRAME802154_SHORTADDRMODE;
+    }
+    params.dest_pid = shape == 14 ? 0x1234 : framer_802154_get_panid();
+    params.src_pid = shape == 10 ? 0x4321 : params.dest_pid;
+    if(shape < 4) {
+      params.fcf.dest_addr_mode = FRAME802154_SHORTADDRMODE;
+      params.dest_addr[0] = 0xFF;
+      params.dest_addr[1] = 0xFF;
+    } else if(shape < 8) {
+      linkaddr_copy((linkaddr_t *)&params.dest_addr, &linkaddr_node_addr);
+    } else {
+      make_addr((linkaddr_t *)&params.dest_addr, i);
+    }
+    make_addr((linkaddr_t *)&params.src_addr, i % NEIGHBORS);
+    len = frame802154_create(&params, frames[i].data, frame802154_hdrlen(&params));
+    memcpy(frames[i].data + len, payload, PAYLOAD_SIZE);
+    frames[i].len = len + PAYLOAD_SIZE;
+    if(shape == 9) {
+      frames[i].len = len - 1;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+create_packet(const struct packet *pkt, int (* create)(void))
+{
+  packetbuf_clear();
+  memcpy(packetbuf_dataptr(), payload, PAYLOAD_SIZE);
+  packetbuf_set_datalen(PAYLOAD_SIZE);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &pkt->receiver);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
+  packetbuf_set_attr(PACKETBUF_ATTR_PENDING, pkt->pending);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, pkt->seqno);
+  return create();
+}
+/*---------------------------------------------------------------------------*/
+static void
+parse_frame(const struct frame *f, int (* parse)(void),
+            struct parse_result *result)
+{
+  packetbuf_copyfrom(f->data, f->len);
+  result->ret = parse();
+  result->datalen = packetbuf_datalen();
+  linkaddr_copy(&result->sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  linkaddr_copy(&result->receiver, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  result->pending = packetbuf_attr(PACKETBUF_ATTR_PENDING);
+  result->packet_id = packetbuf_attr(PACKETBUF_ATTR_PACKET_ID);
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(void)
+{
+  struct parse_result expected, result;
+  uint8_t buf[32];
+  unsigned i;
+  int len;
+
+  for(i = 0; i < CORPUS_SIZE; i++) {
+    len = create_packet(&packets[i], reference_create);
+    memcpy(buf, packetbuf_hdrptr(), len);
+    if(create_packet(&packets[i], framer_802154.create) != len ||
+       memcmp(packetbuf_hdrptr(), buf, len) != 0) {
+      printf("Packet %u: ", i);
+      fail("the header differs from frame802154_create()");
+    }
+  }
+
+  for(i = 0; i < CORPUS_SIZE; i++) {
+    parse_frame(&frames[i], reference_parse, &expected);
+    parse_frame(&frames[i], framer_802154.parse, &result);
+    if(expected.ret != result.ret ||
+       (expected.ret != FRAMER_FAILED &&
+        memcmp(&expected, &result, sizeof(expected)) != 0)) {
+      printf("Frame %u: ", i);
+      fail("the result differs from frame802154_parse()");
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+time_create(int (* create)(void))
+{
+  clock_time_t start;
+  unsigned round;
+  unsigned i;
+
+  start = clock_time();
+  for(round = 0; round < ROUNDS; round++) {
+    for(i = 0; i < CORPUS_SIZE; i++) {
+      create_packet(&packets[i], create);
+    }
+  }
+  return elapsed_ms(start);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+time_parse(int (* parse)(void))
+{
+  struct parse_result result;
+  clock_time_t start;
+  unsigned round;
+  unsigned i;
+
+  start = clock_time();
+  for(round = 0; round < ROUNDS; round++) {
+    for(i = 0; i < CORPUS_SIZE; i++) {
+      parse_frame(&frames[i], parse, &result);
+    }
+  }
+  return elapsed_ms(start);
+}
+/*---------------------------------------------------------------------------*/
+/* Report the time of a framer function without the time it takes to
+   set up the packetbuf, which is the same for both implementations. */
+static void
+report(const char *label, unsigned long ms, unsigned long setup_ms)
+{
+  unsigned long frames;
+
+  frames = (unsigned long)CORPUS_SIZE * ROUNDS;
+  ms = ms > setup_ms ? ms - setup_ms : 0;
+  printf("%s: %lu frames in %lu ms (%lu ns per frame)\n",
+         label, frames, ms, ms * 1000000 / frames);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(framer_bench_process, ev, data)
+{
+  unsigned long setup_ms;
+
+  PROCESS_BEGIN();
+
+  make_packets();
+  make_frames();
+  check();
+  printf("framer_802154 agrees with frame802154 on %u packets and %u frames\n",
+         CORPUS_SIZE, CORPUS_SIZE);
+
+  setup_ms = time_create(no_create);
+  report("framer_802154 create", time_create(framer_802154.create), setup_ms);
+  report("frame802154_create", time_create(reference_create), setup_ms);
+
+  setup_ms = time_parse(no_parse);
+  report("framer_802154 parse", time_parse(framer_802154.parse), setup_ms);
+  report("frame802154_parse", time_parse(reference_parse), setup_ms);
+
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
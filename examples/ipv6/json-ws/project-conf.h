@@ -31,7 +31,8 @@
 #define PROJECT_CONF_H_
 
 #include "jsontree.h"
-#define HTTPD_WS_CONF_USER_STATE struct jsontree_context json
+#define HTTPD_WS_CONF_USER_STATE struct jsontree_context json; \
+                                 int32_t json_offset
 
 
 /* #define JSON_WS_CONF_CALLBACK_PROTO "http" | "udp" | "cosm" */
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         RPL parent selection benchmark on the native platform.
+ *
+ *         The benchmark joins a DAG and feeds DIOs with random ranks
+ *         from a growing number of candidate parents, together with
+ *         transmission results that change their link metrics. After
+ *         each DIO in the verification pass, it checks the parent set
+ *         against the neighbor table and checks that the preferred
+ *         parent is the cheapest one, or within the hysteresis of the
+ *         objective function. It then measures the time per DIO and,
+ *         for comparison, the time of a selection that compares every
+ *         parent in the neighbor table.
+ */
+
+#include "contiki.h"
+#include "net/link-stats.h"
+#include "net/mac/mac.h"
+#include "net/rpl/rpl-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PARENTS	120
+#define CHECK_ROUNDS	2000
+#define ROUNDS		50000
+#define LINK_UPDATE_INTERVAL	16
+
+static uip_lladdr_t lladdrs[MAX_PARENTS];
+static uip_ipaddr_t ipaddrs[MAX_PARENTS];
+static rpl_dio_t dio;
+
+PROCESS(rpl_bench_process, "RPL parent selection benchmark");
+AUTOSTART_PROCESSES(&rpl_bench_process);
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message)
+{
+  printf("%s\n", message);
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+elapsed_ms(clock_time_t start)
+{
+  return (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_neighbor(int i)
+{
+  memset(&lladdrs[i], 0, sizeof(lladdrs[i]));
+  lladdrs[i].addr[sizeof(lladdrs[i].addr) - 2] = (i + 1) >> 8;
+  lladdrs[i].addr[sizeof(lladdrs[i].addr) - 1] = i + 1;
+  uip_ip6addr(&ipaddrs[i], 0xfe80, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&ipaddrs[i], &lladdrs[i]);
+  if(uip_ds6_nbr_add(&ipaddrs[i], &lladdrs[i], 1, NBR_REACHABLE) == NULL) {
+    fail("Failed to add a neighbor");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init_dio(void)
+{
+  memset(&dio, 0, sizeof(dio));
+  uip_ip6addr(&dio.dag_id, 0xaaaa, 0, 0, 0, 0, 0, 0, 1);
+  dio.ocp = RPL_OF.ocp;
+  dio.grounded = 1;
+  dio.mop = RPL_MOP_DEFAULT;
+  dio.version = RPL_LOLLIPOP_INIT;
+  dio.instance_id = RPL_DEFAULT_INSTANCE;
+  dio.dtsn = RPL_LOLLIPOP_INIT;
+  dio.dag_intdoubl = RPL_DIO_INTERVAL_DOUBLINGS;
+  dio.dag_intmin = RPL_DIO_INTERVAL_MIN;
+  dio.dag_redund = RPL_DIO_REDUNDANCY;
+  dio.default_lifetime = RPL_DEFAULT_LIFETIME;
+  dio.lifetime_unit = RPL_DEFAULT_LIFETIME_UNIT;
+  dio.dag_max_rankinc = RPL_MAX_RANKINC;
+  dio.dag_min_hoprankinc = RPL_MIN_HOPRANKINC;
+  dio.mc.type = RPL_DAG_MC;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_dio(int i)
+{
+  /* Ranks between the root rank and three hops keep every candidate
+     within the maximum rank increase. */
+  dio.rank = RPL_MIN_HOPRANKINC + rand() % (2 * RPL_MIN_HOPRANKINC);
+#if RPL_DAG_MC == RPL_DAG_MC_ETX
+  dio.mc.obj.etx = dio.rank;
+#endif /* RPL_DAG_MC == RPL_DAG_MC_ETX */
+  rpl_process_dio(&ipaddrs[i], &dio);
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_link(int i)
+{
+  int numtx;
+
+  numtx = 1 + rand() % 4;
+  link_stats_packet_sent((linkaddr_t *)&lladdrs[i], MAC_TX_OK, numtx);
+  rpl_link_neighbor_callback((linkaddr_t *)&lladdrs[i], MAC_TX_OK, numtx);
+  rpl_recalculate_ranks();
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(rpl_dag_t *dag)
+{
+  rpl_parent_t *p;
+  rpl_parent_t *best;
+  int count;
+  int i;
+
+  for(i = 0; i < dag->parent_count; i++) {
+    p = dag->parent_set[i];
+    if(p->set_index != i + 1 || p->dag != dag) {
+      fail("A parent is misplaced in the parent set");
+    }
+    if(p->cost != dag->instance->of->parent_path_cost(p)) {
+      fail("A parent has an outdated cost");
+    }
+    if(i > 0 && p->cost < dag->parent_set[(i - 1) / 2]->cost) {
+      fail("The parent set is out of order");
+    }
+  }
+
+  count = 0;
+  best = NULL;
+  for(p = nbr_table_head(rpl_parents); p != NULL;
+      p = nbr_table_next(rpl_parents, p)) {
+    if(p->dag != dag || p->rank == INFINITE_RANK) {
+      continue;
+    }
+    count++;
+    if(best == NULL || p->cost < best->cost) {
+      best = p;
+    }
+  }
+  if(count != dag->parent_count) {
+    fail("The parent set does not hold all parents");
+  }
+
+  p = dag->preferred_parent;
+  if(p == NULL) {
+    fail("No preferred parent");
+  }
+  if(p->cost != best->cost &&
+     dag->instance->of->best_parent(p, best) != p) {
+    fail("The preferred parent is not the best parent");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static rpl_parent_t *
+scan_parents(rpl_dag_t *dag)
+{
+  rpl_parent_t *p;
+  rpl_parent_t *best;
+
+  best = NULL;
+  for(p = nbr_table_head(rpl_parents); p != NULL;
+      p = nbr_table_next(rpl_parents, p)) {
+    if(p->dag != dag || p->rank == INFINITE_RANK) {
+      /* ignore this neighbor */
+    } else if(best == NULL) {
+      best = p;
+    } else {
+      best = dag->instance->of->best_parent(best, p);
+    }
+  }
+  return best;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rpl_bench_process, ev, data)
+{
+  static const int parent_counts[] = { 8, 30, 60, MAX_PARENTS };
+  rpl_instance_t *instance;
+  rpl_dag_t *dag;
+  clock_time_t start;
+  unsigned long dio_ms;
+  unsigned long scan_ms;
+  long round;
+  int parents;
+  int i;
+  int j;
+
+  PROCESS_BEGIN();
+
+  srand(1);
+  init_dio();
+  add_neighbor(0);
+  send_dio(0);
+  instance = rpl_get_instance(RPL_DEFAULT_INSTANCE);
+  if(instance == NULL || instance->current_dag == NULL) {
+    fail("Failed to join the DAG");
+  }
+  dag = instance->current_dag;
+  parents = 1;
+
+  for(i = 0; i < sizeof(parent_counts) / sizeof(parent_counts[0]); i++) {
+    for(; parents < parent_counts[i]; parents++) {
+      add_neighbor(parents);
+      send_dio(parents);
+    }
+    if(dag->parent_count != parents) {
+      printf("%d parents in the parent set, expected %d\n",
+             dag->parent_count, parents);
+      exit(EXIT_FAILURE);
+    }
+
+    for(round = 0; round < CHECK_ROUNDS; round++) {
+      if(round % LINK_UPDATE_INTERVAL == 0) {
+        update_link(rand() % parents);
+        check(dag);
+      }
+      send_dio(rand() % parents);
+      check(dag);
+    }
+
+    start = clock_time();
+    for(round = 0; round < ROUNDS; round++) {
+      if(round % LINK_UPDATE_INTERVAL == 0) {
+        update_link(rand() % parents);
+      }
+      send_dio(rand() % parents);
+    }
+    dio_ms = elapsed_ms(start);
+
+    start = clock_time();
+    for(round = 0; round < ROUNDS; round++) {
+      if(scan_parents(dag) == NULL) {
+        fail("No parent found by the scan");
+      }
+    }
+    scan_ms = elapsed_ms(start);
+
+    printf("%3d parents: %lu ns per DIO, %lu ns per full parent scan\n",
+           parents, dio_ms * 1000000 / ROUNDS, scan_ms * 1000000 / ROUNDS);
+  }
+
+  for(j = 0; j < parents; j++) {
+    if(rpl_find_parent(dag, &ipaddrs[j]) == NULL) {
+      fail("A parent was dropped");
+    }
+  }
+
+  printf("RPL benchmark done\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \file
+ *         JSON tokenizer benchmark on the native platform.
+ *
+ *         The benchmark generates a document with an array of sensor
+ *         objects and sums the "value" members of the sensors, first
+ *         with the streaming tokenizer fed in fragments of various
+ *         sizes, and then with jsonparse on the whole document. The
+ *         document has no true, false or null literals, as jsonparse
+ *         does not support them.
+ *
+ *         It then serializes a jsontree into blocks of various sizes and
+ *         compares the blocks with the output through putchar.
+ */
+
+#include "contiki.h"
+#include "jsonparse.h"
+#include "jsonstream.h"
+#include "jsontree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SENSOR_COUNT	10000
+#define ROUNDS		20
+#define DOCUMENT_SIZE	(SENSOR_COUNT * 96L)
+#define TREE_SENSORS	200
+#define TREE_OUTPUT_SIZE	(TREE_SENSORS * 128L)
+#define TREE_ROUNDS	500
+
+static char document[DOCUMENT_SIZE];
+static int document_len;
+
+struct sum {
+  long value;
+  long total;
+  unsigned count;
+};
+
+static char tree_output[TREE_OUTPUT_SIZE];
+static int tree_output_len;
+
+PROCESS(json_bench_process, "JSON tokenizer benchmark");
+AUTOSTART_PROCESSES(&json_bench_process);
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message)
+{
+  printf("%s\n", message);
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+elapsed_ms(clock_time_t start)
+{
+  return (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static long
+generate(void)
+{
+  long expected;
+  unsigned i;
+  unsigned value;
+  int len;
+
+  expected = 0;
+  len = snprintf(document, sizeof(document), "{\"version\": 1, \"sensors\": [");
+  for(i = 0; i < SENSOR_COUNT; i++) {
+    value = (i * 7919) % 100000;
+    expected += value;
+    len += snprintf(document + len, sizeof(document) - len,
+                    "%s\n  {\"id\": %u, \"name\": \"sensor \\\"%u\\\"\", "
+                    "\"value\": %u, \"tags\": [%u, \"t%u\"]}",
+                    i == 0 ? "" : ",", i, i, value, i % 10, i % 3);
+    if(len >= sizeof(document) - 2) {
+      fail("The document buffer is too small");
+    }
+  }
+  len += snprintf(document + len, sizeof(document) - len, "]}\n");
+  document_len = len;
+
+  return expected;
+}
+/*---------------------------------------------------------------------------*/
+static void
+sum_value(struct jsonstream_state *state, struct jsonstream_query *query,
+          int type, const char *value, int len, uint8_t flags)
+{
+  struct sum *sum;
+
+  sum = query->ptr;
+  if(type != JSON_TYPE_NUMBER) {
+    fail("A value is not a number");
+  }
+  if(flags & JSONSTREAM_FIRST) {
+    sum->value = 0;
+  }
+  while(len-- > 0) {
+    sum->value = sum->value * 10 + (*value++ - '0');
+  }
+  if(flags & JSONSTREAM_LAST) {
+    sum->total += sum->value;
+    sum->count++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static long
+stream_sum(int fragment_size)
+{
+  static struct jsonstream_state state;
+  static struct jsonstream_query query;
+  struct sum sum;
+  int offset;
+  int len;
+  int result;
+
+  memset(&sum, 0, sizeof(sum));
+  jsonstream_init(&state);
+  if(jsonstream_query_compile(&query, "/sensors/*/value",
+                              sum_value, &sum) < 0 ||
+     jsonstream_add_query(&state, &query) < 0) {
+    fail("Failed to add the query");
+  }
+
+  result = JSONSTREAM_MORE;
+  for(offset = 0; offset < document_len; offset += len) {
+    len = document_len - offset;
+    if(len > fragment_size) {
+      len = fragment_size;
+    }
+    result = jsonstream_feed(&state, document + offset, len);
+    if(result == JSONSTREAM_ERROR) {
+      printf("Error %d at offset %d\n", jsonstream_get_error(&state), offset);
+      fail("The tokenizer failed");
+    }
+  }
+  if(jsonstream_finish(&state) != JSONSTREAM_DONE) {
+    fail("The document is incomplete");
+  }
+  if(sum.count != SENSOR_COUNT) {
+    fail("The query did not match all sensors");
+  }
+
+  return sum.total;
+}
+/*---------------------------------------------------------------------------*/
+static long
+parse_sum(void)
+{
+  struct jsonparse_state state;
+  long total;
+  int type;
+
+  total = 0;
+  jsonparse_setup(&state, document, document_len);
+  while((type = jsonparse_next(&state)) != 0) {
+    if(type == JSON_TYPE_PAIR_NAME &&
+       jsonparse_strcmp_value(&state, "value") == 0) {
+      if(jsonparse_next(&state) != JSON_TYPE_PAIR ||
+         jsonparse_next(&state) != JSON_TYPE_NUMBER) {
+        fail("jsonparse: a value is not a number");
+      }
+      total += jsonparse_get_value_as_long(&state);
+    }
+  }
+  if(state.error != JSON_ERROR_OK) {
+    fail("jsonparse failed");
+  }
+
+  return total;
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_invalid(const char *text)
+{
+  struct jsonstream_state state;
+
+  jsonstream_init(&state);
+  return jsonstream_feed(&state, text, strlen(text)) == JSONSTREAM_ERROR ||
+    jsonstream_finish(&state) == JSONSTREAM_ERROR;
+}
+/*---------------------------------------------------------------------------*/
+static int
+readings_output(struct jsontree_context *js_ctx)
+{
+  /* Write one reading per call to make the callback span blocks. */
+  if(js_ctx->callback_state == 0) {
+    jsontree_write_atom(js_ctx, "[");
+  } else {
+    jsontree_write_atom(js_ctx, ",");
+  }
+  jsontree_write_int(js_ctx, js_ctx->callback_state * -1000 - 1);
+  if(++js_ctx->callback_state == 4) {
+    jsontree_write_atom(js_ctx, "]");
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static struct jsontree_callback readings = JSONTREE_CALLBACK(readings_output,
+                                                             NULL);
+static struct jsontree_int temperature = { JSON_TYPE_INT, 2150 };
+static struct jsontree_string label = JSONTREE_STRING("outdoor \"north\"");
+
+JSONTREE_OBJECT(sensor,
+                JSONTREE_PAIR("name", &label),
+                JSONTREE_PAIR("temperature", &temperature),
+                JSONTREE_PAIR("readings", &readings));
+JSONTREE_ARRAY(sensor_array, TREE_SENSORS);
+JSONTREE_OBJECT(tree,
+                JSONTREE_PAIR("sensors", &sensor_array));
+/*---------------------------------------------------------------------------*/
+static int
+tree_putchar(int c)
+{
+  if(tree_output_len < sizeof(tree_output)) {
+    tree_output[tree_output_len++] = c;
+  }
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+static int
+count_putchar(int c)
+{
+  tree_output_len++;
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_tree(void)
+{
+  struct jsontree_context js_ctx;
+
+  tree_output_len = 0;
+  jsontree_setup(&js_ctx, (struct jsontree_value *)&tree, tree_putchar);
+  while(jsontree_print_next(&js_ctx));
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_blocks(struct jsontree_context *js_ctx, int size)
+{
+  char block[1024];
+  int32_t offset;
+  int32_t start;
+  int len;
+
+  for(offset = 0; offset >= 0;) {
+    start = offset;
+    len = jsontree_print_block(js_ctx, block, size, &offset);
+    if(len != (offset < 0 ? tree_output_len - start : size) ||
+       memcmp(block, &tree_output[start], len) != 0) {
+      printf("Block size %d: block at %ld differs\n", size, (long)start);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_tree(void)
+{
+  static const int block_sizes[] = { 1, 16, 64, 1024 };
+  struct jsontree_context js_ctx;
+  char block[64];
+  clock_time_t start;
+  unsigned long kbytes;
+  unsigned long ms;
+  unsigned round;
+  int32_t offset;
+  int total;
+  unsigned i;
+
+  for(i = 0; i < TREE_SENSORS; i++) {
+    sensor_array.values[i] = (struct jsontree_value *)&sensor;
+  }
+  print_tree();
+  if(tree_output_len == sizeof(tree_output)) {
+    fail("The tree output buffer is too small");
+  }
+
+  jsontree_setup(&js_ctx, (struct jsontree_value *)&tree, NULL);
+  for(i = 0; i < sizeof(block_sizes) / sizeof(block_sizes[0]); i++) {
+    check_blocks(&js_ctx, block_sizes[i]);
+  }
+
+  /* Requesting a block again restarts the output. */
+  offset = 0;
+  jsontree_print_block(&js_ctx, block, sizeof(block), &offset);
+  jsontree_print_block(&js_ctx, block, sizeof(block), &offset);
+  check_blocks(&js_ctx, sizeof(block));
+
+  kbytes = (unsigned long)tree_output_len * TREE_ROUNDS / 1000;
+
+  start = clock_time();
+  for(round = 0; round < TREE_ROUNDS; round++) {
+    print_tree();
+  }
+  ms = elapsed_ms(start);
+  printf("jsontree, putchar: %lu KB in %lu ms\n", kbytes, ms);
+
+  start = clock_time();
+  for(round = 0; round < TREE_ROUNDS; round++) {
+    for(offset = 0; offset >= 0;) {
+      jsontree_print_block(&js_ctx, block, sizeof(block), &offset);
+    }
+  }
+  ms = elapsed_ms(start);
+  printf("jsontree, 64-byte blocks: %lu KB in %lu ms\n", kbytes, ms);
+
+  /* Without a resumable context, each block generates the output from
+     the start and discards what precedes the block. */
+  total = tree_output_len;
+  start = clock_time();
+  for(round = 0; round < TREE_ROUNDS / 50; round++) {
+    for(offset = 0; offset < total; offset += sizeof(block)) {
+      jsontree_setup(&js_ctx, (struct jsontree_value *)&tree, count_putchar);
+      tree_output_len = 0;
+      while(jsontree_print_next(&js_ctx) &&
+            tree_output_len < offset + sizeof(block));
+    }
+  }
+  tree_output_len = total;
+  ms = elapsed_ms(start) * 50;
+  printf("jsontree, 64-byte blocks from the start: %lu KB in %lu ms\n",
+         kbytes, ms);
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(const char *label, unsigned long ms)
+{
+  unsigned long kbytes;
+
+  kbytes = (unsigned long)document_len * ROUNDS / 1000;
+  printf("%s: %lu KB in %lu ms (%lu KB/s)\n",
+         label, kbytes, ms, ms == 0 ? 0 : kbytes * 1000 / ms);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(json_bench_process, ev, data)
+{
+  static const int fragment_sizes[] = { 1, 7, 64, 1024, DOCUMENT_SIZE };
+  clock_time_t start;
+  long expected;
+  unsigned i;
+  unsigned round;
+
+  PROCESS_BEGIN();
+
+  expected = generate();
+  printf("Generated a document of %d bytes\n", document_len);
+
+  for(i = 0; i < sizeof(fragment_sizes) / sizeof(fragment_sizes[0]); i++) {
+    if(stream_sum(fragment_sizes[i]) != expected) {
+      printf("Fragment size %d: wrong sum\n", fragment_sizes[i]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if(parse_sum() != expected) {
+    fail("jsonparse: wrong sum");
+  }
+
+  if(!check_invalid("{\"a\": [1, 2}") || !check_invalid("{\"a\" 1}") ||
+     !check_invalid("[tru]") || !check_invalid("{\"a\": [1, 2]")) {
+    fail("A malformed document was accepted");
+  }
+
+  start = clock_time();
+  for(round = 0; round < ROUNDS; round++) {
+    stream_sum(64);
+  }
+  report("jsonstream, 64-byte fragments", elapsed_ms(start));
+
+  start = clock_time();
+  for(round = 0; round < ROUNDS; round++) {
+    stream_sum(DOCUMENT_SIZE);
+  }
+  report("jsonstream, whole document", elapsed_ms(start));
+
+  start = clock_time();
+  for(round = 0; round < ROUNDS; round++) {
+    parse_sum();
+  }
+  report("jsonparse, whole document", elapsed_ms(start));
+
+  bench_tree();
+
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Test of the replacement policy of the neighbor tables.
+ *
+ *         The test fills the shared neighbor key space from a regular
+ *         table and from a cache table, and checks that caches never
+ *         replace neighbors that the regular table uses, that cache
+ *         entries are replaced first, and that locked neighbors are
+ *         never replaced.
+ */
+
+#include "contiki.h"
+#include "net/nbr-table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+NBR_TABLE(uint8_t, routes);
+NBR_TABLE(uint8_t, stats);
+
+static int removed_stats;
+
+PROCESS(nbr_table_test_process, "Neighbor table test");
+AUTOSTART_PROCESSES(&nbr_table_test_process);
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message)
+{
+  printf("%s\n", message);
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+stats_removed(nbr_table_item_t *item)
+{
+  removed_stats++;
+}
+/*---------------------------------------------------------------------------*/
+static const linkaddr_t *
+neighbor(uint8_t id)
+{
+  static linkaddr_t lladdr;
+
+  linkaddr_copy(&lladdr, &linkaddr_null);
+  lladdr.u8[0] = id;
+  return &lladdr;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+add(nbr_table_t *table, uint8_t id)
+{
+  uint8_t *item;
+
+  item = nbr_table_add_lladdr(table, neighbor(id));
+  if(item != NULL) {
+    *item = id;
+  }
+  return item;
+}
+/*---------------------------------------------------------------------------*/
+static int
+has(nbr_table_t *table, uint8_t id)
+{
+  uint8_t *item;
+
+  item = nbr_table_get_from_lladdr(table, neighbor(id));
+  return item != NULL && *item == id;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(nbr_table_t *table, uint8_t id, int expected, const char *message)
+{
+  if(has(table, id) != expected) {
+    printf("Neighbor %u: ", id);
+    fail(message);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(nbr_table_test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  if(!nbr_table_register(routes, NULL) ||
+     !nbr_table_register_cache(stats, stats_removed)) {
+    fail("Could not register the tables");
+  }
+
+  /* Two neighbors with routes and two cached ones fill the key space. */
+  if(add(routes, 1) == NULL || add(routes, 2) == NULL ||
+     add(stats, 3) == NULL || add(stats, 4) == NULL) {
+    fail("Could not fill the neighbor tables");
+  }
+
+  /* A new cached neighbor replaces the oldest cached one. */
+  if(add(stats, 5) == NULL) {
+    fail("A cache could not replace its own entry");
+  }
+  check(stats, 3, 0, "the oldest cache entry was kept");
+  check(stats, 4, 1, "a newer cache entry was replaced");
+  check(routes, 1, 1, "a cache replaced a route");
+  check(routes, 2, 1, "a cache replaced a route");
+  if(removed_stats != 1) {
+    fail("The cache was not told about the replaced entry");
+  }
+
+  /* A new route replaces a cached neighbor rather than a route. */
+  if(add(routes, 6) == NULL || add(routes, 7) == NULL) {
+    fail("A route could not replace a cache entry");
+  }
+  check(stats, 4, 0, "a cache entry was kept instead of a route");
+  check(stats, 5, 0, "a cache entry was kept instead of a route");
+  check(routes, 1, 1, "a route was replaced instead of a cache entry");
+  check(routes, 2, 1, "a route was replaced instead of a cache entry");
+  if(removed_stats != 3) {
+    fail("The cache was not told about the replaced entries");
+  }
+
+  /* With routes to all neighbors, a cache gets no new entries. */
+  if(add(stats, 8) != NULL) {
+    fail("A cache replaced a route");
+  }
+  check(routes, 1, 1, "a route was lost to a cache");
+  check(routes, 7, 1, "a route was lost to a cache");
+
+  /* A cache may share the key of a neighbor that has a route. */
+  if(add(stats, 2) == NULL) {
+    fail("A cache could not add a known neighbor");
+  }
+  check(routes, 2, 1, "a shared neighbor lost its route");
+
+  /* Locked neighbors are never replaced. */
+  nbr_table_lock(routes, nbr_table_get_from_lladdr(routes, neighbor(1)));
+  if(add(routes, 9) == NULL) {
+    fail("A route could not replace an unlocked route");
+  }
+  check(routes, 1, 1, "a locked neighbor was replaced");
+  check(routes, 2, 0, "the oldest unlocked route was kept");
+  check(stats, 2, 0, "the replaced neighbor kept its cache entry");
+  check(routes, 6, 1, "a newer route was replaced");
+
+  printf("Neighbor table test OK\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Phase prediction benchmark on the native platform.
+ *
+ *         The benchmark replays the transmissions of a ContikiMAC
+ *         sender on a Tmote Sky to a neighbor whose clock drifts, at
+ *         random intervals of up to five minutes. It compares the old
+ *         prediction, the last observed phase with the full guard time,
+ *         with the drift fit and its adaptive guard time, and reports
+ *         the strobes per packet and the packets that missed the
+ *         wake-up of the neighbor.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/mac/phase-drift.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The timing of ContikiMAC at 8 Hz with a 32768 Hz rtimer. */
+#define CYCLE_TIME      4096
+#define GUARD_TIME      546
+#define MIN_GUARD_TIME  210
+/* A strobe of a 60-byte frame and the interval that follows it. */
+#define STROBE_TIME     (70 + 13)
+
+#define PACKETS         2000
+#define MIN_INTERVAL    5
+#define MAX_INTERVAL    300
+/* The clock of the neighbor jitters by up to this many ticks. */
+#define JITTER          2
+
+struct result {
+  unsigned long strobes;
+  unsigned misses;
+  unsigned long guard;
+};
+
+static const int ppms[] = { 0, 10, -10, 40, -40, 100, -100 };
+
+PROCESS(phase_drift_bench_process, "Phase prediction benchmark");
+AUTOSTART_PROCESSES(&phase_drift_bench_process);
+/*---------------------------------------------------------------------------*/
+/* The wake-up of the neighbor, with its drift in 1/2^PHASE_DRIFT_SHIFT
+   ticks per second. */
+static rtimer_clock_t
+wakeup(int32_t drift, unsigned long seconds)
+{
+  long long ticks;
+
+  ticks = ((long long)drift * (long long)seconds) >> PHASE_DRIFT_SHIFT;
+  return (rtimer_clock_t)(ticks + random_rand() % (2 * JITTER + 1) - JITTER);
+}
+/*---------------------------------------------------------------------------*/
+/* Strobe from guard ticks before the predicted phase until the
+   neighbor wakes up, and return the start of the strobe that it
+   acknowledges. */
+static rtimer_clock_t
+strobe(struct result *r, rtimer_clock_t predicted, rtimer_clock_t guard,
+       rtimer_clock_t phase)
+{
+  rtimer_clock_t start;
+  int32_t delta;
+  unsigned strobes;
+
+  start = predicted - guard;
+  delta = (rtimer_clock_t)(phase - start) & (CYCLE_TIME - 1);
+  if(delta > CYCLE_TIME / 2) {
+    /* The neighbor woke up before the first strobe, so it is not
+       heard until its next wake-up. */
+    r->misses++;
+  }
+  strobes = delta / STROBE_TIME;
+  r->strobes += strobes + 1;
+  r->guard += guard;
+  return start + strobes * STROBE_TIME;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(int ppm)
+{
+  struct result last_result, fit_result;
+  struct phase_drift d;
+  rtimer_clock_t last;
+  unsigned long seconds;
+  int32_t drift;
+  int i;
+
+  drift = ((int32_t)ppm * 32768L * (1 << PHASE_DRIFT_SHIFT)) / 1000000L;
+
+  random_init(ppm + 1);
+  seconds = 0;
+  last = wakeup(drift, seconds);
+  phase_drift_init(&d, last, seconds);
+  memset(&last_result, 0, sizeof(last_result));
+  memset(&fit_result, 0, sizeof(fit_result));
+
+  for(i = 0; i < PACKETS; i++) {
+    rtimer_clock_t phase;
+
+    seconds += MIN_INTERVAL + random_rand() % (MAX_INTERVAL - MIN_INTERVAL);
+    phase = wakeup(drift, seconds);
+
+    last = strobe(&last_result, last, GUARD_TIME, phase);
+    phase_drift_observe(&d,
+                        strobe(&fit_result,
+                               phase_drift_predict(&d, seconds),
+                               phase_drift_guard(&d, GUARD_TIME,
+                                                 MIN_GUARD_TIME),
+                               phase),
+                        CYCLE_TIME, seconds);
+  }
+
+  printf("Drift %4d ppm: last phase %lu.%02lu strobes/packet %u misses, "
+         "drift fit %lu.%02lu strobes/packet %u misses, guard %lu ticks\n",
+         ppm,
+         last_result.strobes / PACKETS, last_result.strobes * 100 / PACKETS % 100,
+         last_result.misses,
+         fit_result.strobes / PACKETS, fit_result.strobes * 100 / PACKETS % 100,
+         fit_result.misses, fit_result.guard / PACKETS);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(phase_drift_bench_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  printf("%d packets at intervals of %d to %d s, cycle %d ticks\n",
+         PACKETS, MIN_INTERVAL, MAX_INTERVAL, CYCLE_TIME);
+  for(i = 0; i < sizeof(ppms) / sizeof(ppms[0]); i++) {
+    run(ppms[i]);
+  }
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
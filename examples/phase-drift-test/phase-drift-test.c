@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Test of the phase drift prediction.
+ *
+ *         The test feeds the prediction with the phases of a neighbor
+ *         whose clock drifts at a known rate, and checks the fitted
+ *         drift, the predicted phase, the smoothed error and the guard
+ *         time, and that a phase switch clears the history.
+ */
+
+#include "contiki.h"
+#include "net/mac/phase-drift.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* A ContikiMAC cycle of 8 Hz with a 32768 Hz rtimer. */
+#define CYCLE_TIME      4096
+/* A ContikiMAC cycle of 32 Hz. */
+#define SHORT_CYCLE_TIME 1024
+/* The guard times of ContikiMAC with a 32768 Hz rtimer. */
+#define GUARD_TIME      546
+#define MIN_GUARD_TIME  210
+/* A start phase just before the rtimer wraps. */
+#define START_PHASE     65500
+
+#define INTERVAL        15
+#define OBSERVATIONS    30
+
+PROCESS(phase_drift_test_process, "Phase drift test");
+AUTOSTART_PROCESSES(&phase_drift_test_process);
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message)
+{
+  printf("%s\n", message);
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+/* The phase of a neighbor whose clock drifts drift/2^PHASE_DRIFT_SHIFT
+   ticks per second, observed a number of cycles after it. */
+static rtimer_clock_t
+phase(int32_t drift, unsigned long seconds, rtimer_clock_t cycle_time)
+{
+  long long ticks;
+
+  ticks = (long long)drift * (long long)seconds;
+  ticks = (ticks + (1 << (PHASE_DRIFT_SHIFT - 1))) >> PHASE_DRIFT_SHIFT;
+  return (rtimer_clock_t)(START_PHASE + ticks + 7 * seconds * cycle_time);
+}
+/*---------------------------------------------------------------------------*/
+/* The distance between two phases, modulo the cycle time. */
+static int32_t
+distance(rtimer_clock_t a, rtimer_clock_t b, rtimer_clock_t cycle_time)
+{
+  int32_t d;
+
+  d = (rtimer_clock_t)(a - b) % cycle_time;
+  if(d > cycle_time / 2) {
+    d -= cycle_time;
+  }
+  return d < 0 ? -d : d;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_fit(int32_t drift, rtimer_clock_t cycle_time)
+{
+  struct phase_drift d;
+  unsigned long seconds;
+  int32_t e;
+  int i;
+
+  seconds = 1000;
+  phase_drift_init(&d, phase(drift, seconds, cycle_time), seconds);
+  for(i = 1; i < OBSERVATIONS; i++) {
+    seconds += INTERVAL;
+    phase_drift_observe(&d, phase(drift, seconds, cycle_time),
+                        cycle_time, seconds);
+  }
+
+  printf("Drift %ld fitted as %ld, error %lu/%u ticks\n",
+         (long)drift, (long)d.drift,
+         (unsigned long)d.error, 1 << PHASE_DRIFT_ERROR_SHIFT);
+
+  if(d.observations != PHASE_HISTORY) {
+    fail("The history was not filled");
+  }
+  /* The observed phases are rounded to ticks, so the fit is off by
+     at most a tick over the span of the history. */
+  e = d.drift - drift;
+  if(e < 0) {
+    e = -e;
+  }
+  if(e > (1 << PHASE_DRIFT_SHIFT) / (INTERVAL * (PHASE_HISTORY - 1)) + 1) {
+    fail("The fitted drift is wrong");
+  }
+  if(distance(phase_drift_predict(&d, seconds + 120),
+              phase(drift, seconds + 120, cycle_time), cycle_time) > 2) {
+    fail("The predicted phase is wrong");
+  }
+  /* Rounding the observed phases to ticks alone gives errors of a
+     tick. */
+  if(d.error > 2 << PHASE_DRIFT_ERROR_SHIFT) {
+    fail("The error of the predictions is above two ticks");
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(phase_drift_test_process, ev, data)
+{
+  static struct phase_drift d;
+  int32_t drift;
+  int i;
+
+  PROCESS_BEGIN();
+
+  /* 3.5 ticks per second, about 100 ppm of a 32768 Hz clock. */
+  check_fit(896, CYCLE_TIME);
+  check_fit(-896, CYCLE_TIME);
+  check_fit(-576, SHORT_CYCLE_TIME);
+  check_fit(0, CYCLE_TIME);
+
+  /* Errors of a few ticks must not be smoothed away. */
+  phase_drift_init(&d, START_PHASE, 0);
+  for(i = 1; i <= OBSERVATIONS; i++) {
+    phase_drift_observe(&d, START_PHASE, CYCLE_TIME, i * INTERVAL);
+  }
+  if(d.error != 0 ||
+     phase_drift_guard(&d, GUARD_TIME, MIN_GUARD_TIME) != MIN_GUARD_TIME) {
+    fail("The error of exact observations is not zero");
+  }
+  phase_drift_observe(&d, (rtimer_clock_t)(START_PHASE + 3), CYCLE_TIME,
+                      (OBSERVATIONS + 1) * INTERVAL);
+  if(d.error == 0 || phase_drift_guard(&d, GUARD_TIME, MIN_GUARD_TIME) <=
+     MIN_GUARD_TIME) {
+    fail("An error of three ticks was rounded away");
+  }
+  for(i = 0; i < OBSERVATIONS; i++) {
+    phase_drift_observe(&d, (rtimer_clock_t)(START_PHASE + (i & 1 ? 3 : -3)),
+                        CYCLE_TIME,
+                        (OBSERVATIONS + 2 + i) * INTERVAL);
+  }
+  printf("Jitter of 3 ticks smoothed to %lu/%u ticks\n",
+         (unsigned long)d.error, 1 << PHASE_DRIFT_ERROR_SHIFT);
+  if(d.error < 1 << PHASE_DRIFT_ERROR_SHIFT) {
+    fail("A jitter of three ticks was smoothed below a tick");
+  }
+
+  /* A phase switch clears the history but keeps the drift. */
+  drift = d.drift;
+  phase_drift_observe(&d, (rtimer_clock_t)(START_PHASE + CYCLE_TIME / 2),
+                      CYCLE_TIME,
+                      (2 * OBSERVATIONS + 2) * INTERVAL);
+  if(d.observations != 1 || d.drift != drift) {
+    fail("A phase switch did not restart the fit");
+  }
+
+  /* Observations older than PHASE_HISTORY_AGE are left out. */
+  phase_drift_observe(&d, (rtimer_clock_t)(START_PHASE + CYCLE_TIME / 2),
+                      CYCLE_TIME,
+                      (2 * OBSERVATIONS + 2) * INTERVAL +
+                      PHASE_HISTORY_AGE + 1);
+  if(d.observations != 1) {
+    fail("An old observation was kept");
+  }
+
+  printf("Phase drift test OK\n");
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
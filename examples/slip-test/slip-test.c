@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \file
+ *         Test of SLIP input on the native platform.
+ *
+ *         The test encodes frames that contain the SLIP control bytes
+ *         and feeds the stream through slip_input_block() in blocks of
+ *         every size, so that escapes and frame ends fall on every
+ *         block boundary. It then checks that broken frames and frames
+ *         that arrive while two are buffered are dropped without
+ *         damaging the frames around them.
+ */
+
+#include "contiki.h"
+#include "net/ip/uip.h"
+#include "dev/slip.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLIP_END     0300
+#define SLIP_ESC     0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+
+#define FRAME_COUNT	6
+#define FRAME_SIZE	120
+#define STREAM_SIZE	(FRAME_COUNT * (2 * FRAME_SIZE + 2))
+
+static uint8_t frames[FRAME_COUNT][FRAME_SIZE];
+static uint16_t frame_lens[FRAME_COUNT];
+static uint8_t stream[STREAM_SIZE];
+static uint16_t stream_len;
+
+static uint8_t received[FRAME_COUNT * 2][FRAME_SIZE];
+static uint16_t received_lens[FRAME_COUNT * 2];
+static int received_count;
+
+PROCESS(slip_test_process, "SLIP test");
+AUTOSTART_PROCESSES(&slip_test_process);
+/*---------------------------------------------------------------------------*/
+static void
+fail(const char *message)
+{
+  printf("%s\n", message);
+  exit(EXIT_FAILURE);
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_test_input(void)
+{
+  if(received_count == FRAME_COUNT * 2 || uip_len > FRAME_SIZE) {
+    fail("Received too many frames or too long a frame");
+  }
+  memcpy(received[received_count], &uip_buf[UIP_LLH_LEN], uip_len);
+  received_lens[received_count] = uip_len;
+  received_count++;
+  uip_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Let the upper half take the frames that the lower half has buffered. */
+static void
+drain(void)
+{
+  int count;
+
+  do {
+    count = received_count;
+    process_post_synch(&slip_process, PROCESS_EVENT_POLL, NULL);
+  } while(received_count != count);
+}
+/*---------------------------------------------------------------------------*/
+static void
+encode(const uint8_t *frame, uint16_t len)
+{
+  uint16_t i;
+
+  stream[stream_len++] = SLIP_END;
+  for(i = 0; i < len; i++) {
+    if(frame[i] == SLIP_END) {
+      stream[stream_len++] = SLIP_ESC;
+      stream[stream_len++] = SLIP_ESC_END;
+    } else if(frame[i] == SLIP_ESC) {
+      stream[stream_len++] = SLIP_ESC;
+      stream[stream_len++] = SLIP_ESC_ESC;
+    } else {
+      stream[stream_len++] = frame[i];
+    }
+  }
+  stream[stream_len++] = SLIP_END;
+}
+/*---------------------------------------------------------------------------*/
+/* Frames of different lengths, with control bytes at the start, at the
+   end, next to each other and spread out. */
+static void
+make_frames(void)
+{
+  int f, i;
+
+  for(f = 0; f < FRAME_COUNT; f++) {
+    frame_lens[f] = FRAME_SIZE - f * 13;
+    for(i = 0; i < frame_lens[f]; i++) {
+      frames[f][i] = (uint8_t)(i * 7 + f);
+      if((i + f) % 5 == 0) {
+        frames[f][i] = (i & 1) ? SLIP_END : SLIP_ESC;
+      }
+    }
+    frames[f][0] = SLIP_ESC;
+    frames[f][frame_lens[f] - 1] = SLIP_END;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_received(int index, int frame)
+{
+  if(index >= received_count ||
+     received_lens[index] != frame_lens[frame] ||
+     memcmp(received[index], frames[frame], frame_lens[frame]) != 0) {
+    printf("Frame %d: ", frame);
+    fail("the frame was not received intact");
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Blocks up to the length of the shortest encoded frame never hold
+   the start of a third frame while two are buffered. */
+static void
+test_block_sizes(void)
+{
+  uint16_t block, max_block, i, n;
+  int f;
+
+  stream_len = 0;
+  max_block = STREAM_SIZE;
+  for(f = 0; f < FRAME_COUNT; f++) {
+    n = stream_len;
+    encode(frames[f], frame_lens[f]);
+    if(stream_len - n < max_block) {
+      max_block = stream_len - n;
+    }
+  }
+
+  for(block = 1; block <= max_block; block++) {
+    received_count = 0;
+    for(i = 0; i < stream_len; i += n) {
+      n = stream_len - i < block ? stream_len - i : block;
+      slip_input_block(&stream[i], n);
+      drain();
+    }
+    if(received_count != FRAME_COUNT) {
+      printf("Block size %u: ", block);
+      fail("the wrong number of frames was received");
+    }
+    for(f = 0; f < FRAME_COUNT; f++) {
+      check_received(f, f);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_broken_escape(void)
+{
+  uint16_t rubbish;
+
+  rubbish = slip_rubbish;
+  received_count = 0;
+  stream_len = 0;
+  encode(frames[0], frame_lens[0]);
+  /* An escape that is followed by neither SLIP_ESC_END nor SLIP_ESC_ESC
+     breaks the frame. */
+  stream[stream_len - 1] = SLIP_ESC;
+  stream[stream_len++] = 'x';
+  stream[stream_len++] = SLIP_END;
+  encode(frames[1], frame_lens[1]);
+  slip_input_block(stream, stream_len);
+  drain();
+
+  if(slip_rubbish != rubbish + 1 || received_count != 1) {
+    fail("A broken frame was not dropped");
+  }
+  check_received(0, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_overrun(void)
+{
+  uint16_t overrun, half;
+
+  /* Three frames at once: the third arrives while two are buffered. */
+  overrun = slip_overrun;
+  received_count = 0;
+  stream_len = 0;
+  encode(frames[0], frame_lens[0]);
+  encode(frames[1], frame_lens[1]);
+  encode(frames[2], frame_lens[2]);
+  slip_input_block(stream, stream_len);
+  drain();
+  if(slip_overrun != overrun + 1 || received_count != 2) {
+    fail("A frame that arrived while two were buffered was not dropped");
+  }
+  check_received(0, 0);
+  check_received(1, 1);
+
+  /* The same, but the upper half takes the frames while the third one
+     is arriving. The rest of it must not be glued onto the next frame. */
+  received_count = 0;
+  stream_len = 0;
+  encode(frames[3], frame_lens[3]);
+  encode(frames[4], frame_lens[4]);
+  half = stream_len;
+  encode(frames[5], frame_lens[5]);
+  half += (stream_len - half) / 2;
+  slip_input_block(stream, half);
+  drain();
+  encode(frames[0], frame_lens[0]);
+  slip_input_block(&stream[half], stream_len - half);
+  drain();
+  if(received_count != 3) {
+    fail("A frame cut short was not dropped");
+  }
+  check_received(0, 3);
+  check_received(1, 4);
+  check_received(2, 0);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(slip_test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  process_start(&slip_process, NULL);
+
+  make_frames();
+  test_block_sizes();
+  test_broken_escape();
+  test_overrun();
+
+  printf("SLIP test passed: %u frames, %u broken, %u overrun\n",
+         slip_frames, slip_rubbish, slip_overrun);
+  exit(EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -56,6 +56,18 @@
 #define COFFEE_LOG_TABLE_LIMIT		256
 #define COFFEE_MICRO_LOGS		0
 #define COFFEE_IO_SEMANTICS		1
+#ifdef COFFEE_CONF_NAME_INDEX
+#define COFFEE_NAME_INDEX		COFFEE_CONF_NAME_INDEX
+#else
+#define COFFEE_NAME_INDEX		1
+#endif
+#define COFFEE_NAME_INDEX_SIZE		512
+#ifdef COFFEE_CONF_GC_INCREMENTAL
+#define COFFEE_GC_INCREMENTAL		COFFEE_CONF_GC_INCREMENTAL
+#else
+#define COFFEE_GC_INCREMENTAL		1
+#endif
+#define COFFEE_APPEND_MODE		1
 
 #define COFFEE_WRITE(buf, size, offset)				\
 		xmem_pwrite((char *)(buf), (size), COFFEE_START + (offset))
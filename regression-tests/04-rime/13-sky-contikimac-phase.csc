@@ -0,0 +1,167 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<simconf>
+  <project EXPORT="discard">[APPS_DIR]/mrm</project>
+  <project EXPORT="discard">[APPS_DIR]/mspsim</project>
+  <project EXPORT="discard">[APPS_DIR]/avrora</project>
+  <project EXPORT="discard">[APPS_DIR]/serial_socket</project>
+  <project EXPORT="discard">[APPS_DIR]/collect-view</project>
+  <project EXPORT="discard">[APPS_DIR]/powertracker</project>
+  <simulation>
+    <title>My simulation</title>
+    <randomseed>1</randomseed>
+    <motedelay_us>10000000</motedelay_us>
+    <radiomedium>
+      org.contikios.cooja.radiomediums.UDGM
+      <transmitting_range>50.0</transmitting_range>
+      <interference_range>0.0</interference_range>
+      <success_ratio_tx>1.0</success_ratio_tx>
+      <success_ratio_rx>1.0</success_ratio_rx>
+    </radiomedium>
+    <events>
+      <logoutput>40000</logoutput>
+    </events>
+    <motetype>
+      org.contikios.cooja.mspmote.SkyMoteType
+      <identifier>sky1</identifier>
+      <description>Phase node</description>
+      <source EXPORT="discard">[CONTIKI_DIR]/regression-tests/04-rime/code/phase-node.c</source>
+      <commands EXPORT="discard">make clean TARGET=sky
+make phase-node.sky DEFINES=CONTIKIMAC_CONF_STATS=1 TARGET=sky</commands>
+      <firmware EXPORT="copy">[CONTIKI_DIR]/regression-tests/04-rime/code/phase-node.sky</firmware>
+      <moteinterface>org.contikios.cooja.interfaces.Position</moteinterface>
+      <moteinterface>org.contikios.cooja.interfaces.IPAddress</moteinterface>
+      <moteinterface>org.contikios.cooja.interfaces.Mote2MoteRelations</moteinterface>
+      <moteinterface>org.contikios.cooja.mspmote.interfaces.MspClock</moteinterface>
+      <moteinterface>org.contikios.cooja.mspmote.interfaces.MspMoteID</moteinterface>
+      <moteinterface>org.contikios.cooja.mspmote.interfaces.SkyButton</moteinterface>
+      <moteinterface>org.contikios.cooja.mspmote.interfaces.SkyFlash</moteinterface>
+      <moteinterface>org.contikios.cooja.mspmote.interfaces.Msp802154Radio</moteinterface>
+      <moteinterface>org.contikios.cooja.mspmote.interfaces.MspSerial</moteinterface>
+      <moteinterface>org.contikios.cooja.mspmote.interfaces.SkyLED</moteinterface>
+    </motetype>
+    <mote>
+      <breakpoints />
+      <interface_config>
+        org.contikios.cooja.interfaces.Position
+        <x>3.0783332685337617</x>
+        <y>38.39795740836801</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        org.contikios.cooja.mspmote.interfaces.MspMoteID
+        <id>1</id>
+      </interface_config>
+      <motetype_identifier>sky1</motetype_identifier>
+    </mote>
+    <mote>
+      <breakpoints />
+      <interface_config>
+        org.contikios.cooja.interfaces.Position
+        <x>1.1986251808192212</x>
+        <y>53.65838347315817</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        org.contikios.cooja.mspmote.interfaces.MspMoteID
+        <id>2</id>
+      </interface_config>
+      <motetype_identifier>sky1</motetype_identifier>
+    </mote>
+  </simulation>
+  <plugin>
+    org.contikios.cooja.plugins.SimControl
+    <width>265</width>
+    <z>4</z>
+    <height>200</height>
+    <location_x>0</location_x>
+    <location_y>0</location_y>
+  </plugin>
+  <plugin>
+    org.contikios.cooja.plugins.LogListener
+    <plugin_config>
+      <filter />
+      <formatted_time />
+      <coloring />
+    </plugin_config>
+    <width>539</width>
+    <z>0</z>
+    <height>319</height>
+    <location_x>0</location_x>
+    <location_y>325</location_y>
+  </plugin>
+  <plugin>
+    org.contikios.cooja.plugins.Visualizer
+    <plugin_config>
+      <skin>org.contikios.cooja.plugins.skins.IDVisualizerSkin</skin>
+      <skin>org.contikios.cooja.plugins.skins.UDGMVisualizerSkin</skin>
+      <viewport>0.6259856679816412 0.0 0.0 0.6259856679816412 77.4082730178659 -21.226329635441804</viewport>
+    </plugin_config>
+    <width>263</width>
+    <z>2</z>
+    <height>125</height>
+    <location_x>1</location_x>
+    <location_y>200</location_y>
+  </plugin>
+  <plugin>
+    org.contikios.cooja.plugins.RadioLogger
+    <plugin_config>
+      <split>150</split>
+      <formatted_time />
+      <showdups>false</showdups>
+      <hidenodests>false</hidenodests>
+    </plugin_config>
+    <width>276</width>
+    <z>1</z>
+    <height>324</height>
+    <location_x>264</location_x>
+    <location_y>1</location_y>
+  </plugin>
+  <plugin>
+    org.contikios.cooja.plugins.ScriptRunner
+    <plugin_config>
+      <script>TIMEOUT(600000);
+
+/* Node 1 sends 60 packets to node 2 with ContikiMAC phase optimization,
+   and reports the strobes per packet with unknown and predicted phases. */
+nr_recv = 0;
+nr_done = 0;
+phase_tx = 0;
+phase_misses = 0;
+
+while(nr_done &lt; 2) {
+  YIELD();
+
+  if(id == 2 &amp;&amp; msg.startsWith("Received")) {
+    nr_recv++;
+  } else if(msg.startsWith("Strobes")) {
+    log.log(id + ": " + msg + "\n");
+    fields = msg.split(" ");
+    phase_tx = parseInt(fields[6]);
+    phase_misses = parseInt(fields[10]);
+  } else if(msg.startsWith("Acked")) {
+    log.log(id + ": " + msg + "\n");
+  } else if(msg.startsWith("Done")) {
+    nr_done++;
+  }
+}
+
+log.log("recv=" + nr_recv + " phase packets=" + phase_tx +
+        " misses=" + phase_misses + "\n");
+if(nr_recv &lt; 57) {
+  log.log("Error: too few packets received\n");
+  log.testFailed();
+}
+if(phase_tx &lt; 50 || phase_misses &gt; phase_tx / 10) {
+  log.log("Error: the phase of the receiver was not followed\n");
+  log.testFailed();
+}
+log.testOK();</script>
+      <active>true</active>
+    </plugin_config>
+    <width>600</width>
+    <z>3</z>
+    <height>643</height>
+    <location_x>539</location_x>
+    <location_y>1</location_y>
+  </plugin>
+</simconf>
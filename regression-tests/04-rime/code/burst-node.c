@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Bulk transfer over ContikiMAC: node 1 queues bursts of
+ *         unicast packets for node 2, and both nodes report the
+ *         throughput and their radio duty cycle.
+ */
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "net/mac/contikimac/contikimac.h"
+#include "sys/energest.h"
+#include "sys/node-id.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SENDER_ID     1
+#define RECEIVER_ID   2
+
+#define ROUNDS        10
+#define BURST_SIZE    6
+#define PAYLOAD_SIZE  80
+#define ROUND_INTERVAL (CLOCK_SECOND * 10)
+/*---------------------------------------------------------------------------*/
+PROCESS(burst_node_process, "Burst node");
+AUTOSTART_PROCESSES(&burst_node_process);
+
+static struct unicast_conn uc;
+static uint8_t pending;
+static uint8_t acked;
+static unsigned received;
+/*---------------------------------------------------------------------------*/
+static void
+recv_uc(struct unicast_conn *c, const linkaddr_t *from)
+{
+  received++;
+  printf("Received %u\n", received);
+}
+/*---------------------------------------------------------------------------*/
+static void
+sent_uc(struct unicast_conn *c, int status, int num_tx)
+{
+  if(status == MAC_TX_OK) {
+    acked++;
+  }
+  if(pending > 0 && --pending == 0) {
+    process_poll(&burst_node_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct unicast_callbacks unicast_callbacks = {recv_uc, sent_uc};
+/*---------------------------------------------------------------------------*/
+static unsigned long
+permil(unsigned long part, unsigned long all)
+{
+  all /= 1000;
+  return all == 0 ? 0 : part / all;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(burst_node_process, ev, data)
+{
+  static struct etimer et;
+  static int round;
+  static clock_time_t start;
+  static unsigned long rx, tx, all;
+  static uint8_t payload[PAYLOAD_SIZE];
+  linkaddr_t receiver;
+  int i;
+
+  PROCESS_BEGIN();
+
+  unicast_open(&uc, 146, &unicast_callbacks);
+  memset(payload, 'b', sizeof(payload));
+
+  energest_flush();
+  rx = energest_type_time(ENERGEST_TYPE_LISTEN);
+  tx = energest_type_time(ENERGEST_TYPE_TRANSMIT);
+  all = energest_type_time(ENERGEST_TYPE_CPU) +
+    energest_type_time(ENERGEST_TYPE_LPM);
+
+  for(round = 0; round < ROUNDS; round++) {
+    etimer_set(&et, ROUND_INTERVAL);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+    if(node_id != SENDER_ID) {
+      continue;
+    }
+
+    receiver.u8[0] = RECEIVER_ID;
+    receiver.u8[1] = 0;
+
+    /* Queue the whole burst before the MAC layer gets to run. */
+    start = clock_time();
+    pending = BURST_SIZE;
+    acked = 0;
+    for(i = 0; i < BURST_SIZE; i++) {
+      packetbuf_copyfrom(payload, sizeof(payload));
+      unicast_send(&uc, &receiver);
+    }
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    printf("Round %d: %u of %u packets acked in %lu ms\n", round,
+           acked, BURST_SIZE,
+           (unsigned long)(clock_time() - start) * 1000 / CLOCK_SECOND);
+  }
+
+  /* Let the receiver get the last round before reporting. */
+  etimer_set(&et, ROUND_INTERVAL);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  energest_flush();
+  rx = energest_type_time(ENERGEST_TYPE_LISTEN) - rx;
+  tx = energest_type_time(ENERGEST_TYPE_TRANSMIT) - tx;
+  all = energest_type_time(ENERGEST_TYPE_CPU) +
+    energest_type_time(ENERGEST_TYPE_LPM) - all;
+  printf("Duty cycle: rx %lu.%lu%% tx %lu.%lu%%\n",
+         permil(rx, all) / 10, permil(rx, all) % 10,
+         permil(tx, all) / 10, permil(tx, all) % 10);
+
+  if(node_id == SENDER_ID) {
+    printf("Strobes: %lu packets %lu strobes, phase %lu packets %lu strobes, burst %lu packets %lu strobes\n",
+           CONTIKIMAC_STATS_GET(tx), CONTIKIMAC_STATS_GET(strobes),
+           CONTIKIMAC_STATS_GET(phase_tx), CONTIKIMAC_STATS_GET(phase_strobes),
+           CONTIKIMAC_STATS_GET(burst_tx), CONTIKIMAC_STATS_GET(burst_strobes));
+  }
+  printf("Done\n");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
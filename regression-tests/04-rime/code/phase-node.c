@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Phase optimization over ContikiMAC: node 1 sends unicast
+ *         packets to node 2 a few seconds apart, and reports the
+ *         strobes per packet to receivers with unknown and with
+ *         predicted phases.
+ */
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "net/mac/contikimac/contikimac.h"
+#include "lib/random.h"
+#include "sys/node-id.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SENDER_ID     1
+#define RECEIVER_ID   2
+
+#define PACKETS       60
+#define PAYLOAD_SIZE  40
+#define SEND_INTERVAL (CLOCK_SECOND * 4)
+/*---------------------------------------------------------------------------*/
+PROCESS(phase_node_process, "Phase node");
+AUTOSTART_PROCESSES(&phase_node_process);
+
+static struct unicast_conn uc;
+static unsigned received;
+static unsigned acked;
+/*---------------------------------------------------------------------------*/
+static void
+recv_uc(struct unicast_conn *c, const linkaddr_t *from)
+{
+  received++;
+  printf("Received %u\n", received);
+}
+/*---------------------------------------------------------------------------*/
+static void
+sent_uc(struct unicast_conn *c, int status, int num_tx)
+{
+  if(status == MAC_TX_OK) {
+    acked++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct unicast_callbacks unicast_callbacks = {recv_uc, sent_uc};
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(phase_node_process, ev, data)
+{
+  static struct etimer et;
+  static int i;
+  static uint8_t payload[PAYLOAD_SIZE];
+  linkaddr_t receiver;
+
+  PROCESS_BEGIN();
+
+  unicast_open(&uc, 146, &unicast_callbacks);
+  memset(payload, 'p', sizeof(payload));
+
+  for(i = 0; i < PACKETS; i++) {
+    /* Spread the packets over the cycle of the receiver. */
+    etimer_set(&et, SEND_INTERVAL + random_rand() % CLOCK_SECOND);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+    if(node_id != SENDER_ID) {
+      continue;
+    }
+
+    receiver.u8[0] = RECEIVER_ID;
+    receiver.u8[1] = 0;
+    packetbuf_copyfrom(payload, sizeof(payload));
+    unicast_send(&uc, &receiver);
+  }
+
+  /* Let the receiver get the last packet before reporting. */
+  etimer_set(&et, SEND_INTERVAL * 2);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  if(node_id == SENDER_ID) {
+    printf("Acked %u of %u packets\n", acked, PACKETS);
+    printf("Strobes: %lu packets %lu strobes, phase %lu packets %lu strobes %lu misses\n",
+           CONTIKIMAC_STATS_GET(tx), CONTIKIMAC_STATS_GET(strobes),
+           CONTIKIMAC_STATS_GET(phase_tx), CONTIKIMAC_STATS_GET(phase_strobes),
+           CONTIKIMAC_STATS_GET(phase_misses));
+  }
+  printf("Done\n");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         RPL root that sends multicast datagrams in bursts, to check that
+ *         the multicast engine forwards all datagrams of a burst
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ipv6/multicast/uip-mcast6.h"
+#include "net/rpl/rpl.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MCAST_SINK_UDP_PORT 3001
+#define START_DELAY   (60 * CLOCK_SECOND)
+#define BURST_PERIOD  (4 * CLOCK_SECOND)
+#define BURST_SIZE    4
+#define BURSTS        25
+
+static struct uip_udp_conn *mcast_conn;
+static uint32_t seq_id;
+/*---------------------------------------------------------------------------*/
+PROCESS(burst_root_process, "Multicast burst root");
+AUTOSTART_PROCESSES(&burst_root_process);
+/*---------------------------------------------------------------------------*/
+static void
+send_burst(void)
+{
+  uint32_t id;
+  int i;
+
+  for(i = 0; i < BURST_SIZE; i++) {
+    seq_id++;
+    id = uip_htonl(seq_id);
+    printf("Send %lu\n", (unsigned long)seq_id);
+    uip_udp_packet_send(mcast_conn, &id, sizeof(id));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_root(void)
+{
+  uip_ipaddr_t ipaddr;
+  rpl_dag_t *dag;
+
+  uip_ip6addr(&ipaddr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&ipaddr, &uip_lladdr);
+  uip_ds6_addr_add(&ipaddr, 0, ADDR_MANUAL);
+
+  dag = rpl_set_root(RPL_DEFAULT_INSTANCE, &ipaddr);
+  if(dag != NULL) {
+    rpl_set_prefix(dag, &ipaddr, 64);
+    printf("Created a new RPL dag\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(burst_root_process, ev, data)
+{
+  static struct etimer et;
+  static int bursts;
+  uip_ipaddr_t addr;
+
+  PROCESS_BEGIN();
+
+  set_root();
+
+  uip_ip6addr(&addr, 0xFF1E, 0, 0, 0, 0, 0, 0x89, 0xABCD);
+  mcast_conn = udp_new(&addr, UIP_HTONS(MCAST_SINK_UDP_PORT), NULL);
+
+  etimer_set(&et, START_DELAY);
+  for(bursts = 0; bursts < BURSTS; bursts++) {
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    etimer_set(&et, BURST_PERIOD);
+    send_burst();
+  }
+  printf("Sent %lu datagrams\n", (unsigned long)seq_id);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
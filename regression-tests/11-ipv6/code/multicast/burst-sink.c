@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Multicast group member that reports every datagram it receives
+ *         from the burst root. It also forwards datagrams to the members
+ *         further down the DODAG
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ipv6/multicast/uip-mcast6.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MCAST_SINK_UDP_PORT 3001
+
+static struct uip_udp_conn *sink_conn;
+/*---------------------------------------------------------------------------*/
+PROCESS(burst_sink_process, "Multicast burst sink");
+AUTOSTART_PROCESSES(&burst_sink_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(burst_sink_process, ev, data)
+{
+  uip_ipaddr_t addr;
+  uint32_t id;
+
+  PROCESS_BEGIN();
+
+  uip_ip6addr(&addr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&addr, &uip_lladdr);
+  uip_ds6_addr_add(&addr, 0, ADDR_AUTOCONF);
+
+  uip_ip6addr(&addr, 0xFF1E, 0, 0, 0, 0, 0, 0x89, 0xABCD);
+  if(uip_ds6_maddr_add(&addr) == NULL) {
+    printf("Failed to join the multicast group\n");
+    PROCESS_EXIT();
+  }
+
+  sink_conn = udp_new(NULL, UIP_HTONS(0), NULL);
+  udp_bind(sink_conn, UIP_HTONS(MCAST_SINK_UDP_PORT));
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == tcpip_event);
+    if(uip_newdata()) {
+      memcpy(&id, uip_appdata, sizeof(id));
+      printf("In: %lu\n", (unsigned long)uip_ntohl(id));
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         RPL root that sends the same multicast datagram again and
+ *         again, to check that the multicast engine does not take the
+ *         repeated datagrams for duplicates of each other
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ipv6/multicast/uip-mcast6.h"
+#include "net/rpl/rpl.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MCAST_SINK_UDP_PORT 3001
+#define START_DELAY   (60 * CLOCK_SECOND)
+/* Well apart compared to the forwarding delays */
+#define REPEAT_PERIOD (2 * CLOCK_SECOND)
+#define REPEATS       30
+/* Every datagram carries this same ID */
+#define REPEAT_ID     42
+
+static struct uip_udp_conn *mcast_conn;
+/*---------------------------------------------------------------------------*/
+PROCESS(repeat_root_process, "Multicast repeat root");
+AUTOSTART_PROCESSES(&repeat_root_process);
+/*---------------------------------------------------------------------------*/
+static void
+send_repeat(void)
+{
+  uint32_t id;
+
+  id = uip_htonl(REPEAT_ID);
+  printf("Send %lu\n", (unsigned long)REPEAT_ID);
+  uip_udp_packet_send(mcast_conn, &id, sizeof(id));
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_root(void)
+{
+  uip_ipaddr_t ipaddr;
+  rpl_dag_t *dag;
+
+  uip_ip6addr(&ipaddr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&ipaddr, &uip_lladdr);
+  uip_ds6_addr_add(&ipaddr, 0, ADDR_MANUAL);
+
+  dag = rpl_set_root(RPL_DEFAULT_INSTANCE, &ipaddr);
+  if(dag != NULL) {
+    rpl_set_prefix(dag, &ipaddr, 64);
+    printf("Created a new RPL dag\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(repeat_root_process, ev, data)
+{
+  static struct etimer et;
+  static int repeats;
+  uip_ipaddr_t addr;
+
+  PROCESS_BEGIN();
+
+  set_root();
+
+  uip_ip6addr(&addr, 0xFF1E, 0, 0, 0, 0, 0, 0x89, 0xABCD);
+  mcast_conn = udp_new(&addr, UIP_HTONS(MCAST_SINK_UDP_PORT), NULL);
+
+  etimer_set(&et, START_DELAY);
+  for(repeats = 0; repeats < REPEATS; repeats++) {
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    etimer_set(&et, REPEAT_PERIOD);
+    send_repeat();
+  }
+  printf("Sent %d datagrams\n", REPEATS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
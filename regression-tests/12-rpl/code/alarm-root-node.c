@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+#include "contiki.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ip/uip-debug.h"
+
+#include "simple-udp.h"
+
+#include "net/rpl/rpl.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define UDP_PORT 1234
+
+/* The instance that carries the alarms, next to the default instance. */
+#define ALARM_INSTANCE 0x2a
+
+static struct simple_udp_connection unicast_connection;
+
+/*---------------------------------------------------------------------------*/
+PROCESS(alarm_root_process, "Alarm root process");
+AUTOSTART_PROCESSES(&alarm_root_process);
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  char buf[20];
+
+  printf("Data received from ");
+  uip_debug_ipaddr_print(sender_addr);
+  printf(" on port %d from port %d with length %d: '%s'\n",
+         receiver_port, sender_port, datalen, data);
+
+  /* Echo the message back down in the instance it was sent in. The
+     alarm instance has no default route at the root, so the echo only
+     arrives if the instance has its own downward route to the sender.
+     The message is copied first, as it is still in uip_buf. */
+  if(datalen > sizeof(buf)) {
+    return;
+  }
+  memcpy(buf, data, datalen);
+  if(strncmp(buf, "Alarm", 5) == 0) {
+    rpl_set_output_instance(ALARM_INSTANCE);
+  }
+  simple_udp_sendto(&unicast_connection, buf, datalen, sender_addr);
+}
+/*---------------------------------------------------------------------------*/
+static uip_ipaddr_t *
+set_global_address(void)
+{
+  static uip_ipaddr_t ipaddr;
+
+  uip_ip6addr(&ipaddr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&ipaddr, &uip_lladdr);
+  uip_ds6_addr_add(&ipaddr, 0, ADDR_AUTOCONF);
+
+  return &ipaddr;
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_rpl_dag(uint8_t instance_id, uip_ipaddr_t *ipaddr, rpl_of_t *of)
+{
+  rpl_dag_t *dag;
+  uip_ipaddr_t prefix;
+
+  dag = rpl_set_root_with_of(instance_id, ipaddr, of);
+  if(dag == NULL) {
+    printf("failed to create a new RPL DAG for instance %u\n", instance_id);
+    return;
+  }
+  uip_ip6addr(&prefix, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  rpl_set_prefix(dag, &prefix, 64);
+  printf("created a new RPL DAG for instance %u with OCP %u\n",
+         instance_id, of->ocp);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(alarm_root_process, ev, data)
+{
+  uip_ipaddr_t *ipaddr;
+
+  PROCESS_BEGIN();
+
+  ipaddr = set_global_address();
+
+  create_rpl_dag(RPL_DEFAULT_INSTANCE, ipaddr, &rpl_mrhof);
+  create_rpl_dag(ALARM_INSTANCE, ipaddr, &rpl_of0);
+
+  simple_udp_register(&unicast_connection, UDP_PORT,
+                      NULL, UDP_PORT, receiver);
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "sys/etimer.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ip/uip-debug.h"
+
+#include "simple-udp.h"
+
+#include "net/rpl/rpl.h"
+#include "net/rpl/rpl-private.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define UDP_PORT 1234
+
+/* The instance that carries the alarms, next to the default instance. */
+#define ALARM_INSTANCE 0x2a
+
+#define SEND_INTERVAL		(30 * CLOCK_SECOND)
+#define SEND_TIME		(random_rand() % (SEND_INTERVAL / 2))
+
+/* The number of echoed alarms after which the node withdraws its route
+   in the alarm instance. */
+#define WITHDRAW_AFTER_ALARMS	5
+
+static struct simple_udp_connection unicast_connection;
+static unsigned alarm_echoes;
+
+/*---------------------------------------------------------------------------*/
+PROCESS(alarm_sender_process, "Alarm sender process");
+AUTOSTART_PROCESSES(&alarm_sender_process);
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  printf("Echo received: '%s'\n", data);
+  if(strncmp((const char *)data, "Alarm", 5) == 0) {
+    alarm_echoes++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_global_address(void)
+{
+  uip_ipaddr_t ipaddr;
+
+  uip_ip6addr(&ipaddr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&ipaddr, &uip_lladdr);
+  uip_ds6_addr_add(&ipaddr, 0, ADDR_AUTOCONF);
+}
+/*---------------------------------------------------------------------------*/
+/* Send a No-Path DAO for the global address in the alarm instance only.
+   The route of the default instance must stay in place, so that bulk
+   messages are still echoed. */
+static int
+withdraw_alarm_route(void)
+{
+  rpl_instance_t *instance;
+  uip_ipaddr_t ipaddr;
+
+  instance = rpl_get_instance(ALARM_INSTANCE);
+  if(instance == NULL || instance->current_dag == NULL ||
+     instance->current_dag->preferred_parent == NULL) {
+    return 0;
+  }
+
+  uip_ip6addr(&ipaddr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&ipaddr, &uip_lladdr);
+  dao_output_target(instance->current_dag->preferred_parent, &ipaddr,
+                    RPL_ZERO_LIFETIME);
+  printf("Withdrew the route in the alarm instance\n");
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_message(const char *type, unsigned number)
+{
+  uip_ipaddr_t addr;
+  char buf[20];
+
+  uip_ip6addr(&addr, 0xaaaa, 0, 0, 0, 0x0203, 0x003, 0x003, 0x003);
+
+  printf("Sending %s %u\n", type, number);
+  sprintf(buf, "%s %u", type, number);
+  simple_udp_sendto(&unicast_connection, buf, strlen(buf) + 1, &addr);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(alarm_sender_process, ev, data)
+{
+  static struct etimer periodic_timer;
+  static struct etimer send_timer;
+  static unsigned message_number;
+  static uint8_t joined;
+  static uint8_t withdrawn;
+  rpl_instance_t *instance;
+
+  PROCESS_BEGIN();
+
+  set_global_address();
+
+  simple_udp_register(&unicast_connection, UDP_PORT,
+                      NULL, UDP_PORT, receiver);
+
+  etimer_set(&periodic_timer, SEND_INTERVAL);
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&periodic_timer));
+    etimer_reset(&periodic_timer);
+
+    instance = rpl_get_instance(ALARM_INSTANCE);
+    if(!joined && instance != NULL) {
+      joined = 1;
+      printf("Joined the alarm instance with OCP %u\n", instance->of->ocp);
+    }
+
+    /* Bulk data goes in the default instance, and the alarms in the
+       alarm instance that the node has joined next to it. */
+    send_message("Bulk", message_number);
+
+    etimer_set(&send_timer, SEND_TIME);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&send_timer));
+
+    if(rpl_set_output_instance(ALARM_INSTANCE)) {
+      send_message("Alarm", message_number);
+    } else {
+      printf("Not in the alarm instance yet\n");
+    }
+    message_number++;
+
+    if(!withdrawn && alarm_echoes >= WITHDRAW_AFTER_ALARMS) {
+      withdrawn = withdraw_alarm_route();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2014, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+#include "contiki.h"
+#include "sys/etimer.h"
+#include "sys/node-id.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/rpl/rpl.h"
+#include "net/rpl/rpl-private.h"
+
+#include <stdio.h>
+
+/* Node 1 is the root. The other nodes that run this code are routers,
+   which forward the DAO targets of their children. */
+#define ROOT_ID 1
+
+#define REPORT_INTERVAL (10 * CLOCK_SECOND)
+
+/*---------------------------------------------------------------------------*/
+PROCESS(dao_aggregation_process, "DAO aggregation process");
+AUTOSTART_PROCESSES(&dao_aggregation_process);
+/*---------------------------------------------------------------------------*/
+static uip_ipaddr_t *
+set_global_address(void)
+{
+  static uip_ipaddr_t ipaddr;
+
+  uip_ip6addr(&ipaddr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&ipaddr, &uip_lladdr);
+  uip_ds6_addr_add(&ipaddr, 0, ADDR_AUTOCONF);
+
+  return &ipaddr;
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_rpl_dag(uip_ipaddr_t *ipaddr)
+{
+  rpl_dag_t *dag;
+  uip_ipaddr_t prefix;
+
+  dag = rpl_set_root(RPL_DEFAULT_INSTANCE, ipaddr);
+  if(dag == NULL) {
+    printf("failed to create a new RPL DAG\n");
+    return;
+  }
+  uip_ip6addr(&prefix, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  rpl_set_prefix(dag, &prefix, 64);
+  printf("created a new RPL DAG\n");
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(dao_aggregation_process, ev, data)
+{
+  static struct etimer et;
+  uip_ipaddr_t *ipaddr;
+
+  PROCESS_BEGIN();
+
+  ipaddr = set_global_address();
+  if(node_id == ROOT_ID) {
+    create_rpl_dag(ipaddr);
+  }
+
+  etimer_set(&et, REPORT_INTERVAL);
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    etimer_reset(&et);
+
+    printf("%s: routes %d, DAOs sent %u, targets merged %u, replaced %u\n",
+           node_id == ROOT_ID ? "Root" : "Router",
+           uip_ds6_route_num_routes(), rpl_stats.dao_sent,
+           rpl_stats.dao_merged, rpl_stats.dao_replaced);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
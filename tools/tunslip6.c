@@ -48,6 +48,7 @@
 #include <signal.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -57,25 +58,62 @@
 #include <err.h>
 
 int verbose = 1;
-const char *ipaddr;
 const char *netmask;
-int slipfd = 0;
-uint16_t basedelay=0,delaymsec=0;
-uint32_t startsec,startmsec,delaystartsec,delaystartmsec;
+uint16_t basedelay=0;
+uint32_t startsec,startmsec;
 int timestamp = 0, flowcontrol=0;
 
+#define SLIP_BUF_SIZE 2000
+#define MAX_LINKS     8
+
+struct slip_stats {
+  unsigned long rx_bytes, rx_packets, rx_errors;
+  unsigned long tx_bytes, tx_packets, tx_errors;
+};
+
+/*
+ * A link connects one serial device (or TCP connection) to one TUN/TAP
+ * interface. Each link has its own SLIP decoder state, output queue,
+ * packet delay and statistics.
+ */
+struct slip_link {
+  const char *siodev;
+  const char *host;
+  const char *port;
+  const char *ipaddr;
+  char tundev[1024];
+  int slipfd;
+  int tunfd;
+
+  /* SLIP decoder state. */
+  unsigned char inbuf[SLIP_BUF_SIZE];
+  int inbufptr;
+  int in_esc;
+  int in_overflow;
+
+  /* Escaped data waiting to be written to the serial line. */
+  unsigned char slip_buf[2 * SLIP_BUF_SIZE + 2];
+  int slip_begin, slip_end;
+
+  uint16_t delaymsec;
+  uint32_t delaystartsec, delaystartmsec;
+
+  struct slip_stats stats;
+};
+
+struct slip_link links[MAX_LINKS];
+int nlinks = 0;
+
 int ssystem(const char *fmt, ...)
      __attribute__((__format__ (__printf__, 1, 2)));
-void write_to_serial(int outfd, void *inbuf, int len);
+void write_to_serial(struct slip_link *l, const void *inbuf, int len);
 
-void slip_send(int fd, unsigned char c);
-void slip_send_char(int fd, unsigned char c);
+void slip_send(struct slip_link *l, unsigned char c);
+void slip_send_char(struct slip_link *l, unsigned char c);
 
 //#define PROGRESS(s) fprintf(stderr, s)
 #define PROGRESS(s) do { } while (0)
 
-char tundev[1024] = { "" };
-
 int
 ssystem(const char *fmt, ...) __attribute__((__format__ (__printf__, 1, 2)));
 
@@ -151,237 +189,351 @@ is_sensible_string(const unsigned char *s, int len)
 }
 
 /*
- * Read from serial, when we have a packet write it to tun. No output
- * buffering, input buffered by stdio.
+ * Find the first SLIP_END or SLIP_ESC in buf, or return end.
  */
-void
-serial_to_tun(FILE *inslip, int outfd)
+static const unsigned char *
+find_special(const unsigned char *buf, const unsigned char *end)
 {
-  static union {
-    unsigned char inbuf[2000];
-  } uip;
-  static int inbufptr = 0;
-  int ret,i;
-  unsigned char c;
+  const unsigned char *e, *esc;
 
-#ifdef linux
-  ret = fread(&c, 1, 1, inslip);
-  if(ret == -1 || ret == 0) err(1, "serial_to_tun: read");
-  goto after_fread;
-#endif
-
- read_more:
-  if(inbufptr >= sizeof(uip.inbuf)) {
-     if(timestamp) stamptime();
-     fprintf(stderr, "*** dropping large %d byte packet\n",inbufptr);
-	 inbufptr = 0;
-  }
-  ret = fread(&c, 1, 1, inslip);
-#ifdef linux
- after_fread:
-#endif
-  if(ret == -1) {
-    err(1, "serial_to_tun: read");
+  e = memchr(buf, SLIP_END, end - buf);
+  esc = memchr(buf, SLIP_ESC, (e != NULL ? e : end) - buf);
+  if(esc != NULL) {
+    return esc;
   }
-  if(ret == 0) {
-    clearerr(inslip);
-    return;
-  }
-  /*  fprintf(stderr, ".");*/
-  switch(c) {
-  case SLIP_END:
-    if(inbufptr > 0) {
-      if(uip.inbuf[0] == '!') {
-	if(uip.inbuf[1] == 'M') {
-	  /* Read gateway MAC address and autoconfigure tap0 interface */
-	  char macs[24];
-	  int i, pos;
-	  for(i = 0, pos = 0; i < 16; i++) {
-	    macs[pos++] = uip.inbuf[2 + i];
-	    if((i & 1) == 1 && i < 14) {
-	      macs[pos++] = ':';
-	    }
-	  }
-          if(timestamp) stamptime();
-	  macs[pos] = '\0';
-//	  printf("*** Gateway's MAC address: %s\n", macs);
-	  fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s down", tundev);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s hw ether %s", tundev, &macs[6]);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s up", tundev);
+  return e != NULL ? e : end;
+}
+
+/*
+ * Handle a complete frame received from the serial line.
+ */
+static void
+slip_input_frame(struct slip_link *l)
+{
+  unsigned char *inbuf = l->inbuf;
+  int inbufptr = l->inbufptr;
+  int i;
+
+  if(inbuf[0] == '!') {
+    if(inbuf[1] == 'M') {
+      /* Read gateway MAC address and autoconfigure tap0 interface */
+      char macs[24];
+      int i, pos;
+      for(i = 0, pos = 0; i < 16; i++) {
+	macs[pos++] = inbuf[2 + i];
+	if((i & 1) == 1 && i < 14) {
+	  macs[pos++] = ':';
 	}
-      } else if(uip.inbuf[0] == '?') {
-	if(uip.inbuf[1] == 'P') {
-          /* Prefix info requested */
-          struct in6_addr addr;
-	  int i;
-	  char *s = strchr(ipaddr, '/');
-	  if(s != NULL) {
-	    *s = '\0';
-	  }
-          inet_pton(AF_INET6, ipaddr, &addr);
-          if(timestamp) stamptime();
-          fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
- //         printf("*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
-		 ipaddr, 
-		 addr.s6_addr[0], addr.s6_addr[1],
-		 addr.s6_addr[2], addr.s6_addr[3],
-		 addr.s6_addr[4], addr.s6_addr[5],
-		 addr.s6_addr[6], addr.s6_addr[7]);
-	  slip_send(slipfd, '!');
-	  slip_send(slipfd, 'P');
-	  for(i = 0; i < 8; i++) {
-	    /* need to call the slip_send_char for stuffing */
-	    slip_send_char(slipfd, addr.s6_addr[i]);
-	  }
-	  slip_send(slipfd, SLIP_END);
-        }
+      }
+      if(timestamp) stamptime();
+      macs[pos] = '\0';
+      fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s down", l->tundev);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s hw ether %s", l->tundev, &macs[6]);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s up", l->tundev);
+    }
+  } else if(inbuf[0] == '?') {
+    if(inbuf[1] == 'P') {
+      /* Prefix info requested */
+      struct in6_addr addr;
+      int i;
+      char ipaddr[INET6_ADDRSTRLEN + 4];
+      char *s;
+      strncpy(ipaddr, l->ipaddr, sizeof(ipaddr) - 1);
+      ipaddr[sizeof(ipaddr) - 1] = '\0';
+      s = strchr(ipaddr, '/');
+      if(s != NULL) {
+	*s = '\0';
+      }
+      inet_pton(AF_INET6, ipaddr, &addr);
+      if(timestamp) stamptime();
+      fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
+	     ipaddr,
+	     addr.s6_addr[0], addr.s6_addr[1],
+	     addr.s6_addr[2], addr.s6_addr[3],
+	     addr.s6_addr[4], addr.s6_addr[5],
+	     addr.s6_addr[6], addr.s6_addr[7]);
+      slip_send(l, '!');
+      slip_send(l, 'P');
+      for(i = 0; i < 8; i++) {
+	/* need to call the slip_send_char for stuffing */
+	slip_send_char(l, addr.s6_addr[i]);
+      }
+      slip_send(l, SLIP_END);
+    }
 #define DEBUG_LINE_MARKER '\r'
-      } else if(uip.inbuf[0] == DEBUG_LINE_MARKER) {    
-	fwrite(uip.inbuf + 1, inbufptr - 1, 1, stdout);
-      } else if(is_sensible_string(uip.inbuf, inbufptr)) {
-        if(verbose==1) {   /* strings already echoed below for verbose>1 */
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-        }
-      } else {
-        if(verbose>2) {
-          if (timestamp) stamptime();
-          printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
-          if (verbose>4) {
+  } else if(inbuf[0] == DEBUG_LINE_MARKER) {
+    fwrite(inbuf + 1, inbufptr - 1, 1, stdout);
+  } else if(is_sensible_string(inbuf, inbufptr)) {
+    if(verbose==1) {   /* strings already echoed below for verbose>1 */
+      if (timestamp) stamptime();
+      fwrite(inbuf, inbufptr, 1, stdout);
+    }
+  } else {
+    if(verbose>2) {
+      if (timestamp) stamptime();
+      printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
+      if (verbose>4) {
 #if WIRESHARK_IMPORT_FORMAT
-            printf("0000");
-	        for(i = 0; i < inbufptr; i++) printf(" %02x",uip.inbuf[i]);
+	printf("0000");
+	for(i = 0; i < inbufptr; i++) printf(" %02x",inbuf[i]);
 #else
-            printf("         ");
-            for(i = 0; i < inbufptr; i++) {
-              printf("%02x", uip.inbuf[i]);
-              if((i & 3) == 3) printf(" ");
-              if((i & 15) == 15) printf("\n         ");
-            }
-#endif
-            printf("\n");
-          }
-        }
-	if(write(outfd, uip.inbuf, inbufptr) != inbufptr) {
-	  err(1, "serial_to_tun: write");
+	printf("         ");
+	for(i = 0; i < inbufptr; i++) {
+	  printf("%02x", inbuf[i]);
+	  if((i & 3) == 3) printf(" ");
+	  if((i & 15) == 15) printf("\n         ");
 	}
+#endif
+	printf("\n");
       }
-      inbufptr = 0;
     }
-    break;
+    if(write(l->tunfd, inbuf, inbufptr) != inbufptr) {
+      err(1, "serial_to_tun: write");
+    }
+    l->stats.rx_packets++;
+  }
+}
 
-  case SLIP_ESC:
-    if(fread(&c, 1, 1, inslip) != 1) {
-      clearerr(inslip);
-      /* Put ESC back and give up! */
-      ungetc(SLIP_ESC, inslip);
-      return;
+/*
+ * Append unescaped frame data to the input buffer.
+ */
+static void
+slip_input_data(struct slip_link *l, const unsigned char *data, int len)
+{
+  const unsigned char *nl;
+  int i, n;
+
+  while(len > 0) {
+    n = len;
+
+    /* Echo lines as they are received for verbose=2,3,5+ */
+    if((verbose==2) || (verbose==3) || (verbose>4)) {
+      nl = memchr(data, '\n', len);
+      if(nl != NULL) {
+	n = nl - data + 1;
+      }
     }
 
-    switch(c) {
-    case SLIP_ESC_END:
-      c = SLIP_END;
-      break;
-    case SLIP_ESC_ESC:
-      c = SLIP_ESC;
-      break;
+    if(!l->in_overflow) {
+      if(l->inbufptr + n > sizeof(l->inbuf)) {
+	if(timestamp) stamptime();
+	fprintf(stderr, "*** dropping large %d byte packet\n", l->inbufptr + n);
+	l->in_overflow = 1;
+	l->inbufptr = 0;
+	l->stats.rx_errors++;
+      } else {
+	memcpy(l->inbuf + l->inbufptr, data, n);
+	l->inbufptr += n;
+
+	if((verbose==2) || (verbose==3) || (verbose>4)) {
+	  if(data[n - 1] == '\n' && is_sensible_string(l->inbuf, l->inbufptr)) {
+	    if (timestamp) stamptime();
+	    fwrite(l->inbuf, l->inbufptr, 1, stdout);
+	    l->inbufptr = 0;
+	  }
+	}
+      }
     }
-    /* FALLTHROUGH */
-  default:
-    uip.inbuf[inbufptr++] = c;
 
-    /* Echo lines as they are received for verbose=2,3,5+ */
     /* Echo all printable characters for verbose==4 */
-    if((verbose==2) || (verbose==3) || (verbose>4)) {
-      if(c=='\n') {
-        if(is_sensible_string(uip.inbuf, inbufptr)) {
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-          inbufptr=0;
-        }
+    if(verbose==4) {
+      for(i = 0; i < n; i++) {
+	unsigned char c = data[i];
+	if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
+	  fwrite(&c, 1, 1, stdout);
+	  if(c=='\n') if(timestamp) stamptime();
+	}
+      }
+    }
+
+    data += n;
+    len -= n;
+  }
+}
+
+/*
+ * Decode a chunk of SLIP data. The chunk may contain any number of
+ * frames and may end in the middle of a frame or an escape sequence.
+ */
+void
+slip_decode(struct slip_link *l, const unsigned char *buf, int len)
+{
+  const unsigned char *end = buf + len;
+  const unsigned char *p;
+  unsigned char c;
+
+  while(buf < end) {
+    if(l->in_esc) {
+      l->in_esc = 0;
+      c = *buf++;
+      switch(c) {
+      case SLIP_ESC_END:
+	c = SLIP_END;
+	break;
+      case SLIP_ESC_ESC:
+	c = SLIP_ESC;
+	break;
       }
-    } else if(verbose==4) {
-      if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
-	fwrite(&c, 1, 1, stdout);
-        if(c=='\n') if(timestamp) stamptime();
+      slip_input_data(l, &c, 1);
+      continue;
+    }
+
+    /* Copy everything up to the next special character at once. */
+    p = find_special(buf, end);
+    if(p > buf) {
+      slip_input_data(l, buf, p - buf);
+      buf = p;
+    }
+    if(buf == end) {
+      break;
+    }
+
+    if(*buf == SLIP_END) {
+      if(l->in_overflow) {
+	l->in_overflow = 0;
+      } else if(l->inbufptr > 0) {
+	slip_input_frame(l);
       }
+      l->inbufptr = 0;
+    } else {
+      l->in_esc = 1;
     }
-    
-    break;
+    buf++;
   }
+}
 
-  goto read_more;
+/*
+ * Read from serial, when we have a packet write it to tun. No output
+ * buffering, input is read in blocks and decoded a chunk at a time.
+ */
+void
+serial_to_tun(struct slip_link *l)
+{
+  unsigned char buf[4096];
+  int ret;
+
+  ret = read(l->slipfd, buf, sizeof(buf));
+  if(ret == -1) {
+    if(errno == EAGAIN || errno == EINTR) {
+      return;
+    }
+    err(1, "serial_to_tun: read");
+  }
+  if(ret == 0) {
+    errx(1, "serial_to_tun: end of file on %s",
+	 l->host != NULL ? l->host : l->siodev);
+  }
+
+  l->stats.rx_bytes += ret;
+  slip_decode(l, buf, ret);
 }
 
-unsigned char slip_buf[2000];
-int slip_end, slip_begin;
+static const unsigned char slip_end_seq[] = { SLIP_END };
+static const unsigned char slip_esc_end_seq[] = { SLIP_ESC, SLIP_ESC_END };
+static const unsigned char slip_esc_esc_seq[] = { SLIP_ESC, SLIP_ESC_ESC };
 
 void
-slip_send_char(int fd, unsigned char c)
+slip_send_char(struct slip_link *l, unsigned char c)
 {
   switch(c) {
   case SLIP_END:
-    slip_send(fd, SLIP_ESC);
-    slip_send(fd, SLIP_ESC_END);
+    slip_send(l, SLIP_ESC);
+    slip_send(l, SLIP_ESC_END);
     break;
   case SLIP_ESC:
-    slip_send(fd, SLIP_ESC);
-    slip_send(fd, SLIP_ESC_ESC);
+    slip_send(l, SLIP_ESC);
+    slip_send(l, SLIP_ESC_ESC);
     break;
   default:
-    slip_send(fd, c);
+    slip_send(l, c);
     break;
   }
 }
 
-void
-slip_send(int fd, unsigned char c)
+static void
+slip_send_buf(struct slip_link *l, const void *buf, int len)
 {
-  if(slip_end >= sizeof(slip_buf)) {
+  if(l->slip_end + len > sizeof(l->slip_buf)) {
     err(1, "slip_send overflow");
   }
-  slip_buf[slip_end] = c;
-  slip_end++;
+  memcpy(l->slip_buf + l->slip_end, buf, len);
+  l->slip_end += len;
+}
+
+void
+slip_send(struct slip_link *l, unsigned char c)
+{
+  slip_send_buf(l, &c, 1);
 }
 
 int
-slip_empty()
+slip_empty(struct slip_link *l)
 {
-  return slip_end == 0;
+  return l->slip_end == 0;
 }
 
 void
-slip_flushbuf(int fd)
+slip_flushbuf(struct slip_link *l)
 {
   int n;
   
-  if(slip_empty()) {
+  if(slip_empty(l)) {
     return;
   }
 
-  n = write(fd, slip_buf + slip_begin, (slip_end - slip_begin));
+  n = write(l->slipfd, l->slip_buf + l->slip_begin,
+	    (l->slip_end - l->slip_begin));
 
   if(n == -1 && errno != EAGAIN) {
     err(1, "slip_flushbuf write failed");
   } else if(n == -1) {
     PROGRESS("Q");		/* Outqueueis full! */
   } else {
-    slip_begin += n;
-    if(slip_begin == slip_end) {
-      slip_begin = slip_end = 0;
+    l->slip_begin += n;
+    l->stats.tx_bytes += n;
+    if(l->slip_begin == l->slip_end) {
+      l->slip_begin = l->slip_end = 0;
     }
   }
 }
 
+/*
+ * Escape a packet into the output buffer.
+ */
+static void
+slip_encode(struct slip_link *l, const unsigned char *p, int len)
+{
+  const unsigned char *end = p + len;
+  const unsigned char *q;
+
+  while(p < end) {
+    q = find_special(p, end);
+    if(q > p) {
+      slip_send_buf(l, p, q - p);
+    }
+    if(q == end) {
+      break;
+    }
+    slip_send_buf(l, *q == SLIP_END ? slip_esc_end_seq : slip_esc_esc_seq, 2);
+    p = q + 1;
+  }
+  slip_send(l, SLIP_END);
+}
+
+#define SLIP_IOV_MAX 64
+
 void
-write_to_serial(int outfd, void *inbuf, int len)
+write_to_serial(struct slip_link *l, const void *inbuf, int len)
 {
-  u_int8_t *p = inbuf;
-  int i;
+  const u_int8_t *p = inbuf;
+  const u_int8_t *end = p + len;
+  const u_int8_t *q;
+  struct iovec iov[SLIP_IOV_MAX];
+  int iovcnt, i, n;
 
   if(verbose>2) {
     if (timestamp) stamptime();
@@ -401,28 +553,73 @@ write_to_serial(int outfd, void *inbuf, int len)
       printf("\n");
     }
   }
+  l->stats.tx_packets++;
 
   /* It would be ``nice'' to send a SLIP_END here but it's not
    * really necessary.
    */
-  /* slip_send(outfd, SLIP_END); */
+  /* slip_send(l, SLIP_END); */
 
-  for(i = 0; i < len; i++) {
-    switch(p[i]) {
-    case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
-      break;
-    case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
-      break;
-    default:
-      slip_send(outfd, p[i]);
+  if(!slip_empty(l)) {
+    /* Keep the order of the data that is already queued. */
+    slip_encode(l, p, len);
+    PROGRESS("t");
+    return;
+  }
+
+  /*
+   * Write the packet with a single writev(), with the unescaped runs
+   * taken directly from the packet and the escape sequences in between.
+   */
+  for(iovcnt = 0; p < end && iovcnt < SLIP_IOV_MAX - 2;) {
+    q = find_special(p, end);
+    if(q > p) {
+      iov[iovcnt].iov_base = (void *)p;
+      iov[iovcnt].iov_len = q - p;
+      iovcnt++;
+    }
+    if(q == end) {
+      p = end;
       break;
     }
+    iov[iovcnt].iov_base = (void *)(*q == SLIP_END ?
+				    slip_esc_end_seq : slip_esc_esc_seq);
+    iov[iovcnt].iov_len = 2;
+    iovcnt++;
+    p = q + 1;
+  }
+
+  if(p < end) {
+    /* Too many escape sequences for one vector. */
+    slip_encode(l, inbuf, len);
+    slip_flushbuf(l);
+    PROGRESS("t");
+    return;
+  }
+
+  iov[iovcnt].iov_base = (void *)slip_end_seq;
+  iov[iovcnt].iov_len = 1;
+  iovcnt++;
+
+  n = writev(l->slipfd, iov, iovcnt);
+  if(n == -1) {
+    if(errno != EAGAIN) {
+      err(1, "write_to_serial: writev");
+    }
+    l->stats.tx_errors++;
+    n = 0;
+  }
+  l->stats.tx_bytes += n;
+
+  /* Queue the part that could not be written. */
+  for(i = 0; i < iovcnt; i++) {
+    if(n >= iov[i].iov_len) {
+      n -= iov[i].iov_len;
+    } else {
+      slip_send_buf(l, (const char *)iov[i].iov_base + n, iov[i].iov_len - n);
+      n = 0;
+    }
   }
-  slip_send(outfd, SLIP_END);
   PROGRESS("t");
 }
 
@@ -431,19 +628,33 @@ write_to_serial(int outfd, void *inbuf, int len)
  * Read from tun, write to slip.
  */
 int
-tun_to_serial(int infd, int outfd)
+tun_to_serial(struct slip_link *l)
 {
   struct {
-    unsigned char inbuf[2000];
+    unsigned char inbuf[SLIP_BUF_SIZE];
   } uip;
   int size;
 
-  if((size = read(infd, uip.inbuf, 2000)) == -1) err(1, "tun_to_serial: read");
+  if((size = read(l->tunfd, uip.inbuf, sizeof(uip.inbuf))) == -1) err(1, "tun_to_serial: read");
 
-  write_to_serial(outfd, uip.inbuf, size);
+  write_to_serial(l, uip.inbuf, size);
   return size;
 }
 
+void
+print_stats(void)
+{
+  struct slip_link *l;
+
+  for(l = links; l < links + nlinks; l++) {
+    if (timestamp) stamptime();
+    fprintf(stderr, "*** %s: rx %lu bytes %lu packets %lu errors,"
+	    " tx %lu bytes %lu packets %lu errors\n", l->tundev,
+	    l->stats.rx_bytes, l->stats.rx_packets, l->stats.rx_errors,
+	    l->stats.tx_bytes, l->stats.tx_packets, l->stats.tx_errors);
+  }
+}
+
 #ifndef BAUDRATE
 #define BAUDRATE B115200
 #endif
@@ -544,7 +755,7 @@ tun_alloc(char *dev, int tap)
 #endif
 
 void
-cleanup(void)
+cleanup_link(const char *tundev, const char *ipaddr)
 {
 #ifndef __APPLE__
   if (timestamp) stamptime();
@@ -573,6 +784,19 @@ cleanup(void)
 #endif
 }
 
+void
+cleanup(void)
+{
+  struct slip_link *l;
+
+  print_stats();
+  for(l = links; l < links + nlinks; l++) {
+    if(l->tunfd > 0) {
+      cleanup_link(l->tundev, l->ipaddr);
+    }
+  }
+}
+
 void
 sigcleanup(int signo)
 {
@@ -581,6 +805,13 @@ sigcleanup(int signo)
 }
 
 static int got_sigalarm;
+static volatile sig_atomic_t got_sigusr1;
+
+void
+sigusr1(int signo)
+{
+  got_sigusr1 = 1;
+}
 
 void
 sigalarm(int signo)
@@ -685,21 +916,108 @@ ifconf(const char *tundev, const char *ipaddr)
   ssystem("ifconfig %s\n", tundev);
 }
 
+/*
+ * Open the serial device or TCP connection of a link.
+ */
+void
+link_open_slip(struct slip_link *l)
+{
+  if(l->host != NULL) {
+    struct addrinfo hints, *servinfo, *p;
+    int rv;
+    char s[INET6_ADDRSTRLEN];
+
+    if(l->port == NULL) {
+      l->port = "60001";
+    }
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if((rv = getaddrinfo(l->host, l->port, &hints, &servinfo)) != 0) {
+      err(1, "getaddrinfo: %s", gai_strerror(rv));
+    }
+
+    /* loop through all the results and connect to the first we can */
+    for(p = servinfo; p != NULL; p = p->ai_next) {
+      if((l->slipfd = socket(p->ai_family, p->ai_socktype,
+                             p->ai_protocol)) == -1) {
+        perror("client: socket");
+        continue;
+      }
+
+      if(connect(l->slipfd, p->ai_addr, p->ai_addrlen) == -1) {
+        close(l->slipfd);
+        perror("client: connect");
+        continue;
+      }
+      break;
+    }
+
+    if(p == NULL) {
+      err(1, "can't connect to ``%s:%s''", l->host, l->port);
+    }
+
+    fcntl(l->slipfd, F_SETFL, O_NONBLOCK);
+
+    inet_ntop(p->ai_family, get_in_addr((struct sockaddr *)p->ai_addr),
+              s, sizeof(s));
+    fprintf(stderr, "slip connected to ``%s:%s''\n", s, l->port);
+
+    /* all done with this structure */
+    freeaddrinfo(servinfo);
+
+  } else {
+    if(l->siodev != NULL) {
+      l->slipfd = devopen(l->siodev, O_RDWR | O_NONBLOCK);
+      if(l->slipfd == -1) {
+	err(1, "can't open siodev ``/dev/%s''", l->siodev);
+      }
+    } else {
+      static const char *siodevs[] = {
+        "ttyUSB0", "cuaU0", "ucom0" /* linux, fbsd6, fbsd5 */
+      };
+      int i;
+      for(i = 0; i < 3; i++) {
+        l->siodev = siodevs[i];
+        l->slipfd = devopen(l->siodev, O_RDWR | O_NONBLOCK);
+        if(l->slipfd != -1) {
+          break;
+        }
+      }
+      if(l->slipfd == -1) {
+        err(1, "can't open siodev");
+      }
+    }
+    if (timestamp) stamptime();
+    fprintf(stderr, "********SLIP started on ``/dev/%s''\n", l->siodev);
+    stty_telos(l->slipfd);
+  }
+  slip_send(l, SLIP_END);
+}
+
+struct slip_link *
+link_new(void)
+{
+  if(nlinks == MAX_LINKS) {
+    errx(1, "too many links (at most %d)", MAX_LINKS);
+  }
+  return &links[nlinks++];
+}
+
 int
 main(int argc, char **argv)
 {
   int c;
-  int tunfd, maxfd;
+  int maxfd;
   int ret;
   fd_set rset, wset;
-  FILE *inslip;
-  const char *siodev = NULL;
-  const char *host = NULL;
-  const char *port = NULL;
   const char *prog;
   int baudrate = -2;
   int tap = 0;
-  slipfd = 0;
+  int i;
+  struct slip_link *l = NULL;
 
   prog = argv[0];
   setvbuf(stdout, NULL, _IOLBF, 0); /* Line buffered output. */
@@ -719,27 +1037,41 @@ main(int argc, char **argv)
       break;
 
     case 's':
+      /* Each serial device starts a new link. */
+      if(l == NULL || l->siodev != NULL || l->host != NULL) {
+	l = link_new();
+      }
       if(strncmp("/dev/", optarg, 5) == 0) {
-	siodev = optarg + 5;
+	l->siodev = optarg + 5;
       } else {
-	siodev = optarg;
+	l->siodev = optarg;
       }
       break;
 
     case 't':
+      if(l == NULL || *l->tundev != '\0') {
+	l = link_new();
+      }
       if(strncmp("/dev/", optarg, 5) == 0) {
-	strncpy(tundev, optarg + 5, sizeof(tundev));
+	strncpy(l->tundev, optarg + 5, sizeof(l->tundev) - 1);
       } else {
-	strncpy(tundev, optarg, sizeof(tundev));
+	strncpy(l->tundev, optarg, sizeof(l->tundev) - 1);
       }
       break;
 
     case 'a':
-      host = optarg;
+      /* Each server address starts a new link. */
+      if(l == NULL || l->siodev != NULL || l->host != NULL) {
+	l = link_new();
+      }
+      l->host = optarg;
       break;
 
     case 'p':
-      port = optarg;
+      if(l == NULL) {
+	l = link_new();
+      }
+      l->port = optarg;
       break;
 
     case 'd':
@@ -759,8 +1091,9 @@ main(int argc, char **argv)
     case '?':
     case 'h':
     default:
-fprintf(stderr,"usage:  %s [options] ipaddress\n", prog);
+fprintf(stderr,"usage:  %s [options] ipaddress [ipaddress...]\n", prog);
 fprintf(stderr,"example: tunslip6 -L -v2 -s ttyUSB1 aaaa::1/64\n");
+fprintf(stderr,"example: tunslip6 -s ttyUSB0 -t tun0 -s ttyUSB1 -t tun1 aaaa::1/64 bbbb::1/64\n");
 fprintf(stderr,"Options are:\n");
 #ifndef __APPLE__
 fprintf(stderr," -B baudrate    9600,19200,38400,57600,115200 (default),230400,460800,921600\n");
@@ -785,6 +1118,9 @@ fprintf(stderr,"                Actual delay is basedelay*(#6LowPAN fragments) m
 fprintf(stderr,"                -d is equivalent to -d10.\n");
 fprintf(stderr," -a serveraddr  \n");
 fprintf(stderr," -p serverport  \n");
+fprintf(stderr,"Repeat -s or -a (each optionally followed by -t) to serve several\n");
+fprintf(stderr,"links, and give one ipaddress per link. Send SIGUSR1 to print\n");
+fprintf(stderr,"the link statistics.\n");
 exit(1);
       break;
     }
@@ -792,10 +1128,16 @@ exit(1);
   argc -= (optind - 1);
   argv += (optind - 1);
 
-  if(argc != 2 && argc != 3) {
-    err(1, "usage: %s [-B baudrate] [-H] [-L] [-s siodev] [-t tundev] [-T] [-v verbosity] [-d delay] [-a serveraddress] [-p serverport] ipaddress", prog);
+  if(nlinks == 0) {
+    link_new();
+  }
+
+  if(argc < 2 || (argc - 1 != nlinks && !(nlinks == 1 && argc == 3))) {
+    err(1, "usage: %s [-B baudrate] [-H] [-L] [-s siodev] [-t tundev] [-T] [-v verbosity] [-d delay] [-a serveraddress] [-p serverport] ipaddress [ipaddress...]", prog);
+  }
+  for(i = 0; i < nlinks; i++) {
+    links[i].ipaddr = argv[1 + i];
   }
-  ipaddr = argv[1];
 
   switch(baudrate) {
   case -2:
@@ -831,170 +1173,106 @@ exit(1);
     break;
   }
 
-  if(*tundev == '\0') {
-    /* Use default. */
-    if(tap) {
-      strcpy(tundev, "tap0");
-    } else {
-      strcpy(tundev, "tun0");
-    }
-  }
-  if(host != NULL) {
-    struct addrinfo hints, *servinfo, *p;
-    int rv;
-    char s[INET6_ADDRSTRLEN];
-
-    if(port == NULL) {
-      port = "60001";
-    }
-
-    memset(&hints, 0, sizeof hints);
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-
-    if((rv = getaddrinfo(host, port, &hints, &servinfo)) != 0) {
-      err(1, "getaddrinfo: %s", gai_strerror(rv));
-    }
-
-    /* loop through all the results and connect to the first we can */
-    for(p = servinfo; p != NULL; p = p->ai_next) {
-      if((slipfd = socket(p->ai_family, p->ai_socktype,
-                          p->ai_protocol)) == -1) {
-        perror("client: socket");
-        continue;
-      }
-
-      if(connect(slipfd, p->ai_addr, p->ai_addrlen) == -1) {
-        close(slipfd);
-        perror("client: connect");
-        continue;
-      }
-      break;
-    }
-
-    if(p == NULL) {
-      err(1, "can't connect to ``%s:%s''", host, port);
+  for(l = links; l < links + nlinks; l++) {
+    if(*l->tundev == '\0') {
+      /* Use default. */
+      snprintf(l->tundev, sizeof(l->tundev), "%s%d",
+	       tap ? "tap" : "tun", (int)(l - links));
     }
 
-    fcntl(slipfd, F_SETFL, O_NONBLOCK);
-
-    inet_ntop(p->ai_family, get_in_addr((struct sockaddr *)p->ai_addr),
-              s, sizeof(s));
-    fprintf(stderr, "slip connected to ``%s:%s''\n", s, port);
-
-    /* all done with this structure */
-    freeaddrinfo(servinfo);
+    link_open_slip(l);
 
-  } else {
-    if(siodev != NULL) {
-      slipfd = devopen(siodev, O_RDWR | O_NONBLOCK);
-      if(slipfd == -1) {
-	err(1, "can't open siodev ``/dev/%s''", siodev);
-      }
-    } else {
-      static const char *siodevs[] = {
-        "ttyUSB0", "cuaU0", "ucom0" /* linux, fbsd6, fbsd5 */
-      };
-      int i;
-      for(i = 0; i < 3; i++) {
-        siodev = siodevs[i];
-        slipfd = devopen(siodev, O_RDWR | O_NONBLOCK);
-        if(slipfd != -1) {
-          break;
-        }
-      }
-      if(slipfd == -1) {
-        err(1, "can't open siodev");
-      }
-    }
+    l->tunfd = tun_alloc(l->tundev, tap);
+    if(l->tunfd == -1) err(1, "main: open");
     if (timestamp) stamptime();
-    fprintf(stderr, "********SLIP started on ``/dev/%s''\n", siodev);
-    stty_telos(slipfd);
+    fprintf(stderr, "opened %s device ``/dev/%s''\n",
+	    tap ? "tap" : "tun", l->tundev);
   }
-  slip_send(slipfd, SLIP_END);
-  inslip = fdopen(slipfd, "r");
-  if(inslip == NULL) err(1, "main: fdopen");
-
-  tunfd = tun_alloc(tundev, tap);
-  if(tunfd == -1) err(1, "main: open");
-  if (timestamp) stamptime();
-  fprintf(stderr, "opened %s device ``/dev/%s''\n",
-          tap ? "tap" : "tun", tundev);
 
   atexit(cleanup);
   signal(SIGHUP, sigcleanup);
   signal(SIGTERM, sigcleanup);
   signal(SIGINT, sigcleanup);
   signal(SIGALRM, sigalarm);
-  ifconf(tundev, ipaddr);
+  signal(SIGUSR1, sigusr1);
+  for(l = links; l < links + nlinks; l++) {
+    ifconf(l->tundev, l->ipaddr);
+  }
 
   while(1) {
     maxfd = 0;
     FD_ZERO(&rset);
     FD_ZERO(&wset);
 
+    if(got_sigusr1) {
+      got_sigusr1 = 0;
+      print_stats();
+    }
+
 /* do not send IPA all the time... - add get MAC later... */
 /*     if(got_sigalarm) { */
 /*       /\* Send "?IPA". *\/ */
-/*       slip_send(slipfd, '?'); */
-/*       slip_send(slipfd, 'I'); */
-/*       slip_send(slipfd, 'P'); */
-/*       slip_send(slipfd, 'A'); */
-/*       slip_send(slipfd, SLIP_END); */
+/*       slip_send(l, '?'); */
+/*       slip_send(l, 'I'); */
+/*       slip_send(l, 'P'); */
+/*       slip_send(l, 'A'); */
+/*       slip_send(l, SLIP_END); */
 /*       got_sigalarm = 0; */
 /*     } */
 
-    if(!slip_empty()) {		/* Anything to flush? */
-      FD_SET(slipfd, &wset);
-    }
+    for(l = links; l < links + nlinks; l++) {
+      if(!slip_empty(l)) {		/* Anything to flush? */
+	FD_SET(l->slipfd, &wset);
+      }
+
+      FD_SET(l->slipfd, &rset);	/* Read from slip ASAP! */
+      if(l->slipfd > maxfd) maxfd = l->slipfd;
 
-    FD_SET(slipfd, &rset);	/* Read from slip ASAP! */
-    if(slipfd > maxfd) maxfd = slipfd;
-    
-    /* We only have one packet at a time queued for slip output. */
-    if(slip_empty()) {
-      FD_SET(tunfd, &rset);
-      if(tunfd > maxfd) maxfd = tunfd;
+      /* We only have one packet at a time queued for slip output. */
+      if(slip_empty(l)) {
+	FD_SET(l->tunfd, &rset);
+	if(l->tunfd > maxfd) maxfd = l->tunfd;
+      }
     }
 
     ret = select(maxfd + 1, &rset, &wset, NULL, NULL);
     if(ret == -1 && errno != EINTR) {
       err(1, "select");
     } else if(ret > 0) {
-      if(FD_ISSET(slipfd, &rset)) {
-        serial_to_tun(inslip, tunfd);
-      }
-      
-      if(FD_ISSET(slipfd, &wset)) {
-	slip_flushbuf(slipfd);
-	sigalarm_reset();
-      }
- 
-      /* Optional delay between outgoing packets */
-      /* Base delay times number of 6lowpan fragments to be sent */
-      if(delaymsec) {
-       struct timeval tv;
-       int dmsec;
-       gettimeofday(&tv, NULL) ;
-       dmsec=(tv.tv_sec-delaystartsec)*1000+tv.tv_usec/1000-delaystartmsec;
-       if(dmsec<0) delaymsec=0;
-       if(dmsec>delaymsec) delaymsec=0;
-      }
-      if(delaymsec==0) {
-        int size;
-        if(slip_empty() && FD_ISSET(tunfd, &rset)) {
-          size=tun_to_serial(tunfd, slipfd);
-          slip_flushbuf(slipfd);
-          sigalarm_reset();
-          if(basedelay) {
-            struct timeval tv;
-            gettimeofday(&tv, NULL) ;
- //         delaymsec=basedelay*(1+(size/120));//multiply by # of 6lowpan packets?
-            delaymsec=basedelay;
-            delaystartsec =tv.tv_sec;
-            delaystartmsec=tv.tv_usec/1000;
-          }
-        }
+      for(l = links; l < links + nlinks; l++) {
+	if(FD_ISSET(l->slipfd, &rset)) {
+	  serial_to_tun(l);
+	}
+
+	if(FD_ISSET(l->slipfd, &wset)) {
+	  slip_flushbuf(l);
+	  sigalarm_reset();
+	}
+
+	/* Optional delay between outgoing packets */
+	/* Base delay times number of 6lowpan fragments to be sent */
+	if(l->delaymsec) {
+	  struct timeval tv;
+	  int dmsec;
+	  gettimeofday(&tv, NULL) ;
+	  dmsec=(tv.tv_sec-l->delaystartsec)*1000+tv.tv_usec/1000-l->delaystartmsec;
+	  if(dmsec<0) l->delaymsec=0;
+	  if(dmsec>l->delaymsec) l->delaymsec=0;
+	}
+	if(l->delaymsec==0) {
+	  if(slip_empty(l) && FD_ISSET(l->tunfd, &rset)) {
+	    tun_to_serial(l);
+	    slip_flushbuf(l);
+	    sigalarm_reset();
+	    if(basedelay) {
+	      struct timeval tv;
+	      gettimeofday(&tv, NULL) ;
+	      l->delaymsec=basedelay;
+	      l->delaystartsec =tv.tv_sec;
+	      l->delaystartmsec=tv.tv_usec/1000;
+	    }
+	  }
+	}
       }
     }
   }